@@ -0,0 +1,645 @@
+#include "AssetLoader.h"
+#include "DDSTextureLoader.h"
+#include "TextureCompressor.h"
+#include "ResourceRegistry.h"
+#include <Windows.h>
+#include <wincodec.h>
+#include <cstdio>
+#include <cfloat>
+
+#pragma comment(lib, "windowscodecs.lib")
+
+//streamed mip loads going at once, so they never crowd out the first loads of everything else
+static const unsigned int MaxStreamingLoads = 4;
+
+//flat colored textures keep BC1 (half the size of BC7) if it's at least this close to the source
+static const float Bc1MinimumPsnr = 40.0f;
+
+//an image decoded on a worker, 4 bytes per pixel with the rows packed together
+struct DecodedImage
+{
+	unsigned int width;
+	unsigned int height;
+	DXGI_FORMAT format;
+	std::vector<unsigned char> pixels;
+};
+
+//decodes from the file's bytes, they've already been read in to hash them
+static bool DecodeImage(IWICImagingFactory* factory, std::vector<unsigned char>& file, DecodedImage& out)
+{
+	if (!factory || file.empty())
+		return false;
+
+	Microsoft::WRL::ComPtr<IWICStream> stream;
+	Microsoft::WRL::ComPtr<IWICBitmapDecoder> decoder;
+	Microsoft::WRL::ComPtr<IWICBitmapFrameDecode> frame;
+	if (FAILED(factory->CreateStream(stream.GetAddressOf())) ||
+		FAILED(stream->InitializeFromMemory(&file[0], (DWORD)file.size())) ||
+		FAILED(factory->CreateDecoderFromStream(stream.Get(), 0, WICDecodeMetadataCacheOnDemand, decoder.GetAddressOf())) ||
+		FAILED(decoder->GetFrame(0, frame.GetAddressOf())))
+		return false;
+
+	UINT width = 0;
+	UINT height = 0;
+	if (FAILED(frame->GetSize(&width, &height)) || width == 0 || height == 0)
+		return false;
+
+	// Decide on srgb the same way DirectXTK's CreateWICTextureFromFile
+	// does by default, so nothing looks different from loading it there
+	bool srgb = false;
+	Microsoft::WRL::ComPtr<IWICMetadataQueryReader> metadata;
+	GUID container = {};
+	if (SUCCEEDED(frame->GetMetadataQueryReader(metadata.GetAddressOf())) && SUCCEEDED(metadata->GetContainerFormat(&container)))
+	{
+		PROPVARIANT value;
+		PropVariantInit(&value);
+		if (container == GUID_ContainerFormatPng)
+		{
+			//pngs say so with an sRGB chunk, or a gamma of 1/2.2
+			if (SUCCEEDED(metadata->GetMetadataByName(L"/sRGB/RenderingIntent", &value)) && value.vt == VT_UI1)
+				srgb = true;
+			else if (SUCCEEDED(metadata->GetMetadataByName(L"/gAMA/ImageGamma", &value)) && value.vt == VT_UI4)
+				srgb = value.uintVal == 45455;
+		}
+		else if (SUCCEEDED(metadata->GetMetadataByName(L"System.Image.ColorSpace", &value)) && value.vt == VT_UI2)
+		{
+			srgb = value.uiVal == 1;
+		}
+		PropVariantClear(&value);
+	}
+
+	// Everything becomes plain 8 bit rgba, whatever the file had
+	Microsoft::WRL::ComPtr<IWICFormatConverter> converter;
+	if (FAILED(factory->CreateFormatConverter(converter.GetAddressOf())) ||
+		FAILED(converter->Initialize(frame.Get(), GUID_WICPixelFormat32bppRGBA, WICBitmapDitherTypeErrorDiffusion, 0, 0, WICBitmapPaletteTypeMedianCut)))
+		return false;
+
+	out.width = width;
+	out.height = height;
+	out.format = srgb ? DXGI_FORMAT_R8G8B8A8_UNORM_SRGB : DXGI_FORMAT_R8G8B8A8_UNORM;
+	out.pixels.resize((size_t)width * height * 4);
+	return SUCCEEDED(converter->CopyPixels(0, width * 4, (UINT)out.pixels.size(), &out.pixels[0]));
+}
+
+static bool ReadWholeFile(const std::wstring& filename, std::vector<unsigned char>& out)
+{
+	HANDLE file = CreateFileW(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	DWORD read = 0;
+	bool success = GetFileSizeEx(file, &size) && size.QuadPart > 0 && size.QuadPart < 0x7FFFFFFF;
+	if (success)
+	{
+		out.resize((size_t)size.QuadPart);
+		success = ReadFile(file, &out[0], (DWORD)out.size(), &read, 0) && read == out.size();
+	}
+	CloseHandle(file);
+	return success;
+}
+
+// Makes the texture and fills in its mips on the gpu, like
+// CreateWICTextureFromFile does when it's given a context
+static Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> CreateTexture(ID3D11Device* device, ID3D11DeviceContext* context, const DecodedImage& image)
+{
+	UINT support = 0;
+	bool autoMips = SUCCEEDED(device->CheckFormatSupport(image.format, &support)) && (support & D3D11_FORMAT_SUPPORT_MIP_AUTOGEN);
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = image.width;
+	desc.Height = image.height;
+	desc.MipLevels = autoMips ? 0 : 1;
+	desc.ArraySize = 1;
+	desc.Format = image.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = autoMips ? D3D11_USAGE_DEFAULT : D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE | (autoMips ? D3D11_BIND_RENDER_TARGET : 0);
+	desc.MiscFlags = autoMips ? D3D11_RESOURCE_MISC_GENERATE_MIPS : 0;
+
+	D3D11_SUBRESOURCE_DATA data = {};
+	data.pSysMem = &image.pixels[0];
+	data.SysMemPitch = image.width * 4;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+	if (FAILED(device->CreateTexture2D(&desc, autoMips ? 0 : &data, texture.GetAddressOf())))
+		return nullptr;
+
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = image.format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	if (FAILED(device->CreateShaderResourceView(texture.Get(), &srvDesc, srv.GetAddressOf())))
+		return nullptr;
+
+	if (autoMips)
+	{
+		context->UpdateSubresource(texture.Get(), 0, 0, data.pSysMem, data.SysMemPitch, 0);
+		context->GenerateMips(srv.Get());
+	}
+	return srv;
+}
+
+//what a texture load hands the device thread - a dds file (imports and cubemaps) or a decoded image
+struct LoadedTexture
+{
+	std::vector<unsigned char> file;
+	unsigned long long contentHash = 0;
+	DecodedImage image;
+	bool onDisk = false;	// the dds is saved as an import too, so its levels can be read back later
+};
+
+static std::wstring GetImportPath(const std::wstring& filename, TextureKind kind)
+{
+	static const wchar_t* importSuffixes[] = { L"", L"color", L"normalmap", L"mask", L"" };
+	return TextureCompressor::GetImportPath(filename, importSuffixes[(int)kind]);
+}
+
+// An import's header is stamped with the file it came from, so
+// only its blocks and their layout are hashed - the same pixels
+// imported from two files then share one texture
+static unsigned long long HashImport(const std::vector<unsigned char>& dds)
+{
+	CompressedTexture layout;
+	size_t blocksOffset = 0;
+	if (!TextureCompressor::ReadDdsLayout(dds, layout, blocksOffset))
+		return TextureCache::HashContents(&dds[0], dds.size());
+
+	unsigned int shape[4] = { layout.width, layout.height, layout.mipCount, (unsigned int)layout.format };
+	unsigned long long hash = TextureCache::HashContents((const unsigned char*)shape, sizeof(shape));
+	return TextureCache::HashContents(&dds[blocksOffset], dds.size() - blocksOffset, hash);
+}
+
+//the worker thread side of every texture load - the import if it's still good, otherwise decoded and imported
+static void ReadTexture(IWICImagingFactory* factory, const std::wstring& filename, TextureKind kind, LoadedTexture& t)
+{
+	//compressed kinds are loaded from their import when it's still good
+	bool compressed = kind == TextureKind::Color || kind == TextureKind::NormalMap || kind == TextureKind::Mask;
+	std::wstring importPath = GetImportPath(filename, kind);
+	if (compressed && TextureCompressor::ReadImport(importPath, filename, t.file))
+	{
+		t.contentHash = HashImport(t.file);
+		t.onDisk = true;
+		return;
+	}
+
+	if (!ReadWholeFile(filename, t.file))
+	{
+		t.file.clear();
+		return;
+	}
+	t.contentHash = TextureCache::HashContents(&t.file[0], t.file.size());
+
+	//cubemaps are made from the file as is on the device thread
+	if (kind == TextureKind::Cubemap)
+		return;
+
+	bool decoded = DecodeImage(factory, t.file, t.image);
+	std::vector<unsigned char>().swap(t.file);
+	if (!decoded)
+	{
+		t.image.pixels.clear();
+		return;
+	}
+	//d3d wants the top level of a block compressed texture in whole blocks, anything else stays rgba8
+	if (!compressed || t.image.width % 4 != 0 || t.image.height % 4 != 0)
+		return;
+
+	// First time this texture's been seen like this - mip and
+	// compress it, and save that for next time
+	ImageRgba source;
+	source.width = t.image.width;
+	source.height = t.image.height;
+	source.pixels.swap(t.image.pixels);
+	bool srgb = t.image.format == DXGI_FORMAT_R8G8B8A8_UNORM_SRGB;
+
+	CompressedTexture texture;
+	if (kind == TextureKind::NormalMap)
+	{
+		TextureCompressor::Compress(source, BlockFormat::BC5, MipFilter::Normal, false, texture);
+	}
+	else if (kind == TextureKind::Mask)
+	{
+		TextureCompressor::Compress(source, BlockFormat::BC4, MipFilter::Linear, false, texture);
+	}
+	else
+	{
+		//BC1 has no real alpha, so only opaque textures get to try it
+		bool opaque = true;
+		for (size_t i = 3; i < source.pixels.size() && opaque; i += 4)
+			opaque = source.pixels[i] == 255;
+		if (opaque)
+			TextureCompressor::Compress(source, BlockFormat::BC1, MipFilter::Color, srgb, texture);
+		if (!opaque || texture.psnr < Bc1MinimumPsnr)
+			TextureCompressor::Compress(source, BlockFormat::BC7, MipFilter::Color, srgb, texture);
+	}
+
+	TextureCompressor::BuildDds(texture, filename, t.file);
+	t.onDisk = TextureCompressor::WriteImport(importPath, t.file);
+	t.contentHash = HashImport(t.file);
+}
+
+AssetLoader::AssetLoader(ResourceRegistry& registry, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int threadCount)
+	: registry(registry), textureStreamer(device, context), geometryArena(device, context)
+{
+	this->device = device;
+	this->context = context;
+	stopping = false;
+	pending = 0;
+	streamingLoads = 0;
+
+	CreatePlaceholders();
+
+	// Leave a core for the device thread, it still has frames to draw
+	if (threadCount == 0)
+	{
+		threadCount = std::thread::hardware_concurrency();
+		threadCount = threadCount > 1 ? threadCount - 1 : 1;
+	}
+	for (unsigned int i = 0; i < threadCount; i++)
+		workers.push_back(std::thread(&AssetLoader::WorkerLoop, this));
+}
+
+AssetLoader::~AssetLoader()
+{
+	//anything not started yet is dropped, the workers only finish what they're holding
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	jobAdded.notify_all();
+	for (auto& w : workers)
+		w.join();
+}
+
+void AssetLoader::WorkerLoop()
+{
+	// WIC is COM, so each worker starts COM and gets its own factory
+	CoInitializeEx(0, COINIT_MULTITHREADED);
+	Microsoft::WRL::ComPtr<IWICImagingFactory> factory;
+	CoCreateInstance(CLSID_WICImagingFactory, 0, CLSCTX_INPROC_SERVER, IID_PPV_ARGS(factory.GetAddressOf()));
+
+	while (true)
+	{
+		Job job;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+			if (stopping)
+				break;
+			job = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		job.load(factory.Get());
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			loaded.push_back(std::move(job));
+		}
+		jobLoaded.notify_one();
+	}
+
+	factory.Reset();
+	CoUninitialize();
+}
+
+void AssetLoader::AddJob(Job& job)
+{
+	//mip loads don't start or hold up the load timer, or keep the loader from looking idle
+	if (job.streaming)
+	{
+		streamingLoads++;
+	}
+	else
+	{
+		if (pending == 0)
+			firstRequest = std::chrono::high_resolution_clock::now();
+		pending++;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	jobAdded.notify_one();
+}
+
+MeshHandle AssetLoader::LoadMesh(const std::string& filename, MeshOptions options)
+{
+	MeshHandle mesh = registry.AddMesh(Mesh(context, options));
+	std::shared_ptr<MeshData> data = std::make_shared<MeshData>();
+
+	Job job;
+	job.load = [filename, options, data](IWICImagingFactory*)
+	{
+		Mesh::LoadData(filename.c_str(), options, *data);
+	};
+	job.create = [this, filename, mesh, data]()
+	{
+		//looked up now, the pool may have moved it since the load started
+		Mesh& loadedMesh = registry.GetMesh(mesh);
+		loadedMesh.Upload(*data, geometryArena);
+#if defined(DEBUG) || defined(_DEBUG)
+		if (!loadedMesh.IsReady())
+			printf("Couldn't load mesh %s\n", filename.c_str());
+#endif
+	};
+	AddJob(job);
+	return mesh;
+}
+
+void AssetLoader::LoadTexture(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady)
+{
+	LoadCachedTexture(filename, kind, onReady);
+}
+
+void AssetLoader::LoadCubemap(const std::wstring& filename, TextureReadyCallback onReady)
+{
+	LoadCachedTexture(filename, TextureKind::Cubemap, onReady);
+}
+
+TextureCache& AssetLoader::GetTextureCache()
+{
+	return textureCache;
+}
+
+std::shared_ptr<StreamedTexture> AssetLoader::LoadStreamedTexture(const std::wstring& filename, TextureKind kind)
+{
+	//already loaded or on its way, everyone asking shares the one texture
+	std::shared_ptr<StreamedTexture> texture;
+	if (textureCache.RequestStreamed(filename, kind, texture))
+		return texture;
+
+	std::shared_ptr<LoadedTexture> loadedTexture = std::make_shared<LoadedTexture>();
+
+	Job job;
+	job.load = [filename, kind, loadedTexture](IWICImagingFactory* factory)
+	{
+		ReadTexture(factory, filename, kind, *loadedTexture);
+	};
+	job.create = [this, filename, kind, texture, loadedTexture]()
+	{
+		LoadedTexture& t = *loadedTexture;
+		unsigned long long gpuBytes = 0;
+		std::shared_ptr<StreamedTexture> same = textureCache.FindStreamedContents(t.contentHash, kind);
+		if (same && (!t.image.pixels.empty() || !t.file.empty()))
+		{
+			//another path had the very same bytes, this one follows its mips along
+			textureStreamer.Share(*same, texture);
+			gpuBytes = !t.image.pixels.empty() ? (unsigned long long)t.image.pixels.size() * 4 / 3 : t.file.size();
+		}
+		else if (!t.image.pixels.empty())
+		{
+			//wasn't imported (an Image, or not in whole blocks), so it's all there from the start
+			texture->srv = CreateTexture(device.Get(), context.Get(), t.image);
+			texture->width = t.image.width;
+			texture->height = t.image.height;
+			gpuBytes = texture->srv ? (unsigned long long)t.image.pixels.size() * 4 / 3 : 0;
+		}
+		else if (!t.file.empty())
+		{
+			if (textureStreamer.Add(texture, GetImportPath(filename, kind), t.file, t.onDisk))
+				gpuBytes = t.file.size();
+		}
+
+		//nobody wants it any more, so it goes straight back out of the streamer
+		if (!textureCache.ResolveStreamed(filename, kind, texture, t.contentHash, gpuBytes))
+			textureStreamer.Remove(texture);
+#if defined(DEBUG) || defined(_DEBUG)
+		if (!texture->srv)
+			printf("Couldn't load texture %ls\n", filename.c_str());
+#endif
+	};
+	AddJob(job);
+	return texture;
+}
+
+void AssetLoader::ReleaseStreamedTexture(const std::wstring& filename, TextureKind kind)
+{
+	std::shared_ptr<StreamedTexture> released;
+	textureCache.ReleaseStreamed(filename, kind, released);
+	if (released)
+		textureStreamer.Remove(released);
+}
+
+TextureStreamer& AssetLoader::GetTextureStreamer()
+{
+	return textureStreamer;
+}
+
+GeometryArena& AssetLoader::GetGeometryArena()
+{
+	return geometryArena;
+}
+
+void AssetLoader::StreamTextures()
+{
+	std::vector<MipLoad> loads;
+	textureStreamer.Plan(MaxStreamingLoads, loads);
+
+	for (auto& l : loads)
+	{
+		std::shared_ptr<MipLoad> load = std::make_shared<MipLoad>(std::move(l));
+
+		Job job;
+		job.load = [load](IWICImagingFactory*)
+		{
+			TextureStreamer::ReadLevels(*load);
+		};
+		job.create = [this, load]()
+		{
+			textureStreamer.FinishLoad(*load);
+		};
+		job.streaming = true;
+		AddJob(job);
+	}
+}
+
+void AssetLoader::LoadCachedTexture(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady)
+{
+	//already loaded or on its way, nothing more to do
+	if (textureCache.Request(filename, kind, onReady))
+		return;
+
+	std::shared_ptr<LoadedTexture> loadedTexture = std::make_shared<LoadedTexture>();
+
+	Job job;
+	job.load = [filename, kind, loadedTexture](IWICImagingFactory* factory)
+	{
+		ReadTexture(factory, filename, kind, *loadedTexture);
+	};
+	job.create = [this, filename, kind, loadedTexture]()
+	{
+		LoadedTexture& t = *loadedTexture;
+		bool fromImage = !t.image.pixels.empty();
+		bool loadedOk = fromImage || !t.file.empty();
+
+		// Another path might have had the very same bytes, in
+		// which case its texture does for this one as well
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+		unsigned long long gpuBytes = 0;
+		if (loadedOk)
+		{
+			srv = textureCache.FindContents(t.contentHash, kind);
+			if (fromImage)
+			{
+				if (!srv)
+					srv = CreateTexture(device.Get(), context.Get(), t.image);
+				//a full mip chain is another third on top of the top level
+				gpuBytes = (unsigned long long)t.image.pixels.size() * 4 / 3;
+			}
+			else
+			{
+				//imports and cubemaps are both dds files by now
+				if (!srv)
+					DirectX::CreateDDSTextureFromMemory(device.Get(), context.Get(), &t.file[0], t.file.size(), 0, srv.GetAddressOf());
+				//near enough, a dds is mostly the texture's own bytes
+				gpuBytes = t.file.size();
+			}
+		}
+
+		//a failed load just keeps its placeholder
+		textureCache.Resolve(filename, kind, srv, t.contentHash, gpuBytes);
+#if defined(DEBUG) || defined(_DEBUG)
+		if (!srv)
+			printf("Couldn't load %s %ls\n", kind == TextureKind::Cubemap ? "cubemap" : "texture", filename.c_str());
+#endif
+	};
+	AddJob(job);
+}
+
+unsigned int AssetLoader::Update(float maxMilliseconds)
+{
+	auto start = std::chrono::high_resolution_clock::now();
+	unsigned int finished = 0;
+
+	while (true)
+	{
+		Job job;
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			if (loaded.empty())
+				break;
+			job = std::move(loaded.front());
+			loaded.pop_front();
+		}
+
+		job.create();
+		auto now = std::chrono::high_resolution_clock::now();
+		if (job.streaming)
+		{
+			streamingLoads--;
+		}
+		else
+		{
+			finished++;
+			pending--;
+			if (pending == 0)
+				lastFinish = now;
+		}
+		if (std::chrono::duration<float, std::milli>(now - start).count() >= maxMilliseconds)
+			break;
+	}
+
+	return finished;
+}
+
+void AssetLoader::Finish()
+{
+	while (pending > 0 || streamingLoads > 0)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobLoaded.wait(lock, [this] { return !loaded.empty(); });
+		}
+		Update(FLT_MAX);
+	}
+}
+
+unsigned int AssetLoader::GetPendingCount()
+{
+	return pending;
+}
+
+bool AssetLoader::IsIdle()
+{
+	return pending == 0;
+}
+
+double AssetLoader::GetLoadSeconds()
+{
+	auto end = pending > 0 ? std::chrono::high_resolution_clock::now() : lastFinish;
+	return std::chrono::duration<double>(end - firstRequest).count();
+}
+
+unsigned int AssetLoader::GetThreadCount()
+{
+	return (unsigned int)workers.size();
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AssetLoader::GetPlaceholder(PlaceholderTexture placeholder)
+{
+	return placeholders[(int)placeholder];
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> AssetLoader::GetPlaceholderCubemap()
+{
+	return placeholderCubemap;
+}
+
+void AssetLoader::CreatePlaceholders()
+{
+	// Single pixel textures, in the same order as PlaceholderTexture
+	const unsigned int colors[(int)PlaceholderTexture::Count] =
+	{
+		0xFFFFFFFF,	// white
+		0xFF000000,	// black
+		0xFF808080,	// gray
+		0xFFFF8080,	// flat normal (0.5, 0.5, 1) - the bytes are r, g, b, a from the low end
+	};
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = 1;
+	desc.Height = 1;
+	desc.MipLevels = 1;
+	desc.ArraySize = 1;
+	desc.Format = DXGI_FORMAT_R8G8B8A8_UNORM;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_IMMUTABLE;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	for (int i = 0; i < (int)PlaceholderTexture::Count; i++)
+	{
+		D3D11_SUBRESOURCE_DATA data = {};
+		data.pSysMem = &colors[i];
+		data.SysMemPitch = 4;
+
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> texture;
+		if (SUCCEEDED(device->CreateTexture2D(&desc, &data, texture.GetAddressOf())))
+			device->CreateShaderResourceView(texture.Get(), 0, placeholders[i].GetAddressOf());
+	}
+
+	// A plain sky colored cube for the sky
+	const unsigned int skyColor = 0xFFBF9966;	// (0.4, 0.6, 0.75)
+	D3D11_SUBRESOURCE_DATA faces[6] = {};
+	for (int i = 0; i < 6; i++)
+	{
+		faces[i].pSysMem = &skyColor;
+		faces[i].SysMemPitch = 4;
+	}
+	desc.ArraySize = 6;
+	desc.MiscFlags = D3D11_RESOURCE_MISC_TEXTURECUBE;
+
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> cube;
+	if (SUCCEEDED(device->CreateTexture2D(&desc, faces, cube.GetAddressOf())))
+	{
+		D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+		srvDesc.Format = desc.Format;
+		srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURECUBE;
+		srvDesc.TextureCube.MipLevels = 1;
+		device->CreateShaderResourceView(cube.Get(), &srvDesc, placeholderCubemap.GetAddressOf());
+	}
+}
@@ -0,0 +1,126 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include "Mesh.h"
+#include "ResourcePool.h"
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+
+struct IWICImagingFactory;
+class ResourceRegistry;
+
+// What a material shows in a texture's place until the real one is loaded
+enum class PlaceholderTexture
+{
+	White,		// ramps and roughness
+	Black,		// metalness
+	Gray,		// albedo
+	FlatNormal,	// normal maps, straight out of the surface
+	Count
+};
+
+// --------------------------------------------------------
+// Background asset loading
+//
+// Reading and decoding (obj parsing and processing, WIC
+// image decodes, dds file reads) happens on a pool of worker
+// threads. Finished cpu side data waits in a queue until the
+// device thread calls Update, which creates the d3d resources
+// a few at a time so no single frame stalls on them.
+//
+// Everything handed out works right away - meshes (made in
+// the registry, their data in a shared GeometryArena) draw
+// nothing and textures are placeholders until they're ready.
+// Textures go through a TextureCache, so asking for the same
+// one again (or a copy of it) shares the first load. Streamed
+// textures do too, and are then handed to a TextureStreamer,
+// which keeps loading their finer mips on the same workers.
+// --------------------------------------------------------
+class AssetLoader
+{
+public:
+	//threadCount 0 uses one worker per core, less the device thread's
+	AssetLoader(ResourceRegistry& registry, Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int threadCount = 0);
+	~AssetLoader();
+
+	//the mesh is added to the registry empty and stays that way until its buffers are made in Update
+	MeshHandle LoadMesh(const std::string& filename, MeshOptions options = MeshOptions());
+	//any image WIC can read - Image keeps it rgba8 with gpu made mips, the other kinds
+	//are imported once to a block compressed dds next to the file and loaded from that
+	void LoadTexture(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady);
+	//a dds file, as is
+	void LoadCubemap(const std::wstring& filename, TextureReadyCallback onReady);
+	//every texture and cubemap load is a reference in here, release them through it
+	TextureCache& GetTextureCache();
+
+	//like LoadTexture, but only the small mips are loaded at first and the streamer brings
+	//in the rest as they're asked for - the texture's srv is null until those first mips are in
+	std::shared_ptr<StreamedTexture> LoadStreamedTexture(const std::wstring& filename, TextureKind kind);
+	//drops one reference taken by LoadStreamedTexture, its mips go once nothing refers to it
+	void ReleaseStreamedTexture(const std::wstring& filename, TextureKind kind);
+	TextureStreamer& GetTextureStreamer();
+	//every loaded mesh's vertices and indices
+	GeometryArena& GetGeometryArena();
+	//starts reading the mips the streamer wants, after this frame's requests - they're swapped in by Update
+	void StreamTextures();
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetPlaceholder(PlaceholderTexture placeholder);
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> GetPlaceholderCubemap();
+
+	//creates the resources for loads that have finished - call once a frame on the device thread
+	//stops once it has spent maxMilliseconds, returns how many assets it finished
+	unsigned int Update(float maxMilliseconds);
+	//blocks until everything requested so far is done
+	void Finish();
+
+	unsigned int GetPendingCount();	// requested but not created yet - streamed mips don't count
+	bool IsIdle();
+	double GetLoadSeconds();		// first request to last finish (or to now, while still loading)
+	unsigned int GetThreadCount();
+
+private:
+	struct Job
+	{
+		std::function<void(IWICImagingFactory*)> load;	// worker thread - files and decoding
+		std::function<void()> create;					// device thread - d3d resources
+		bool streaming = false;							// a mip load for the streamer, not an asset
+	};
+
+	void AddJob(Job& job);
+	void LoadCachedTexture(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady);
+	void WorkerLoop();
+	void CreatePlaceholders();
+
+	ResourceRegistry& registry;
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable jobLoaded;
+	std::deque<Job> jobs;							// waiting for a worker
+	std::deque<Job> loaded;							// waiting for the device thread
+	bool stopping;
+
+	//only touched on the device thread
+	TextureCache textureCache;
+	TextureStreamer textureStreamer;
+	GeometryArena geometryArena;
+	unsigned int pending;
+	unsigned int streamingLoads;	// kept out of pending, they go on all game and aren't loading anything new
+	std::chrono::high_resolution_clock::time_point firstRequest;
+	std::chrono::high_resolution_clock::time_point lastFinish;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholders[(int)PlaceholderTexture::Count];
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> placeholderCubemap;
+};
@@ -0,0 +1,153 @@
+#include "Bounds.h"
+#include <cmath>
+
+using namespace DirectX;
+
+MeshBounds Bounds::Compute(const Vertex* vertices, unsigned int vertexCount)
+{
+	MeshBounds bounds;
+	bounds.box = ComputeAabb(vertices, vertexCount);
+	bounds.sphere = ComputeSphere(vertices, vertexCount, bounds.box);
+	bounds.uvDensity = 0.0f;	// needs the triangles, see ComputeUvDensity
+	return bounds;
+}
+
+Aabb Bounds::ComputeAabb(const Vertex* vertices, unsigned int vertexCount)
+{
+	Aabb box = { XMFLOAT3(0, 0, 0), XMFLOAT3(0, 0, 0) };
+	if (vertexCount == 0)
+		return box;
+
+	// Four separate running min/maxes so each step doesn't have
+	// to wait on the one before it, folded together at the end
+	XMVECTOR first = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR min0 = first, min1 = first, min2 = first, min3 = first;
+	XMVECTOR max0 = first, max1 = first, max2 = first, max3 = first;
+
+	unsigned int i = 1;
+	for (; i + 4 <= vertexCount; i += 4)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[i + 0].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[i + 1].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[i + 2].Position);
+		XMVECTOR p3 = XMLoadFloat3(&vertices[i + 3].Position);
+		min0 = XMVectorMin(min0, p0); max0 = XMVectorMax(max0, p0);
+		min1 = XMVectorMin(min1, p1); max1 = XMVectorMax(max1, p1);
+		min2 = XMVectorMin(min2, p2); max2 = XMVectorMax(max2, p2);
+		min3 = XMVectorMin(min3, p3); max3 = XMVectorMax(max3, p3);
+	}
+	for (; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		min0 = XMVectorMin(min0, p);
+		max0 = XMVectorMax(max0, p);
+	}
+
+	XMStoreFloat3(&box.minCorner, XMVectorMin(XMVectorMin(min0, min1), XMVectorMin(min2, min3)));
+	XMStoreFloat3(&box.maxCorner, XMVectorMax(XMVectorMax(max0, max1), XMVectorMax(max2, max3)));
+	return box;
+}
+
+Sphere Bounds::ComputeSphere(const Vertex* vertices, unsigned int vertexCount, const Aabb& box)
+{
+	// Centered on the box, just far enough out to reach the furthest vertex
+	// - a little looser than the tightest possible sphere, but exact about
+	//   what it contains and it's a single pass
+	Sphere sphere;
+	XMVECTOR center = (XMLoadFloat3(&box.minCorner) + XMLoadFloat3(&box.maxCorner)) * 0.5f;
+	XMStoreFloat3(&sphere.center, center);
+
+	XMVECTOR furthest0 = XMVectorZero();
+	XMVECTOR furthest1 = XMVectorZero();
+	unsigned int i = 0;
+	for (; i + 2 <= vertexCount; i += 2)
+	{
+		furthest0 = XMVectorMax(furthest0, XMVector3LengthSq(XMLoadFloat3(&vertices[i].Position) - center));
+		furthest1 = XMVectorMax(furthest1, XMVector3LengthSq(XMLoadFloat3(&vertices[i + 1].Position) - center));
+	}
+	if (i < vertexCount)
+		furthest0 = XMVectorMax(furthest0, XMVector3LengthSq(XMLoadFloat3(&vertices[i].Position) - center));
+
+	sphere.radius = sqrtf(XMVectorGetX(XMVectorMax(furthest0, furthest1)));
+	return sphere;
+}
+
+float Bounds::ComputeUvDensity(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	// Twice the area of each triangle in both spaces, the halves cancel out
+	float uvArea = 0.0f;
+	float surfaceArea = 0.0f;
+	for (unsigned int i = 0; i + 3 <= indexCount; i += 3)
+	{
+		const Vertex& v0 = vertices[indices[i]];
+		const Vertex& v1 = vertices[indices[i + 1]];
+		const Vertex& v2 = vertices[indices[i + 2]];
+
+		XMVECTOR p0 = XMLoadFloat3(&v0.Position);
+		surfaceArea += XMVectorGetX(XMVector3Length(XMVector3Cross(XMLoadFloat3(&v1.Position) - p0, XMLoadFloat3(&v2.Position) - p0)));
+
+		float du1 = v1.UV.x - v0.UV.x, dv1 = v1.UV.y - v0.UV.y;
+		float du2 = v2.UV.x - v0.UV.x, dv2 = v2.UV.y - v0.UV.y;
+		uvArea += fabsf(du1 * dv2 - du2 * dv1);
+	}
+
+	//an area ratio, so the square root is uv units per unit of length
+	return surfaceArea > 0.0f ? sqrtf(uvArea / surfaceArea) : 0.0f;
+}
+
+void Bounds::TransformAabbs(const Aabb* localBoxes, const XMFLOAT4X4* worldMatrices, unsigned int count, Aabb* worldBoxes)
+{
+	for (unsigned int i = 0; i < count; i++)
+	{
+		XMMATRIX world = XMLoadFloat4x4(&worldMatrices[i]);
+		XMVECTOR localMin = XMLoadFloat3(&localBoxes[i].minCorner);
+		XMVECTOR localMax = XMLoadFloat3(&localBoxes[i].maxCorner);
+		XMVECTOR center = (localMin + localMax) * 0.5f;
+		XMVECTOR extents = (localMax - localMin) * 0.5f;
+
+		// Arvo - the center moves like any point, and each world axis of
+		// the extents is how far the local extents reach along it, which
+		// is the extents run through the matrix with every entry made positive
+		XMVECTOR worldCenter = XMVector3Transform(center, world);
+		XMVECTOR worldExtents =
+			XMVectorSplatX(extents) * XMVectorAbs(world.r[0]) +
+			XMVectorSplatY(extents) * XMVectorAbs(world.r[1]) +
+			XMVectorSplatZ(extents) * XMVectorAbs(world.r[2]);
+
+		XMStoreFloat3(&worldBoxes[i].minCorner, worldCenter - worldExtents);
+		XMStoreFloat3(&worldBoxes[i].maxCorner, worldCenter + worldExtents);
+	}
+}
+
+Aabb Bounds::TransformAabb(const Aabb& localBox, const XMFLOAT4X4& worldMatrix)
+{
+	Aabb worldBox;
+	TransformAabbs(&localBox, &worldMatrix, 1, &worldBox);
+	return worldBox;
+}
+
+Sphere Bounds::TransformSphere(const Sphere& localSphere, const XMFLOAT4X4& worldMatrix)
+{
+	Sphere worldSphere;
+	XMStoreFloat3(&worldSphere.center, XMVector3Transform(XMLoadFloat3(&localSphere.center), XMLoadFloat4x4(&worldMatrix)));
+	worldSphere.radius = localSphere.radius * GetLargestScale(worldMatrix);
+	return worldSphere;
+}
+
+float Bounds::GetLargestScale(const XMFLOAT4X4& worldMatrix)
+{
+	XMMATRIX world = XMLoadFloat4x4(&worldMatrix);
+
+	// The rows are the local axes in world space, the longest
+	// one is the most the sphere can be stretched by
+	XMVECTOR scaleSq = XMVectorMax(XMVector3LengthSq(world.r[0]), XMVectorMax(XMVector3LengthSq(world.r[1]), XMVector3LengthSq(world.r[2])));
+	return sqrtf(XMVectorGetX(scaleSq));
+}
+
+Aabb Bounds::Merge(const Aabb& a, const Aabb& b)
+{
+	Aabb merged;
+	XMStoreFloat3(&merged.minCorner, XMVectorMin(XMLoadFloat3(&a.minCorner), XMLoadFloat3(&b.minCorner)));
+	XMStoreFloat3(&merged.maxCorner, XMVectorMax(XMLoadFloat3(&a.maxCorner), XMLoadFloat3(&b.maxCorner)));
+	return merged;
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// Axis aligned box (corners rather than min/max, Windows.h has macros by those names)
+struct Aabb
+{
+	DirectX::XMFLOAT3 minCorner;
+	DirectX::XMFLOAT3 maxCorner;
+};
+
+struct Sphere
+{
+	DirectX::XMFLOAT3 center;
+	float radius;
+};
+
+// Everything a mesh knows about where it is, in its own local space
+struct MeshBounds
+{
+	Aabb box;
+	Sphere sphere;
+	float uvDensity;	// uv units per local unit of surface, on average - how stretched the textures are
+};
+
+// --------------------------------------------------------
+// Bounding volume helpers
+//
+// World matrices are the row vector kind DirectXMath builds
+// (and Transform stores), so a point goes p * world.
+// --------------------------------------------------------
+class Bounds
+{
+public:
+	//box and sphere around a set of vertices - the sphere is centered on the box
+	static MeshBounds Compute(const Vertex* vertices, unsigned int vertexCount);
+	static Aabb ComputeAabb(const Vertex* vertices, unsigned int vertexCount);
+	static Sphere ComputeSphere(const Vertex* vertices, unsigned int vertexCount, const Aabb& box);
+	//square root of the total uv area over the total surface area of the triangles
+	static float ComputeUvDensity(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount);
+
+	//world space boxes that contain each local box moved by its world matrix (Arvo's method)
+	static void TransformAabbs(const Aabb* localBoxes, const DirectX::XMFLOAT4X4* worldMatrices, unsigned int count, Aabb* worldBoxes);
+	static Aabb TransformAabb(const Aabb& localBox, const DirectX::XMFLOAT4X4& worldMatrix);
+
+	//stays a sphere, so the radius grows by the largest scale in the matrix
+	static Sphere TransformSphere(const Sphere& localSphere, const DirectX::XMFLOAT4X4& worldMatrix);
+	//the most anything is stretched by the matrix, in any direction of its local axes
+	static float GetLargestScale(const DirectX::XMFLOAT4X4& worldMatrix);
+
+	//smallest box around both
+	static Aabb Merge(const Aabb& a, const Aabb& b);
+};
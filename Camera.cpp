@@ -1,12 +1,16 @@
 #include "Camera.h"
 #include "Input.h"
+#include "FrustumCuller.h"
 using namespace DirectX;
 
 Camera::Camera(float x, float y, float z, float aspectRatio)
 {
 	transform.SetPosition(x, y, z);
-	UpdateViewMatrix();
+	epoch = 0;
+	//identity until UpdateViewMatrix makes the real one, so the planes the projection extracts aren't built from garbage
+	XMStoreFloat4x4(&viewMatrix, XMMatrixIdentity());
 	UpdateProjectionMatrix(aspectRatio);
+	UpdateViewMatrix();
 }
 
 Camera::~Camera()
@@ -52,8 +56,12 @@ void Camera::Update(float dt)
 		
 	}
 
-	//make sure we send a call to update our view matrix
-	UpdateViewMatrix();
+	//the view matrix only needs redoing if the camera moved or turned, whether from input or anything else
+	XMFLOAT3 pos = transform.GetPosition();
+	XMFLOAT3 forward = transform.GetForward();
+	if (pos.x != viewPosition.x || pos.y != viewPosition.y || pos.z != viewPosition.z ||
+		forward.x != viewForward.x || forward.y != viewForward.y || forward.z != viewForward.z)
+		UpdateViewMatrix();
 }
 
 void Camera::UpdateViewMatrix()
@@ -61,19 +69,20 @@ void Camera::UpdateViewMatrix()
 	//need the pos direction and world up vectors
 	XMFLOAT3 pos = transform.GetPosition();
 	XMFLOAT3 up = XMFLOAT3(0, 1, 0);
-	XMFLOAT3 rot = transform.GetRotation();
-	XMVECTOR forward = XMVector3Rotate(
-		XMVectorSet(0, 0, 1, 0),
-		XMQuaternionRotationRollPitchYaw(rot.x, rot.y, rot.z));
+	//cached by the transform, only worked out again after it turns or moves
+	XMFLOAT3 forward = transform.GetForward();
 
 
 	XMMATRIX view = XMMatrixLookToLH(
 		XMLoadFloat3(&pos),
-		forward,
+		XMLoadFloat3(&forward),
 		XMLoadFloat3(&up));
 
 	//store our newly made matrix
 	XMStoreFloat4x4(&viewMatrix, view);
+	viewPosition = pos;
+	viewForward = forward;
+	UpdateFrustumPlanes();
 }
 
 //dont have to call every fram
@@ -90,6 +99,15 @@ void Camera::UpdateProjectionMatrix(float aspectRatio)
 
 
 	XMStoreFloat4x4(&projectionMatrix, proj);
+	UpdateFrustumPlanes();
+}
+
+void Camera::UpdateFrustumPlanes()
+{
+	XMMATRIX viewProj = XMMatrixMultiply(XMLoadFloat4x4(&viewMatrix), XMLoadFloat4x4(&projectionMatrix));
+	XMStoreFloat4x4(&viewProjectionMatrix, viewProj);
+	FrustumCuller::ExtractPlanes(viewProj, frustumPlanes);
+	epoch++;
 }
 
 Transform* Camera::GetTransform()
@@ -106,3 +124,18 @@ DirectX::XMFLOAT4X4 Camera::GetProjectionMatrix()
 {
 	return projectionMatrix;
 }
+
+DirectX::XMFLOAT4X4 Camera::GetViewProjectionMatrix()
+{
+	return viewProjectionMatrix;
+}
+
+unsigned int Camera::GetEpoch()
+{
+	return epoch;
+}
+
+const DirectX::XMFLOAT4* Camera::GetFrustumPlanes()
+{
+	return frustumPlanes;
+}
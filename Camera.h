@@ -17,13 +17,30 @@ public:
 
 	DirectX::XMFLOAT4X4 GetViewMatrix();
 	DirectX::XMFLOAT4X4 GetProjectionMatrix();
+	DirectX::XMFLOAT4X4 GetViewProjectionMatrix();
+
+	//goes up every time the view or projection changes, so anything worked out from them can tell it's out of date
+	unsigned int GetEpoch();
+
+	//left, right, bottom, top, near, far - world space, normalized, inside is ax + by + cz + d >= 0
+	static const unsigned int FrustumPlaneCount = 6;
+	const DirectX::XMFLOAT4* GetFrustumPlanes();
 
 private:
 	//camera matrixes
 	DirectX::XMFLOAT4X4 viewMatrix;
 	DirectX::XMFLOAT4X4 projectionMatrix;
+	//view * projection and the planes pulled out of it, redone whenever either changes
+	DirectX::XMFLOAT4X4 viewProjectionMatrix;
+	DirectX::XMFLOAT4 frustumPlanes[FrustumPlaneCount];
+	unsigned int epoch;
+	//where the view matrix was built from, to tell when it needs building again
+	DirectX::XMFLOAT3 viewPosition;
+	DirectX::XMFLOAT3 viewForward;
 
 	Transform transform;
 
+	void UpdateFrustumPlanes();
+
 };
 
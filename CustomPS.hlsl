@@ -27,7 +27,9 @@ float4 main(VertexToPixelNormalMapping input) : SV_TARGET
 	///////////////////////////////////////////////////////////////////////////////////////
 	input.normal = normalize(input.normal);
 	//get our unpacked normals which we get by converting the color
-	float3 unpackedNormal = NormalMap.Sample(BasicSampler, input.uv * 3).rgb * 2 - 1;
+	//normal maps are BC5 now, which only keeps x and y - z is always the positive one that makes it unit length
+	float2 unpackedXY = NormalMap.Sample(BasicSampler, input.uv * 3).rg * 2 - 1;
+	float3 unpackedNormal = float3(unpackedXY, sqrt(saturate(1 - dot(unpackedXY, unpackedXY))));
 
 	// Simplifications include not re-normalizing the same vector more than once!
 	float3 N = normalize(input.normal); // Must be normalized here or before
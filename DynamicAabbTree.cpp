@@ -0,0 +1,533 @@
+#include "DynamicAabbTree.h"
+#include <algorithm>
+#include <cmath>
+#include <cassert>
+
+using namespace DirectX;
+
+const float DynamicAabbTree::DefaultMargin = 0.1f;
+
+//what insertion tries to keep small - a ray or a query box is about that likely to touch it
+static float SurfaceArea(const Aabb& box)
+{
+	float x = box.maxCorner.x - box.minCorner.x;
+	float y = box.maxCorner.y - box.minCorner.y;
+	float z = box.maxCorner.z - box.minCorner.z;
+	return 2.0f * (x * y + y * z + z * x);
+}
+
+static bool Contains(const Aabb& outer, const Aabb& inner)
+{
+	return outer.minCorner.x <= inner.minCorner.x && outer.minCorner.y <= inner.minCorner.y && outer.minCorner.z <= inner.minCorner.z &&
+		outer.maxCorner.x >= inner.maxCorner.x && outer.maxCorner.y >= inner.maxCorner.y && outer.maxCorner.z >= inner.maxCorner.z;
+}
+
+static bool Overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.minCorner.x <= b.maxCorner.x && a.minCorner.y <= b.maxCorner.y && a.minCorner.z <= b.maxCorner.z &&
+		a.maxCorner.x >= b.minCorner.x && a.maxCorner.y >= b.minCorner.y && a.maxCorner.z >= b.minCorner.z;
+}
+
+// -1 when the box is all the way outside one of the planes, 1 when
+// it's inside every one of them, 0 when it's across some
+static int ClassifyAgainstPlanes(const Aabb& box, const XMFLOAT4* planes, unsigned int planeCount)
+{
+	float centerX = (box.minCorner.x + box.maxCorner.x) * 0.5f;
+	float centerY = (box.minCorner.y + box.maxCorner.y) * 0.5f;
+	float centerZ = (box.minCorner.z + box.maxCorner.z) * 0.5f;
+	float extentX = (box.maxCorner.x - box.minCorner.x) * 0.5f;
+	float extentY = (box.maxCorner.y - box.minCorner.y) * 0.5f;
+	float extentZ = (box.maxCorner.z - box.minCorner.z) * 0.5f;
+
+	int result = 1;
+	for (unsigned int i = 0; i < planeCount; i++)
+	{
+		const XMFLOAT4& plane = planes[i];
+		float distance = plane.x * centerX + plane.y * centerY + plane.z * centerZ + plane.w;
+		float reach = fabsf(plane.x) * extentX + fabsf(plane.y) * extentY + fabsf(plane.z) * extentZ;
+		if (distance + reach < 0)
+			return -1;
+		if (distance - reach < 0)
+			result = 0;
+	}
+	return result;
+}
+
+// Slab test - where the ray enters the box, if it does before maxDistance
+static bool RayHitsBox(const float* origin, const float* direction, const float* inverseDirection, const Aabb& box, float maxDistance, float& entry)
+{
+	const float* minCorner = &box.minCorner.x;
+	const float* maxCorner = &box.maxCorner.x;
+	float enter = 0;
+	float exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		//parallel to this pair of sides, so it's either always between them or never
+		if (direction[axis] == 0)
+		{
+			if (origin[axis] < minCorner[axis] || origin[axis] > maxCorner[axis])
+				return false;
+			continue;
+		}
+		float t0 = (minCorner[axis] - origin[axis]) * inverseDirection[axis];
+		float t1 = (maxCorner[axis] - origin[axis]) * inverseDirection[axis];
+		enter = (std::max)(enter, (std::min)(t0, t1));
+		exit = (std::min)(exit, (std::max)(t0, t1));
+		if (enter > exit)
+			return false;
+	}
+	entry = enter;
+	return true;
+}
+
+DynamicAabbTree::DynamicAabbTree(float margin)
+	: root(NullNode), freeList(NullNode), leafCount(0), nodeCount(0), margin(margin)
+{
+}
+
+unsigned int DynamicAabbTree::AllocateNode()
+{
+	unsigned int node;
+	if (freeList != NullNode)
+	{
+		node = freeList;
+		freeList = nodes[node].parent;
+	}
+	else
+	{
+		node = (unsigned int)nodes.size();
+		nodes.push_back(Node());
+	}
+
+	Node& n = nodes[node];
+	n.parent = NullNode;
+	n.left = NullNode;
+	n.right = NullNode;
+	n.height = 0;
+	n.userData = 0;
+	nodeCount++;
+	return node;
+}
+
+void DynamicAabbTree::FreeNode(unsigned int node)
+{
+	nodes[node].parent = freeList;
+	nodes[node].height = -1;
+	freeList = node;
+	nodeCount--;
+}
+
+Aabb DynamicAabbTree::Fatten(const Aabb& box)
+{
+	Aabb fat;
+	fat.minCorner = XMFLOAT3(box.minCorner.x - margin, box.minCorner.y - margin, box.minCorner.z - margin);
+	fat.maxCorner = XMFLOAT3(box.maxCorner.x + margin, box.maxCorner.y + margin, box.maxCorner.z + margin);
+	return fat;
+}
+
+unsigned int DynamicAabbTree::Insert(const Aabb& box, unsigned int userData)
+{
+	unsigned int leaf = AllocateNode();
+	nodes[leaf].box = Fatten(box);
+	nodes[leaf].tightBox = box;
+	nodes[leaf].userData = userData;
+	InsertLeaf(leaf);
+	leafCount++;
+	return leaf;
+}
+
+void DynamicAabbTree::Remove(unsigned int proxy)
+{
+	assert(proxy < nodes.size() && nodes[proxy].IsLeaf() && nodes[proxy].height == 0);
+	RemoveLeaf(proxy);
+	FreeNode(proxy);
+	leafCount--;
+}
+
+bool DynamicAabbTree::Move(unsigned int proxy, const Aabb& box)
+{
+	assert(proxy < nodes.size() && nodes[proxy].IsLeaf() && nodes[proxy].height == 0);
+	nodes[proxy].tightBox = box;
+	if (Contains(nodes[proxy].box, box))
+		return false;
+
+	RemoveLeaf(proxy);
+	nodes[proxy].box = Fatten(box);
+	InsertLeaf(proxy);
+	return true;
+}
+
+void DynamicAabbTree::Clear()
+{
+	nodes.clear();
+	root = NullNode;
+	freeList = NullNode;
+	leafCount = 0;
+	nodeCount = 0;
+}
+
+void DynamicAabbTree::Reserve(unsigned int count)
+{
+	//a leaf for each, and one fewer nodes above them
+	nodes.reserve(count * 2);
+	stack.reserve(count);
+}
+
+unsigned int DynamicAabbTree::GetUserData(unsigned int proxy)
+{
+	return nodes[proxy].userData;
+}
+
+const Aabb& DynamicAabbTree::GetFatBox(unsigned int proxy)
+{
+	return nodes[proxy].box;
+}
+
+void DynamicAabbTree::InsertLeaf(unsigned int leaf)
+{
+	if (root == NullNode)
+	{
+		root = leaf;
+		nodes[leaf].parent = NullNode;
+		return;
+	}
+
+	// Walk down to the cheapest sibling for the new leaf. Every node on
+	// the way grows to hold it whichever child it goes under (that's the
+	// inherited cost), so stop as soon as pairing with this node is
+	// cheaper than anything going further could be
+	Aabb leafBox = nodes[leaf].box;
+	unsigned int index = root;
+	while (!nodes[index].IsLeaf())
+	{
+		const Node& node = nodes[index];
+		float area = SurfaceArea(node.box);
+		float combinedArea = SurfaceArea(Bounds::Merge(node.box, leafBox));
+		float cost = 2.0f * combinedArea;
+		float inheritedCost = 2.0f * (combinedArea - area);
+
+		float childCosts[2];
+		unsigned int children[2] = { node.left, node.right };
+		for (int c = 0; c < 2; c++)
+		{
+			const Node& child = nodes[children[c]];
+			float mergedArea = SurfaceArea(Bounds::Merge(child.box, leafBox));
+			childCosts[c] = (child.IsLeaf() ? mergedArea : mergedArea - SurfaceArea(child.box)) + inheritedCost;
+		}
+
+		if (cost < childCosts[0] && cost < childCosts[1])
+			break;
+		index = childCosts[0] < childCosts[1] ? children[0] : children[1];
+	}
+	unsigned int sibling = index;
+
+	// A new node takes the sibling's place, with the sibling and the leaf under it
+	unsigned int oldParent = nodes[sibling].parent;
+	unsigned int newParent = AllocateNode();
+	nodes[newParent].parent = oldParent;
+	nodes[newParent].box = Bounds::Merge(leafBox, nodes[sibling].box);
+	nodes[newParent].height = nodes[sibling].height + 1;
+	nodes[newParent].left = sibling;
+	nodes[newParent].right = leaf;
+	nodes[sibling].parent = newParent;
+	nodes[leaf].parent = newParent;
+
+	if (oldParent == NullNode)
+		root = newParent;
+	else if (nodes[oldParent].left == sibling)
+		nodes[oldParent].left = newParent;
+	else
+		nodes[oldParent].right = newParent;
+
+	Refit(oldParent);
+}
+
+void DynamicAabbTree::RemoveLeaf(unsigned int leaf)
+{
+	if (leaf == root)
+	{
+		root = NullNode;
+		return;
+	}
+
+	// The leaf's parent goes too, its other child moves up into its place
+	unsigned int parent = nodes[leaf].parent;
+	unsigned int grandParent = nodes[parent].parent;
+	unsigned int sibling = nodes[parent].left == leaf ? nodes[parent].right : nodes[parent].left;
+	FreeNode(parent);
+
+	nodes[sibling].parent = grandParent;
+	if (grandParent == NullNode)
+	{
+		root = sibling;
+		return;
+	}
+	if (nodes[grandParent].left == parent)
+		nodes[grandParent].left = sibling;
+	else
+		nodes[grandParent].right = sibling;
+	Refit(grandParent);
+}
+
+void DynamicAabbTree::Refit(unsigned int node)
+{
+	while (node != NullNode)
+	{
+		node = Balance(node);
+		Node& n = nodes[node];
+		n.height = 1 + (std::max)(nodes[n.left].height, nodes[n.right].height);
+		n.box = Bounds::Merge(nodes[n.left].box, nodes[n.right].box);
+		node = n.parent;
+	}
+}
+
+unsigned int DynamicAabbTree::Balance(unsigned int a)
+{
+	Node& nodeA = nodes[a];
+	if (nodeA.IsLeaf() || nodeA.height < 2)
+		return a;
+
+	// One child's more than a level taller than the other, so that child
+	// comes up to take a's place, with a under it. Of the tall child's
+	// own two, the taller one stays with it and the shorter goes to a
+	// (where the tall child used to be)
+	unsigned int b = nodeA.left;
+	unsigned int c = nodeA.right;
+	int balance = nodes[c].height - nodes[b].height;
+	if (balance >= -1 && balance <= 1)
+		return a;
+
+	bool rightIsTaller = balance > 1;
+	unsigned int up = rightIsTaller ? c : b;
+	unsigned int stays = rightIsTaller ? b : c;
+	Node& nodeUp = nodes[up];
+	unsigned int f = nodeUp.left;
+	unsigned int g = nodeUp.right;
+	unsigned int taller = nodes[f].height > nodes[g].height ? f : g;
+	unsigned int shorter = taller == f ? g : f;
+
+	// up takes a's place under a's old parent
+	nodeUp.left = a;
+	nodeUp.parent = nodeA.parent;
+	nodeA.parent = up;
+	if (nodeUp.parent == NullNode)
+		root = up;
+	else if (nodes[nodeUp.parent].left == a)
+		nodes[nodeUp.parent].left = up;
+	else
+		nodes[nodeUp.parent].right = up;
+
+	// a keeps its other child and gets the shorter grandchild
+	nodeUp.right = taller;
+	if (rightIsTaller)
+		nodeA.right = shorter;
+	else
+		nodeA.left = shorter;
+	nodes[shorter].parent = a;
+
+	nodeA.box = Bounds::Merge(nodes[stays].box, nodes[shorter].box);
+	nodeA.height = 1 + (std::max)(nodes[stays].height, nodes[shorter].height);
+	nodeUp.box = Bounds::Merge(nodeA.box, nodes[taller].box);
+	nodeUp.height = 1 + (std::max)(nodeA.height, nodes[taller].height);
+	return up;
+}
+
+void DynamicAabbTree::QueryFrustum(const XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results)
+{
+	// Once a node is inside every plane so is everything under it, those
+	// are pushed with this bit set and come out without another test
+	const unsigned int InsideBit = 0x80000000;
+
+	results.clear();
+	if (root == NullNode)
+		return;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned int entry = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[entry & ~InsideBit];
+		bool inside = (entry & InsideBit) != 0;
+
+		if (node.IsLeaf())
+		{
+			if (inside || ClassifyAgainstPlanes(node.tightBox, planes, planeCount) >= 0)
+				results.push_back(node.userData);
+			continue;
+		}
+		if (!inside)
+		{
+			int side = ClassifyAgainstPlanes(node.box, planes, planeCount);
+			if (side < 0)
+				continue;
+			inside = side > 0;
+		}
+		stack.push_back(node.left | (inside ? InsideBit : 0));
+		stack.push_back(node.right | (inside ? InsideBit : 0));
+	}
+}
+
+void DynamicAabbTree::QueryOverlap(const Aabb& box, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (root == NullNode)
+		return;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf())
+		{
+			if (Overlaps(node.tightBox, box))
+				results.push_back(node.userData);
+		}
+		else if (Overlaps(node.box, box))
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+void DynamicAabbTree::QueryRay(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, std::vector<unsigned int>& results)
+{
+	results.clear();
+	if (root == NullNode)
+		return;
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	float inverse[3] = { 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		float entry;
+		if (!RayHitsBox(o, d, inverse, node.IsLeaf() ? node.tightBox : node.box, maxDistance, entry))
+			continue;
+		if (node.IsLeaf())
+			results.push_back(node.userData);
+		else
+		{
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+}
+
+bool DynamicAabbTree::RayCast(const XMFLOAT3& origin, const XMFLOAT3& direction, float maxDistance, unsigned int& userData, float& hitDistance)
+{
+	if (root == NullNode)
+		return false;
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	float inverse[3] = { 1.0f / d[0], 1.0f / d[1], 1.0f / d[2] };
+
+	// Anything that starts further away than the closest hit so far can
+	// be skipped, so the nearer child is looked at first (pushed last)
+	bool hit = false;
+	float closest = maxDistance;
+	float entry;
+	if (!RayHitsBox(o, d, inverse, nodes[root].IsLeaf() ? nodes[root].tightBox : nodes[root].box, closest, entry))
+		return false;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		const Node& node = nodes[stack.back()];
+		stack.pop_back();
+		if (node.IsLeaf())
+		{
+			if (RayHitsBox(o, d, inverse, node.tightBox, closest, entry))
+			{
+				hit = true;
+				closest = entry;
+				userData = node.userData;
+			}
+			continue;
+		}
+		if (!RayHitsBox(o, d, inverse, node.box, closest, entry))
+			continue;
+
+		float leftEntry, rightEntry;
+		bool hitsLeft = RayHitsBox(o, d, inverse, nodes[node.left].box, closest, leftEntry);
+		bool hitsRight = RayHitsBox(o, d, inverse, nodes[node.right].box, closest, rightEntry);
+		if (hitsLeft && hitsRight)
+		{
+			bool leftFirst = leftEntry <= rightEntry;
+			stack.push_back(leftFirst ? node.right : node.left);
+			stack.push_back(leftFirst ? node.left : node.right);
+		}
+		else if (hitsLeft)
+			stack.push_back(node.left);
+		else if (hitsRight)
+			stack.push_back(node.right);
+	}
+	if (hit)
+		hitDistance = closest;
+	return hit;
+}
+
+unsigned int DynamicAabbTree::GetLeafCount()
+{
+	return leafCount;
+}
+
+unsigned int DynamicAabbTree::GetNodeCount()
+{
+	return nodeCount;
+}
+
+unsigned int DynamicAabbTree::GetHeight()
+{
+	return root == NullNode ? 0 : (unsigned int)nodes[root].height;
+}
+
+Aabb DynamicAabbTree::GetBounds()
+{
+	return root == NullNode ? Aabb() : nodes[root].box;
+}
+
+bool DynamicAabbTree::Validate()
+{
+	if (root == NullNode)
+		return leafCount == 0 && nodeCount == 0;
+	if (nodes[root].parent != NullNode)
+		return false;
+
+	unsigned int leaves = 0;
+	unsigned int visited = 0;
+	stack.clear();
+	stack.push_back(root);
+	while (!stack.empty())
+	{
+		unsigned int index = stack.back();
+		stack.pop_back();
+		const Node& node = nodes[index];
+		visited++;
+		if (node.IsLeaf())
+		{
+			if (node.height != 0 || node.right != NullNode || !Contains(node.box, node.tightBox))
+				return false;
+			leaves++;
+			continue;
+		}
+
+		const Node& left = nodes[node.left];
+		const Node& right = nodes[node.right];
+		if (left.parent != index || right.parent != index)
+			return false;
+		if (node.height != 1 + (std::max)(left.height, right.height))
+			return false;
+		if (!Contains(node.box, left.box) || !Contains(node.box, right.box))
+			return false;
+		stack.push_back(node.left);
+		stack.push_back(node.right);
+	}
+	return leaves == leafCount && visited == nodeCount;
+}
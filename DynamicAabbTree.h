@@ -0,0 +1,96 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// Dynamic AABB tree
+//
+// A bounding volume hierarchy over boxes that move around,
+// for finding what's in view, under a ray or touching a box
+// without looking at everything. Each box is a leaf, and every
+// other node holds the box around its two children.
+//
+// Leaves keep their box fattened by a margin, so something
+// that moves a little stays inside it and Move doesn't have to
+// touch the tree. Only when it leaves is it taken out and put
+// back in - the cheapest spot by surface area, then back up
+// the path rotating nodes (like an AVL tree) so no side gets
+// much taller than the other. Either way it's O(log n).
+//
+// Queries test the fattened boxes on the way down but the
+// real box at the leaves, so their results are exact.
+//
+// Nodes live in one vector with a free list, and queries use
+// a stack that's kept between calls, so once it's grown to fit
+// nothing allocates (results go in vectors the caller keeps).
+// --------------------------------------------------------
+class DynamicAabbTree
+{
+public:
+	static const unsigned int NullNode = 0xFFFFFFFF;
+	static const float DefaultMargin;
+
+	explicit DynamicAabbTree(float margin = DefaultMargin);
+
+	//returns a proxy for the box, userData is what queries hand back for it
+	unsigned int Insert(const Aabb& box, unsigned int userData);
+	void Remove(unsigned int proxy);
+	//returns true if the tree had to change - false if it's still inside its fattened box
+	bool Move(unsigned int proxy, const Aabb& box);
+	void Clear();
+	//room for this many boxes without growing
+	void Reserve(unsigned int count);
+
+	unsigned int GetUserData(unsigned int proxy);
+	const Aabb& GetFatBox(unsigned int proxy);
+
+	// Queries - each one clears results and fills it with userData
+	//planes like FrustumCuller's, inside being ax + by + cz + d >= 0
+	void QueryFrustum(const DirectX::XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results);
+	void QueryOverlap(const Aabb& box, std::vector<unsigned int>& results);
+	//every box the ray passes through within maxDistance (direction doesn't need to be normalized, distances are in its lengths)
+	void QueryRay(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, std::vector<unsigned int>& results);
+	//the first box the ray hits - false if none, otherwise userData and the distance to it
+	bool RayCast(const DirectX::XMFLOAT3& origin, const DirectX::XMFLOAT3& direction, float maxDistance, unsigned int& userData, float& hitDistance);
+
+	unsigned int GetLeafCount();
+	unsigned int GetNodeCount();
+	unsigned int GetHeight();
+	//box around everything, fattened - an empty box when there's nothing in it
+	Aabb GetBounds();
+	//walks the whole tree checking links, heights and that every box holds its children - for testing
+	bool Validate();
+
+private:
+	struct Node
+	{
+		Aabb box;				// fattened for leaves, around both children otherwise
+		Aabb tightBox;			// leaves only, what was actually passed in
+		unsigned int parent;	// next free node while on the free list
+		unsigned int left;		// NullNode for leaves
+		unsigned int right;
+		int height;				// 0 for leaves, -1 while free
+		unsigned int userData;
+
+		bool IsLeaf() const { return left == NullNode; }
+	};
+
+	std::vector<Node> nodes;
+	std::vector<unsigned int> stack;	// kept so queries don't allocate
+	unsigned int root;
+	unsigned int freeList;
+	unsigned int leafCount;
+	unsigned int nodeCount;
+	float margin;
+
+	unsigned int AllocateNode();
+	void FreeNode(unsigned int node);
+	void InsertLeaf(unsigned int leaf);
+	void RemoveLeaf(unsigned int leaf);
+	//rotates a taller grandchild up if node is out of balance, returns whatever is in node's place now
+	unsigned int Balance(unsigned int node);
+	//fixes up heights and boxes from node to the root, balancing on the way
+	void Refit(unsigned int node);
+	Aabb Fatten(const Aabb& box);
+};
@@ -0,0 +1,455 @@
+#include "EntityStore.h"
+#include "TransformBatch.h"
+#include <cstdio>
+#include <cassert>
+#include <algorithm>
+
+using namespace DirectX;
+
+EntityStore::EntityStore()
+{
+	hierarchyChanged = false;
+	sceneEpoch = 0;
+}
+
+EntityId EntityStore::Add(MeshHandle mesh, MaterialHandle material)
+{
+	EntityId id;
+	if (!freeSlots.empty())
+	{
+		id.index = freeSlots.back();
+		freeSlots.pop_back();
+	}
+	else
+	{
+		id.index = (unsigned int)slots.size();
+		slots.push_back({ 0, 1 });
+	}
+	id.generation = slots[id.index].generation;
+
+	unsigned int index = (unsigned int)ids.size();
+	slots[id.index].index = index;
+
+	//starts out where a default Transform does
+	XMFLOAT4X4 identity;
+	XMStoreFloat4x4(&identity, XMMatrixIdentity());
+	ids.push_back(id);
+	positions.push_back(XMFLOAT3(0, 0, 0));
+	rotations.push_back(XMFLOAT3(0, 0, 0));
+	scales.push_back(XMFLOAT3(1, 1, 1));
+	parents.push_back(EntityId());
+	localMatrices.push_back(identity);
+	localInverseTransposes.push_back(identity);
+	worldMatrices.push_back(identity);
+	worldInverseTransposes.push_back(identity);
+	meshes.push_back(mesh);
+	materials.push_back(material);
+	localBounds.push_back(Aabb());
+	worldBounds.push_back(Aabb());
+	dirty.push_back(0);
+	hierarchyChanged = true;
+	sceneEpoch++;
+	return id;
+}
+
+void EntityStore::Remove(EntityId id)
+{
+	if (!IsAlive(id))
+		return;
+
+	// Move the last entity into the gap so the arrays stay packed
+	unsigned int index = slots[id.index].index;
+	unsigned int last = (unsigned int)ids.size() - 1;
+	if (index != last)
+	{
+		ids[index] = ids[last];
+		positions[index] = positions[last];
+		rotations[index] = rotations[last];
+		scales[index] = scales[last];
+		parents[index] = parents[last];
+		localMatrices[index] = localMatrices[last];
+		localInverseTransposes[index] = localInverseTransposes[last];
+		worldMatrices[index] = worldMatrices[last];
+		worldInverseTransposes[index] = worldInverseTransposes[last];
+		meshes[index] = meshes[last];
+		materials[index] = materials[last];
+		localBounds[index] = localBounds[last];
+		worldBounds[index] = worldBounds[last];
+		dirty[index] = dirty[last];
+		slots[ids[index].index].index = index;
+	}
+	ids.pop_back();
+	positions.pop_back();
+	rotations.pop_back();
+	scales.pop_back();
+	parents.pop_back();
+	localMatrices.pop_back();
+	localInverseTransposes.pop_back();
+	worldMatrices.pop_back();
+	worldInverseTransposes.pop_back();
+	meshes.pop_back();
+	materials.pop_back();
+	localBounds.pop_back();
+	worldBounds.pop_back();
+	dirty.pop_back();
+
+	//skip 0 if it ever wraps around, that's the invalid generation
+	if (++slots[id.index].generation == 0)
+		slots[id.index].generation = 1;
+	freeSlots.push_back(id.index);
+
+	//indices have moved, and its children (found by their parent ids going stale) need new worlds
+	hierarchyChanged = true;
+	sceneEpoch++;
+}
+
+bool EntityStore::IsAlive(EntityId id)
+{
+	return id.generation != 0 && id.index < slots.size() && slots[id.index].generation == id.generation;
+}
+
+unsigned int EntityStore::GetIndex(EntityId id)
+{
+#if defined(DEBUG) || defined(_DEBUG)
+	if (!IsAlive(id))
+	{
+		printf("Stale or invalid entity (index %u, generation %u)\n", id.index, id.generation);
+		assert(false);
+	}
+#endif
+	return slots[id.index].index;
+}
+
+unsigned int EntityStore::GetCount()
+{
+	return (unsigned int)ids.size();
+}
+
+void EntityStore::Reserve(unsigned int count)
+{
+	ids.reserve(count);
+	positions.reserve(count);
+	rotations.reserve(count);
+	scales.reserve(count);
+	parents.reserve(count);
+	localMatrices.reserve(count);
+	localInverseTransposes.reserve(count);
+	worldMatrices.reserve(count);
+	worldInverseTransposes.reserve(count);
+	meshes.reserve(count);
+	materials.reserve(count);
+	localBounds.reserve(count);
+	worldBounds.reserve(count);
+	dirty.reserve(count);
+	slots.reserve(count);
+}
+
+void EntityStore::MarkDirty(unsigned int index)
+{
+	if (dirty[index])
+		return;
+	dirty[index] = 1;
+	dirtyIds.push_back(ids[index]);
+}
+
+bool EntityStore::SetParent(EntityId id, EntityId parent)
+{
+	unsigned int index = GetIndex(id);
+	if (IsAlive(parent))
+	{
+		// Walk up from the new parent, if we get back to id it would loop
+		for (EntityId above = parent; IsAlive(above); above = parents[slots[above.index].index])
+		{
+			if (above == id)
+			{
+#if defined(DEBUG) || defined(_DEBUG)
+				printf("Entity %u can't be parented under its own child %u\n", id.index, parent.index);
+#endif
+				return false;
+			}
+		}
+	}
+	else
+		parent = EntityId();
+
+	if (parents[index] != parent)
+	{
+		parents[index] = parent;
+		hierarchyChanged = true;
+		sceneEpoch++;
+	}
+	return true;
+}
+
+EntityId EntityStore::GetParent(EntityId id)
+{
+	return parents[GetIndex(id)];
+}
+
+void EntityStore::SetPosition(EntityId id, float x, float y, float z)
+{
+	unsigned int index = GetIndex(id);
+	positions[index] = XMFLOAT3(x, y, z);
+	MarkDirty(index);
+}
+
+void EntityStore::SetRotation(EntityId id, float pitch, float yaw, float roll)
+{
+	unsigned int index = GetIndex(id);
+	rotations[index] = XMFLOAT3(pitch, yaw, roll);
+	MarkDirty(index);
+}
+
+void EntityStore::SetScale(EntityId id, float x, float y, float z)
+{
+	unsigned int index = GetIndex(id);
+	scales[index] = XMFLOAT3(x, y, z);
+	MarkDirty(index);
+}
+
+void EntityStore::SetMesh(EntityId id, MeshHandle mesh)
+{
+	unsigned int index = GetIndex(id);
+	if (meshes[index] != mesh)
+	{
+		meshes[index] = mesh;
+		sceneEpoch++;
+	}
+}
+
+void EntityStore::SetMaterial(EntityId id, MaterialHandle material)
+{
+	unsigned int index = GetIndex(id);
+	if (materials[index] != material)
+	{
+		materials[index] = material;
+		sceneEpoch++;
+	}
+}
+
+XMFLOAT3 EntityStore::GetPosition(EntityId id)
+{
+	return positions[GetIndex(id)];
+}
+
+XMFLOAT3 EntityStore::GetRotation(EntityId id)
+{
+	return rotations[GetIndex(id)];
+}
+
+XMFLOAT3 EntityStore::GetScale(EntityId id)
+{
+	return scales[GetIndex(id)];
+}
+
+MeshHandle EntityStore::GetMesh(EntityId id)
+{
+	return meshes[GetIndex(id)];
+}
+
+MaterialHandle EntityStore::GetMaterial(EntityId id)
+{
+	return materials[GetIndex(id)];
+}
+
+void EntityStore::UpdateWorldMatrices()
+{
+	//turn the dirty ids into indices, skipping anything removed since it was marked
+	//or already picked up through an earlier copy of its id
+	dirtyIndices.clear();
+	for (EntityId id : dirtyIds)
+	{
+		if (!IsAlive(id))
+			continue;
+		unsigned int i = slots[id.index].index;
+		if (!dirty[i])
+			continue;
+		dirty[i] = 0;
+		dirtyIndices.push_back(i);
+	}
+	dirtyIds.clear();
+	moved.clear();
+
+	if (!dirtyIndices.empty())
+		TransformBatch::BuildWorldMatrices(positions.data(), rotations.data(), scales.data(), dirtyIndices.data(), (unsigned int)dirtyIndices.size(),
+			localMatrices.data(), localInverseTransposes.data());
+
+	//anything could be under anything now, so every world is redone
+	if (hierarchyChanged)
+	{
+		RebuildHierarchy();
+		PropagateWorldMatrices(0, (unsigned int)order.size());
+		return;
+	}
+
+	// Each changed entity's subtree is the run of positions from it to
+	// its subtree end. Sorted, a run that starts inside the last one is
+	// part of it (subtrees are nested or apart, never overlapping)
+	for (unsigned int& i : dirtyIndices)
+		i = orderPositions[i];
+	std::sort(dirtyIndices.begin(), dirtyIndices.end());
+	unsigned int end = 0;
+	for (unsigned int start : dirtyIndices)
+	{
+		if (start < end)
+			continue;
+		end = subtreeEnds[start];
+		PropagateWorldMatrices(start, end);
+	}
+}
+
+void EntityStore::RebuildHierarchy()
+{
+	unsigned int count = (unsigned int)ids.size();
+	order.clear();
+	orderParents.resize(count);
+	subtreeEnds.resize(count);
+	orderPositions.resize(count);
+
+	// Everyone's parent index, and how many children each has - a
+	// parent that's been removed leaves its children at the top
+	std::vector<unsigned int> parentIndices(count);
+	std::vector<unsigned int> childStarts(count + 1, 0);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (!IsAlive(parents[i]))
+			parents[i] = EntityId();
+		parentIndices[i] = parents[i].IsValid() ? slots[parents[i].index].index : NoParent;
+		if (parentIndices[i] != NoParent)
+			childStarts[parentIndices[i] + 1]++;
+	}
+
+	//children listed together by parent, counting sort style
+	for (unsigned int i = 0; i < count; i++)
+		childStarts[i + 1] += childStarts[i];
+	std::vector<unsigned int> children(childStarts[count]);
+	std::vector<unsigned int> childFill(childStarts.begin(), childStarts.end() - 1);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		if (parentIndices[i] != NoParent)
+			children[childFill[parentIndices[i]]++] = i;
+	}
+
+	// Depth first from each entity without a parent, with a stack
+	// instead of recursion so deep hierarchies can't overflow anything
+	std::vector<unsigned int> stack;
+	for (unsigned int root = 0; root < count; root++)
+	{
+		if (parentIndices[root] != NoParent)
+			continue;
+		stack.push_back(root);
+		while (!stack.empty())
+		{
+			unsigned int i = stack.back();
+			stack.pop_back();
+			orderPositions[i] = (unsigned int)order.size();
+			orderParents[order.size()] = parentIndices[i];
+			order.push_back(i);
+			//backwards so they come out in order
+			for (unsigned int c = childStarts[i + 1]; c > childStarts[i]; c--)
+				stack.push_back(children[c - 1]);
+		}
+	}
+
+	// Subtree sizes, back to front so every child is done before its parent
+	std::vector<unsigned int> sizes(count, 1);
+	for (unsigned int k = count; k-- > 0;)
+	{
+		if (orderParents[k] != NoParent)
+			sizes[orderParents[k]] += sizes[order[k]];
+		subtreeEnds[k] = k + sizes[order[k]];
+	}
+
+	hierarchyChanged = false;
+}
+
+void EntityStore::PropagateWorldMatrices(unsigned int start, unsigned int end)
+{
+	for (unsigned int k = start; k < end; k++)
+	{
+		unsigned int i = order[k];
+		unsigned int parent = orderParents[k];
+		moved.push_back(i);
+		if (parent == NoParent)
+		{
+			worldMatrices[i] = localMatrices[i];
+			worldInverseTransposes[i] = localInverseTransposes[i];
+			continue;
+		}
+
+		// The parent comes earlier in the order, so it's already up to date.
+		// Inverse transposes multiply in the same order as the matrices do
+		XMStoreFloat4x4(&worldMatrices[i], XMLoadFloat4x4(&localMatrices[i]) * XMLoadFloat4x4(&worldMatrices[parent]));
+		XMStoreFloat4x4(&worldInverseTransposes[i], XMLoadFloat4x4(&localInverseTransposes[i]) * XMLoadFloat4x4(&worldInverseTransposes[parent]));
+	}
+}
+
+unsigned int EntityStore::GetDirtyCount()
+{
+	return (unsigned int)dirtyIds.size();
+}
+
+const unsigned int* EntityStore::GetMovedIndices()
+{
+	return moved.data();
+}
+
+unsigned int EntityStore::GetMovedCount()
+{
+	return (unsigned int)moved.size();
+}
+
+unsigned int EntityStore::GetSceneEpoch()
+{
+	return sceneEpoch;
+}
+
+const EntityId* EntityStore::GetIds()
+{
+	return ids.data();
+}
+
+const XMFLOAT3* EntityStore::GetPositions()
+{
+	return positions.data();
+}
+
+const XMFLOAT3* EntityStore::GetRotations()
+{
+	return rotations.data();
+}
+
+const XMFLOAT3* EntityStore::GetScales()
+{
+	return scales.data();
+}
+
+const XMFLOAT4X4* EntityStore::GetWorldMatrices()
+{
+	return worldMatrices.data();
+}
+
+const XMFLOAT4X4* EntityStore::GetWorldInverseTransposes()
+{
+	return worldInverseTransposes.data();
+}
+
+const MeshHandle* EntityStore::GetMeshes()
+{
+	return meshes.data();
+}
+
+const MaterialHandle* EntityStore::GetMaterials()
+{
+	return materials.data();
+}
+
+Aabb* EntityStore::GetLocalBounds()
+{
+	return localBounds.data();
+}
+
+Aabb* EntityStore::GetWorldBounds()
+{
+	return worldBounds.data();
+}
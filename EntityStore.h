@@ -0,0 +1,136 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "ResourcePool.h"
+#include "Bounds.h"
+
+struct EntityTag;
+typedef Handle<EntityTag> EntityId;
+
+// --------------------------------------------------------
+// Entity storage
+//
+// Every entity's components sit in their own array - all the
+// positions together, all the world matrices together and so
+// on - so a pass over one component reads straight through
+// memory instead of hopping from object to object.
+//
+// Entities are packed at the front of the arrays. Removing
+// one moves the last entity into its place, so array order
+// isn't stable, but ids are: an id finds its entity wherever
+// it's moved to, and goes stale once it's removed (debug
+// builds catch stale ids the same way ResourcePool does).
+//
+// Entities can have a parent, and then their position, rotation
+// and scale are relative to it. UpdateWorldMatrices rebuilds the
+// local matrices of whatever changed (all handed to TransformBatch
+// at once), then walks an array of every entity in depth first
+// order, parents before their children. Each changed entity's
+// subtree is one run of that array, so worlds are redone in a
+// single pass over those runs, no recursion, and subtrees that
+// didn't change aren't looked at.
+//
+// The depth first order is only rebuilt when entities are added,
+// removed or reparented.
+//
+// For anything caching what it worked out from the entities, the
+// scene epoch counts changes to which entities there are, where
+// they sit in the arrays, their parents, meshes and materials.
+// Moving them doesn't count - UpdateWorldMatrices lists the ones
+// whose world matrices it redid instead.
+// --------------------------------------------------------
+class EntityStore
+{
+public:
+	EntityStore();
+
+	//an entity with no mesh draws nothing, but can still be a parent
+	EntityId Add(MeshHandle mesh, MaterialHandle material);
+	//its children are left without a parent, their local transforms become world ones
+	void Remove(EntityId id);
+	bool IsAlive(EntityId id);
+	//where it is in the arrays right now - removing other entities can change it
+	unsigned int GetIndex(EntityId id);
+	unsigned int GetCount();
+	void Reserve(unsigned int count);
+
+	//an invalid parent detaches it - false if parent is one of its own children (or itself)
+	bool SetParent(EntityId id, EntityId parent);
+	EntityId GetParent(EntityId id);
+
+	// Relative to the parent, or the world if there isn't one
+	void SetPosition(EntityId id, float x, float y, float z);
+	void SetRotation(EntityId id, float pitch, float yaw, float roll);
+	void SetScale(EntityId id, float x, float y, float z);
+	void SetMesh(EntityId id, MeshHandle mesh);
+	void SetMaterial(EntityId id, MaterialHandle material);
+	DirectX::XMFLOAT3 GetPosition(EntityId id);
+	DirectX::XMFLOAT3 GetRotation(EntityId id);	// pitch, yaw, roll
+	DirectX::XMFLOAT3 GetScale(EntityId id);
+	MeshHandle GetMesh(EntityId id);
+	MaterialHandle GetMaterial(EntityId id);
+
+	//rebuilds the world and inverse transpose matrices of everything that moved since the last call, and everything under it
+	void UpdateWorldMatrices();
+	unsigned int GetDirtyCount();
+	//indices of the entities the last UpdateWorldMatrices gave new world matrices
+	const unsigned int* GetMovedIndices();
+	unsigned int GetMovedCount();
+	unsigned int GetSceneEpoch();
+
+	// The component arrays, GetCount() long and all in the same order
+	// - pointers last until the next Add or Remove
+	// - positions, rotations and scales are the local ones, the matrices are world
+	const EntityId* GetIds();
+	const DirectX::XMFLOAT3* GetPositions();
+	const DirectX::XMFLOAT3* GetRotations();
+	const DirectX::XMFLOAT3* GetScales();
+	const DirectX::XMFLOAT4X4* GetWorldMatrices();
+	const DirectX::XMFLOAT4X4* GetWorldInverseTransposes();
+	const MeshHandle* GetMeshes();
+	const MaterialHandle* GetMaterials();
+	Aabb* GetLocalBounds();		// filled in by whoever knows the meshes, the store just keeps them
+	Aabb* GetWorldBounds();
+
+private:
+	struct Slot
+	{
+		unsigned int index;			// into the arrays, while alive
+		unsigned int generation;
+	};
+
+	std::vector<EntityId> ids;
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> rotations;
+	std::vector<DirectX::XMFLOAT3> scales;
+	std::vector<EntityId> parents;
+	std::vector<DirectX::XMFLOAT4X4> localMatrices;
+	std::vector<DirectX::XMFLOAT4X4> localInverseTransposes;
+	std::vector<DirectX::XMFLOAT4X4> worldMatrices;
+	std::vector<DirectX::XMFLOAT4X4> worldInverseTransposes;
+	std::vector<MeshHandle> meshes;
+	std::vector<MaterialHandle> materials;
+	std::vector<Aabb> localBounds;
+	std::vector<Aabb> worldBounds;
+	std::vector<unsigned char> dirty;	// matrices need rebuilding, one per entity
+
+	std::vector<EntityId> dirtyIds;		// the dirty ones, so updates don't look at every entity
+	std::vector<unsigned int> dirtyIndices;	// where those are, gathered for TransformBatch
+	std::vector<unsigned int> moved;		// everything whose world was redone last update
+	unsigned int sceneEpoch;
+	std::vector<Slot> slots;			// by id index
+	std::vector<unsigned int> freeSlots;
+
+	// Depth first order, rebuilt when hierarchyChanged
+	static const unsigned int NoParent = 0xFFFFFFFF;
+	std::vector<unsigned int> order;			// entity index at each position
+	std::vector<unsigned int> orderParents;		// entity index of its parent, or NoParent
+	std::vector<unsigned int> subtreeEnds;		// one past the last position under it
+	std::vector<unsigned int> orderPositions;	// by entity index, where it is in order
+	bool hierarchyChanged;
+
+	void MarkDirty(unsigned int index);
+	void RebuildHierarchy();
+	//redoes world matrices for the depth first positions [start, end)
+	void PropagateWorldMatrices(unsigned int start, unsigned int end);
+};
@@ -0,0 +1,117 @@
+#include "FrustumCuller.h"
+#include <cmath>
+
+using namespace DirectX;
+
+unsigned int FrustumCuller::Cull(const Aabb* boxes, const unsigned int* indices, unsigned int count,
+	const XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& visible)
+{
+	// Room for everything up front, so an index can be written whether
+	// it's visible or not and only kept (by moving past it) if it is -
+	// no branch to guess wrong on
+	visible.resize(count);
+	unsigned int visibleCount = 0;
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+
+	for (unsigned int first = 0; first < count; first += 4)
+	{
+		// Gather four boxes - a group at the end with fewer
+		// than four left repeats its first one in the spare lanes
+		unsigned int lanes = count - first < 4 ? count - first : 4;
+		XMFLOAT4A minX, minY, minZ, maxX, maxY, maxZ;
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const Aabb& box = boxes[indices[first + (k < lanes ? k : 0)]];
+			(&minX.x)[k] = box.minCorner.x;
+			(&minY.x)[k] = box.minCorner.y;
+			(&minZ.x)[k] = box.minCorner.z;
+			(&maxX.x)[k] = box.maxCorner.x;
+			(&maxY.x)[k] = box.maxCorner.y;
+			(&maxZ.x)[k] = box.maxCorner.z;
+		}
+
+		XMVECTOR centerX = (XMLoadFloat4A(&minX) + XMLoadFloat4A(&maxX)) * half;
+		XMVECTOR centerY = (XMLoadFloat4A(&minY) + XMLoadFloat4A(&maxY)) * half;
+		XMVECTOR centerZ = (XMLoadFloat4A(&minZ) + XMLoadFloat4A(&maxZ)) * half;
+		XMVECTOR extentX = (XMLoadFloat4A(&maxX) - XMLoadFloat4A(&minX)) * half;
+		XMVECTOR extentY = (XMLoadFloat4A(&maxY) - XMLoadFloat4A(&minY)) * half;
+		XMVECTOR extentZ = (XMLoadFloat4A(&maxZ) - XMLoadFloat4A(&minZ)) * half;
+
+		// A box is outside a plane when even the corner furthest along its
+		// normal is behind it - the center's distance plus the extents
+		// projected onto the normal
+		XMVECTOR outside = XMVectorZero();
+		for (unsigned int p = 0; p < planeCount; p++)
+		{
+			const XMFLOAT4& plane = planes[p];
+			XMVECTOR distance = centerX * XMVectorReplicate(plane.x) + centerY * XMVectorReplicate(plane.y) + centerZ * XMVectorReplicate(plane.z) + XMVectorReplicate(plane.w);
+			XMVECTOR reach = extentX * XMVectorReplicate(fabsf(plane.x)) + extentY * XMVectorReplicate(fabsf(plane.y)) + extentZ * XMVectorReplicate(fabsf(plane.z));
+			outside = XMVectorOrInt(outside, XMVectorLess(distance + reach, XMVectorZero()));
+		}
+
+		uint32_t culled[4];
+		XMStoreInt4(culled, outside);
+		for (unsigned int k = 0; k < lanes; k++)
+		{
+			visible[visibleCount] = indices[first + k];
+			visibleCount += culled[k] == 0;
+		}
+	}
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+unsigned int FrustumCuller::CullReference(const Aabb* boxes, const unsigned int* indices, unsigned int count,
+	const XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	for (unsigned int n = 0; n < count; n++)
+	{
+		if (!IsOutsidePlanes(boxes[indices[n]], planes, planeCount))
+			visible.push_back(indices[n]);
+	}
+	return (unsigned int)visible.size();
+}
+
+bool FrustumCuller::IsOutsidePlanes(const Aabb& box, const XMFLOAT4* planes, unsigned int planeCount)
+{
+	for (unsigned int i = 0; i < planeCount; i++)
+	{
+		// The corner furthest along the plane's normal
+		const XMFLOAT4& plane = planes[i];
+		XMVECTOR corner = XMVectorSet(
+			plane.x >= 0 ? box.maxCorner.x : box.minCorner.x,
+			plane.y >= 0 ? box.maxCorner.y : box.minCorner.y,
+			plane.z >= 0 ? box.maxCorner.z : box.minCorner.z,
+			1.0f);
+		if (XMVectorGetX(XMVector4Dot(XMLoadFloat4(&plane), corner)) < 0)
+			return true;
+	}
+	return false;
+}
+
+void FrustumCuller::ExtractPlanes(FXMMATRIX viewProjection, XMFLOAT4* planes)
+{
+	// A point p is on screen when its clip space x, y and z (p * viewProj)
+	// are between -w and w (0 and w for z), and each of those is a dot
+	// product with one column of viewProj - so each plane is a sum or
+	// difference of two columns (Gribb and Hartmann)
+	XMFLOAT4X4 viewProj;
+	XMStoreFloat4x4(&viewProj, viewProjection);
+	XMVECTOR columns[4];
+	for (int c = 0; c < 4; c++)
+		columns[c] = XMVectorSet(viewProj.m[0][c], viewProj.m[1][c], viewProj.m[2][c], viewProj.m[3][c]);
+
+	XMVECTOR sides[PlaneCount] =
+	{
+		columns[3] + columns[0],	// left
+		columns[3] - columns[0],	// right
+		columns[3] + columns[1],	// bottom
+		columns[3] - columns[1],	// top
+		columns[2],					// near
+		columns[3] - columns[2]		// far
+	};
+	//normalized so the distances come out in world units
+	for (unsigned int i = 0; i < PlaneCount; i++)
+		XMStoreFloat4(&planes[i], XMPlaneNormalize(sides[i]));
+}
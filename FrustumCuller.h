@@ -0,0 +1,35 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// Frustum culling for world space boxes
+//
+// Planes are (a, b, c, d) with inside being ax + by + cz + d >= 0,
+// the same as MeshletCuller's (Camera::GetFrustumPlanes gives
+// six of them). A box is only culled when it's completely on
+// the outside of one plane, so boxes near a corner of the
+// frustum can get through - it never culls anything visible.
+//
+// Cull works four boxes at a time the way TransformBatch does,
+// gathered into registers that each hold one value from all
+// four - every box's center x in one, extent x in another -
+// and each plane is tested against all four at once.
+// --------------------------------------------------------
+class FrustumCuller
+{
+public:
+	//fills visible with every index out of indices[0, count) whose box isn't outside the planes, in the same order - returns how many
+	static unsigned int Cull(const Aabb* boxes, const unsigned int* indices, unsigned int count,
+		const DirectX::XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& visible);
+
+	//one box at a time - the plain version to check Cull against
+	static unsigned int CullReference(const Aabb* boxes, const unsigned int* indices, unsigned int count,
+		const DirectX::XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& visible);
+	static bool IsOutsidePlanes(const Aabb& box, const DirectX::XMFLOAT4* planes, unsigned int planeCount);
+
+	//left, right, bottom, top, near, far out of a world to clip matrix (view * projection), normalized
+	static const unsigned int PlaneCount = 6;
+	static void ExtractPlanes(DirectX::FXMMATRIX viewProjection, DirectX::XMFLOAT4* planes);
+};
@@ -1,5 +1,7 @@
 #include "Game.h"
 #include <iostream>
+#include <algorithm>
+#include <cstring>
 #include "DXCore.h"
 #include "Vertex.h"
 #include "Input.h"
@@ -7,8 +9,7 @@
 #include "BufferStructs.h"
 #include "GameEntity.h"
 #include "Material.h"
-#include "WICTextureLoader.h"
-#include "DDSTextureLoader.h"
+#include "FrustumCuller.h"
 // Assumes files are in "imgui" subfolder!
 #include "imgui/imgui.h"
 #include "imgui/imgui_impl_dx11.h"
@@ -17,6 +18,11 @@
 #pragma comment(lib, "d3dcompiler.lib")
 // For the DirectX Math library
 using namespace DirectX;
+
+//how long each frame may spend creating resources for assets that finished loading
+static const float AssetUploadMillisecondsPerFrame = 4.0f;
+//gpu memory streamed textures may take up to start with, it can be changed in the debug window
+static const float DefaultTextureBudgetMB = 16.0f;
 // --------------------------------------------------------
 // Constructor
 //
@@ -34,7 +40,16 @@ Game::Game(HINSTANCE hInstance)
 		true),			   // Show extra stats (fps) in title bar?
 	//call transform constructor
 	transform(),
-	vsync(false)
+	vsync(false),
+	textureBudgetMB(DefaultTextureBudgetMB),
+	geometryBinds(0),
+	proxySceneEpoch(0),
+	cullingMode(CullingMode::Grid),
+	occlusionCulling(true),
+	cachedCullingMode(CullingMode::Grid),
+	cachedOcclusionCulling(true),
+	firstFrameReported(false),
+	assetsLoadedReported(false)
 {
 #if defined(DEBUG) || defined(_DEBUG)
 	// Do we want a console window?  Probably only in debug mode
@@ -58,8 +73,6 @@ Game::~Game()
 	ImGui_ImplDX11_Shutdown();
 	ImGui_ImplWin32_Shutdown();
 	ImGui::DestroyContext();
-	//make sure we offload our entities in our constructor
-	for (auto& e : listOfEntitys) { delete e; }
 
 
 }
@@ -69,6 +82,10 @@ Game::~Game()
 // --------------------------------------------------------
 void Game::Init()
 {
+	initStartTime = std::chrono::high_resolution_clock::now();
+
+	//start the loader first so its workers are busy while the rest of this runs
+	assetLoader = std::make_unique<AssetLoader>(registry, device, context);
 
 	//gui
 	initImGui();
@@ -113,6 +130,27 @@ void Game::Update(float deltaTime, float totalTime)
 
 	//make sure we update our camera
 	camera->Update(deltaTime);
+
+	//turn whatever the loader finished into real resources, without letting it eat the whole frame
+	assetLoader->Update(AssetUploadMillisecondsPerFrame);
+	if (!assetsLoadedReported && assetLoader->IsIdle())
+	{
+		assetsLoadedReported = true;
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("All assets loaded %.2f ms after Init (%.2f ms of loading on %u threads)\n",
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - initStartTime).count(),
+			assetLoader->GetLoadSeconds() * 1000.0,
+			assetLoader->GetThreadCount());
+		TextureCache& textureCache = assetLoader->GetTextureCache();
+		printf("Texture cache: %u of %u requests hit (%.0f%%), %u textures, %.2f MB saved\n",
+			textureCache.GetHitCount(), textureCache.GetRequestCount(), textureCache.GetHitRate() * 100.0f,
+			textureCache.GetTextureCount(), textureCache.GetBytesSaved() / (1024.0 * 1024.0));
+#endif
+	}
+
+	UpdateEntityBounds();
+	UpdateTextureStreaming();
+	CullEntities();
 }
 // --------------------------------------------------------
 // Clear the screen, redraw everything, present to the user
@@ -125,18 +163,18 @@ void Game::Draw(float deltaTime, float totalTime)
 	/////////////////////////////Baic shader///////////////////////////////////
 	///////////////////////////////////////////////////////////////////////////////
 	offset += .00001f;
-	pixelShader->SetFloat("scale", offset);
-	pixelShader->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
+	registry.GetPixelShader(pixelShader).SetFloat("scale", offset);
+	registry.GetPixelShader(pixelShader).SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
 	///////////////////////////////////////////////////////////////////////////////
 	/////////////////////////////Normals///////////////////////////////////
 	///////////////////////////////////////////////////////////////////////////////
-	pixelShader2->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
+	registry.GetPixelShader(pixelShader2).SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
 	///////////////////////////////////////////////////////////////////////////////
 	///////////////////////////////////////////////////////////////////////////////
 
 	//
 	//Give the toon pixel shader lights
-	toonPixelShader->SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
+	registry.GetPixelShader(toonPixelShader).SetData("lights", &lights[0], sizeof(Light) * (int)lights.size());
 
 	/*
 	// Background color (Cornflower Blue in this case) for clearing
@@ -153,18 +191,25 @@ void Game::Draw(float deltaTime, float totalTime)
 		0);
 		*/
 
+	//every mesh is in the arena's buffers, they only get set again when the vertex format changes
+	GeometryArena& geometryArena = assetLoader->GetGeometryArena();
+	geometryArena.ResetBinding();
+	unsigned int bindsBefore = geometryArena.GetBindCount();
+
 		//loop through and draw our entitys
-	for (int i = 0; i < listOfEntitys.size(); i++) {
+	for (unsigned int i : visibilityCache.GetDrawList()) {
 		//going to pass this jawn over to our shader here because for some reason this doesnt belong in entity class but wouldnt it make more sense to pass the ambient color into the entity instead of creating a seperation of tasks that just doesnt make a whole lot of sense, Yeah i get it, this is probably a little less cpu power but im not sure if its worth the loss in coesive code
-		listOfEntitys[i]->GetMaterial()->GetPixelShader()->SetFloat3("ambient", ambientColor);
-		listOfEntitys[i]->GetMaterial()->BindTexturesAndSamplers();
+		Material& material = registry.GetMaterial(entities.GetMaterials()[i]);
+		registry.GetPixelShader(material.GetPixelShader()).SetFloat3("ambient", ambientColor);
+		material.BindTexturesAndSamplers(registry);
 
-		listOfEntitys[i]->Draw(context, camera);
+		GameEntity::Draw(entities, i, registry, context, camera);
 	}
 	//draw sky here
 	{
-		skyObj->Draw(context, camera);
+		skyObj->Draw(registry, context, camera);
 	}
+	geometryBinds = geometryArena.GetBindCount() - bindsBefore;
 
 
 	//now that everything is done we can do our postprocessing
@@ -178,6 +223,16 @@ void Game::Draw(float deltaTime, float totalTime)
 	//  - Do this exactly ONCE PER FRAME (always at the very end of the frame)
 	swapChain->Present(vsync ? 1 : 0, 0);
 
+	if (!firstFrameReported)
+	{
+		firstFrameReported = true;
+#if defined(DEBUG) || defined(_DEBUG)
+		printf("First frame presented %.2f ms after Init (%u assets still loading)\n",
+			std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - initStartTime).count(),
+			assetLoader->GetPendingCount());
+#endif
+	}
+
 	// Due to the usage of a more sophisticated swap chain,
 	// the render target must be re-bound after every call to Present()
 	context->OMSetRenderTargets(1, backBufferRTV.GetAddressOf(), depthStencilView.Get());
@@ -205,17 +260,22 @@ void Game::initImGui()
 }
 void Game::LoadShaders()
 {
-	vertexShader = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShader.cso").c_str());
-	pixelShader = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"PixelShader.cso").c_str());
+	vertexShader = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShader.cso").c_str()));
+	pixelShader = registry.AddPixelShader(std::make_unique<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"PixelShader.cso").c_str()));
 
-	vertexShaderSky = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"skyVS.cso").c_str());
-	pixelShaderSky = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"skyPS.cso").c_str());
+	vertexShaderSky = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"skyVS.cso").c_str()));
+	pixelShaderSky = registry.AddPixelShader(std::make_unique<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"skyPS.cso").c_str()));
 
-	pixelShader2 = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"CustomPS.cso").c_str());
-	vertexShaderNM = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderNM.cso").c_str());
+	pixelShader2 = registry.AddPixelShader(std::make_unique<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"CustomPS.cso").c_str()));
+	vertexShaderNM = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderNM.cso").c_str()));
 
-	toonPixelShader = std::make_shared<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"ToonShadingPS.cso").c_str());
-	toonVertexShader = std::make_shared<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderNM.cso").c_str());
+	toonPixelShader = registry.AddPixelShader(std::make_unique<SimplePixelShader>(device, context, GetFullPathTo_Wide(L"ToonShadingPS.cso").c_str()));
+	toonVertexShader = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderNM.cso").c_str()));
+
+	//compact vertices need an explicit input layout, both compact shaders take the same input so they can share it
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> compactLayout = VertexCompactCodec::CreateInputLayout(device, GetFullPathTo_Wide(L"VertexShaderCompact.cso").c_str());
+	vertexShaderCompact = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderCompact.cso").c_str(), compactLayout, false));
+	vertexShaderCompactNM = registry.AddVertexShader(std::make_unique<SimpleVertexShader>(device, context, GetFullPathTo_Wide(L"VertexShaderCompactNM.cso").c_str(), compactLayout, false));
 
 }
 // --------------------------------------------------------
@@ -225,12 +285,23 @@ void Game::CreateBasicGeometry()
 {
 	// Create some temporary variables to represent colors
 	// - Not necessary, just makes things more readable
-	sphere = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/sphere.obj").c_str(), device, context);
-	torus = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/torus.obj").c_str(), device, context);
-	cube = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cube.obj").c_str(), device, context);
-	cylinder = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/cylinder.obj").c_str(), device, context);
-	helix = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/helix.obj").c_str(), device, context);
-	quad = std::make_shared<Mesh>(GetFullPathTo("../../Assets/Models/quad.obj").c_str(), device, context);
+	//the sphere and cube get scattered hundreds of times, so they use the smaller vertex format and get lods
+	MeshOptions compactOptions;
+	compactOptions.compactVertices = true;
+	compactOptions.lodRatios = { 0.5f, 0.25f, 0.125f };
+	compactOptions.buildMeshlets = true;
+	//the showcase props are drawn up close, where culling their meshlets on their own pays off
+	MeshOptions propOptions;
+	propOptions.buildMeshlets = true;
+
+	//these come back empty and fill in once the loader's workers get to them
+	sphere = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/sphere.obj"), compactOptions);
+	torus = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/torus.obj"), propOptions);
+	cube = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/cube.obj"), compactOptions);
+	cylinder = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/cylinder.obj"), propOptions);
+	helix = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/helix.obj"), propOptions);
+	quad = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/quad.obj"));
+	skyCube = assetLoader->LoadMesh(GetFullPathTo("../../Assets/Models/cube.obj"));
 
 
 }
@@ -259,249 +330,180 @@ void Game::LoadTexturesSRVsAndSampler()
 	Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler3;
 	device->CreateSamplerState(&sampDesc, sampler3.GetAddressOf());
 
-	//skymap
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> skyMap;
-
-	//PBRS
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodMetal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodNormals;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodRoughness;
+	mat1 = registry.AddMaterial(Material(vertexShader, pixelShader, XMFLOAT3(1, 1, 1), .9f));
+
+	mat2 = registry.AddMaterial(Material(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f));
+	mat3 = registry.AddMaterial(Material(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f));
+
+	mat4 = registry.AddMaterial(Material(vertexShaderNM, toonPixelShader, XMFLOAT3(1, 1, 1), 1.0f));
+	mat5 = registry.AddMaterial(Material(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f));
+
+	grassMat = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f));
+	cactusMat = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f));
+	groundMat = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f));
+	rockMat = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f));
+	rockMatTwo = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f));
+	woodMat = registry.AddMaterial(Material(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), 0.9f));
+
+	//give every material the compact version of its vertex shader, so any of them can go on any mesh
+	registry.GetMaterial(mat1).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(mat2).SetCompactVertexShader(vertexShaderCompactNM);
+	registry.GetMaterial(mat3).SetCompactVertexShader(vertexShaderCompactNM);
+	registry.GetMaterial(mat4).SetCompactVertexShader(vertexShaderCompactNM);
+	registry.GetMaterial(mat5).SetCompactVertexShader(vertexShaderCompactNM);
+	registry.GetMaterial(grassMat).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(cactusMat).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(groundMat).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(rockMat).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(rockMatTwo).SetCompactVertexShader(vertexShaderCompact);
+	registry.GetMaterial(woodMat).SetCompactVertexShader(vertexShaderCompact);
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedMetal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedNormals;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> scratchedRoughness;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeMetal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeNormals;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> bronzeRoughness;
+	/*
+	//set the resources for this material
+	mat1->AddTextureSRV("SurfaceTexture", rock);//rock
+	mat1->AddSampler("BasicSampler", sampler);
+	*/
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorMetal;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorNormals;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> floorRoughness;
+	registry.GetMaterial(grassMat).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(grassMat).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(cactusMat).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(cactusMat).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(rockMat).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(rockMat).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(rockMatTwo).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(rockMatTwo).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(groundMat).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(groundMat).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(woodMat).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(woodMat).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(mat4).AddSampler("BasicSampler", sampler2);
+	registry.GetMaterial(mat4).AddSampler("ToonRampSampler", sampler3);
+	registry.GetMaterial(mat5).AddSampler("BasicSampler", sampler);
+	registry.GetMaterial(mat3).AddSampler("BasicSampler", sampler);
+	registry.GetMaterial(mat2).AddSampler("BasicSampler", sampler);
+
+	// Every texture gets a slot in the registry that starts out
+	// as a placeholder, and the materials that use it point at
+	// that slot - once the loader has it ready it goes in the
+	// slot and every one of them picks it up
+	// - the kind picks how it's compressed (see TextureKind)
+	// - compressed kinds are streamed, they start at a small mip and
+	//   get finer ones as UpdateTextureStreaming asks for them
+	auto loadTexture = [&](const wchar_t* file, TextureKind kind, PlaceholderTexture placeholder, const char* name, std::vector<MaterialHandle> materials)
+	{
+		TextureHandle texture = registry.AddTexture(assetLoader->GetPlaceholder(placeholder));
+		for (auto& m : materials)
+			registry.GetMaterial(m).AddTexture(name, texture);
+		if (kind != TextureKind::Image)
+		{
+			registry.GetTexture(texture).streamed = assetLoader->LoadStreamedTexture(GetFullPathTo_Wide(file), kind);
+			return;
+		}
+		assetLoader->LoadTexture(GetFullPathTo_Wide(file), kind, [this, texture](Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+		{
+			registry.GetTexture(texture).srv = srv;
+		});
+	};
 
 	//toon shading
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rampTexture;
-
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cactusAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cactusNormals;
+	loadTexture(L"../../Assets/Textures/RampTexture.png", TextureKind::Image, PlaceholderTexture::White, "ToonRamp", { grassMat, cactusMat, rockMat, rockMatTwo, groundMat, woodMat, mat4 });
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> grassAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> grassNormals;
+	//the toon shader never reads its normal map, so those are the color texture again and share its load
+	loadTexture(L"../../Assets/Textures/Toon/GrassTexture.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { grassMat });
+	loadTexture(L"../../Assets/Textures/Toon/GrassTexture.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { grassMat });
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rockAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rockNormals;
+	loadTexture(L"../../Assets/Textures/Toon/RockTexture.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { rockMat });
+	loadTexture(L"../../Assets/Textures/Toon/RockTexture.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { rockMat });
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rockTwoAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> rockTwoNormals;
+	loadTexture(L"../../Assets/Textures/Toon/RockTextureTwo.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { rockMatTwo });
+	loadTexture(L"../../Assets/Textures/Toon/RockTextureTwo.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { rockMatTwo });
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> groundAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> groundNormals;
+	loadTexture(L"../../Assets/Textures/Toon/GroundTexture.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { groundMat });
+	loadTexture(L"../../Assets/Textures/Toon/GroundTexture.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { groundMat });
 
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodToonAlbedo;
-	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> woodToonNormals;
+	loadTexture(L"../../Assets/Textures/Toon/CactusTexture.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { cactusMat });
+	loadTexture(L"../../Assets/Textures/Toon/CactusTexture.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { cactusMat });
 
+	loadTexture(L"../../Assets/Textures/Toon/WoodTexture.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { woodMat });
+	loadTexture(L"../../Assets/Textures/Toon/WoodTexture.png", TextureKind::Color, PlaceholderTexture::FlatNormal, "NormalMap", { woodMat });
 
-	//setting the sky SRV to its texture
-	CreateDDSTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/BrightSky.dds").c_str(), 0, skyMap.GetAddressOf());
-	//setting PBR SRVs to their textures
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/wood_albedo.png").c_str(), 0, woodAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/wood_metal.png").c_str(), 0, woodMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/wood_normals.png").c_str(), 0, woodNormals.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/wood_roughness.png").c_str(), 0, woodRoughness.GetAddressOf());
+	//PBRs
+	loadTexture(L"../../Assets/Textures/PBR/wood_albedo.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { mat4 });
+	loadTexture(L"../../Assets/Textures/PBR/wood_normals.png", TextureKind::NormalMap, PlaceholderTexture::FlatNormal, "NormalMap", { mat4 });
+	loadTexture(L"../../Assets/Textures/PBR/wood_roughness.png", TextureKind::Mask, PlaceholderTexture::White, "RoughnessMap", { mat4 });
 
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_albedo.png").c_str(), 0, scratchedAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_metal.png").c_str(), 0, scratchedMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_normals.png").c_str(), 0, scratchedNormals.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/scratched_roughness.png").c_str(), 0, scratchedRoughness.GetAddressOf());
+	loadTexture(L"../../Assets/Textures/PBR/scratched_albedo.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { mat5 });
+	loadTexture(L"../../Assets/Textures/PBR/scratched_normals.png", TextureKind::NormalMap, PlaceholderTexture::FlatNormal, "NormalMap", { mat5 });
+	loadTexture(L"../../Assets/Textures/PBR/scratched_roughness.png", TextureKind::Mask, PlaceholderTexture::White, "RoughnessMap", { mat5 });
+	loadTexture(L"../../Assets/Textures/PBR/scratched_metal.png", TextureKind::Mask, PlaceholderTexture::Black, "MetalnessMap", { mat5 });
 
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_albedo.png").c_str(), 0, bronzeAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_metal.png").c_str(), 0, bronzeMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_normals.png").c_str(), 0, bronzeNormals.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/bronze_roughness.png").c_str(), 0, bronzeRoughness.GetAddressOf());
+	loadTexture(L"../../Assets/Textures/PBR/bronze_albedo.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { mat3 });
+	loadTexture(L"../../Assets/Textures/PBR/bronze_normals.png", TextureKind::NormalMap, PlaceholderTexture::FlatNormal, "NormalMap", { mat3 });
+	loadTexture(L"../../Assets/Textures/PBR/bronze_roughness.png", TextureKind::Mask, PlaceholderTexture::White, "RoughnessMap", { mat3 });
+	loadTexture(L"../../Assets/Textures/PBR/bronze_metal.png", TextureKind::Mask, PlaceholderTexture::Black, "MetalnessMap", { mat3 });
 
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_albedo.png").c_str(), 0, floorAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_metal.png").c_str(), 0, floorMetal.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_normals.png").c_str(), 0, floorNormals.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/PBR/floor_roughness.png").c_str(), 0, floorRoughness.GetAddressOf());
+	loadTexture(L"../../Assets/Textures/PBR/floor_albedo.png", TextureKind::Color, PlaceholderTexture::Gray, "Albedo", { mat2 });
+	loadTexture(L"../../Assets/Textures/PBR/floor_normals.png", TextureKind::NormalMap, PlaceholderTexture::FlatNormal, "NormalMap", { mat2 });
+	loadTexture(L"../../Assets/Textures/PBR/floor_roughness.png", TextureKind::Mask, PlaceholderTexture::White, "RoughnessMap", { mat2 });
+	loadTexture(L"../../Assets/Textures/PBR/floor_metal.png", TextureKind::Mask, PlaceholderTexture::Black, "MetalnessMap", { mat2 });
 
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/RampTexture.png").c_str(), 0, rampTexture.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/GrassTexture.png").c_str(), 0, grassAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/GrassTexture.png").c_str(), 0, grassNormals.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/RockTexture.png").c_str(), 0, rockAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/RockTexture.png").c_str(), 0, rockNormals.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/RockTextureTwo.png").c_str(), 0, rockTwoAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/RockTextureTwo.png").c_str(), 0, rockTwoNormals.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/GroundTexture.png").c_str(), 0, groundAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/GroundTexture.png").c_str(), 0, groundNormals.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/CactusTexture.png").c_str(), 0, cactusAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/CactusTexture.png").c_str(), 0, cactusNormals.GetAddressOf());
-
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/WoodTexture.png").c_str(), 0, woodToonAlbedo.GetAddressOf());
-	CreateWICTextureFromFile(device.Get(), context.Get(), GetFullPathTo_Wide(L"../../Assets/Textures/Toon/WoodTexture.png").c_str(), 0, woodToonNormals.GetAddressOf());
-
-	mat1 = std::make_shared<Material>(vertexShader, pixelShader, XMFLOAT3(1, 1, 1), .9f);
-
-	mat2 = std::make_shared<Material>(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f);
-	mat3 = std::make_shared<Material>(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f);
-
-	mat4 = std::make_shared<Material>(vertexShaderNM, toonPixelShader, XMFLOAT3(1, 1, 1), 1.0f);
-	mat5 = std::make_shared<Material>(vertexShaderNM, pixelShader2, XMFLOAT3(1, 1, 1), 1.0f);
-
-	grassMat = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f);
-	cactusMat = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f);
-	groundMat = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f);
-	rockMat = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f);
-	rockMatTwo = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), .9f);
-	woodMat = std::make_shared<Material>(vertexShader, toonPixelShader, XMFLOAT3(1, 1, 1), 0.9f);
-
-	/*
-	//set the resources for this material
-	mat1->AddTextureSRV("SurfaceTexture", rock);//rock
-	mat1->AddSampler("BasicSampler", sampler);
-	*/
-
-	grassMat->AddSampler("BasicSampler", sampler2);
-	grassMat->AddSampler("ToonRampSampler", sampler3);
-	grassMat->AddTextureSRV("Albedo", grassAlbedo);
-	grassMat->AddTextureSRV("NormalMap", grassNormals);
-	grassMat->AddTextureSRV("ToonRamp", rampTexture);
-
-	cactusMat->AddSampler("BasicSampler", sampler2);
-	cactusMat->AddSampler("ToonRampSampler", sampler3);
-	cactusMat->AddTextureSRV("Albedo", cactusAlbedo);
-	cactusMat->AddTextureSRV("NormalMap", cactusNormals);
-	cactusMat->AddTextureSRV("ToonRamp", rampTexture);
-
-	rockMat->AddSampler("BasicSampler", sampler2);
-	rockMat->AddSampler("ToonRampSampler", sampler3);
-	rockMat->AddTextureSRV("Albedo", rockAlbedo);
-	rockMat->AddTextureSRV("NormalMap", rockNormals);
-	rockMat->AddTextureSRV("ToonRamp", rampTexture);
-
-	rockMatTwo->AddSampler("BasicSampler", sampler2);
-	rockMatTwo->AddSampler("ToonRampSampler", sampler3);
-	rockMatTwo->AddTextureSRV("Albedo", rockTwoAlbedo);
-	rockMatTwo->AddTextureSRV("NormalMap", rockTwoNormals);
-	rockMatTwo->AddTextureSRV("ToonRamp", rampTexture);
-
-	groundMat->AddSampler("BasicSampler", sampler2);
-	groundMat->AddSampler("ToonRampSampler", sampler3);
-	groundMat->AddTextureSRV("Albedo", groundAlbedo);
-	groundMat->AddTextureSRV("NormalMap", groundNormals);
-	groundMat->AddTextureSRV("ToonRamp", rampTexture);
-
-	woodMat->AddSampler("BasicSampler", sampler2);
-	woodMat->AddSampler("ToonRampSampler", sampler3);
-	woodMat->AddTextureSRV("Albedo", woodToonAlbedo);
-	woodMat->AddTextureSRV("NormalMap", woodToonNormals);
-	woodMat->AddTextureSRV("ToonRamp", rampTexture);
-
-	//set these up to use our new PBRs
-	mat4->AddSampler("BasicSampler", sampler2);
-	mat4->AddSampler("ToonRampSampler", sampler3);
-	mat4->AddTextureSRV("Albedo", woodAlbedo);
-	mat4->AddTextureSRV("NormalMap", woodNormals);
-	mat4->AddTextureSRV("RoughnessMap", woodRoughness);
-	mat4->AddTextureSRV("ToonRamp", rampTexture);
-
-	//set these up to use our new PBRs
-	mat5->AddSampler("BasicSampler", sampler);
-	mat5->AddTextureSRV("Albedo", scratchedAlbedo);
-	mat5->AddTextureSRV("NormalMap", scratchedNormals);
-	mat5->AddTextureSRV("RoughnessMap", scratchedRoughness);
-	mat5->AddTextureSRV("MetalnessMap", scratchedMetal);
-
-	//set these up to use our new PBRs
-	mat3->AddSampler("BasicSampler", sampler);
-	mat3->AddTextureSRV("Albedo", bronzeAlbedo);
-	mat3->AddTextureSRV("NormalMap", bronzeNormals);
-	mat3->AddTextureSRV("RoughnessMap", bronzeRoughness);
-	mat3->AddTextureSRV("MetalnessMap", bronzeMetal);
-
-	//set these up to use our new PBRs
-	mat2->AddSampler("BasicSampler", sampler);
-	mat2->AddTextureSRV("Albedo", floorAlbedo);
-	mat2->AddTextureSRV("NormalMap", floorNormals);
-	mat2->AddTextureSRV("RoughnessMap", floorRoughness);
-	mat2->AddTextureSRV("MetalnessMap", floorMetal);
-
-	//make sky
-	skyObj = std::make_shared<Sky>(device, sampler2, skyMap, cube, vertexShaderSky, pixelShaderSky);
+	//make sky, a plain colored one until the real cubemap is in
+	TextureHandle skyCubemap = registry.AddTexture(assetLoader->GetPlaceholderCubemap());
+	skyObj = std::make_shared<Sky>(device, sampler2, skyCubemap, skyCube, vertexShaderSky, pixelShaderSky);
+	assetLoader->LoadCubemap(GetFullPathTo_Wide(L"../../Assets/Textures/BrightSky.dds"), [this, skyCubemap](Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+	{
+		registry.GetTexture(skyCubemap).srv = srv;
+	});
 }
 void Game::CreateEntitys()
 {
 	//creating our 5 entitys
-	GameEntity* sphereEntity = new GameEntity(sphere.get(), grassMat);
-	GameEntity* torusEntity = new GameEntity(torus.get(), cactusMat);
-	GameEntity* cubeEntity = new  GameEntity(cube.get(), rockMat);
-	GameEntity* cylinderEntity = new GameEntity(cylinder.get(), rockMatTwo);
-	GameEntity* helixEntity = new GameEntity(helix.get(), groundMat);
-	GameEntity* quadEntity = new GameEntity(quad.get(), groundMat);
+	EntityId sphereEntity = entities.Add(sphere, grassMat);
+	EntityId torusEntity = entities.Add(torus, cactusMat);
+	EntityId cubeEntity = entities.Add(cube, rockMat);
+	EntityId cylinderEntity = entities.Add(cylinder, rockMatTwo);
+	EntityId helixEntity = entities.Add(helix, groundMat);
+	EntityId quadEntity = entities.Add(quad, groundMat);
+
+	//the booth and the target are empty entities the parts hang off, so each moves as one piece
+	EntityId booth = entities.Add(MeshHandle(), MaterialHandle());
+	EntityId target = entities.Add(MeshHandle(), MaterialHandle());
 
 	//create the target
-	GameEntity* targetFace = new GameEntity(cylinder.get(), woodMat);
-	GameEntity* targetLegLeft = new GameEntity(cylinder.get(), woodMat);
-	GameEntity* targetLegRight = new GameEntity(cylinder.get(), woodMat);
+	EntityId targetFace = entities.Add(cylinder, woodMat);
+	EntityId targetLegLeft = entities.Add(cylinder, woodMat);
+	EntityId targetLegRight = entities.Add(cylinder, woodMat);
 
 	//create the "building"
-	GameEntity* roof = new GameEntity(cube.get(), woodMat);
-	GameEntity* frontLeft = new GameEntity(cube.get(), woodMat);
-	GameEntity* frontRight = new GameEntity(cube.get(), woodMat);
-	GameEntity* backLeft = new GameEntity(cube.get(), woodMat);
-	GameEntity* backRight = new GameEntity(cube.get(), woodMat);
+	EntityId roof = entities.Add(cube, woodMat);
+	EntityId frontLeft = entities.Add(cube, woodMat);
+	EntityId frontRight = entities.Add(cube, woodMat);
+	EntityId backLeft = entities.Add(cube, woodMat);
+	EntityId backRight = entities.Add(cube, woodMat);
 
 	//create the barrier for the building
-	GameEntity* support = new GameEntity(cube.get(), woodMat);
-	GameEntity* counter = new GameEntity(cube.get(), woodMat);
-
-	//pushing entitys to list
-	listOfEntitys.push_back(sphereEntity);
-	listOfEntitys.push_back(torusEntity);
-	listOfEntitys.push_back(cubeEntity);
-	listOfEntitys.push_back(cylinderEntity);
-	listOfEntitys.push_back(helixEntity);
-	listOfEntitys.push_back(quadEntity);
-	listOfEntitys.push_back(targetFace);
-	listOfEntitys.push_back(targetLegLeft);
-	listOfEntitys.push_back(targetLegRight);
-	listOfEntitys.push_back(roof);
-	listOfEntitys.push_back(frontLeft);
-	listOfEntitys.push_back(frontRight);
-	listOfEntitys.push_back(backLeft);
-	listOfEntitys.push_back(backRight);
-	listOfEntitys.push_back(support);
-	listOfEntitys.push_back(counter);
+	EntityId support = entities.Add(cube, woodMat);
+	EntityId counter = entities.Add(cube, woodMat);
 
 	//randomly spawn in 100 blades of grass around the map
 	for (int i = 0; i < 100; i++)
 	{
-		GameEntity* grassEntity = new  GameEntity(cube.get(), grassMat);
+		EntityId grassEntity = entities.Add(cube, grassMat);
 
 		//gets a random value between -50 and 50
 		int xVal = rand() % 100 - 50;
 		int zVal = rand() % 100 - 50;
 
-		grassEntity->GetTransform()->SetPosition(xVal, -0.5, zVal);
-		grassEntity->GetTransform()->SetRotation(0, 0, 0);
-		grassEntity->GetTransform()->SetScale(0.01, 0.3, 0.01);
-
-		listOfEntitys.push_back(grassEntity);
+		entities.SetPosition(grassEntity, xVal, -0.5, zVal);
+		entities.SetRotation(grassEntity, 0, 0, 0);
+		entities.SetScale(grassEntity, 0.01, 0.3, 0.01);
 
 	}
 
 	//randomly spawn in 50 cacti
 	for (int i = 0; i < 50; i++)
 	{
-		GameEntity* grassEntity = new  GameEntity(sphere.get(), cactusMat);
+		EntityId grassEntity = entities.Add(sphere, cactusMat);
 
 		//gets a random value between -50 and 50
 		int xVal = rand() % 100 - 50;
@@ -516,11 +518,10 @@ void Game::CreateEntitys()
 			scaleVal = 1;
 		}
 
-		grassEntity->GetTransform()->SetPosition(xVal, 0, zVal);
-		grassEntity->GetTransform()->SetRotation(0, 0, 0);
-		grassEntity->GetTransform()->SetScale(0.5, scaleVal, 0.5);
+		entities.SetPosition(grassEntity, xVal, 0, zVal);
+		entities.SetRotation(grassEntity, 0, 0, 0);
+		entities.SetScale(grassEntity, 0.5, scaleVal, 0.5);
 
-		listOfEntitys.push_back(grassEntity);
 	}
 
 	//randomly spawn 25 rocks
@@ -529,15 +530,15 @@ void Game::CreateEntitys()
 
 		int randomNum = rand() % 100;
 
-		GameEntity* rockEntity;
+		EntityId rockEntity;
 		
 		//add some diversity to the rock color
 		if (randomNum > 50)
 		{
-			rockEntity = new GameEntity(cube.get(), rockMat);
+			rockEntity = entities.Add(cube, rockMat);
 		}
 		else {
-			rockEntity = new GameEntity(cube.get(), rockMatTwo);
+			rockEntity = entities.Add(cube, rockMatTwo);
 		}
 
 		//gets a random value between -50 and 50
@@ -552,58 +553,69 @@ void Game::CreateEntitys()
 			scaleVal = 1.75;
 		}
 
-		rockEntity->GetTransform()->SetPosition(xVal, -0.5, zVal);
-		rockEntity->GetTransform()->SetRotation(zVal, (zVal + xVal) / 2, xVal);
-		rockEntity->GetTransform()->SetScale(1, 1, 1.25);
+		entities.SetPosition(rockEntity, xVal, -0.5, zVal);
+		entities.SetRotation(rockEntity, zVal, (zVal + xVal) / 2, xVal);
+		entities.SetScale(rockEntity, 1, 1, 1.25);
 
-		listOfEntitys.push_back(rockEntity);
 	}
 
 	/////////////////////////////////
 	//making sure we put them in a good spot
-	listOfEntitys[0]->GetTransform()->SetPosition(0, -10, 0);
-	listOfEntitys[1]->GetTransform()->SetPosition(-2.5, -10, 0);
-	listOfEntitys[2]->GetTransform()->SetPosition(2.5, -10, 0);
-	listOfEntitys[3]->GetTransform()->SetPosition(-5.5, -10, 0);
-	listOfEntitys[4]->GetTransform()->SetPosition(7.5, -10, 0);
-	listOfEntitys[5]->GetTransform()->SetPosition(0, -0.5, 0);
-	listOfEntitys[5]->GetTransform()->SetScale(100, 0, 100);
+	entities.SetPosition(sphereEntity, 0, -10, 0);
+	entities.SetPosition(torusEntity, -2.5, -10, 0);
+	entities.SetPosition(cubeEntity, 2.5, -10, 0);
+	entities.SetPosition(cylinderEntity, -5.5, -10, 0);
+	entities.SetPosition(helixEntity, 7.5, -10, 0);
+	entities.SetPosition(quadEntity, 0, -0.5, 0);
+	entities.SetScale(quadEntity, 100, 0, 100);
+
+	//the target stands inside the booth, everything under them is relative to where they are
+	entities.SetParent(target, booth);
+	entities.SetPosition(target, 0, 0, 6);
+	entities.SetParent(targetFace, target);
+	entities.SetParent(targetLegLeft, target);
+	entities.SetParent(targetLegRight, target);
+	EntityId boothParts[] = { roof, frontLeft, frontRight, backLeft, backRight, support, counter };
+	for (EntityId part : boothParts)
+		entities.SetParent(part, booth);
+	//all cubes, so their boxes are exactly what they cover
+	occluders.assign(std::begin(boothParts), std::end(boothParts));
 
 	//position the target
-	targetFace->GetTransform()->SetPosition(0, 1, 6);
-	targetFace->GetTransform()->SetRotation(90, 0, 0);
-	targetFace->GetTransform()->SetScale(1, 0.25, 1);
+	entities.SetPosition(targetFace, 0, 1, 0);
+	entities.SetRotation(targetFace, 90, 0, 0);
+	entities.SetScale(targetFace, 1, 0.25, 1);
 
-	targetLegLeft->GetTransform()->SetPosition(-0.5, 0, 6);
-	targetLegLeft->GetTransform()->SetRotation(0, 0, 0);
-	targetLegLeft->GetTransform()->SetScale(0.1, 1, 0.1);
+	entities.SetPosition(targetLegLeft, -0.5, 0, 0);
+	entities.SetRotation(targetLegLeft, 0, 0, 0);
+	entities.SetScale(targetLegLeft, 0.1, 1, 0.1);
 
-	targetLegRight->GetTransform()->SetPosition(0.5, 0, 6);
-	targetLegRight->GetTransform()->SetRotation(0, 0, 0);
-	targetLegRight->GetTransform()->SetScale(0.1, 1, 0.1);
+	entities.SetPosition(targetLegRight, 0.5, 0, 0);
+	entities.SetRotation(targetLegRight, 0, 0, 0);
+	entities.SetScale(targetLegRight, 0.1, 1, 0.1);
 
 	//position the building
-	roof->GetTransform()->SetPosition(0, 5, 0);
-	roof->GetTransform()->SetScale(5, 0.1, 10);
+	entities.SetPosition(roof, 0, 5, 0);
+	entities.SetScale(roof, 5, 0.1, 10);
 
-	frontLeft->GetTransform()->SetPosition(4, 0, 9);
-	frontLeft->GetTransform()->SetScale(0.15, 5, 0.15);
+	entities.SetPosition(frontLeft, 4, 0, 9);
+	entities.SetScale(frontLeft, 0.15, 5, 0.15);
 
-	frontRight->GetTransform()->SetPosition(-4, 0, 9);
-	frontRight->GetTransform()->SetScale(0.15, 5, 0.15);
+	entities.SetPosition(frontRight, -4, 0, 9);
+	entities.SetScale(frontRight, 0.15, 5, 0.15);
 
-	backLeft->GetTransform()->SetPosition(4, 0, -9);
-	backLeft->GetTransform()->SetScale(0.15, 5, 0.15);
+	entities.SetPosition(backLeft, 4, 0, -9);
+	entities.SetScale(backLeft, 0.15, 5, 0.15);
 
-	backRight->GetTransform()->SetPosition(-4, 0, -9);
-	backRight->GetTransform()->SetScale(0.15, 5, 0.15);
+	entities.SetPosition(backRight, -4, 0, -9);
+	entities.SetScale(backRight, 0.15, 5, 0.15);
 
 	//position the barrier
-	support->GetTransform()->SetPosition(0, 0, -7.5);
-	support->GetTransform()->SetScale(4, 0.75, 0.25);
+	entities.SetPosition(support, 0, 0, -7.5);
+	entities.SetScale(support, 4, 0.75, 0.25);
 
-	counter->GetTransform()->SetPosition(0, 0.5, -7.5);
-	counter->GetTransform()->SetScale(4.5, 0.15, 0.5);
+	entities.SetPosition(counter, 0, 0.5, -7.5);
+	entities.SetScale(counter, 4.5, 0.15, 0.5);
 
 	/////////////////////////////////
 }
@@ -732,6 +744,245 @@ void Game::SetUpLightUI(Light& light, int index) {
 		ImGui::TreePop();
 	}
 }
+// Rebuilds the world matrices of whatever moved, then moves every
+// entity's local box into world space all together, rather than one
+// at a time whenever something happens to need them
+void Game::UpdateEntityBounds()
+{
+	entities.UpdateWorldMatrices();
+
+	//meshes can finish loading at any point, so the local boxes are picked up again too
+	Aabb* localBounds = entities.GetLocalBounds();
+	const MeshHandle* meshes = entities.GetMeshes();
+	//the ones with no mesh are just a point where they are, and are only there to parent others
+	//- culling is redone for whatever moved, or whose mesh loaded and changed its box
+	drawableEntities.clear();
+	changedEntities.assign(entities.GetMovedIndices(), entities.GetMovedIndices() + entities.GetMovedCount());
+	for (unsigned int i = 0; i < entities.GetCount(); i++)
+	{
+		Aabb box = meshes[i].IsValid() ? registry.GetMesh(meshes[i]).GetBounds().box : Aabb();
+		if (memcmp(&box, &localBounds[i], sizeof(Aabb)) != 0)
+			changedEntities.push_back(i);
+		localBounds[i] = box;
+		if (meshes[i].IsValid())
+			drawableEntities.push_back(i);
+	}
+
+	Bounds::TransformAabbs(localBounds, entities.GetWorldMatrices(), entities.GetCount(), entities.GetWorldBounds());
+
+	// Keep the tree and grid up with the boxes - only what changed needs
+	// moving, and most of those haven't gone far enough to leave their
+	// fattened box or their cell, which costs next to nothing
+	if (entities.GetSceneEpoch() != proxySceneEpoch)
+	{
+		SyncEntityProxies();
+		proxySceneEpoch = entities.GetSceneEpoch();
+	}
+	const EntityId* ids = entities.GetIds();
+	const Aabb* worldBounds = entities.GetWorldBounds();
+	for (unsigned int i : changedEntities)
+	{
+		//the ones without a mesh never got any
+		if (ids[i].index >= entityProxies.size())
+			continue;
+		EntityProxy& proxy = entityProxies[ids[i].index];
+		if (proxy.treeProxy != DynamicAabbTree::NullNode)
+		{
+			entityTree.Move(proxy.treeProxy, worldBounds[i]);
+			entityGrid.Move(proxy.gridProxy, worldBounds[i]);
+		}
+	}
+}
+void Game::SyncEntityProxies()
+{
+	const EntityId* ids = entities.GetIds();
+	const MeshHandle* meshes = entities.GetMeshes();
+	const Aabb* worldBounds = entities.GetWorldBounds();
+
+	// Removed entities, and ones whose mesh was taken away, let go of theirs
+	for (EntityProxy& proxy : entityProxies)
+	{
+		if (proxy.treeProxy == DynamicAabbTree::NullNode)
+			continue;
+		if (entities.IsAlive(proxy.id) && meshes[entities.GetIndex(proxy.id)].IsValid())
+			continue;
+		entityTree.Remove(proxy.treeProxy);
+		entityGrid.Remove(proxy.gridProxy);
+		proxy.treeProxy = DynamicAabbTree::NullNode;
+		proxy.gridProxy = SpatialGrid::NullProxy;
+	}
+
+	//then the ones that can be drawn and don't have any yet - the id's index is what queries hand back
+	for (unsigned int i : drawableEntities)
+	{
+		unsigned int slot = ids[i].index;
+		if (slot >= entityProxies.size())
+			entityProxies.resize(slot + 1, { EntityId(), DynamicAabbTree::NullNode, SpatialGrid::NullProxy });
+		EntityProxy& proxy = entityProxies[slot];
+		if (proxy.treeProxy != DynamicAabbTree::NullNode)
+			continue;
+		proxy.id = ids[i];
+		proxy.treeProxy = entityTree.Insert(worldBounds[i], slot);
+		proxy.gridProxy = entityGrid.Insert(worldBounds[i], slot);
+	}
+}
+// Only what the camera can see and isn't hidden behind the booth gets
+// drawn. When nothing changed since last frame that's the same as last
+// frame, and when only a few entities moved only they're culled again
+void Game::CullEntities()
+{
+	//the epochs don't cover the settings, or everything behind an occluder that moved
+	if (cullingMode != cachedCullingMode || occlusionCulling != cachedOcclusionCulling)
+	{
+		visibilityCache.Invalidate();
+		cachedCullingMode = cullingMode;
+		cachedOcclusionCulling = occlusionCulling;
+	}
+	const EntityId* ids = entities.GetIds();
+	for (unsigned int i : changedEntities)
+	{
+		if (std::find(occluders.begin(), occluders.end(), ids[i]) != occluders.end())
+			visibilityCache.Invalidate();
+	}
+
+	VisibilityReuse reuse = visibilityCache.Begin(camera->GetEpoch(), entities.GetSceneEpoch(), (unsigned int)changedEntities.size(), entities.GetCount());
+	if (reuse == VisibilityReuse::Patch)
+	{
+		for (unsigned int i : changedEntities)
+			visibilityCache.Patch(i, CullEntity(i));
+	}
+	else if (reuse == VisibilityReuse::None)
+	{
+		if (cullingMode != CullingMode::EveryBox)
+		{
+			if (cullingMode == CullingMode::Grid)
+				entityGrid.QueryFrustum(camera->GetFrustumPlanes(), Camera::FrustumPlaneCount, visibleEntities);
+			else
+				entityTree.QueryFrustum(camera->GetFrustumPlanes(), Camera::FrustumPlaneCount, visibleEntities);
+
+			//those are id indices, turned back into where the entities are now
+			for (unsigned int& i : visibleEntities)
+				i = entities.GetIndex(entityProxies[i].id);
+		}
+		else
+			FrustumCuller::Cull(entities.GetWorldBounds(), drawableEntities.data(), (unsigned int)drawableEntities.size(),
+				camera->GetFrustumPlanes(), Camera::FrustumPlaneCount, visibleEntities);
+
+		//drawn in material then mesh order, so draws that share state are together
+		const MeshHandle* meshes = entities.GetMeshes();
+		const MaterialHandle* materials = entities.GetMaterials();
+		entityVisibility.resize(entities.GetCount());
+		drawSortKeys.resize(entities.GetCount());
+		for (unsigned int i = 0; i < entities.GetCount(); i++)
+		{
+			entityVisibility[i] = meshes[i].IsValid() ? Visibility::OutsideView : Visibility::Empty;
+			drawSortKeys[i] = ((unsigned long long)materials[i].index << 32) | meshes[i].index;
+		}
+
+		//then what's behind the booth
+		if (occlusionCulling)
+		{
+			for (unsigned int i : visibleEntities)
+				entityVisibility[i] = Visibility::Occluded;
+			RasterizeOccluders();
+			occlusionCuller.Cull(entities.GetWorldBounds(), visibleEntities.data(), (unsigned int)visibleEntities.size(), unoccludedEntities);
+			visibleEntities.swap(unoccludedEntities);
+		}
+		for (unsigned int i : visibleEntities)
+			entityVisibility[i] = Visibility::Visible;
+		visibilityCache.Store(entityVisibility.data(), drawSortKeys.data(), entities.GetCount());
+	}
+	visibilityCache.End();
+}
+// Draws the occluders' boxes into the occlusion culler's depth buffer,
+// which keeps until they or the camera move
+void Game::RasterizeOccluders()
+{
+	const Aabb* localBounds = entities.GetLocalBounds();
+	const XMFLOAT4X4* worldMatrices = entities.GetWorldMatrices();
+	occlusionCuller.BeginFrame(camera->GetViewProjectionMatrix());
+	for (EntityId id : occluders)
+	{
+		if (entities.IsAlive(id))
+		{
+			unsigned int i = entities.GetIndex(id);
+			occlusionCuller.AddOccluderBox(localBounds[i], worldMatrices[i]);
+		}
+	}
+	occlusionCuller.Rasterize();
+}
+//the same tests CullEntities does for everything, for just the one
+Visibility Game::CullEntity(unsigned int index)
+{
+	const Aabb& box = entities.GetWorldBounds()[index];
+	if (!entities.GetMeshes()[index].IsValid())
+		return Visibility::Empty;
+	if (FrustumCuller::IsOutsidePlanes(box, camera->GetFrustumPlanes(), Camera::FrustumPlaneCount))
+		return Visibility::OutsideView;
+	if (occlusionCulling && !occlusionCuller.IsVisible(box))
+		return Visibility::Occluded;
+	return Visibility::Visible;
+}
+//writes this frame's occlusion depth buffer next to the exe, as a 16 bit pgm
+void Game::DumpOcclusionDepth()
+{
+	std::vector<unsigned char> image;
+	occlusionCuller.BuildDepthImage(image);
+
+	HANDLE file = CreateFileA("occlusion_depth.pgm", GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return;
+	DWORD written = 0;
+	bool success = WriteFile(file, &image[0], (DWORD)image.size(), &written, 0) && written == image.size();
+	CloseHandle(file);
+#if defined(DEBUG) || defined(_DEBUG)
+	printf(success ? "Occlusion depth written to occlusion_depth.pgm\n" : "Couldn't write occlusion_depth.pgm\n");
+#endif
+}
+void Game::UpdateTextureStreaming()
+{
+	TextureStreamer& streamer = assetLoader->GetTextureStreamer();
+	streamer.SetBudget((unsigned long long)(textureBudgetMB * 1024.0f * 1024.0f));
+	streamer.BeginFrame();
+
+	// How many pixels a world unit covers one unit in front of the camera
+	XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+	float pixelsPerUnit = projection._22 * height * 0.5f;
+	XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+	XMVECTOR eye = XMLoadFloat3(&cameraPosition);
+
+	// Every texture on an entity wants the mip that puts about
+	// one texel on each pixel at the closest point of its box
+	const Aabb* worldBounds = entities.GetWorldBounds();
+	const XMFLOAT4X4* worldMatrices = entities.GetWorldMatrices();
+	for (unsigned int i = 0; i < entities.GetCount(); i++)
+	{
+		if (!entities.GetMeshes()[i].IsValid())
+			continue;
+		Mesh& mesh = registry.GetMesh(entities.GetMeshes()[i]);
+		if (!mesh.IsReady())
+			continue;
+
+		XMVECTOR closest = XMVectorClamp(eye, XMLoadFloat3(&worldBounds[i].minCorner), XMLoadFloat3(&worldBounds[i].maxCorner));
+		float distance = XMVectorGetX(XMVector3Length(eye - closest));
+
+		//scaling an entity up spreads its uvs over more of the world
+		float largestScale = (std::max)(Bounds::GetLargestScale(worldMatrices[i]), 0.0001f);
+		float uvDensity = mesh.GetBounds().uvDensity / largestScale;
+
+		for (auto& t : registry.GetMaterial(entities.GetMaterials()[i]).GetTextures())
+		{
+			TextureResource& slot = registry.GetTexture(t.second);
+			if (!slot.streamed)
+				continue;
+			StreamedTexture& texture = *slot.streamed;
+			float mip = TextureStreamer::ComputeMip((std::max)(texture.width, texture.height), uvDensity, distance, pixelsPerUnit);
+			streamer.RequestMip(texture, mip);
+		}
+	}
+
+	assetLoader->StreamTextures();
+}
 void Game::makeImGui(float dt) {
 
 
@@ -766,6 +1017,53 @@ void Game::makeImGui(float dt) {
 	// Combined into a single window
 	ImGui::Begin("Debug");
 
+	if (!assetLoader->IsIdle())
+		ImGui::Text("Loading %u assets...", assetLoader->GetPendingCount());
+
+	TextureCache& textureCache = assetLoader->GetTextureCache();
+	ImGui::Text("Textures: %u (%.1f MB), cache hit rate %.0f%%, %.1f MB saved",
+		textureCache.GetTextureCount(), textureCache.GetBytesResident() / (1024.0 * 1024.0),
+		textureCache.GetHitRate() * 100.0f, textureCache.GetBytesSaved() / (1024.0 * 1024.0));
+
+	MipResidency& residency = assetLoader->GetTextureStreamer().GetResidency();
+	ImGui::Text("Streamed textures: %u, %.2f of %.2f MB resident (%.2f MB wanted), %u loading",
+		residency.GetTextureCount(), residency.GetResidentBytes() / (1024.0 * 1024.0),
+		assetLoader->GetTextureStreamer().GetFullBytes() / (1024.0 * 1024.0),
+		residency.GetRequiredBytes() / (1024.0 * 1024.0), residency.GetLoadCount());
+	ImGui::SliderFloat("Texture budget (MB)", &textureBudgetMB, 0.25f, 64.0f);
+
+	GeometryArena& geometryArena = assetLoader->GetGeometryArena();
+	ImGui::Text("Geometry: %.2f of %.2f MB used, %.0f%% of free vertices fragmented, %u buffer binds for %u meshes",
+		geometryArena.GetUsedBytes() / (1024.0 * 1024.0), geometryArena.GetCapacityBytes() / (1024.0 * 1024.0),
+		(std::max)(geometryArena.GetVertexAllocator(false).GetFragmentation(), geometryArena.GetVertexAllocator(true).GetFragmentation()) * 100.0f,
+		geometryBinds, registry.GetMeshCount());
+	ImGui::Text("Entities: %u drawn, %u outside the view, %u hidden behind the booth", visibilityCache.GetCount(Visibility::Visible),
+		visibilityCache.GetCount(Visibility::OutsideView), visibilityCache.GetCount(Visibility::Occluded));
+	const char* cullingModes[] = { "Every box", "AABB tree", "Grid" };
+	ImGui::Combo("Culling", (int*)&cullingMode, cullingModes, IM_ARRAYSIZE(cullingModes));
+	ImGui::Text("Tree: %u nodes, %u high. Grid: %u cells and %u oversized, %u visited and %u boxes tested last query",
+		entityTree.GetNodeCount(), entityTree.GetHeight(), entityGrid.GetCellCount(), entityGrid.GetOversizedCount(), entityGrid.GetCellsVisited(), entityGrid.GetBoxesTested());
+	ImGui::Checkbox("Occlusion culling", &occlusionCulling);
+	ImGui::Text("Occlusion: %u triangles into %ux%u depth on %u threads", occlusionCuller.GetTriangleCount(),
+		occlusionCuller.GetWidth(), occlusionCuller.GetHeight(), occlusionCuller.GetThreadCount());
+	if (ImGui::Button("Dump occlusion depth"))
+		DumpOcclusionDepth();
+	ImGui::Text("Visibility cache: %.0f%% of frames reused (%u kept, %u patched, %u culled again), %.3f ms a full cull, %.2f ms saved",
+		visibilityCache.GetHitRate() * 100.0f, visibilityCache.GetReusedCount(), visibilityCache.GetPatchedCount(), visibilityCache.GetRebuiltCount(),
+		visibilityCache.GetAverageRebuildMilliseconds(), visibilityCache.GetMillisecondsSaved());
+
+	//everything the entities cover, from last frame's world bounds
+	if (entities.GetCount() > 0)
+	{
+		const Aabb* worldBounds = entities.GetWorldBounds();
+		Aabb scene = worldBounds[0];
+		for (unsigned int i = 1; i < entities.GetCount(); i++)
+			scene = Bounds::Merge(scene, worldBounds[i]);
+		ImGui::Text("Scene bounds: (%.1f, %.1f, %.1f) to (%.1f, %.1f, %.1f)",
+			scene.minCorner.x, scene.minCorner.y, scene.minCorner.z,
+			scene.maxCorner.x, scene.maxCorner.y, scene.maxCorner.z);
+	}
+
 	//make a lights div
 	if (ImGui::CollapsingHeader("Lights"))
 	{
@@ -780,16 +1078,17 @@ void Game::makeImGui(float dt) {
 	if (ImGui::CollapsingHeader("Entities"))
 	{
 
-		for (int i = 0; i < listOfEntitys.size(); i++)
+		//ids rather than indices, the sliders move entities but never remove them
+		for (unsigned int i = 0; i < entities.GetCount(); i++)
 		{
-			SetUpEntityUI(listOfEntitys[i], i);
+			SetUpEntityUI(entities.GetIds()[i], i);
 		}
 	}
 
 	ImGui::End();
 
 }
-void Game::SetUpEntityUI(GameEntity* gameEntity, int index) {
+void Game::SetUpEntityUI(EntityId id, int index) {
 
 
 	std::string indexStr = std::to_string(index);
@@ -801,12 +1100,10 @@ void Game::SetUpEntityUI(GameEntity* gameEntity, int index) {
 		// Transform -----------------------
 		if (ImGui::CollapsingHeader("Transform"))
 		{
-			Transform* transform = gameEntity->GetTransform();
-
 			//grab their initial values so we can have our sliders start at the right value 
-			XMFLOAT3 pos = transform->GetPosition();
-			XMFLOAT3 rot = transform->GetRotation();
-			XMFLOAT3 scale = transform->GetScale();
+			XMFLOAT3 pos = entities.GetPosition(id);
+			XMFLOAT3 rot = entities.GetRotation(id);
+			XMFLOAT3 scale = entities.GetScale(id);
 
 			//create three unique names so that our sliders all have a different name
 			std::string posID = "PositionOfEntity##" + indexStr;
@@ -816,17 +1113,17 @@ void Game::SetUpEntityUI(GameEntity* gameEntity, int index) {
 			if (ImGui::DragFloat3(posID.c_str(), &pos.x, 0.1f))
 			{
 				//make sure we actually set the position because this isnt lical
-				transform->SetPosition(pos.x, pos.y, pos.z);
+				entities.SetPosition(id, pos.x, pos.y, pos.z);
 			}
 
 			if (ImGui::DragFloat3(pyrID.c_str(), &rot.x, 0.1f))
 			{
-				transform->SetRotation(rot.x, rot.y, rot.z);
+				entities.SetRotation(id, rot.x, rot.y, rot.z);
 			}
 
 			if (ImGui::DragFloat3(scaleID.c_str(), &scale.x, 0.1f, 0.0f))
 			{
-				transform->SetScale(scale.x, scale.y, scale.z);
+				entities.SetScale(id, scale.x, scale.y, scale.z);
 			}
 		}
 		ImGui::TreePop();
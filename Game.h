@@ -9,6 +9,22 @@
 #include "Material.h"
 #include "Lights.h"
 #include "Sky.h"
+#include "AssetLoader.h"
+#include "ResourceRegistry.h"
+#include "DynamicAabbTree.h"
+#include "SpatialGrid.h"
+#include "OcclusionCuller.h"
+#include "VisibilityCache.h"
+#include <chrono>
+
+// Which structure finds the entities in view - they all find the same ones
+enum class CullingMode
+{
+	EveryBox,	// FrustumCuller over every drawable entity, four at a time
+	Tree,
+	Grid
+};
+
 class Game 
 	: public DXCore
 {
@@ -23,12 +39,19 @@ public:
 	void initImGui();
 	void makeImGui(float dt);
 	void SetUpLightUI(Light& light, int index);
-	void SetUpEntityUI(GameEntity* gameEntity, int index);
+	void SetUpEntityUI(EntityId id, int index);
 	void DrawLight();
 	void PreRender();
 	void PostRender();
 	void ResizePostProcessResources();
 	void CreatePostProcessSamplerState();
+	void UpdateEntityBounds();
+	void SyncEntityProxies();//gives every drawable entity tree and grid proxies, and drops the ones of entities gone or not drawn
+	void UpdateTextureStreaming();//asks for the mips each entity's textures need this frame
+	void CullEntities();//works out the draw list, or as little of it as changed since last frame
+	void RasterizeOccluders();
+	Visibility CullEntity(unsigned int index);//one entity through every test, for patching the cache
+	void DumpOcclusionDepth();
 	void Update(float deltaTime, float totalTime);
 	void Draw(float deltaTime, float totalTime);
 	//creating our 3 meshes for our shapes
@@ -36,47 +59,93 @@ public:
 	
 
 private:
-	std::vector<GameEntity*> listOfEntitys;
+	//every entity's transform, mesh, material and bounds, kept in arrays by component
+	EntityStore entities;
 	//entity
+	//every mesh, material, shader and texture lives in here, the rest of the game holds handles
+	//- before the loader so the loader is gone first
+	ResourceRegistry registry;
 	//shapes and meshes
-	std::shared_ptr<Mesh> sphere;
-	std::shared_ptr<Mesh> torus;
-	std::shared_ptr<Mesh> cube;
-	std::shared_ptr<Mesh> cylinder;
-	std::shared_ptr<Mesh> helix;
-	std::shared_ptr<Mesh> quad;
+	MeshHandle sphere;
+	MeshHandle torus;
+	MeshHandle cube;
+	MeshHandle cylinder;
+	MeshHandle helix;
+	MeshHandle quad;
+	MeshHandle skyCube;//the sky shader only takes full size vertices
+	//meshes and textures load in the background, everything starts as a placeholder
+	std::unique_ptr<AssetLoader> assetLoader;
+	float textureBudgetMB;//how much gpu memory streamed textures may take up
+	unsigned int geometryBinds;//times last frame's draws had to set the vertex and index buffers
+	//entities with a mesh, and the ones of those inside the camera's frustum when last culled
+	std::vector<unsigned int> drawableEntities;
+	std::vector<unsigned int> visibleEntities;
+	//entities that moved or whose mesh's box changed this frame
+	std::vector<unsigned int> changedEntities;
+	//the drawable entities' world boxes, for culling and any other looking up of what's where
+	//- queries hand back the index of the entity's id, which stays put when other entities are removed
+	DynamicAabbTree entityTree;
+	//the same boxes bucketed by where they are on the ground, which suits the evenly spread props
+	SpatialGrid entityGrid;
+	//where each entity is in both, by its id's index - looked over again whenever the scene epoch moves
+	struct EntityProxy
+	{
+		EntityId id;
+		unsigned int treeProxy;
+		unsigned int gridProxy;
+	};
+	std::vector<EntityProxy> entityProxies;
+	unsigned int proxySceneEpoch;
+	CullingMode cullingMode;
+	//the booth's solid parts get drawn into a small depth buffer on the cpu, and whatever's behind them isn't drawn
+	std::vector<EntityId> occluders;
+	OcclusionCuller occlusionCuller;
+	std::vector<unsigned int> unoccludedEntities;
+	bool occlusionCulling;
+	//what culling found, kept for the frames after it - and the settings it was found with, the cache can't see those
+	VisibilityCache visibilityCache;
+	std::vector<Visibility> entityVisibility;
+	std::vector<unsigned long long> drawSortKeys;
+	CullingMode cachedCullingMode;
+	bool cachedOcclusionCulling;
+	std::chrono::high_resolution_clock::time_point initStartTime;
+	bool firstFrameReported;
+	bool assetsLoadedReported;
 	//transform
 	Transform transform;
 	//camera
 	std::shared_ptr<Camera> camera;
 	//shaders
-	std::shared_ptr<SimplePixelShader> pixelShader;
-	std::shared_ptr<SimplePixelShader> pixelShader2;
-	std::shared_ptr<SimpleVertexShader> vertexShader;
+	PixelShaderHandle pixelShader;
+	PixelShaderHandle pixelShader2;
+	VertexShaderHandle vertexShader;
 
-	std::shared_ptr<SimpleVertexShader> vertexShaderNM;
-	std::shared_ptr<SimplePixelShader> pixelShaderNM;
+	VertexShaderHandle vertexShaderNM;
+	//same as the two above but for meshes with compact vertices
+	VertexShaderHandle vertexShaderCompact;
+	VertexShaderHandle vertexShaderCompactNM;
+	PixelShaderHandle pixelShaderNM;
 
-	std::shared_ptr<SimpleVertexShader> vertexShaderSky;
-	std::shared_ptr<SimplePixelShader> pixelShaderSky;
+	VertexShaderHandle vertexShaderSky;
+	PixelShaderHandle pixelShaderSky;
 
-	std::shared_ptr<SimpleVertexShader> toonVertexShader;
-	std::shared_ptr<SimplePixelShader> toonPixelShader;
+	VertexShaderHandle toonVertexShader;
+	PixelShaderHandle toonPixelShader;
 
 	//materials
-	std::shared_ptr<Material> mat1;
-	std::shared_ptr<Material> mat2;
-	std::shared_ptr<Material> mat3;
-	std::shared_ptr<Material> mat4;
-	std::shared_ptr<Material> mat5;
-	std::shared_ptr<Material> matSky;
-
-	std::shared_ptr<Material> grassMat;
-	std::shared_ptr<Material> cactusMat;
-	std::shared_ptr<Material> groundMat;
-	std::shared_ptr<Material> rockMat;
-	std::shared_ptr<Material> rockMatTwo;
-	std::shared_ptr<Material> woodMat;
+	MaterialHandle mat1;
+	MaterialHandle mat2;
+	MaterialHandle mat3;
+	MaterialHandle mat4;
+	MaterialHandle mat5;
+	MaterialHandle matSky;
+
+	MaterialHandle grassMat;
+	MaterialHandle cactusMat;
+	MaterialHandle groundMat;
+	MaterialHandle rockMat;
+	MaterialHandle rockMatTwo;
+	MaterialHandle woodMat;
 
 	//lights and light data
 	XMFLOAT3 ambientColor;
@@ -4,60 +4,117 @@
 #include "Camera.h" 
 #include "Material.h"
 #include <iostream>
-GameEntity::GameEntity(Mesh* mesh, std::shared_ptr<Material> mat)
-{
-    //make sure we set our material
-    SetMaterial(mat);
-    entitysMesh = mesh;
-}
+#include <cmath>
+#include <vector>
+#include <algorithm>
 
-GameEntity::~GameEntity()
-{
+using namespace DirectX;
+
+//how far off a level of detail may look before we use a finer one, in half screen heights (about a pixel at 1080p)
+static const float LodScreenError = 0.002f;
+
+//meshlets that survive culling, reused by every draw (device thread only)
+static std::vector<unsigned int> visibleMeshlets;
 
-}
 //going to do option two because option 1 doesnt make sense to me
 //passing in our constantbuffer and context so that we draw the idnividual entity we want
-void GameEntity::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
+void GameEntity::Draw(EntityStore& entities, unsigned int index, ResourceRegistry& registry, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
 {
-    material->GetVertexShader()->SetShader();
-    material->GetPixelShader()->SetShader();
+    //nothing to draw until the mesh has finished loading
+    Mesh& mesh = registry.GetMesh(entities.GetMeshes()[index]);
+    if (!mesh.IsReady())
+        return;
+    Material& mat = registry.GetMaterial(entities.GetMaterials()[index]);
+
+    //packed meshes need the matching vertex shader to unpack them
+    VertexShaderHandle vsHandle = mat.GetVertexShader();
+    if (mesh.IsCompact() && mat.GetCompactVertexShader().IsValid())
+        vsHandle = mat.GetCompactVertexShader();
+    SimpleVertexShader* vs = &registry.GetVertexShader(vsHandle);
+    SimplePixelShader* ps = &registry.GetPixelShader(mat.GetPixelShader());
 
-    std::shared_ptr<SimpleVertexShader> vs = material->GetVertexShader();
-    std::shared_ptr<SimplePixelShader> ps = material->GetPixelShader();
+    vs->SetShader();
+    ps->SetShader();
 
-    vs->SetMatrix4x4("worldMatrix", entitysTransform.BuildMatrix());   // match variable  
+    vs->SetMatrix4x4("worldMatrix", entities.GetWorldMatrices()[index]);   // match variable  
     vs->SetMatrix4x4("view", camera->GetViewMatrix());             // names in the  
     vs->SetMatrix4x4("projection", camera->GetProjectionMatrix()); // shaders cbuffer!
-    vs->SetMatrix4x4("invTransposeWorldMatrix", entitysTransform.GetWorldInverseTranspose()); // shaders cbuffer!
+    vs->SetMatrix4x4("invTransposeWorldMatrix", entities.GetWorldInverseTransposes()[index]); // shaders cbuffer!
+    if (mesh.IsCompact())
+    {
+        VertexQuantization quantization = mesh.GetQuantization();
+        vs->SetFloat3("positionOffset", quantization.offset);
+        vs->SetFloat3("positionScale", quantization.scale);
+    }
     vs->CopyAllBufferData();
 
 
     // Send data to the pixel shader
-    ps->SetFloat3("colorTint", material->GetColorTint());
-    ps->SetFloat("roughness", material->GetRoughness());
+    ps->SetFloat3("colorTint", mat.GetColorTint());
+    ps->SetFloat("roughness", mat.GetRoughness());
     ps->SetFloat3("cameraPosition", camera->GetTransform()->GetPosition());
     ps->CopyAllBufferData();
 
-	// Draw the object
-	entitysMesh->Draw();
-}
+    // Pick the coarsest level of detail whose error still
+    // looks smaller than LodScreenError from where the camera is
+    unsigned int lod = 0;
+    if (mesh.GetLodCount() > 1)
+    {
+        //from the world matrix, a parent can move and scale it too
+        const XMFLOAT4X4& world = entities.GetWorldMatrices()[index];
+        XMFLOAT3 position = XMFLOAT3(world._41, world._42, world._43);
+        XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+        float largestScale = Bounds::GetLargestScale(world);
 
-Mesh* GameEntity::GetMesh()
-{
-    return entitysMesh;
-}
+        float distance = XMVectorGetX(XMVector3Length(XMLoadFloat3(&position) - XMLoadFloat3(&cameraPosition)));
 
-Transform* GameEntity::GetTransform()
-{
-    return &entitysTransform;
-}
+        //_22 of the projection is how many half screen heights one unit is at a distance of one
+        XMFLOAT4X4 projection = camera->GetProjectionMatrix();
+        if (distance > 0)
+            lod = mesh.SelectLod(largestScale * projection._22 / distance, LodScreenError);
+    }
 
-void GameEntity::SetMaterial(std::shared_ptr<Material> mat)
-{
-    material = mat;
-}
+    // Meshlets only split the full mesh, so past lod 0 it's drawn whole
+    if (lod == 0 && mesh.HasMeshlets())
+    {
+        const XMFLOAT4X4& world = entities.GetWorldMatrices()[index];
+        XMFLOAT4 localPlanes[Camera::FrustumPlaneCount];
+        MeshletCuller::TransformPlanesToLocal(camera->GetFrustumPlanes(), Camera::FrustumPlaneCount, world, localPlanes);
 
-std::shared_ptr<Material> GameEntity::GetMaterial()
-{
-    return material;
+        // The normal cones only survive rotating, moving and evenly
+        // scaling - if it's stretched, just test the spheres
+        XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+        XMVECTOR scaleSq = XMVectorSet(
+            XMVectorGetX(XMVector3LengthSq(worldMatrix.r[0])),
+            XMVectorGetX(XMVector3LengthSq(worldMatrix.r[1])),
+            XMVectorGetX(XMVector3LengthSq(worldMatrix.r[2])), 0);
+        float smallest = (std::min)(XMVectorGetX(scaleSq), (std::min)(XMVectorGetY(scaleSq), XMVectorGetZ(scaleSq)));
+        float largest = (std::max)(XMVectorGetX(scaleSq), (std::max)(XMVectorGetY(scaleSq), XMVectorGetZ(scaleSq)));
+
+        const MeshletData& meshlets = mesh.GetMeshlets();
+        if (smallest > 0 && largest - smallest <= largest * 0.001f)
+        {
+            XMFLOAT3 cameraPosition = camera->GetTransform()->GetPosition();
+            //the store already has the inverse transpose, transposed back it's world to local
+            XMMATRIX toLocal = XMMatrixTranspose(XMLoadFloat4x4(&entities.GetWorldInverseTransposes()[index]));
+            XMFLOAT3 localCamera;
+            XMStoreFloat3(&localCamera, XMVector3TransformCoord(XMLoadFloat3(&cameraPosition), toLocal));
+            MeshletCuller::Cull(meshlets, localPlanes, Camera::FrustumPlaneCount, localCamera, visibleMeshlets);
+        }
+        else
+        {
+            visibleMeshlets.clear();
+            for (unsigned int i = 0; i < meshlets.meshlets.size(); i++)
+            {
+                if (!MeshletCuller::IsOutsidePlanes(meshlets.meshlets[i], localPlanes, Camera::FrustumPlaneCount))
+                    visibleMeshlets.push_back(i);
+            }
+        }
+
+        mesh.DrawMeshlets(visibleMeshlets);
+        return;
+    }
+
+    // Draw the object
+    mesh.DrawLod(lod);
 }
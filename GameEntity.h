@@ -4,24 +4,15 @@
 #include <wrl/client.h> // Used for ComPtr - a smart pointer for COM objects
 #include <memory>
 #include "Material.h"
+#include "ResourceRegistry.h"
+#include "EntityStore.h"
+// Draws one entity out of the EntityStore - the entity's data
+// all lives in the store, this is just what to do with it
 class GameEntity
 {
 public:
-	//constructor
-	GameEntity(Mesh* mesh, std::shared_ptr<Material> mat);
-	~GameEntity();
 	/// ////////////////////////////////////////////////////////////////////////////
-	void Draw( Microsoft::WRL::ComPtr<ID3D11DeviceContext> context,std::shared_ptr<Camera> camera);
-
-	//getters and setters
-	void SetMaterial(std::shared_ptr<Material> mat);
-	std::shared_ptr<Material> GetMaterial();
-	Mesh* GetMesh();
-	Transform* GetTransform();
-private:
-	//fields
-	Transform entitysTransform;
-	Mesh* entitysMesh;
-	std::shared_ptr<Material> material;
+	//index is where it is in the store's arrays, its world matrices have to be up to date
+	//mesh and material are looked up in the registry
+	static void Draw(EntityStore& entities, unsigned int index, ResourceRegistry& registry, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera);
 };
-
@@ -0,0 +1,280 @@
+#include "GeometryArena.h"
+#include "Vertex.h"
+#include "VertexCompact.h"
+#include <stdio.h>
+#include <algorithm>
+#include <iterator>
+
+RangeAllocator::RangeAllocator(unsigned int capacity)
+{
+	this->capacity = 0;
+	used = 0;
+	Grow(capacity);
+}
+
+unsigned int RangeAllocator::Allocate(unsigned int size)
+{
+	if (size == 0)
+		return InvalidOffset;
+
+	// Smallest free range it fits in, so big ranges are kept for big meshes
+	auto best = freeBySize.lower_bound(size);
+	if (best == freeBySize.end())
+		return InvalidOffset;
+
+	unsigned int offset = best->second;
+	unsigned int rangeSize = best->first;
+	RemoveFreeRange(freeByOffset.find(offset));
+
+	//whatever's left over stays free
+	if (rangeSize > size)
+		AddFreeRange(offset + size, rangeSize - size);
+
+	used += size;
+	return offset;
+}
+
+void RangeAllocator::Free(unsigned int offset, unsigned int size)
+{
+	if (size == 0 || offset == InvalidOffset)
+		return;
+	used -= size;
+
+	// Merge with the free ranges right before and after it
+	auto next = freeByOffset.lower_bound(offset);
+	if (next != freeByOffset.end() && offset + size == next->first)
+	{
+		size += next->second;
+		RemoveFreeRange(next);
+		next = freeByOffset.lower_bound(offset);
+	}
+	if (next != freeByOffset.begin())
+	{
+		auto previous = std::prev(next);
+		if (previous->first + previous->second == offset)
+		{
+			offset = previous->first;
+			size += previous->second;
+			RemoveFreeRange(previous);
+		}
+	}
+
+	AddFreeRange(offset, size);
+}
+
+void RangeAllocator::Grow(unsigned int newCapacity)
+{
+	if (newCapacity <= capacity)
+		return;
+
+	//the new space is freed like anything else so it merges with a free range at the end
+	unsigned int oldCapacity = capacity;
+	capacity = newCapacity;
+	used += newCapacity - oldCapacity;
+	Free(oldCapacity, newCapacity - oldCapacity);
+}
+
+unsigned int RangeAllocator::GetCapacity()
+{
+	return capacity;
+}
+
+unsigned int RangeAllocator::GetUsed()
+{
+	return used;
+}
+
+unsigned int RangeAllocator::GetFreeRangeCount()
+{
+	return (unsigned int)freeByOffset.size();
+}
+
+unsigned int RangeAllocator::GetLargestFreeRange()
+{
+	return freeBySize.empty() ? 0 : freeBySize.rbegin()->first;
+}
+
+float RangeAllocator::GetFragmentation()
+{
+	unsigned int free = capacity - used;
+	return free > 0 ? 1.0f - (float)GetLargestFreeRange() / free : 0.0f;
+}
+
+void RangeAllocator::AddFreeRange(unsigned int offset, unsigned int size)
+{
+	freeByOffset[offset] = size;
+	freeBySize.insert({ size, offset });
+}
+
+void RangeAllocator::RemoveFreeRange(std::map<unsigned int, unsigned int>::iterator range)
+{
+	//several ranges can share a size, find the one at this offset
+	auto sized = freeBySize.equal_range(range->second);
+	for (auto i = sized.first; i != sized.second; ++i)
+	{
+		if (i->second == range->first)
+		{
+			freeBySize.erase(i);
+			break;
+		}
+	}
+	freeByOffset.erase(range);
+}
+
+GeometryArena::GeometryArena(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int vertexCapacity, unsigned int indexCapacity)
+{
+	this->device = device;
+	this->context = context;
+	boundFormat = -1;
+	bindCount = 0;
+
+	vertexPools[0].elementSize = sizeof(Vertex);
+	vertexPools[1].elementSize = sizeof(VertexCompact);
+	indexPool.elementSize = sizeof(unsigned int);
+	vertexPools[0].bindFlags = vertexPools[1].bindFlags = D3D11_BIND_VERTEX_BUFFER;
+	indexPool.bindFlags = D3D11_BIND_INDEX_BUFFER;
+	vertexPools[0].startCapacity = vertexPools[1].startCapacity = vertexCapacity;
+	indexPool.startCapacity = indexCapacity;
+}
+
+bool GeometryArena::Allocate(const void* vertices, unsigned int vertexCount, bool compact, const unsigned int* indices, unsigned int indexCount, GeometryRange& range)
+{
+	Pool& vertexPool = vertexPools[compact ? 1 : 0];
+	unsigned int vertexOffset = Reserve(vertexPool, vertexCount);
+	if (vertexOffset == RangeAllocator::InvalidOffset)
+		return false;
+	unsigned int indexOffset = Reserve(indexPool, indexCount);
+	if (indexOffset == RangeAllocator::InvalidOffset)
+	{
+		vertexPool.allocator.Free(vertexOffset, vertexCount);
+		return false;
+	}
+
+	Write(vertexPool, vertexOffset, vertexCount, vertices);
+	Write(indexPool, indexOffset, indexCount, indices);
+
+	range.vertexOffset = vertexOffset;
+	range.vertexCount = vertexCount;
+	range.indexOffset = indexOffset;
+	range.indexCount = indexCount;
+	range.compact = compact;
+	return true;
+}
+
+void GeometryArena::Free(const GeometryRange& range)
+{
+	//the old contents stay in the buffers until something's written over them
+	vertexPools[range.compact ? 1 : 0].allocator.Free(range.vertexOffset, range.vertexCount);
+	indexPool.allocator.Free(range.indexOffset, range.indexCount);
+}
+
+void GeometryArena::Bind(bool compact)
+{
+	int format = compact ? 1 : 0;
+	if (boundFormat == format)
+		return;
+
+	UINT stride = vertexPools[format].elementSize;
+	UINT offset = 0;
+	context->IASetVertexBuffers(0, 1, vertexPools[format].buffer.GetAddressOf(), &stride, &offset);
+	context->IASetIndexBuffer(indexPool.buffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	boundFormat = format;
+	bindCount++;
+}
+
+void GeometryArena::ResetBinding()
+{
+	boundFormat = -1;
+}
+
+unsigned int GeometryArena::GetBindCount()
+{
+	return bindCount;
+}
+
+unsigned long long GeometryArena::GetUsedBytes()
+{
+	unsigned long long bytes = (unsigned long long)indexPool.allocator.GetUsed() * indexPool.elementSize;
+	for (auto& pool : vertexPools)
+		bytes += (unsigned long long)pool.allocator.GetUsed() * pool.elementSize;
+	return bytes;
+}
+
+unsigned long long GeometryArena::GetCapacityBytes()
+{
+	unsigned long long bytes = (unsigned long long)indexPool.allocator.GetCapacity() * indexPool.elementSize;
+	for (auto& pool : vertexPools)
+		bytes += (unsigned long long)pool.allocator.GetCapacity() * pool.elementSize;
+	return bytes;
+}
+
+RangeAllocator& GeometryArena::GetVertexAllocator(bool compact)
+{
+	return vertexPools[compact ? 1 : 0].allocator;
+}
+
+RangeAllocator& GeometryArena::GetIndexAllocator()
+{
+	return indexPool.allocator;
+}
+
+unsigned int GeometryArena::Reserve(Pool& pool, unsigned int count)
+{
+	unsigned int offset = pool.allocator.Allocate(count);
+	if (offset != RangeAllocator::InvalidOffset)
+		return offset;
+
+	// Doesn't fit, double until it does - whatever's free at the
+	// end of the old buffer counts towards the new space
+	unsigned long long capacity = (std::max)((std::max)(pool.allocator.GetCapacity(), pool.startCapacity), 1u);
+	unsigned long long needed = (unsigned long long)pool.allocator.GetUsed() + count;
+	while (capacity < needed || (pool.buffer && capacity == pool.allocator.GetCapacity()))
+		capacity *= 2;
+	if (capacity * pool.elementSize > 0xFFFFFFFFull || !Resize(pool, (unsigned int)capacity))
+		return RangeAllocator::InvalidOffset;
+
+	//fragmentation can still keep it from fitting, then it goes up again
+	offset = pool.allocator.Allocate(count);
+	return offset != RangeAllocator::InvalidOffset ? offset : Reserve(pool, count);
+}
+
+bool GeometryArena::Resize(Pool& pool, unsigned int capacity)
+{
+	D3D11_BUFFER_DESC desc = {};
+	desc.Usage = D3D11_USAGE_DEFAULT;	// not immutable, meshes come and go
+	desc.ByteWidth = capacity * pool.elementSize;
+	desc.BindFlags = pool.bindFlags;
+	Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;
+	if (FAILED(device->CreateBuffer(&desc, 0, buffer.GetAddressOf())))
+		return false;
+
+	// Everything already in the old one keeps its offset
+	if (pool.buffer)
+	{
+		D3D11_BOX box = {};
+		box.right = pool.allocator.GetCapacity() * pool.elementSize;
+		box.bottom = 1;
+		box.back = 1;
+		context->CopySubresourceRegion(buffer.Get(), 0, 0, 0, 0, pool.buffer.Get(), 0, &box);
+	}
+
+#if defined(DEBUG) || defined(_DEBUG)
+	if (pool.buffer)
+		printf("Geometry arena %s buffer grown to %.2f MB\n", pool.bindFlags == D3D11_BIND_INDEX_BUFFER ? "index" : "vertex", desc.ByteWidth / (1024.0 * 1024.0));
+#endif
+
+	pool.buffer = buffer;
+	pool.allocator.Grow(capacity);
+	boundFormat = -1;	// the old buffer may be the one bound
+	return true;
+}
+
+void GeometryArena::Write(Pool& pool, unsigned int offset, unsigned int count, const void* data)
+{
+	D3D11_BOX box = {};
+	box.left = offset * pool.elementSize;
+	box.right = (offset + count) * pool.elementSize;
+	box.bottom = 1;
+	box.back = 1;
+	context->UpdateSubresource(pool.buffer.Get(), 0, &box, data, 0, 0);
+}
@@ -0,0 +1,115 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <map>
+
+// --------------------------------------------------------
+// Range allocator
+//
+// Hands out ranges of a fixed size space (counted in whatever
+// units the caller likes - vertices, indices) from a list of
+// free ranges. Each allocation takes the smallest free range
+// it fits in, and freed ranges merge with free neighbours, so
+// space only stays split up while something sits between.
+//
+// Only the bookkeeping, no memory, so it can be run without
+// a device.
+// --------------------------------------------------------
+class RangeAllocator
+{
+public:
+	static const unsigned int InvalidOffset = 0xFFFFFFFF;
+
+	RangeAllocator(unsigned int capacity = 0);
+
+	//InvalidOffset if there's no free range big enough
+	unsigned int Allocate(unsigned int size);
+	//size has to be what it was allocated with
+	void Free(unsigned int offset, unsigned int size);
+	//adds free space at the end, everything allocated stays where it is
+	void Grow(unsigned int newCapacity);
+
+	unsigned int GetCapacity();
+	unsigned int GetUsed();
+	unsigned int GetFreeRangeCount();
+	unsigned int GetLargestFreeRange();
+	//how much of the free space is outside the largest free range, 0 when it's all in one piece
+	float GetFragmentation();
+
+private:
+	void AddFreeRange(unsigned int offset, unsigned int size);
+	void RemoveFreeRange(std::map<unsigned int, unsigned int>::iterator range);
+
+	std::map<unsigned int, unsigned int> freeByOffset;		// offset -> size, for finding neighbours
+	std::multimap<unsigned int, unsigned int> freeBySize;	// size -> offset, for the best fit
+	unsigned int capacity;
+	unsigned int used;
+};
+
+// Where a mesh's vertices and indices sit in the arena
+// - indices are relative to the mesh's first vertex, drawn with vertexOffset as the base vertex
+struct GeometryRange
+{
+	unsigned int vertexOffset;
+	unsigned int vertexCount;
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	bool compact;	// which vertex buffer it's in
+};
+
+// --------------------------------------------------------
+// Geometry arena
+//
+// Every mesh's vertices go into one big vertex buffer (one
+// per vertex format, since a binding only has one stride)
+// and every index into one big index buffer. Meshes keep
+// their ranges and draw with a base vertex and start index,
+// so drawing one mesh after another only touches the input
+// assembler when the vertex format changes.
+//
+// A buffer that runs out of room is replaced with one twice
+// the size and the old contents are copied over on the gpu,
+// so ranges never move. Device thread only.
+// --------------------------------------------------------
+class GeometryArena
+{
+public:
+	GeometryArena(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, unsigned int vertexCapacity = 65536, unsigned int indexCapacity = 262144);
+
+	//vertices are Vertex, or VertexCompact if compact - false if the buffers couldn't be made
+	bool Allocate(const void* vertices, unsigned int vertexCount, bool compact, const unsigned int* indices, unsigned int indexCount, GeometryRange& range);
+	void Free(const GeometryRange& range);
+
+	//sets the input assembler up for meshes of this vertex format, if it isn't already
+	void Bind(bool compact);
+	//something else has used the input assembler, so the next Bind has to set it again
+	void ResetBinding();
+
+	unsigned int GetBindCount();		// times Bind had to set the buffers, since the start
+	unsigned long long GetUsedBytes();
+	unsigned long long GetCapacityBytes();
+	RangeAllocator& GetVertexAllocator(bool compact);
+	RangeAllocator& GetIndexAllocator();
+
+private:
+	struct Pool
+	{
+		RangeAllocator allocator;
+		Microsoft::WRL::ComPtr<ID3D11Buffer> buffer;	// null until the first allocation
+		unsigned int elementSize;
+		unsigned int bindFlags;
+		unsigned int startCapacity;
+	};
+
+	//allocates count elements, growing the buffer when they don't fit
+	unsigned int Reserve(Pool& pool, unsigned int count);
+	bool Resize(Pool& pool, unsigned int capacity);
+	void Write(Pool& pool, unsigned int offset, unsigned int count, const void* data);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	Pool vertexPools[2];	// full Vertex, then VertexCompact
+	Pool indexPool;
+	int boundFormat;		// index into vertexPools, -1 when nothing of ours is bound
+	unsigned int bindCount;
+};
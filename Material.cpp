@@ -1,28 +1,34 @@
 #include "Material.h"
+#include "ResourceRegistry.h"
 //set everything up
-Material::Material(std::shared_ptr<SimpleVertexShader> vertexShader, std::shared_ptr<SimplePixelShader> pixelShader, XMFLOAT3 colorTint,float roughness)
+Material::Material(VertexShaderHandle vertexShader, PixelShaderHandle pixelShader, XMFLOAT3 colorTint,float roughness)
 {
 	SetColorTint(colorTint);
 	SetVertexShader(vertexShader);
 	SetPixelShader(pixelShader);
 	SetRoughness(roughness);
 }
-//all shared pointers so not neccessary
+//everything is a handle or a smart pointer so not neccessary
 Material::~Material()
 {
 
 }
 
-std::shared_ptr<SimplePixelShader> Material::GetPixelShader()
+PixelShaderHandle Material::GetPixelShader()
 {
 	return pixelShader;
 }
 
-std::shared_ptr<SimpleVertexShader> Material::GetVertexShader()
+VertexShaderHandle Material::GetVertexShader()
 {
 	return vertexShader;
 }
 
+VertexShaderHandle Material::GetCompactVertexShader()
+{
+	return compactVertexShader;
+}
+
 XMFLOAT3 Material::GetColorTint()
 {
 	return colorTint;
@@ -33,16 +39,21 @@ float Material::GetRoughness()
 	return roughness;
 }
 
-void Material::SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader)
+void Material::SetPixelShader(PixelShaderHandle pixelShader)
 {
 	this->pixelShader = pixelShader;
 }
 
-void Material::SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader)
+void Material::SetVertexShader(VertexShaderHandle vertexShader)
 {
 	this->vertexShader = vertexShader;
 }
 
+void Material::SetCompactVertexShader(VertexShaderHandle compactVertexShader)
+{
+	this->compactVertexShader = compactVertexShader;
+}
+
 void Material::SetColorTint(XMFLOAT3 colorTint)
 {
 	this->colorTint = colorTint;
@@ -53,10 +64,14 @@ void Material::SetRoughness(float roughnessParam)
 	this->roughness = roughnessParam;
 }
 
-void Material::AddTextureSRV(std::string textureSRVName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV)
+void Material::AddTexture(std::string textureSRVName, TextureHandle texture)
+{
+	textures[textureSRVName] = texture;
+}
+
+const std::unordered_map<std::string, TextureHandle>& Material::GetTextures()
 {
-	//insert the key value pairs into out T UO Map
-	textureSRVs.insert({ textureSRVName,SRV});
+	return textures;
 }
 
 void Material::AddSampler(std::string samplerName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler)
@@ -64,9 +79,10 @@ void Material::AddSampler(std::string samplerName, Microsoft::WRL::ComPtr<ID3D11
 	samplers.insert({ samplerName,sampler});
 }
 
-void Material::BindTexturesAndSamplers()
+void Material::BindTexturesAndSamplers(ResourceRegistry& registry)
 {
-	//t.first is the name, t.second is the value(the actual object)
-	for (auto& t : textureSRVs) { pixelShader->SetShaderResourceView(t.first.c_str(), t.second); }
-	for (auto& s : samplers) { pixelShader->SetSamplerState(s.first.c_str(), s.second); }
+	SimplePixelShader& ps = registry.GetPixelShader(pixelShader);
+	//t.first is the name, t.second is the value(the actual object) - streamed textures swap their srv whenever their mips change, so it's looked up every time
+	for (auto& t : textures) { ps.SetShaderResourceView(t.first.c_str(), registry.GetTexture(t.second).GetSRV()); }
+	for (auto& s : samplers) { ps.SetSamplerState(s.first.c_str(), s.second); }
 }
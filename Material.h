@@ -3,34 +3,41 @@
 #include <vector>
 #include "SimpleShader.h"
 #include "DXCore.h"
+#include "ResourcePool.h"
 #include <unordered_map>
 using namespace DirectX;
+class ResourceRegistry;
 class Material
 {
 public:
-	Material(std::shared_ptr<SimpleVertexShader>vertexShader, std::shared_ptr<SimplePixelShader>pixelShader, XMFLOAT3 colorTint,float roughness);
+	Material(VertexShaderHandle vertexShader, PixelShaderHandle pixelShader, XMFLOAT3 colorTint,float roughness);
 	~Material();
 
 	//getters and setters
-	std::shared_ptr<SimplePixelShader> GetPixelShader();
-	std::shared_ptr<SimpleVertexShader> GetVertexShader();
+	PixelShaderHandle GetPixelShader();
+	VertexShaderHandle GetVertexShader();
+	VertexShaderHandle GetCompactVertexShader();//used instead for meshes with compact vertices, invalid if there isn't one
 	XMFLOAT3 GetColorTint();
 	float GetRoughness();
 
-	void SetPixelShader(std::shared_ptr<SimplePixelShader> pixelShader);
-	void SetVertexShader(std::shared_ptr<SimpleVertexShader> vertexShader);
+	void SetPixelShader(PixelShaderHandle pixelShader);
+	void SetVertexShader(VertexShaderHandle vertexShader);
+	void SetCompactVertexShader(VertexShaderHandle compactVertexShader);
 	void SetColorTint(XMFLOAT3 colorTint);
 	void SetRoughness(float roughness);
-	void AddTextureSRV(std::string textureSRVName, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> SRV);
+	//the texture slot's srv is looked up every bind, so swapping a placeholder for the real thing happens in the registry
+	void AddTexture(std::string textureSRVName, TextureHandle texture);
+	const std::unordered_map<std::string, TextureHandle>& GetTextures();
 	void AddSampler(std::string samplerName, Microsoft::WRL::ComPtr<ID3D11SamplerState> sampler);
-	void BindTexturesAndSamplers();
+	void BindTexturesAndSamplers(ResourceRegistry& registry);
 private:
-	//shared ptrs for our shader
-	std::shared_ptr<SimplePixelShader> pixelShader;
-	std::shared_ptr<SimpleVertexShader> vertexShader;
+	//handles for our shaders, they live in the registry
+	PixelShaderHandle pixelShader;
+	VertexShaderHandle vertexShader;
+	VertexShaderHandle compactVertexShader;
 
 	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11SamplerState>> samplers;
-	std::unordered_map<std::string, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>> textureSRVs;
+	std::unordered_map<std::string, TextureHandle> textures;
 	XMFLOAT3 colorTint;
 	float roughness;
 
@@ -1,64 +1,224 @@
 #include "Mesh.h"
+#include "ObjParser.h"
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "TangentGenerator.h"
 #include <vector>
-#include <fstream>
+#include <unordered_map>
+#include <cfloat>
+#include <cstring>
 
+//hashing for welding obj corners, one vertex per unique v/vt/vn triplet in the file
+struct ObjCornerHash
+{
+	size_t operator()(const ObjCorner& corner) const
+	{
+		//mix the three indices together so neighbouring corners dont all land in the same bucket
+		size_t hash = corner.position;
+		hash = hash * 0x9E3779B1u ^ corner.uv;
+		hash = hash * 0x9E3779B1u ^ corner.normal;
+		return hash;
+	}
+};
+
+struct ObjCornerEqual
+{
+	bool operator()(const ObjCorner& a, const ObjCorner& b) const
+	{
+		return a.position == b.position && a.uv == b.uv && a.normal == b.normal;
+	}
+};
 
 using namespace DirectX;
 
-void Mesh::CreateBuffer(Vertex* vertices, int numOfVerts, unsigned int* indices, int numberOfIndices, Microsoft::WRL::ComPtr<ID3D11Device> deviceObject)
+//the data is expected to be final (tangents included) since it may come straight from a mapped cache file
+void Mesh::CreateBuffer(const Vertex* vertices, int numOfVerts, const unsigned int* indices, int numberOfIndices, GeometryArena& arena)
 {
-	//make sure we make our tangents go brrrrrrrrrrrrrrrrrr
-	CalculateTangents(vertices, numOfVerts, indices, numberOfIndices);
-
-
-	numOfIndices = numberOfIndices;
-	// Create the VERTEX BUFFER description -----------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC vbd = {};
-	vbd.Usage = D3D11_USAGE_IMMUTABLE;
-	vbd.ByteWidth = sizeof(Vertex) * numOfVerts;       // 3 = number of vertices in the buffer
-	vbd.BindFlags = D3D11_BIND_VERTEX_BUFFER; // Tells DirectX this is a vertex buffer
-	vbd.CPUAccessFlags = 0;
-	vbd.MiscFlags = 0;
-	vbd.StructureByteStride = 0;
-	D3D11_SUBRESOURCE_DATA initialVertexData = {};
-	initialVertexData.pSysMem = vertices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	deviceObject->CreateBuffer(&vbd, &initialVertexData, vertexBuffer.GetAddressOf());
-
-	/////////////////////////////////////////////////////////////////////////////////////////////////////////
-	//////////////////////////////////////////////////////////////////////////////////////////////////////////
-
-	// Create the INDEX BUFFER description ------------------------------------
-	// - The description is created on the stack because we only need
-	//    it to create the buffer.  The description is then useless.
-	D3D11_BUFFER_DESC ibd = {};
-	ibd.Usage = D3D11_USAGE_IMMUTABLE;
-	ibd.ByteWidth = sizeof(unsigned int) * numberOfIndices;	// 3 = number of indices in the buffer
-	ibd.BindFlags = D3D11_BIND_INDEX_BUFFER;	// Tells DirectX this is an index buffer
-	ibd.CPUAccessFlags = 0;
-	ibd.MiscFlags = 0;
-	ibd.StructureByteStride = 0;
-	D3D11_SUBRESOURCE_DATA initialIndexData = {};
-	initialIndexData.pSysMem = indices;
-
-	// Actually create the buffer with the initial data
-	// - Once we do this, we'll NEVER CHANGE THE BUFFER AGAIN
-	deviceObject->CreateBuffer(&ibd, &initialIndexData, indexBuffer.GetAddressOf());
+	//the buffer may hold several lods, the index count is just the full one
+	numOfIndices = lods.empty() ? numberOfIndices : lods[0].indexCount;
+
+	// Pack the vertices down first if this mesh wants the compact layout
+	// - Done here rather than cached, since it's cheap next to everything else
+	std::vector<VertexCompact> packed;
+	if (compactVertices)
+	{
+		quantization = VertexCompactCodec::ComputeQuantization(vertices, numOfVerts);
+		packed.resize(numOfVerts);
+		VertexCompactCodec::Encode(vertices, numOfVerts, indices, numOfIndices, quantization, &packed[0]);
+	}
+
+	// Everything shares the arena's buffers, this just claims a
+	// range of each - the index buffer may hold several lods
+	if (arena.Allocate(compactVertices ? (const void*)&packed[0] : (const void*)vertices, (unsigned int)numOfVerts, compactVertices, indices, (unsigned int)numberOfIndices, geometry))
+		this->arena = &arena;
 }
 //creating our two buffered arrays using this data
-Mesh::Mesh(Vertex* vertices, int numberOfVerticesInArray, unsigned int* indices, int numberOfIndicesInArray, Microsoft::WRL::ComPtr<ID3D11Device> deviceObject, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject)
+Mesh::Mesh(Vertex* vertices, int numberOfVerticesInArray, unsigned int* indices, int numberOfIndicesInArray, GeometryArena& arena, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject, MeshOptions options)
 {
 	//setting our member variable to the correct object
 	context = contextObject;
-	CreateBuffer(vertices, numberOfVerticesInArray, indices, numberOfIndicesInArray, deviceObject);
+	compactVertices = options.compactVertices;
+	this->arena = 0;
+	geometry = GeometryRange();
+
+	//work on copies, processing may reorder or drop vertices
+	MeshData data;
+	data.vertices.assign(vertices, vertices + numberOfVerticesInArray);
+	data.indices.assign(indices, indices + numberOfIndicesInArray);
+	ProcessMesh(data, options);
+
+	Upload(data, arena);
+}
+
+//an empty mesh that draws nothing until Upload gives it data
+Mesh::Mesh(Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject, MeshOptions options)
+{
+	context = contextObject;
+	compactVertices = options.compactVertices;
+	numOfIndices = 0;
+	bounds = MeshBounds();
+	arena = 0;
+	geometry = GeometryRange();
+}
+
+unsigned long long Mesh::GetProcessingFlags(const MeshOptions& options)
+{
+	unsigned long long flags = 0;
+	if (options.optimizeVertexCache) flags |= 1 << 0;
+	if (options.optimizeVertexCache && options.optimizeOverdraw)
+	{
+		//the threshold changes the result too, keep it to two decimal places in the upper bits
+		flags |= 1 << 1;
+		flags |= (unsigned long long)((unsigned int)(options.overdrawThreshold * 100.0f + 0.5f) & 0xFFFF) << 16;
+	}
+	if (options.buildMeshlets) flags |= 1 << 2;
+
+	//the lod ratios get hashed into the top half
+	if (!options.lodRatios.empty())
+	{
+		unsigned int hash = 2166136261u;
+		for (float ratio : options.lodRatios)
+		{
+			unsigned int bits;
+			memcpy(&bits, &ratio, sizeof(bits));
+			for (int i = 0; i < 4; i++)
+			{
+				hash ^= (bits >> (i * 8)) & 0xFF;
+				hash *= 16777619u;
+			}
+		}
+		flags |= (unsigned long long)hash << 32;
+	}
+	return flags;
+}
+
+//turns welded data into what we actually upload - optional optimizations, then tangents
+void Mesh::ProcessMesh(MeshData& data, const MeshOptions& options)
+{
+	std::vector<Vertex>& verts = data.vertices;
+	std::vector<unsigned int>& indices = data.indices;
+	std::vector<MeshLod>& lods = data.lods;
+	MeshletData& meshlets = data.meshlets;
+	MeshBounds& bounds = data.bounds;
+
+	if (options.optimizeVertexCache)
+	{
+		// Reorder triangles so shared verts are reused while they're still
+		// in the post-transform cache, then lay the verts out in the order
+		// those triangles touch them so fetching them walks forward in memory
+		MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)verts.size());
+
+		// Our toon and PBR pixel shaders cost far more than the vertex
+		// shader, so give a little of that cache efficiency back to draw
+		// the outer, most occluding parts of the mesh first
+		if (options.optimizeOverdraw)
+			MeshOptimizer::OptimizeOverdraw(&indices[0], (unsigned int)indices.size(), &verts[0], (unsigned int)verts.size(), options.overdrawThreshold);
+
+		unsigned int usedVerts = MeshOptimizer::OptimizeVertexFetch(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size());
+		verts.resize(usedVerts);
+	}
+
+	//make sure we make our tangents go brrrrrrrrrrrrrrrrrr
+	CalculateTangents(&verts[0], (int)verts.size(), &indices[0], (int)indices.size());
+
+	// Bounds of the final vertices, for culling, lod selection and picking,
+	// and how much uv space they cover for picking texture mips to stream
+	bounds = Bounds::Compute(&verts[0], (unsigned int)verts.size());
+	bounds.uvDensity = Bounds::ComputeUvDensity(&verts[0], &indices[0], (unsigned int)indices.size());
+
+	// Meshlets come last, they split the index buffer in whatever order it ended up in
+	if (options.buildMeshlets)
+		MeshletBuilder::Build(&verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), meshlets);
+
+	// Levels of detail go on the end of the same index buffer, all
+	// simplified straight from the full mesh so errors don't stack up
+	unsigned int baseIndexCount = (unsigned int)indices.size();
+	lods.clear();
+	MeshLod full = { 0, baseIndexCount, 0.0f };
+	lods.push_back(full);
+
+	std::vector<unsigned int> lodIndices(baseIndexCount);
+	for (float ratio : options.lodRatios)
+	{
+		unsigned int target = (unsigned int)(baseIndexCount / 3 * ratio) * 3;
+
+		float error = 0;
+		unsigned int count = MeshSimplifier::Simplify(&verts[0], (unsigned int)verts.size(), &indices[0], baseIndexCount, target, FLT_MAX, &lodIndices[0], &error);
+
+		// Locked seams can stop a mesh from getting much simpler (the cube
+		// can't lose anything), no point keeping a level that barely changed
+		if (count == 0 || count > lods.back().indexCount * 9 / 10)
+			break;
+
+		if (options.optimizeVertexCache)
+			MeshOptimizer::OptimizeVertexCache(&lodIndices[0], count, (unsigned int)verts.size());
+
+		MeshLod lod = { (unsigned int)indices.size(), count, error };
+		lods.push_back(lod);
+		indices.insert(indices.end(), lodIndices.begin(), lodIndices.begin() + count);
+	}
 }
 
 //createBudder(&verts[0],vertCounter,&indices[0],vertCounter, device);
-Mesh::Mesh(const char* filename,Microsoft::WRL::ComPtr<ID3D11Device> deviceObject, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject)
+Mesh::Mesh(const char* filename, GeometryArena& arena, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject, MeshOptions options)
+{
+	//setting our member variable to the correct object
+	context = contextObject;
+	compactVertices = options.compactVertices;
+	numOfIndices = 0;
+	bounds = MeshBounds();
+	this->arena = 0;
+	geometry = GeometryRange();
+
+	MeshData data;
+	if (LoadData(filename, options, data))
+		Upload(data, arena);
+}
+
+bool Mesh::LoadData(const char* filename, const MeshOptions& options, MeshData& out)
+{
+	// If we've seen this model before there's no parsing and no
+	// processing - the cache file stays mapped until Upload, and
+	// the buffers are filled straight from its pages
+	std::unique_ptr<MeshCache> cache(new MeshCache());
+	if (cache->Open(filename, GetProcessingFlags(options)))
+	{
+		out.vertices.clear();
+		out.indices.clear();
+		out.lods.assign(cache->GetLods(), cache->GetLods() + cache->GetLodCount());
+		out.bounds = cache->GetBounds();
+		cache->GetMeshlets(out.meshlets);
+		out.cache = std::move(cache);
+		return true;
+	}
+
+	out.cache.reset();
+	return BuildData(filename, options, out);
+}
+
+bool Mesh::BuildData(const char* filename, const MeshOptions& options, MeshData& out)
 {
 	// Author: Chris Cascioli
 // Purpose: Basic .OBJ 3D model loading, supporting positions, uvs and normals
@@ -69,202 +229,108 @@ Mesh::Mesh(const char* filename,Microsoft::WRL::ComPtr<ID3D11Device> deviceObjec
 //
 // - NOTE: You'll need to #include <fstream>
 
-	//setting our member variable to the correct object
-	context = contextObject;
-	// File input object
-	std::ifstream obj(filename);
+	//the file reading moved to ObjParser, the vertex assembly and space conversion below are still from this loader
+
+	// Read the raw positions, uvs, normals and triangle corners
+	// - The parser memory maps the file and splits it across threads
+	ObjParser parser;
+	ObjData obj;
+	if (!parser.Parse(filename, obj) || obj.corners.empty())
+		return false;
+
+	std::vector<Vertex>& verts = out.vertices;		// Verts we're assembling
+	std::vector<UINT>& indices = out.indices;		// Indices of these verts
+	verts.clear();
+	indices.clear();
+	verts.reserve(obj.positions.size());
+	indices.reserve(obj.corners.size());
+
+	// Every unique v/vt/vn triplet becomes exactly one vertex, so
+	// corners shared between faces are stored once and referenced
+	// through the index buffer instead of being duplicated
+	std::unordered_map<ObjCorner, unsigned int, ObjCornerHash, ObjCornerEqual> weldedVerts;
+	weldedVerts.reserve(obj.corners.size());
+	auto weldVertex = [&](const ObjCorner& corner)
+	{
+		auto found = weldedVerts.find(corner);
+		if (found != weldedVerts.end())
+			return found->second;
+
+		// Create the vert by looking up corresponding data from the file
+		Vertex v;
+		v.Position = obj.positions[corner.position];
+		v.UV = obj.uvs[corner.uv];
+		v.Normal = obj.normals[corner.normal];
+		v.Tangent = XMFLOAT3(0, 0, 0);
+
+		// The model is most likely in a right-handed space,
+		// especially if it came from Maya.  We want to convert
+		// to a left-handed space for DirectX.  This means we 
+		// need to:
+		//  - Invert the Z position
+		//  - Invert the normal's Z
+		//  - Flip the winding order (done when adding indices)
+		// We also need to flip the UV coordinate since DirectX
+		// defines (0,0) as the top left of the texture, and many
+		// 3D modeling packages use the bottom left as (0,0)
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+
+		unsigned int index = (unsigned int)verts.size();
+		verts.push_back(v);
+
+		weldedVerts.insert({ corner, index });
+		return index;
+	};
+
+	for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
+	{
+		unsigned int v1 = weldVertex(obj.corners[i]);
+		unsigned int v2 = weldVertex(obj.corners[i + 1]);
+		unsigned int v3 = weldVertex(obj.corners[i + 2]);
+
+		// Add the triangle (flipping the winding order)
+		indices.push_back(v1);
+		indices.push_back(v3);
+		indices.push_back(v2);
+	}
 
-	// Check for successful open
-	if (!obj.is_open())
-		return;
+	ProcessMesh(out, options);
 
-	// Variables used while reading the file
-	std::vector<XMFLOAT3> positions;	// Positions from the file
-	std::vector<XMFLOAT3> normals;		// Normals from the file
-	std::vector<XMFLOAT2> uvs;		// UVs from the file
-	std::vector<Vertex> verts;		// Verts we're assembling
-	std::vector<UINT> indices;		// Indices of these verts
-	int vertCounter = 0;			// Count of vertices
-	int indexCounter = 0;			// Count of indices
-	char chars[100];			// String for line reading
-
-	// Still have data left?
-	while (obj.good())
-	{
-		// Get the line (100 characters should be more than enough)
-		obj.getline(chars, 100);
+	// Save the finished arrays so the next run can skip all of the above
+	MeshCache::Write(filename, GetProcessingFlags(options), &verts[0], (unsigned int)verts.size(), &indices[0], (unsigned int)indices.size(), &out.lods[0], (unsigned int)out.lods.size(), out.bounds, options.buildMeshlets ? &out.meshlets : 0);
+	return true;
+}
 
-		// Check the type of line
-		if (chars[0] == 'v' && chars[1] == 'n')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 norm;
-			sscanf_s(
-				chars,
-				"vn %f %f %f",
-				&norm.x, &norm.y, &norm.z);
-
-			// Add to the list of normals
-			normals.push_back(norm);
-		}
-		else if (chars[0] == 'v' && chars[1] == 't')
-		{
-			// Read the 2 numbers directly into an XMFLOAT2
-			XMFLOAT2 uv;
-			sscanf_s(
-				chars,
-				"vt %f %f",
-				&uv.x, &uv.y);
-
-			// Add to the list of uv's
-			uvs.push_back(uv);
-		}
-		else if (chars[0] == 'v')
-		{
-			// Read the 3 numbers directly into an XMFLOAT3
-			XMFLOAT3 pos;
-			sscanf_s(
-				chars,
-				"v %f %f %f",
-				&pos.x, &pos.y, &pos.z);
-
-			// Add to the positions
-			positions.push_back(pos);
-		}
-		else if (chars[0] == 'f')
-		{
-			// Read the face indices into an array
-			// NOTE: This assumes the given obj file contains
-			//  vertex positions, uv coordinates AND normals.
-			unsigned int i[12];
-			int numbersRead = sscanf_s(
-				chars,
-				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
-				&i[0], &i[1], &i[2],
-				&i[3], &i[4], &i[5],
-				&i[6], &i[7], &i[8],
-				&i[9], &i[10], &i[11]);
-
-			// If we only got the first number, chances are the OBJ
-			// file has no UV coordinates.  This isn't great, but we
-			// still want to load the model without crashing, so we
-			// need to re-read a different pattern (in which we assume
-			// there are no UVs denoted for any of the vertices)
-			if (numbersRead == 1)
-			{
-				// Re-read with a different pattern
-				numbersRead = sscanf_s(
-					chars,
-					"f %d//%d %d//%d %d//%d %d//%d",
-					&i[0], &i[2],
-					&i[3], &i[5],
-					&i[6], &i[8],
-					&i[9], &i[11]);
-
-				// The following indices are where the UVs should 
-				// have been, so give them a valid value
-				i[1] = 1;
-				i[4] = 1;
-				i[7] = 1;
-				i[10] = 1;
-
-				// If we have no UVs, create a single UV coordinate
-				// that will be used for all vertices
-				if (uvs.size() == 0)
-					uvs.push_back(XMFLOAT2(0, 0));
-			}
+void Mesh::Upload(MeshData& data, GeometryArena& arena)
+{
+	if (data.GetVertexCount() == 0 || data.GetIndexCount() == 0)
+		return;
 
-			// - Create the verts by looking up
-			//    corresponding data from vectors
-			// - OBJ File indices are 1-based, so
-			//    they need to be adusted
-			Vertex v1;
-			v1.Position = positions[i[0] - 1];
-			v1.UV = uvs[i[1] - 1];
-			v1.Normal = normals[i[2] - 1];
-
-			Vertex v2;
-			v2.Position = positions[i[3] - 1];
-			v2.UV = uvs[i[4] - 1];
-			v2.Normal = normals[i[5] - 1];
-
-			Vertex v3;
-			v3.Position = positions[i[6] - 1];
-			v3.UV = uvs[i[7] - 1];
-			v3.Normal = normals[i[8] - 1];
-
-			// The model is most likely in a right-handed space,
-			// especially if it came from Maya.  We want to convert
-			// to a left-handed space for DirectX.  This means we 
-			// need to:
-			//  - Invert the Z position
-			//  - Invert the normal's Z
-			//  - Flip the winding order
-			// We also need to flip the UV coordinate since DirectX
-			// defines (0,0) as the top left of the texture, and many
-			// 3D modeling packages use the bottom left as (0,0)
-
-			// Flip the UV's since they're probably "upside down"
-			v1.UV.y = 1.0f - v1.UV.y;
-			v2.UV.y = 1.0f - v2.UV.y;
-			v3.UV.y = 1.0f - v3.UV.y;
-
-			// Flip Z (LH vs. RH)
-			v1.Position.z *= -1.0f;
-			v2.Position.z *= -1.0f;
-			v3.Position.z *= -1.0f;
-
-			// Flip normal's Z
-			v1.Normal.z *= -1.0f;
-			v2.Normal.z *= -1.0f;
-			v3.Normal.z *= -1.0f;
-
-			// Add the verts to the vector (flipping the winding order)
-			verts.push_back(v1);
-			verts.push_back(v3);
-			verts.push_back(v2);
-			vertCounter += 3;
-
-			// Add three more indices
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-			indices.push_back(indexCounter); indexCounter += 1;
-
-			// Was there a 4th face?
-			// - 12 numbers read means 4 faces WITH uv's
-			// - 8 numbers read means 4 faces WITHOUT uv's
-			if (numbersRead == 12 || numbersRead == 8)
-			{
-				// Make the last vertex
-				Vertex v4;
-				v4.Position = positions[i[9] - 1];
-				v4.UV = uvs[i[10] - 1];
-				v4.Normal = normals[i[11] - 1];
-
-				// Flip the UV, Z pos and normal's Z
-				v4.UV.y = 1.0f - v4.UV.y;
-				v4.Position.z *= -1.0f;
-				v4.Normal.z *= -1.0f;
-
-				// Add a whole triangle (flipping the winding order)
-				verts.push_back(v1);
-				verts.push_back(v4);
-				verts.push_back(v3);
-				vertCounter += 3;
-
-				// Add three more indices
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-				indices.push_back(indexCounter); indexCounter += 1;
-			}
-		}
-	}
+	//the small stuff moves over, the arrays only need to live until the buffers exist
+	lods.swap(data.lods);
+	meshlets.meshlets.swap(data.meshlets.meshlets);
+	meshlets.vertices.swap(data.meshlets.vertices);
+	meshlets.triangles.swap(data.meshlets.triangles);
+	bounds = data.bounds;
 
-	// Close the file and create the actual buffers
-	obj.close();
+	CreateBuffer(data.GetVertices(), (int)data.GetVertexCount(), data.GetIndices(), (int)data.GetIndexCount(), arena);
+	data.cache.reset();
+}
+
+void Mesh::Release()
+{
+	if (arena)
+		arena->Free(geometry);
+	arena = 0;
+	geometry = GeometryRange();
+	numOfIndices = 0;
+}
 
-	CreateBuffer(&verts[0], vertCounter, &indices[0], indexCounter, deviceObject);
-	
+bool Mesh::IsReady()
+{
+	return arena != 0;
 }
 
 //because we are using smart pointers we do not need to clean out our memory
@@ -276,100 +342,108 @@ Mesh::~Mesh()
 // belongs to christophen cannoli
 void Mesh::CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices)
 {
-	// Reset tangents
-	for (int i = 0; i < numVerts; i++)
-	{
-		verts[i].Tangent = XMFLOAT3(0, 0, 0);
-	}
+	TangentGenerator::Generate(verts, (unsigned int)numVerts, indices, (unsigned int)numIndices);
+}
+const GeometryRange& Mesh::GetGeometry()
+{
+	return geometry;
+}
+int Mesh::GetIndexCount() 
+{
+	return numOfIndices;
+}
+const MeshBounds& Mesh::GetBounds()
+{
+	return bounds;
+}
+bool Mesh::IsCompact()
+{
+	return compactVertices;
+}
+VertexQuantization Mesh::GetQuantization()
+{
+	return quantization;
+}
+const MeshletData& Mesh::GetMeshlets()
+{
+	return meshlets;
+}
+bool Mesh::HasMeshlets()
+{
+	return !meshlets.meshlets.empty();
+}
+void Mesh::DrawMeshlets(const std::vector<unsigned int>& visibleMeshlets)
+{
+	if (!arena)
+		return;
 
-	// Calculate tangents one whole triangle at a time
-	for (int i = 0; i < numIndices;)
-	{
-		// Grab indices and vertices of first triangle
-		unsigned int i1 = indices[i++];
-		unsigned int i2 = indices[i++];
-		unsigned int i3 = indices[i++];
-		Vertex* v1 = &verts[i1];
-		Vertex* v2 = &verts[i2];
-		Vertex* v3 = &verts[i3];
-
-		// Calculate vectors relative to triangle positions
-		float x1 = v2->Position.x - v1->Position.x;
-		float y1 = v2->Position.y - v1->Position.y;
-		float z1 = v2->Position.z - v1->Position.z;
-
-		float x2 = v3->Position.x - v1->Position.x;
-		float y2 = v3->Position.y - v1->Position.y;
-		float z2 = v3->Position.z - v1->Position.z;
-
-		// Do the same for vectors relative to triangle uv's
-		float s1 = v2->UV.x - v1->UV.x;
-		float t1 = v2->UV.y - v1->UV.y;
-
-		float s2 = v3->UV.x - v1->UV.x;
-		float t2 = v3->UV.y - v1->UV.y;
-
-		// Create vectors for tangent calculation
-		float r = 1.0f / (s1 * t2 - s2 * t1);
-
-		float tx = (t2 * x1 - t1 * x2) * r;
-		float ty = (t2 * y1 - t1 * y2) * r;
-		float tz = (t2 * z1 - t1 * z2) * r;
-
-		// Adjust tangents of each vert of the triangle
-		v1->Tangent.x += tx;
-		v1->Tangent.y += ty;
-		v1->Tangent.z += tz;
-
-		v2->Tangent.x += tx;
-		v2->Tangent.y += ty;
-		v2->Tangent.z += tz;
-
-		v3->Tangent.x += tx;
-		v3->Tangent.y += ty;
-		v3->Tangent.z += tz;
-	}
+	arena->Bind(compactVertices);
 
-	// Ensure all of the tangents are orthogonal to the normals
-	for (int i = 0; i < numVerts; i++)
+	// Each meshlet is a range of the index buffer, so neighbouring
+	// visible meshlets can go out together as one draw call
+	size_t i = 0;
+	while (i < visibleMeshlets.size())
 	{
-		// Grab the two vectors
-		XMVECTOR normal = XMLoadFloat3(&verts[i].Normal);
-		XMVECTOR tangent = XMLoadFloat3(&verts[i].Tangent);
+		const Meshlet& first = meshlets.meshlets[visibleMeshlets[i]];
+		unsigned int start = first.indexOffset;
+		unsigned int end = start + first.triangleCount * 3;
 
-		// Use Gram-Schmidt orthonormalize to ensure
-		// the normal and tangent are exactly 90 degrees apart
-		tangent = XMVector3Normalize(
-			tangent - normal * XMVector3Dot(normal, tangent));
+		for (i++; i < visibleMeshlets.size(); i++)
+		{
+			const Meshlet& next = meshlets.meshlets[visibleMeshlets[i]];
+			if (next.indexOffset != end)
+				break;
+			end += next.triangleCount * 3;
+		}
 
-		// Store the tangent
-		XMStoreFloat3(&verts[i].Tangent, tangent);
+		context->DrawIndexed(end - start, geometry.indexOffset + start, geometry.vertexOffset);
 	}
 }
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetVertexBuffer()
+unsigned int Mesh::GetLodCount()
 {
-	return vertexBuffer;
+	return lods.empty() ? 1 : (unsigned int)lods.size();
 }
-Microsoft::WRL::ComPtr<ID3D11Buffer> Mesh::GetIndexBuffer()
+const MeshLod& Mesh::GetLod(unsigned int lod)
 {
-	return indexBuffer;
+	return lods[lod];
 }
-int Mesh::GetIndexCount() 
+unsigned int Mesh::SelectLod(float errorScale, float maxError)
 {
-	return numOfIndices;
+	// Errors only grow with each level, so walk up until one is too coarse
+	unsigned int selected = 0;
+	for (unsigned int i = 1; i < lods.size(); i++)
+	{
+		if (lods[i].error * errorScale > maxError)
+			break;
+		selected = i;
+	}
+	return selected;
+}
+void Mesh::DrawLod(unsigned int lod)
+{
+	if (!arena)
+		return;
+
+	if (lod == 0 || lod >= lods.size())
+	{
+		Draw();
+		return;
+	}
+
+	arena->Bind(compactVertices);
+
+	//every lod indexes the same vertices, just a different range of indices
+	context->DrawIndexed(lods[lod].indexCount, geometry.indexOffset + lods[lod].indexOffset, geometry.vertexOffset);
 }
 void Mesh::Draw() 
 {
+	if (!arena)
+		return;
+
 	// Set buffers in the input assembler
-	//  - Do this ONCE PER OBJECT you're drawing, since each object might
-	//    have different geometry.
-	//  - for this demo, this step *could* simply be done once during Init(),
-	//    but I'm doing it here because it's often done multiple times per frame
-	//    in a larger application/game
-	UINT stride = sizeof(Vertex);
-	UINT offset = 0;
-	context->IASetVertexBuffers(0, 1, vertexBuffer.GetAddressOf(), &stride, &offset);
-	context->IASetIndexBuffer(indexBuffer.Get(), DXGI_FORMAT_R32_UINT, 0);
+	//  - every mesh of the same vertex format is in the same buffers, so
+	//    this only does anything when the format changes (see GeometryArena)
+	arena->Bind(compactVertices);
 
 
 	// Finally do the actual drawing
@@ -379,6 +453,6 @@ void Mesh::Draw()
 	//     vertices in the currently set VERTEX BUFFER
 	context->DrawIndexed(
 		GetIndexCount(),     // The number of indices to use (we could draw a subset if we wanted)
-		0,     // Offset to the first index we want to use
-		0);    // Offset to add to each index when looking up vertices
+		geometry.indexOffset,     // Offset to the first index we want to use
+		geometry.vertexOffset);    // Offset to add to each index when looking up vertices
 }
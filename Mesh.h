@@ -1,28 +1,95 @@
 #pragma once
 #include <d3d11.h>
 #include <wrl/client.h>
+#include <vector>
+#include <memory>
 #include "Vertex.h"
+#include "VertexCompact.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "Bounds.h"
+#include "GeometryArena.h"
+#include "MeshCache.h"
+
+// Optional processing applied to a mesh's data before its buffers are created
+// - Anything set here is baked into the mesh cache, so it costs nothing after the first run
+struct MeshOptions
+{
+	bool optimizeVertexCache = true;	// reorder triangles and vertices for the post-transform vertex cache
+	bool optimizeOverdraw = true;		// then reorder clusters of triangles so likely occluders draw first
+	float overdrawThreshold = 1.05f;	// how much vertex cache efficiency (ACMR) the overdraw pass may give up
+	bool compactVertices = false;		// upload packed VertexCompact (20 bytes) instead of Vertex (44 bytes), needs a compact vertex shader
+	bool buildMeshlets = false;			// split the triangles into meshlets that can be culled on their own
+	std::vector<float> lodRatios;		// extra levels of detail to build, as fractions of the full triangle count (e.g. 0.5, 0.25)
+};
+
+// Everything a mesh needs before it can make its buffers
+// - Built without touching the device, so it can happen on any thread
+struct MeshData
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;	// every lod, one after another
+	std::vector<MeshLod> lods;
+	MeshletData meshlets;
+	MeshBounds bounds;
+	//when it came from the cache, the file stays mapped and the vertices and indices are read straight out of it (the vectors stay empty)
+	std::unique_ptr<MeshCache> cache;
+
+	// Wherever the arrays are
+	const Vertex* GetVertices() { return cache ? cache->GetVertices() : vertices.data(); }
+	unsigned int GetVertexCount() { return cache ? cache->GetVertexCount() : (unsigned int)vertices.size(); }
+	const unsigned int* GetIndices() { return cache ? cache->GetIndices() : indices.data(); }
+	unsigned int GetIndexCount() { return cache ? cache->GetIndexCount() : (unsigned int)indices.size(); }
+};
 
 class Mesh
 {
 public:
 	//our neccessary member variables
-	Microsoft::WRL::ComPtr<ID3D11Buffer> vertexBuffer;
-	Microsoft::WRL::ComPtr<ID3D11Buffer> indexBuffer;
+	GeometryArena* arena;	// holds the vertices and indices, null until they're uploaded
+	GeometryRange geometry;	// where they are in it
 	Microsoft::WRL::ComPtr<ID3D11DeviceContext>	context;
 	int numOfIndices;
+	bool compactVertices;	// is the vertex buffer VertexCompact rather than Vertex?
+	VertexQuantization quantization;	// how to unpack compact positions
+	MeshletData meshlets;	// empty unless built
+	std::vector<MeshLod> lods;	// lods[0] is the full mesh, the rest follow it in the index buffer
+	MeshBounds bounds;	// local space box and sphere around every vertex
 	//createBudder(&verts[0],vertCounter,&indices[0],vertCounter, device);
 	
 
 	//our neccessary methods
-	Mesh(Vertex vertexArray[], int numberOfVerticesInArray, unsigned int indicesArray[], int numberOfIndicesInArray, Microsoft::WRL::ComPtr<ID3D11Device> deviceObject, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
-	Mesh(const char* filename,Microsoft::WRL::ComPtr<ID3D11Device> deviceObject, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject);
-	~Mesh();
-	void CreateBuffer(Vertex vertices[], int numOfVerts, unsigned int indices[], int numberOfIndices, Microsoft::WRL::ComPtr<ID3D11Device> deviceObject);
-	void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetVertexBuffer();//return the pointer to the vertex buffer object
-	Microsoft::WRL::ComPtr<ID3D11Buffer> GetIndexBuffer();
+	Mesh(Vertex vertexArray[], int numberOfVerticesInArray, unsigned int indicesArray[], int numberOfIndicesInArray, GeometryArena& arena, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, MeshOptions options = MeshOptions());
+	Mesh(const char* filename, GeometryArena& arena, Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject, MeshOptions options = MeshOptions());
+	Mesh(Microsoft::WRL::ComPtr<ID3D11DeviceContext> contextObject, MeshOptions options = MeshOptions());//empty until Upload
+	~Mesh();//copies share the same range, so it's given back by Release rather than here
+	void CreateBuffer(const Vertex vertices[], int numOfVerts, const unsigned int indices[], int numberOfIndices, GeometryArena& arena);
+	//the cpu side of loading, safe to call from any thread - from the cache if it's up to date, otherwise BuildData
+	static bool LoadData(const char* filename, const MeshOptions& options, MeshData& out);
+	//parses and processes an obj, then saves the result to the cache
+	static bool BuildData(const char* filename, const MeshOptions& options, MeshData& out);
+	static void ProcessMesh(MeshData& data, const MeshOptions& options);
+	//every processing step that changes the final data, so the cache knows what it was built with
+	static unsigned long long GetProcessingFlags(const MeshOptions& options);
+	static void CalculateTangents(Vertex* verts, int numVerts, unsigned int* indices, int numIndices);
+	//puts finished data in the arena (device thread only), data's arrays are left behind
+	void Upload(MeshData& data, GeometryArena& arena);
+	//gives the mesh's range back to the arena, it's empty again afterwards
+	void Release();
+	bool IsReady();//false until it's in the arena, drawing before then does nothing
+	const GeometryRange& GetGeometry();
 	int GetIndexCount();//returns the number of indices this mesh contains.
+	unsigned int GetLodCount();
+	const MeshLod& GetLod(unsigned int lod);
+	//coarsest lod whose error stays under maxError once multiplied by errorScale (e.g. projection scale / distance)
+	unsigned int SelectLod(float errorScale, float maxError);
+	const MeshBounds& GetBounds();
+	bool IsCompact();
+	VertexQuantization GetQuantization();
+	const MeshletData& GetMeshlets();
+	bool HasMeshlets();
 	void Draw();
+	void DrawLod(unsigned int lod);
+	void DrawMeshlets(const std::vector<unsigned int>& visibleMeshlets);//draws only these meshlets, in increasing order
 };
 
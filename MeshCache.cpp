@@ -0,0 +1,353 @@
+#include "MeshCache.h"
+#include <Windows.h>
+#include <cstdio>
+#include <cstddef>
+
+using namespace DirectX;
+
+//bump this whenever the header, the vertex layout or the way meshes are processed changes
+static const unsigned int MeshCacheVersion = 7;
+
+//size, write time and content hash of a source file
+struct SourceInfo
+{
+	unsigned long long size;
+	unsigned long long writeTime;
+};
+
+static bool GetSourceInfo(const char* filename, SourceInfo& info)
+{
+	WIN32_FILE_ATTRIBUTE_DATA data = {};
+	if (!GetFileAttributesExA(filename, GetFileExInfoStandard, &data))
+		return false;
+
+	info.size = ((unsigned long long)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+	info.writeTime = ((unsigned long long)data.ftLastWriteTime.dwHighDateTime << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return true;
+}
+
+//FNV-1a over the whole source file, only needed when the write time alone can't vouch for the cache
+static bool HashSource(const char* filename, unsigned long long& hash)
+{
+	hash = 14695981039346656037ull;
+
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(file, &size))
+	{
+		CloseHandle(file);
+		return false;
+	}
+	if (size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return true;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	const unsigned char* bytes = mapping ? (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : 0;
+	if (bytes)
+	{
+		for (long long i = 0; i < size.QuadPart; i++)
+		{
+			hash ^= bytes[i];
+			hash *= 1099511628211ull;
+		}
+		UnmapViewOfFile(bytes);
+	}
+	if (mapping) CloseHandle(mapping);
+	CloseHandle(file);
+	return bytes != 0;
+}
+
+//puts the source's new write time in an existing cache file, so the next open doesn't have to hash the source again
+static void RestampCache(const std::string& cachePath, unsigned long long sourceWriteTime)
+{
+	HANDLE cacheFile = CreateFileA(cachePath.c_str(), GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+	if (cacheFile == INVALID_HANDLE_VALUE)
+		return;
+
+	//it doesn't matter if this fails, it just means hashing again next time
+	LARGE_INTEGER offset = {};
+	offset.QuadPart = offsetof(MeshCacheHeader, sourceWriteTime);
+	DWORD written = 0;
+	if (SetFilePointerEx(cacheFile, offset, 0, FILE_BEGIN))
+		WriteFile(cacheFile, &sourceWriteTime, sizeof(sourceWriteTime), &written, 0);
+	CloseHandle(cacheFile);
+}
+
+MeshCache::MeshCache()
+{
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	view = 0;
+	header = 0;
+}
+
+MeshCache::~MeshCache()
+{
+	Close();
+}
+
+void MeshCache::Close()
+{
+	if (view) UnmapViewOfFile(view);
+	if (mapping) CloseHandle((HANDLE)mapping);
+	if (file != INVALID_HANDLE_VALUE) CloseHandle((HANDLE)file);
+
+	file = INVALID_HANDLE_VALUE;
+	mapping = 0;
+	view = 0;
+	header = 0;
+}
+
+std::string MeshCache::GetCachePath(const char* sourceFilename, unsigned long long processingFlags)
+{
+	char flags[32];
+	snprintf(flags, sizeof(flags), ".%016llx.meshbin", processingFlags);
+	return std::string(sourceFilename) + flags;
+}
+
+bool MeshCache::Open(const char* sourceFilename, unsigned long long processingFlags)
+{
+	Close();
+
+	SourceInfo source = {};
+	if (!GetSourceInfo(sourceFilename, source))
+		return false;
+
+	std::string cachePath = GetCachePath(sourceFilename, processingFlags);
+	//write sharing too, so an out of date stamp can be fixed while it's mapped
+	file = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, 0, OPEN_EXISTING, 0, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx((HANDLE)file, &size) || size.QuadPart < (long long)sizeof(MeshCacheHeader))
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMappingA((HANDLE)file, 0, PAGE_READONLY, 0, 0, 0);
+	if (mapping)
+		view = (const char*)MapViewOfFile((HANDLE)mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!view)
+	{
+		Close();
+		return false;
+	}
+	header = (const MeshCacheHeader*)view;
+
+	// Make sure this file is something we wrote, with this exact layout
+	unsigned long long expectedSize =
+		sizeof(MeshCacheHeader) +
+		(unsigned long long)header->vertexCount * sizeof(Vertex) +
+		(unsigned long long)header->indexCount * sizeof(unsigned int) +
+		(unsigned long long)header->lodCount * sizeof(MeshLod) +
+		(unsigned long long)header->meshletCount * sizeof(Meshlet) +
+		(unsigned long long)header->meshletVertexCount * sizeof(unsigned int) +
+		header->meshletTriangleBytes;
+
+	if (memcmp(header->magic, "MBIN", 4) != 0 ||
+		header->version != MeshCacheVersion ||
+		header->vertexStride != sizeof(Vertex) ||
+		header->processingFlags != processingFlags ||
+		header->vertexCount == 0 ||
+		header->indexCount == 0 ||
+		header->lodCount == 0 ||
+		(unsigned long long)size.QuadPart != expectedSize)
+	{
+		Close();
+		return false;
+	}
+
+	// The counts add up, now make sure nothing inside points past
+	// the end of what it indexes - a bad file falls back to the source
+	if (!ValidateRanges())
+	{
+		Close();
+		return false;
+	}
+
+	// Is it still up to date with the source?
+	// - Same size and write time is the quick answer
+	// - If only the write time moved (copied or checked out again)
+	//   the contents might still match, so fall back to the hash
+	if (header->sourceSize != source.size)
+	{
+		Close();
+		return false;
+	}
+	if (header->sourceWriteTime != source.writeTime)
+	{
+		unsigned long long hash = 0;
+		if (!HashSource(sourceFilename, hash) || hash != header->sourceHash)
+		{
+			Close();
+			return false;
+		}
+		RestampCache(cachePath, source.writeTime);
+	}
+
+	return true;
+}
+
+bool MeshCache::ValidateRanges()
+{
+	const unsigned int* indices = GetIndices();
+	for (unsigned int i = 0; i < header->indexCount; i++)
+	{
+		if (indices[i] >= header->vertexCount)
+			return false;
+	}
+
+	//widened so offset + count can't wrap around
+	const MeshLod* lods = GetLods();
+	for (unsigned int i = 0; i < header->lodCount; i++)
+	{
+		if (lods[i].indexCount == 0 || lods[i].indexCount % 3 != 0 ||
+			(unsigned long long)lods[i].indexOffset + lods[i].indexCount > header->indexCount)
+			return false;
+	}
+
+	if (header->meshletCount == 0)
+		return true;
+
+	const Meshlet* meshlets = (const Meshlet*)(lods + header->lodCount);
+	const unsigned int* meshletVertices = (const unsigned int*)(meshlets + header->meshletCount);
+	const unsigned char* meshletTriangles = (const unsigned char*)(meshletVertices + header->meshletVertexCount);
+	for (unsigned int i = 0; i < header->meshletVertexCount; i++)
+	{
+		if (meshletVertices[i] >= header->vertexCount)
+			return false;
+	}
+	for (unsigned int i = 0; i < header->meshletCount; i++)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		unsigned long long triangleBytes = (unsigned long long)meshlet.triangleCount * 3;
+		if ((unsigned long long)meshlet.vertexOffset + meshlet.vertexCount > header->meshletVertexCount ||
+			meshlet.triangleOffset + triangleBytes > header->meshletTriangleBytes ||
+			meshlet.indexOffset + triangleBytes > header->indexCount)
+			return false;
+		for (unsigned long long t = 0; t < triangleBytes; t++)
+		{
+			if (meshletTriangles[meshlet.triangleOffset + t] >= meshlet.vertexCount)
+				return false;
+		}
+	}
+	return true;
+}
+
+bool MeshCache::Write(const char* sourceFilename, unsigned long long processingFlags, const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const MeshLod* lods, unsigned int lodCount, const MeshBounds& bounds, const MeshletData* meshlets)
+{
+	if (vertexCount == 0 || indexCount == 0 || lodCount == 0)
+		return false;
+
+	SourceInfo source = {};
+	unsigned long long hash = 0;
+	if (!GetSourceInfo(sourceFilename, source) || !HashSource(sourceFilename, hash))
+		return false;
+
+	MeshCacheHeader out = {};
+	memcpy(out.magic, "MBIN", 4);
+	out.version = MeshCacheVersion;
+	out.vertexStride = sizeof(Vertex);
+	out.vertexCount = vertexCount;
+	out.indexCount = indexCount;
+	out.lodCount = lodCount;
+	out.processingFlags = processingFlags;
+	if (meshlets && !meshlets->meshlets.empty())
+	{
+		out.meshletCount = (unsigned int)meshlets->meshlets.size();
+		out.meshletVertexCount = (unsigned int)meshlets->vertices.size();
+		out.meshletTriangleBytes = (unsigned int)meshlets->triangles.size();
+	}
+	out.sourceSize = source.size;
+	out.sourceWriteTime = source.writeTime;
+	out.sourceHash = hash;
+	out.bounds = bounds;
+
+	// Write to a temporary file first and swap it in at the end,
+	// so a crash mid-write never leaves a half written cache behind
+	std::string cachePath = GetCachePath(sourceFilename, processingFlags);
+	std::string tempPath = cachePath + ".tmp";
+	HANDLE cacheFile = CreateFileA(tempPath.c_str(), GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (cacheFile == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	bool success =
+		WriteFile(cacheFile, &out, sizeof(MeshCacheHeader), &written, 0) &&
+		WriteFile(cacheFile, vertices, sizeof(Vertex) * vertexCount, &written, 0) &&
+		WriteFile(cacheFile, indices, sizeof(unsigned int) * indexCount, &written, 0) &&
+		WriteFile(cacheFile, lods, sizeof(MeshLod) * lodCount, &written, 0);
+	if (success && out.meshletCount > 0)
+	{
+		success =
+			WriteFile(cacheFile, &meshlets->meshlets[0], sizeof(Meshlet) * out.meshletCount, &written, 0) &&
+			WriteFile(cacheFile, &meshlets->vertices[0], sizeof(unsigned int) * out.meshletVertexCount, &written, 0) &&
+			WriteFile(cacheFile, &meshlets->triangles[0], out.meshletTriangleBytes, &written, 0);
+	}
+	CloseHandle(cacheFile);
+
+	if (!success || !MoveFileExA(tempPath.c_str(), cachePath.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileA(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
+
+const Vertex* MeshCache::GetVertices()
+{
+	return header ? (const Vertex*)(view + sizeof(MeshCacheHeader)) : 0;
+}
+
+const unsigned int* MeshCache::GetIndices()
+{
+	return header ? (const unsigned int*)(view + sizeof(MeshCacheHeader) + sizeof(Vertex) * header->vertexCount) : 0;
+}
+
+unsigned int MeshCache::GetVertexCount()
+{
+	return header ? header->vertexCount : 0;
+}
+
+unsigned int MeshCache::GetIndexCount()
+{
+	return header ? header->indexCount : 0;
+}
+
+const MeshLod* MeshCache::GetLods()
+{
+	return header ? (const MeshLod*)(GetIndices() + header->indexCount) : 0;
+}
+
+unsigned int MeshCache::GetLodCount()
+{
+	return header ? header->lodCount : 0;
+}
+
+bool MeshCache::GetMeshlets(MeshletData& out)
+{
+	if (!header || header->meshletCount == 0)
+		return false;
+
+	const Meshlet* meshlets = (const Meshlet*)(GetLods() + header->lodCount);
+	const unsigned int* meshletVertices = (const unsigned int*)(meshlets + header->meshletCount);
+	const unsigned char* meshletTriangles = (const unsigned char*)(meshletVertices + header->meshletVertexCount);
+
+	out.meshlets.assign(meshlets, meshlets + header->meshletCount);
+	out.vertices.assign(meshletVertices, meshletVertices + header->meshletVertexCount);
+	out.triangles.assign(meshletTriangles, meshletTriangles + header->meshletTriangleBytes);
+	return true;
+}
+
+MeshBounds MeshCache::GetBounds()
+{
+	return header ? header->bounds : MeshBounds();
+}
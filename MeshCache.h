@@ -0,0 +1,79 @@
+#pragma once
+#include <DirectXMath.h>
+#include <string>
+#include "Vertex.h"
+#include "Meshlet.h"
+#include "MeshSimplifier.h"
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// Binary mesh cache (.meshbin)
+//
+// Holds the final, ready to upload vertex and index arrays
+// (tangents included) for a source model, so later runs skip
+// parsing entirely.  The file is memory mapped and the arrays
+// are handed to the GPU straight from the mapped pages.
+//
+// Layout: MeshCacheHeader, vertices, indices (every lod),
+// lods, then the optional meshlets, meshlet vertices and
+// meshlet triangles
+// --------------------------------------------------------
+struct MeshCacheHeader
+{
+	char magic[4];				// "MBIN"
+	unsigned int version;		// bumped whenever the layout or the processing changes
+	unsigned int vertexStride;	// sizeof(Vertex) when written
+	unsigned int vertexCount;
+	unsigned int indexCount;
+	unsigned int meshletCount;			// 0 unless meshlets were built
+	unsigned int meshletVertexCount;
+	unsigned int meshletTriangleBytes;
+	unsigned int lodCount;				// always at least 1, the full mesh
+	unsigned long long processingFlags;	// which optional processing steps were applied (see MeshOptions)
+	unsigned long long sourceSize;		// size of the source file in bytes
+	unsigned long long sourceWriteTime;	// last write time of the source file
+	unsigned long long sourceHash;		// FNV-1a hash of the source file's contents
+	MeshBounds bounds;					// local space box and sphere around the vertices
+};
+
+class MeshCache
+{
+public:
+	MeshCache();
+	~MeshCache();
+	//it owns the file handles, so only one of it
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	//maps the cache file for this source, returns false if it is missing, out of date, processed differently or damaged
+	bool Open(const char* sourceFilename, unsigned long long processingFlags);
+	void Close();
+
+	//writes (or replaces) the cache file for this source
+	// - meshlets can be null
+	static bool Write(const char* sourceFilename, unsigned long long processingFlags, const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const MeshLod* lods, unsigned int lodCount, const MeshBounds& bounds, const MeshletData* meshlets);
+
+	//where the cache for a given source lives - right next to it, one file per way of processing it
+	//(so the same model loaded two ways, or by two threads at once, never fights over one file)
+	static std::string GetCachePath(const char* sourceFilename, unsigned long long processingFlags);
+
+	//pointers into the mapped file, only valid while the cache is open
+	const Vertex* GetVertices();
+	const unsigned int* GetIndices();
+	unsigned int GetVertexCount();
+	unsigned int GetIndexCount();
+	const MeshLod* GetLods();
+	unsigned int GetLodCount();
+	//copies the meshlets out (they're small next to the vertices), false if there are none
+	bool GetMeshlets(MeshletData& out);
+	MeshBounds GetBounds();
+
+private:
+	void* file;		// HANDLE
+	void* mapping;	// HANDLE
+	const char* view;
+	const MeshCacheHeader* header;
+
+	//false if any index, lod or meshlet points outside the arrays it indexes
+	bool ValidateRanges();
+};
@@ -0,0 +1,549 @@
+#include "MeshOptimizer.h"
+#include <vector>
+#include <cmath>
+#include <climits>
+#include <cfloat>
+#include <algorithm>
+
+using namespace DirectX;
+
+// Tuning values from Tom Forsyth's "Linear-Speed Vertex Cache Optimisation"
+static const int ForsythCacheSize = 32;
+static const float ForsythCacheDecayPower = 1.5f;
+static const float ForsythLastTriScore = 0.75f;
+static const float ForsythValenceBoostScale = 2.0f;
+static const float ForsythValenceBoostPower = 0.5f;
+static const unsigned int ForsythValenceTableSize = 64;
+
+//precomputed pieces of the vertex score so the inner loop never calls pow
+struct ForsythScoreTables
+{
+	float cache[ForsythCacheSize];
+	float valence[ForsythValenceTableSize];
+
+	ForsythScoreTables()
+	{
+		for (int i = 0; i < ForsythCacheSize; i++)
+		{
+			if (i < 3)
+			{
+				//the three verts of the triangle we just emitted - deliberately not the best
+				//score, otherwise we'd keep walking a strip and starve the rest of the cache
+				cache[i] = ForsythLastTriScore;
+			}
+			else
+			{
+				float scaler = 1.0f - (i - 3) * (1.0f / (ForsythCacheSize - 3));
+				cache[i] = powf(scaler, ForsythCacheDecayPower);
+			}
+		}
+
+		valence[0] = 0;
+		for (unsigned int i = 1; i < ForsythValenceTableSize; i++)
+			valence[i] = ForsythValenceBoostScale * powf((float)i, -ForsythValenceBoostPower);
+	}
+
+	float Score(int cachePosition, unsigned int remainingValence) const
+	{
+		//nothing left to draw with this vertex, it doesn't matter anymore
+		if (remainingValence == 0)
+			return -1.0f;
+
+		float score = cachePosition >= 0 ? cache[cachePosition] : 0.0f;
+
+		//boost verts with only a few triangles left so we finish them off and don't leave lone triangles behind
+		if (remainingValence < ForsythValenceTableSize)
+			score += valence[remainingValence];
+		else
+			score += ForsythValenceBoostScale * powf((float)remainingValence, -ForsythValenceBoostPower);
+
+		return score;
+	}
+};
+
+void MeshOptimizer::OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	static const ForsythScoreTables tables;
+
+	unsigned int triCount = indexCount / 3;
+	if (triCount < 2 || vertexCount == 0)
+		return;
+
+	// Build the vertex -> triangle adjacency in one flat array
+	// - Each vertex owns [offsets[v], offsets[v] + remaining[v]) which
+	//   shrinks as its triangles get emitted
+	std::vector<unsigned int> remaining(vertexCount, 0);
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		remaining[indices[i]]++;
+
+	std::vector<unsigned int> offsets(vertexCount, 0);
+	unsigned int runningOffset = 0;
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		offsets[v] = runningOffset;
+		runningOffset += remaining[v];
+	}
+
+	std::vector<unsigned int> adjacency(triCount * 3);
+	std::vector<unsigned int> fill(offsets);
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		adjacency[fill[indices[t * 3 + 0]]++] = t;
+		adjacency[fill[indices[t * 3 + 1]]++] = t;
+		adjacency[fill[indices[t * 3 + 2]]++] = t;
+	}
+
+	// Initial scores, nothing is in the cache yet
+	std::vector<float> vertexScores(vertexCount);
+	std::vector<int> cachePositions(vertexCount, -1);
+	for (unsigned int v = 0; v < vertexCount; v++)
+		vertexScores[v] = tables.Score(-1, remaining[v]);
+
+	std::vector<float> triScores(triCount);
+	std::vector<bool> emitted(triCount, false);
+	unsigned int bestTri = 0;
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		triScores[t] =
+			vertexScores[indices[t * 3 + 0]] +
+			vertexScores[indices[t * 3 + 1]] +
+			vertexScores[indices[t * 3 + 2]];
+
+		if (triScores[t] > triScores[bestTri])
+			bestTri = t;
+	}
+
+	// The simulated LRU cache, plus room for the 3 verts pushed in each step
+	unsigned int cache[ForsythCacheSize + 3];
+	unsigned int newCache[ForsythCacheSize + 3];
+	unsigned int cacheCount = 0;
+
+	std::vector<unsigned int> output;
+	output.reserve(triCount * 3);
+
+	//when the cache runs dry (disconnected pieces) we walk forward from here to find any triangle left
+	unsigned int nextUnemitted = 0;
+
+	while (output.size() < triCount * 3)
+	{
+		if (bestTri == UINT_MAX)
+		{
+			while (emitted[nextUnemitted])
+				nextUnemitted++;
+			bestTri = nextUnemitted;
+		}
+
+		// Emit the chosen triangle
+		unsigned int* tri = &indices[bestTri * 3];
+		output.push_back(tri[0]);
+		output.push_back(tri[1]);
+		output.push_back(tri[2]);
+		emitted[bestTri] = true;
+
+		// Remove it from its vertices' live adjacency
+		for (int k = 0; k < 3; k++)
+		{
+			unsigned int v = tri[k];
+			unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int i = 0; i < remaining[v]; i++)
+			{
+				if (list[i] == bestTri)
+				{
+					list[i] = list[remaining[v] - 1];
+					remaining[v]--;
+					break;
+				}
+			}
+		}
+
+		// Push the triangle's verts to the front of the cache
+		unsigned int newCount = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			bool duplicate = false;
+			for (unsigned int i = 0; i < newCount; i++)
+				duplicate = duplicate || newCache[i] == tri[k];
+			if (!duplicate)
+				newCache[newCount++] = tri[k];
+		}
+		unsigned int triVerts = newCount;
+		for (unsigned int i = 0; i < cacheCount; i++)
+		{
+			unsigned int v = cache[i];
+			bool duplicate = false;
+			for (unsigned int j = 0; j < triVerts; j++)
+				duplicate = duplicate || newCache[j] == v;
+			if (!duplicate)
+				newCache[newCount++] = v;
+		}
+
+		// Rescore everything that was touched - verts that fell out of
+		// the cache lose their cache bonus, everything else moved
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			cachePositions[v] = i < (unsigned int)ForsythCacheSize ? (int)i : -1;
+
+			float newScore = tables.Score(cachePositions[v], remaining[v]);
+			float difference = newScore - vertexScores[v];
+			vertexScores[v] = newScore;
+
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+				triScores[list[j]] += difference;
+		}
+
+		// The next triangle is the best one touching the cache
+		bestTri = UINT_MAX;
+		float bestScore = -1.0f;
+		for (unsigned int i = 0; i < newCount; i++)
+		{
+			unsigned int v = newCache[i];
+			const unsigned int* list = &adjacency[offsets[v]];
+			for (unsigned int j = 0; j < remaining[v]; j++)
+			{
+				if (triScores[list[j]] > bestScore)
+				{
+					bestScore = triScores[list[j]];
+					bestTri = list[j];
+				}
+			}
+		}
+
+		cacheCount = newCount < (unsigned int)ForsythCacheSize ? newCount : ForsythCacheSize;
+		for (unsigned int i = 0; i < cacheCount; i++)
+			cache[i] = newCache[i];
+	}
+
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		indices[i] = output[i];
+}
+
+//pushes one triangle through a simulated FIFO cache (see AnalyzeVertexCache), returns how many of its verts missed
+static unsigned int SimulateTriangle(const unsigned int* tri, unsigned int cacheSize, std::vector<unsigned int>& timestamps, unsigned int& time)
+{
+	unsigned int misses = 0;
+	for (int k = 0; k < 3; k++)
+	{
+		if (time - timestamps[tri[k]] > cacheSize)
+		{
+			timestamps[tri[k]] = time++;
+			misses++;
+		}
+	}
+	return misses;
+}
+
+//sort key for one cluster of triangles
+struct OverdrawCluster
+{
+	unsigned int start;	// first triangle
+	unsigned int end;	// one past the last triangle
+	unsigned int misses;	// vertex cache misses drawing it from a cold cache
+	float sortKey;
+};
+
+void MeshOptimizer::OptimizeOverdraw(unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount, float threshold)
+{
+	static const unsigned int cacheSize = 16;
+
+	unsigned int triCount = indexCount / 3;
+	if (triCount < 2 || vertexCount == 0)
+		return;
+
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	unsigned int time = cacheSize + 1;
+
+	// Hard boundaries - places where the vertex cache order already starts
+	// over (a triangle with no verts in the cache), so cutting there
+	// costs nothing in vertex shader invocations
+	std::vector<unsigned int> hardStarts;
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		unsigned int misses = SimulateTriangle(&indices[t * 3], cacheSize, timestamps, time);
+		if (t == 0 || misses == 3)
+			hardStarts.push_back(t);
+	}
+	hardStarts.push_back(triCount);
+
+	// Soft boundaries - split the hard clusters further whenever the cache
+	// efficiency so far is within threshold of the whole cluster's
+	std::vector<OverdrawCluster> clusters;
+	for (size_t h = 0; h + 1 < hardStarts.size(); h++)
+	{
+		unsigned int start = hardStarts[h];
+		unsigned int end = hardStarts[h + 1];
+
+		time += cacheSize + 1;
+		unsigned int clusterMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+			clusterMisses += SimulateTriangle(&indices[t * 3], cacheSize, timestamps, time);
+		float clusterThreshold = threshold * clusterMisses / (end - start);
+
+		time += cacheSize + 1;
+		unsigned int runningMisses = 0;
+		unsigned int runningTris = 0;
+		unsigned int clusterStart = start;
+		size_t firstCluster = clusters.size();
+		unsigned int totalMisses = 0;
+		for (unsigned int t = start; t < end; t++)
+		{
+			runningMisses += SimulateTriangle(&indices[t * 3], cacheSize, timestamps, time);
+			runningTris++;
+
+			if (t + 1 < end && runningMisses <= clusterThreshold * runningTris)
+			{
+				OverdrawCluster cluster = { clusterStart, t + 1, runningMisses, 0 };
+				clusters.push_back(cluster);
+				totalMisses += runningMisses;
+				clusterStart = t + 1;
+				runningMisses = 0;
+				runningTris = 0;
+				time += cacheSize + 1;
+			}
+		}
+		OverdrawCluster cluster = { clusterStart, end, runningMisses, 0 };
+		clusters.push_back(cluster);
+		totalMisses += runningMisses;
+
+		// Whatever was left at the end never got under the threshold on its
+		// own and can push the whole cluster over - fold the last pieces back
+		// together until it isn't. Each cluster can be drawn after anything,
+		// so its cold cache misses are the most it can cost, and this keeps
+		// the final ACMR within threshold of the vertex cache order
+		while (totalMisses > threshold * clusterMisses && clusters.size() > firstCluster + 1)
+		{
+			OverdrawCluster last = clusters.back();
+			clusters.pop_back();
+			OverdrawCluster& merged = clusters.back();
+			totalMisses -= merged.misses + last.misses;
+
+			merged.end = last.end;
+			merged.misses = 0;
+			time += cacheSize + 1;
+			for (unsigned int t = merged.start; t < merged.end; t++)
+				merged.misses += SimulateTriangle(&indices[t * 3], cacheSize, timestamps, time);
+			totalMisses += merged.misses;
+		}
+	}
+
+	// Area weighted centroid of the whole mesh
+	XMVECTOR meshCentroid = XMVectorZero();
+	float meshArea = 0;
+	for (unsigned int t = 0; t < triCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+		float area = XMVectorGetX(XMVector3Length(XMVector3Cross(p1 - p0, p2 - p0)));
+		meshCentroid += (p0 + p1 + p2) * (area / 3.0f);
+		meshArea += area;
+	}
+	if (meshArea > 0)
+		meshCentroid = meshCentroid / meshArea;
+
+	// A cluster that faces away from the middle of the mesh and sits far
+	// out from it is likely to cover the rest, so it should draw first
+	// - This doesn't depend on the view, which is what lets us bake it
+	for (auto& cluster : clusters)
+	{
+		XMVECTOR centroid = XMVectorZero();
+		XMVECTOR normal = XMVectorZero();
+		float area = 0;
+		for (unsigned int t = cluster.start; t < cluster.end; t++)
+		{
+			XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+			//the cross product's length is twice the area, so summing them area weights the normal for free
+			XMVECTOR faceNormal = XMVector3Cross(p1 - p0, p2 - p0);
+			float faceArea = XMVectorGetX(XMVector3Length(faceNormal));
+			centroid += (p0 + p1 + p2) * (faceArea / 3.0f);
+			normal += faceNormal;
+			area += faceArea;
+		}
+		if (area > 0)
+			centroid = centroid / area;
+
+		cluster.sortKey = XMVectorGetX(XMVector3Dot(centroid - meshCentroid, XMVector3Normalize(normal)));
+	}
+
+	std::stable_sort(clusters.begin(), clusters.end(),
+		[](const OverdrawCluster& a, const OverdrawCluster& b) { return a.sortKey > b.sortKey; });
+
+	std::vector<unsigned int> output;
+	output.reserve(triCount * 3);
+	for (auto& cluster : clusters)
+		output.insert(output.end(), indices + cluster.start * 3, indices + cluster.end * 3);
+
+	for (unsigned int i = 0; i < triCount * 3; i++)
+		indices[i] = output[i];
+}
+
+unsigned int MeshOptimizer::OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount)
+{
+	// Give every vertex a new slot the first time the index buffer touches it
+	std::vector<unsigned int> remap(vertexCount, UINT_MAX);
+	unsigned int nextVertex = 0;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int& slot = remap[indices[i]];
+		if (slot == UINT_MAX)
+			slot = nextVertex++;
+		indices[i] = slot;
+	}
+
+	// Shuffle the vertices into their new slots, unused ones are left behind
+	std::vector<Vertex> original(vertices, vertices + vertexCount);
+	for (unsigned int v = 0; v < vertexCount; v++)
+	{
+		if (remap[v] != UINT_MAX)
+			vertices[remap[v]] = original[v];
+	}
+
+	return nextVertex;
+}
+
+VertexCacheStats MeshOptimizer::AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize)
+{
+	VertexCacheStats stats = {};
+	if (indexCount < 3 || vertexCount == 0)
+		return stats;
+
+	// A FIFO cache tracked with timestamps - a vertex is still
+	// cached if fewer than cacheSize misses happened since it went in
+	std::vector<unsigned int> timestamps(vertexCount, 0);
+	std::vector<bool> used(vertexCount, false);
+	unsigned int time = cacheSize + 1;
+	unsigned int misses = 0;
+	unsigned int usedCount = 0;
+
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		unsigned int v = indices[i];
+		if (time - timestamps[v] > cacheSize)
+		{
+			timestamps[v] = time++;
+			misses++;
+		}
+		if (!used[v])
+		{
+			used[v] = true;
+			usedCount++;
+		}
+	}
+
+	stats.acmr = (float)misses / (indexCount / 3);
+	stats.atvr = (float)misses / usedCount;
+	return stats;
+}
+
+OverdrawStats MeshOptimizer::AnalyzeOverdraw(const unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount)
+{
+	static const int gridSize = 128;
+	static const int viewCount = 16;
+
+	OverdrawStats stats = {};
+	unsigned int triCount = indexCount / 3;
+	if (triCount == 0 || vertexCount == 0)
+		return stats;
+
+	// Fit the views around the mesh's bounds
+	XMVECTOR boundsMin = XMLoadFloat3(&vertices[indices[0]].Position);
+	XMVECTOR boundsMax = boundsMin;
+	for (unsigned int i = 1; i < triCount * 3; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[indices[i]].Position);
+		boundsMin = XMVectorMin(boundsMin, p);
+		boundsMax = XMVectorMax(boundsMax, p);
+	}
+	XMVECTOR center = (boundsMin + boundsMax) * 0.5f;
+	float radius = XMVectorGetX(XMVector3Length(boundsMax - center));
+	if (radius <= 0)
+		return stats;
+
+	std::vector<float> depth(gridSize * gridSize);
+	std::vector<XMFLOAT3> projected(vertexCount);
+
+	for (int view = 0; view < viewCount; view++)
+	{
+		// Spread the view directions evenly over a sphere (fibonacci spiral)
+		float y = 1.0f - (view + 0.5f) * (2.0f / viewCount);
+		float ring = sqrtf(1.0f - y * y);
+		float angle = view * 2.39996323f;
+		XMVECTOR dir = XMVectorSet(cosf(angle) * ring, y, sinf(angle) * ring, 0);
+
+		XMVECTOR up = fabsf(y) < 0.99f ? XMVectorSet(0, 1, 0, 0) : XMVectorSet(1, 0, 0, 0);
+		XMVECTOR right = XMVector3Normalize(XMVector3Cross(up, dir));
+		up = XMVector3Cross(dir, right);
+
+		// Orthographic projection onto the grid, z is distance along the view
+		for (unsigned int v = 0; v < vertexCount; v++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[v].Position) - center;
+			projected[v].x = (XMVectorGetX(XMVector3Dot(p, right)) / radius * 0.5f + 0.5f) * gridSize;
+			projected[v].y = (XMVectorGetX(XMVector3Dot(p, up)) / radius * 0.5f + 0.5f) * gridSize;
+			projected[v].z = XMVectorGetX(XMVector3Dot(p, dir));
+		}
+
+		std::fill(depth.begin(), depth.end(), FLT_MAX);
+
+		for (unsigned int t = 0; t < triCount; t++)
+		{
+			const unsigned int* tri = &indices[t * 3];
+
+			// Cull back faces just like the GPU would (clockwise is front facing)
+			XMVECTOR p0 = XMLoadFloat3(&vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[tri[2]].Position);
+			if (XMVectorGetX(XMVector3Dot(XMVector3Cross(p1 - p0, p2 - p0), dir)) >= 0)
+				continue;
+
+			const XMFLOAT3& a = projected[tri[0]];
+			const XMFLOAT3& b = projected[tri[1]];
+			const XMFLOAT3& c = projected[tri[2]];
+			float area = (b.x - a.x) * (c.y - a.y) - (c.x - a.x) * (b.y - a.y);
+			if (area == 0)
+				continue;
+			float invArea = 1.0f / area;
+
+			int minX = (std::max)(0, (int)floorf((std::min)(a.x, (std::min)(b.x, c.x))));
+			int maxX = (std::min)(gridSize - 1, (int)ceilf((std::max)(a.x, (std::max)(b.x, c.x))));
+			int minY = (std::max)(0, (int)floorf((std::min)(a.y, (std::min)(b.y, c.y))));
+			int maxY = (std::min)(gridSize - 1, (int)ceilf((std::max)(a.y, (std::max)(b.y, c.y))));
+
+			for (int py = minY; py <= maxY; py++)
+			{
+				for (int px = minX; px <= maxX; px++)
+				{
+					// Barycentrics at the pixel center
+					float x = px + 0.5f;
+					float y = py + 0.5f;
+					float w0 = ((b.x - x) * (c.y - y) - (c.x - x) * (b.y - y)) * invArea;
+					float w1 = ((c.x - x) * (a.y - y) - (a.x - x) * (c.y - y)) * invArea;
+					float w2 = 1.0f - w0 - w1;
+					if (w0 < 0 || w1 < 0 || w2 < 0)
+						continue;
+
+					float z = w0 * a.z + w1 * b.z + w2 * c.z;
+					float& stored = depth[py * gridSize + px];
+					if (z < stored)
+					{
+						stored = z;
+						stats.pixelsShaded++;
+					}
+				}
+			}
+		}
+
+		for (float d : depth)
+		{
+			if (d != FLT_MAX)
+				stats.pixelsCovered++;
+		}
+	}
+
+	stats.overdraw = stats.pixelsCovered ? (float)stats.pixelsShaded / stats.pixelsCovered : 0;
+	return stats;
+}
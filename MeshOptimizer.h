@@ -0,0 +1,47 @@
+#pragma once
+#include "Vertex.h"
+
+// Results of simulating a post-transform vertex cache over an index buffer
+struct VertexCacheStats
+{
+	float acmr;	// average cache miss ratio - vertex shader runs per triangle (0.5 - 3.0)
+	float atvr;	// average transformed vertex ratio - vertex shader runs per vertex (1.0 is perfect)
+};
+
+// Results of rasterizing a mesh on the CPU from a ring of viewpoints around it
+struct OverdrawStats
+{
+	float overdraw;	// pixels shaded / pixels covered, averaged over all viewpoints (1.0 is perfect)
+	unsigned int pixelsCovered;
+	unsigned int pixelsShaded;
+};
+
+// --------------------------------------------------------
+// Offline index/vertex buffer optimizations
+//
+// These run once when a model is imported (the results are
+// saved in the mesh cache), so they trade import time for
+// fewer vertex shader invocations every frame.
+// --------------------------------------------------------
+class MeshOptimizer
+{
+public:
+	//reorders triangles for post-transform vertex cache locality (Forsyth's algorithm)
+	static void OptimizeVertexCache(unsigned int* indices, unsigned int indexCount, unsigned int vertexCount);
+
+	//reorders clusters of triangles so the ones most likely to occlude the rest of the mesh draw first
+	// - Clusters come from the vertex cache order, the threshold is how much worse than
+	//   that order (in ACMR) we're willing to get, 1.05 allows 5%
+	// - Must run after OptimizeVertexCache and before OptimizeVertexFetch
+	static void OptimizeOverdraw(unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount, float threshold);
+
+	//reorders vertices into the order they are first used by the index buffer, for fetch locality
+	//returns the new vertex count, since vertices no triangle uses are dropped
+	static unsigned int OptimizeVertexFetch(Vertex* vertices, unsigned int vertexCount, unsigned int* indices, unsigned int indexCount);
+
+	//simulates a FIFO cache of the given size (16 is typical for desktop GPUs)
+	static VertexCacheStats AnalyzeVertexCache(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount, unsigned int cacheSize = 16);
+
+	//software rasterizes the mesh (back faces culled, depth tested, in index order) from several viewpoints
+	static OverdrawStats AnalyzeOverdraw(const unsigned int* indices, unsigned int indexCount, const Vertex* vertices, unsigned int vertexCount);
+};
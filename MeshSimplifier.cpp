@@ -0,0 +1,425 @@
+#include "MeshSimplifier.h"
+#include <vector>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cstring>
+#include <climits>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// Sum of squared distances to a set of planes, as a
+// symmetric 4x4 matrix (only the 10 unique terms are kept)
+// weighted by the area of the triangle each plane came from
+// --------------------------------------------------------
+struct Quadric
+{
+	double a2, b2, c2, d2;
+	double ab, ac, ad;
+	double bc, bd;
+	double cd;
+	double weight;
+};
+
+static void AddPlane(Quadric& q, double a, double b, double c, double d, double weight)
+{
+	q.a2 += a * a * weight;
+	q.b2 += b * b * weight;
+	q.c2 += c * c * weight;
+	q.d2 += d * d * weight;
+	q.ab += a * b * weight;
+	q.ac += a * c * weight;
+	q.ad += a * d * weight;
+	q.bc += b * c * weight;
+	q.bd += b * d * weight;
+	q.cd += c * d * weight;
+	q.weight += weight;
+}
+
+static void AddQuadric(Quadric& q, const Quadric& other)
+{
+	q.a2 += other.a2; q.b2 += other.b2; q.c2 += other.c2; q.d2 += other.d2;
+	q.ab += other.ab; q.ac += other.ac; q.ad += other.ad;
+	q.bc += other.bc; q.bd += other.bd;
+	q.cd += other.cd;
+	q.weight += other.weight;
+}
+
+//average squared distance from the point to the quadric's planes
+static double QuadricError(const Quadric& q, const XMFLOAT3& p)
+{
+	double x = p.x, y = p.y, z = p.z;
+	double error =
+		q.a2 * x * x + q.b2 * y * y + q.c2 * z * z + q.d2 +
+		2 * (q.ab * x * y + q.ac * x * z + q.bc * y * z) +
+		2 * (q.ad * x + q.bd * y + q.cd * z);
+	error = error < 0 ? 0 : error;
+	return q.weight > 0 ? error / q.weight : 0;
+}
+
+//position bits, so only exactly matching positions get welded together
+struct PositionHash
+{
+	size_t operator()(const XMFLOAT3& p) const
+	{
+		unsigned int bits[3];
+		memcpy(bits, &p, sizeof(bits));
+		return (bits[0] * 73856093u) ^ (bits[1] * 19349663u) ^ (bits[2] * 83492791u);
+	}
+};
+
+struct PositionEqual
+{
+	bool operator()(const XMFLOAT3& a, const XMFLOAT3& b) const
+	{
+		return memcmp(&a, &b, sizeof(XMFLOAT3)) == 0;
+	}
+};
+
+//same for position, uv and normal together (tangents are derived, so they don't count)
+struct VertexValueHash
+{
+	size_t operator()(const Vertex& v) const
+	{
+		unsigned int bits[8];
+		memcpy(bits, &v.Position, sizeof(float) * 8);
+		size_t hash = 0;
+		for (int i = 0; i < 8; i++)
+			hash = hash * 0x9E3779B1u ^ bits[i];
+		return hash;
+	}
+};
+
+struct VertexValueEqual
+{
+	bool operator()(const Vertex& a, const Vertex& b) const
+	{
+		return memcmp(&a.Position, &b.Position, sizeof(float) * 8) == 0;
+	}
+};
+
+//collapse "from" onto "to", with what it costs
+struct Collapse
+{
+	unsigned int from;
+	unsigned int to;
+	float error;
+};
+
+//would moving "from" onto "to" flip or badly stretch any triangle that survives it?
+static bool CollapseFlipsTriangles(const Vertex* vertices, const unsigned int* indices, const std::vector<unsigned int>& adjacencyOffsets, const std::vector<unsigned int>& adjacency, unsigned int from, unsigned int to)
+{
+	XMVECTOR target = XMLoadFloat3(&vertices[to].Position);
+	for (unsigned int i = adjacencyOffsets[from]; i < adjacencyOffsets[from + 1]; i++)
+	{
+		const unsigned int* tri = &indices[adjacency[i] * 3];
+
+		//triangles on the collapsing edge disappear, nothing to check
+		if (tri[0] == to || tri[1] == to || tri[2] == to)
+			continue;
+
+		XMVECTOR p[3];
+		XMVECTOR moved[3];
+		for (int k = 0; k < 3; k++)
+		{
+			p[k] = XMLoadFloat3(&vertices[tri[k]].Position);
+			moved[k] = tri[k] == from ? target : p[k];
+		}
+
+		XMVECTOR before = XMVector3Cross(p[1] - p[0], p[2] - p[0]);
+		XMVECTOR after = XMVector3Cross(moved[1] - moved[0], moved[2] - moved[0]);
+
+		// Reject anything that turns more than ~75 degrees
+		float dot = XMVectorGetX(XMVector3Dot(before, after));
+		float lengths = XMVectorGetX(XMVector3Length(before)) * XMVectorGetX(XMVector3Length(after));
+		if (dot <= 0.25f * lengths)
+			return true;
+	}
+	return false;
+}
+
+unsigned int MeshSimplifier::Simplify(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, unsigned int targetIndexCount, float maxError, unsigned int* outIndices, float* resultError)
+{
+	if (resultError)
+		*resultError = 0;
+	if (vertexCount == 0 || indexCount < 3)
+		return 0;
+
+	std::vector<unsigned int> result(indices, indices + indexCount);
+	double maxErrorSq = (double)maxError * maxError;
+	double worstErrorSq = 0;
+
+	// Some files give every corner its own normal index even when the
+	// values match, so first point identical vertices at one copy -
+	// otherwise they'd all look like seams and never collapse
+	std::vector<char> used(vertexCount, 0);
+	{
+		std::unordered_map<Vertex, unsigned int, VertexValueHash, VertexValueEqual> firstWithValue;
+		firstWithValue.reserve(vertexCount);
+		std::vector<unsigned int> valueRemap(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+			valueRemap[i] = firstWithValue.insert({ vertices[i], i }).first->second;
+		for (auto& index : result)
+		{
+			index = valueRemap[index];
+			used[index] = 1;
+		}
+	}
+
+	// Weld by position - every vertex gets the first vertex at its position,
+	// and any position shared by more than one (used) vertex is a seam
+	std::vector<unsigned int> positionRemap(vertexCount);
+	std::vector<unsigned int> wedgeCount(vertexCount, 0);
+	{
+		std::unordered_map<XMFLOAT3, unsigned int, PositionHash, PositionEqual> firstAtPosition;
+		firstAtPosition.reserve(vertexCount);
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			positionRemap[i] = firstAtPosition.insert({ vertices[i].Position, i }).first->second;
+			if (used[i])
+				wedgeCount[positionRemap[i]]++;
+		}
+	}
+
+	// A seam between two sides can still slide along itself (both copies
+	// move together), but where three or more meet it has to stay put
+	std::vector<char> locked(vertexCount, 0);
+	for (unsigned int i = 0; i < vertexCount; i++)
+		locked[i] = wedgeCount[positionRemap[i]] > 2;
+
+	// Ring of the used vertices at each position, to find a vertex's other copies
+	std::vector<unsigned int> nextWedge(vertexCount);
+	{
+		std::vector<unsigned int> firstWedge(vertexCount, UINT_MAX);
+		for (unsigned int i = 0; i < vertexCount; i++)
+		{
+			nextWedge[i] = i;
+			if (!used[i])
+				continue;
+
+			unsigned int& first = firstWedge[positionRemap[i]];
+			if (first == UINT_MAX)
+			{
+				first = i;
+				continue;
+			}
+			nextWedge[i] = nextWedge[first];
+			nextWedge[first] = i;
+		}
+	}
+
+	// Open borders - an edge nobody walks the other way
+	{
+		std::unordered_set<unsigned long long> edges;
+		edges.reserve(indexCount);
+		for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned long long a = positionRemap[result[i + k]];
+				unsigned long long b = positionRemap[result[i + (k + 1) % 3]];
+				edges.insert((a << 32) | b);
+			}
+		}
+		for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+		{
+			for (int k = 0; k < 3; k++)
+			{
+				unsigned int a = result[i + k];
+				unsigned int b = result[i + (k + 1) % 3];
+				unsigned long long reverse = ((unsigned long long)positionRemap[b] << 32) | positionRemap[a];
+				if (edges.find(reverse) == edges.end())
+				{
+					locked[a] = 1;
+					locked[b] = 1;
+				}
+			}
+		}
+	}
+
+	// One quadric per position, from the planes of every triangle touching it
+	std::vector<Quadric> quadrics(vertexCount);
+	memset(&quadrics[0], 0, sizeof(Quadric) * vertexCount);
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[result[i]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[result[i + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[result[i + 2]].Position);
+		XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+		float area = XMVectorGetX(XMVector3Length(normal));
+		if (area <= 0)
+			continue;
+		normal = normal / area;
+
+		XMFLOAT3 n;
+		XMStoreFloat3(&n, normal);
+		float d = -XMVectorGetX(XMVector3Dot(normal, p0));
+		for (int k = 0; k < 3; k++)
+			AddPlane(quadrics[positionRemap[result[i + k]]], n.x, n.y, n.z, d, area * 0.5f);
+	}
+
+	std::vector<unsigned int> adjacencyOffsets(vertexCount + 1);
+	std::vector<unsigned int> adjacency;
+	std::vector<Collapse> collapses;
+	std::vector<unsigned int> collapseTarget(vertexCount);
+	std::vector<char> touched(vertexCount);
+
+	// Each pass collapses a batch of the cheapest edges, then
+	// rebuilds everything that depends on the index buffer
+	while (result.size() > targetIndexCount)
+	{
+		unsigned int triangleCount = (unsigned int)result.size() / 3;
+
+		// Vertex -> triangles
+		std::fill(adjacencyOffsets.begin(), adjacencyOffsets.end(), 0);
+		for (unsigned int index : result)
+			adjacencyOffsets[index + 1]++;
+		for (unsigned int i = 0; i < vertexCount; i++)
+			adjacencyOffsets[i + 1] += adjacencyOffsets[i];
+		adjacency.resize(result.size());
+		{
+			std::vector<unsigned int> fill(adjacencyOffsets.begin(), adjacencyOffsets.end() - 1);
+			for (unsigned int i = 0; i < result.size(); i++)
+				adjacency[fill[result[i]]++] = i / 3;
+		}
+
+		// The vertex at "position" that shares a triangle with this one, UINT_MAX if there isn't one
+		auto findPartner = [&](unsigned int wedge, unsigned int position)
+		{
+			for (unsigned int t = adjacencyOffsets[wedge]; t < adjacencyOffsets[wedge + 1]; t++)
+			{
+				const unsigned int* tri = &result[adjacency[t] * 3];
+				for (int k = 0; k < 3; k++)
+				{
+					if (positionRemap[tri[k]] == position)
+						return tri[k];
+				}
+			}
+			return (unsigned int)UINT_MAX;
+		};
+
+		// Every copy of "from" needs somewhere to go - for a seam that
+		// means the edge has to run along the seam, not across it
+		auto canCollapse = [&](unsigned int from, unsigned int to)
+		{
+			if (locked[from])
+				return false;
+			unsigned int wedge = from;
+			do
+			{
+				if (findPartner(wedge, positionRemap[to]) == UINT_MAX)
+					return false;
+				wedge = nextWedge[wedge];
+			} while (wedge != from);
+			return true;
+		};
+
+		// Every edge gets one candidate, in whichever direction is cheaper
+		collapses.clear();
+		for (unsigned int i = 0; i < result.size(); i++)
+		{
+			unsigned int a = result[i];
+			unsigned int b = result[i - i % 3 + (i + 1) % 3];
+
+			//edges inside the mesh show up once from each side (maybe as
+			//different copies along a seam), only take one of them
+			if (positionRemap[a] > positionRemap[b])
+				continue;
+
+			const Quadric& qa = quadrics[positionRemap[a]];
+			const Quadric& qb = quadrics[positionRemap[b]];
+			Quadric combined = qa;
+			AddQuadric(combined, qb);
+
+			double aOntoB = canCollapse(a, b) ? QuadricError(combined, vertices[b].Position) : DBL_MAX;
+			double bOntoA = canCollapse(b, a) ? QuadricError(combined, vertices[a].Position) : DBL_MAX;
+			if (aOntoB == DBL_MAX && bOntoA == DBL_MAX)
+				continue;
+
+			Collapse collapse;
+			collapse.from = aOntoB <= bOntoA ? a : b;
+			collapse.to = aOntoB <= bOntoA ? b : a;
+			collapse.error = (float)(aOntoB <= bOntoA ? aOntoB : bOntoA);
+			collapses.push_back(collapse);
+		}
+
+		std::sort(collapses.begin(), collapses.end(),
+			[](const Collapse& x, const Collapse& y) { return x.error < y.error; });
+
+		// Each collapse removes about two triangles
+		unsigned int collapseBudget = (triangleCount - targetIndexCount / 3) / 2 + 1;
+		unsigned int collapsed = 0;
+
+		for (unsigned int i = 0; i < vertexCount; i++)
+			collapseTarget[i] = i;
+		std::fill(touched.begin(), touched.end(), 0);
+
+		for (auto& collapse : collapses)
+		{
+			if (collapse.error > maxErrorSq || collapsed >= collapseBudget)
+				break;
+
+			// Only one change per neighbourhood per pass, so the flip
+			// checks always see the real current positions
+			if (touched[collapse.from] || touched[collapse.to])
+				continue;
+
+			bool valid = true;
+			unsigned int wedge = collapse.from;
+			do
+			{
+				unsigned int partner = findPartner(wedge, positionRemap[collapse.to]);
+				if (touched[wedge] || touched[partner] || CollapseFlipsTriangles(vertices, &result[0], adjacencyOffsets, adjacency, wedge, partner))
+					valid = false;
+				wedge = nextWedge[wedge];
+			} while (valid && wedge != collapse.from);
+			if (!valid)
+				continue;
+
+			// Move every copy onto its partner and keep the area around it still for the rest of the pass
+			wedge = collapse.from;
+			do
+			{
+				collapseTarget[wedge] = findPartner(wedge, positionRemap[collapse.to]);
+				for (unsigned int t = adjacencyOffsets[wedge]; t < adjacencyOffsets[wedge + 1]; t++)
+				{
+					const unsigned int* tri = &result[adjacency[t] * 3];
+					touched[tri[0]] = touched[tri[1]] = touched[tri[2]] = 1;
+				}
+				wedge = nextWedge[wedge];
+			} while (wedge != collapse.from);
+
+			AddQuadric(quadrics[positionRemap[collapse.to]], quadrics[positionRemap[collapse.from]]);
+			if (collapse.error > worstErrorSq)
+				worstErrorSq = collapse.error;
+			collapsed++;
+		}
+
+		if (collapsed == 0)
+			break;
+
+		// Apply the collapses and drop the triangles that closed up
+		unsigned int write = 0;
+		for (unsigned int i = 0; i < result.size(); i += 3)
+		{
+			unsigned int a = collapseTarget[result[i]];
+			unsigned int b = collapseTarget[result[i + 1]];
+			unsigned int c = collapseTarget[result[i + 2]];
+			if (a == b || b == c || a == c)
+				continue;
+			result[write++] = a;
+			result[write++] = b;
+			result[write++] = c;
+		}
+		result.resize(write);
+	}
+
+	if (!result.empty())
+		memcpy(outIndices, &result[0], result.size() * sizeof(unsigned int));
+	if (resultError)
+		*resultError = (float)sqrt(worstErrorSq);
+	return (unsigned int)result.size();
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include "Vertex.h"
+
+// One level of detail - a range of the mesh's index buffer
+struct MeshLod
+{
+	unsigned int indexOffset;
+	unsigned int indexCount;
+	float error;	// how far (in local units) the simplified surface may be from the original, 0 for the full mesh
+};
+
+// --------------------------------------------------------
+// Quadric error metric mesh simplification
+//
+// Collapses edges one vertex onto another (so the result
+// still indexes the original vertex buffer), cheapest first,
+// until the target triangle count is reached.
+//
+// UV/normal seams (several vertices sharing one position)
+// are kept - a seam vertex only collapses along the seam,
+// taking both of its copies with it, and vertices where three
+// or more sides meet or on open borders never move at all.
+// --------------------------------------------------------
+class MeshSimplifier
+{
+public:
+	//writes the simplified triangles to outIndices (must fit indexCount entries), returns the new index count
+	// - maxError stops early once collapses would move the surface further than this (local units)
+	// - resultError gets the largest error of any collapse that was made
+	static unsigned int Simplify(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, unsigned int targetIndexCount, float maxError, unsigned int* outIndices, float* resultError);
+};
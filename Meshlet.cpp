@@ -0,0 +1,255 @@
+#include "Meshlet.h"
+#include <cmath>
+
+using namespace DirectX;
+
+//marks vertices that aren't in the meshlet being built
+static const unsigned char NotInMeshlet = 0xFF;
+
+void MeshletBuilder::Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, MeshletData& out)
+{
+	out.meshlets.clear();
+	out.vertices.clear();
+	out.triangles.clear();
+
+	if (vertexCount == 0 || indexCount < 3)
+		return;
+
+	// Where each mesh vertex lives inside the current meshlet
+	std::vector<unsigned char> localIndex(vertexCount, NotInMeshlet);
+
+	Meshlet current = {};
+
+	auto finishMeshlet = [&](unsigned int nextIndex)
+	{
+		ComputeBounds(vertices, indices + current.indexOffset, current.triangleCount * 3, current);
+		out.meshlets.push_back(current);
+
+		for (unsigned int i = 0; i < current.vertexCount; i++)
+			localIndex[out.vertices[current.vertexOffset + i]] = NotInMeshlet;
+
+		current = Meshlet();
+		current.vertexOffset = (unsigned int)out.vertices.size();
+		current.triangleOffset = (unsigned int)out.triangles.size();
+		current.indexOffset = nextIndex;
+	};
+
+	// Walk the triangles in order, starting a new meshlet whenever the
+	// next one won't fit - the vertex cache order already keeps
+	// neighbouring triangles together, so this stays tight without
+	// having to search for the best next triangle
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		unsigned int a = indices[i];
+		unsigned int b = indices[i + 1];
+		unsigned int c = indices[i + 2];
+
+		unsigned int newVerts =
+			(localIndex[a] == NotInMeshlet) +
+			(localIndex[b] == NotInMeshlet && b != a) +
+			(localIndex[c] == NotInMeshlet && c != a && c != b);
+
+		if (current.vertexCount + newVerts > MaxMeshletVertices || current.triangleCount + 1u > MaxMeshletTriangles)
+			finishMeshlet(i);
+
+		unsigned int tri[3] = { a, b, c };
+		for (int k = 0; k < 3; k++)
+		{
+			if (localIndex[tri[k]] == NotInMeshlet)
+			{
+				localIndex[tri[k]] = (unsigned char)current.vertexCount++;
+				out.vertices.push_back(tri[k]);
+			}
+			out.triangles.push_back(localIndex[tri[k]]);
+		}
+		current.triangleCount++;
+	}
+
+	if (current.triangleCount > 0)
+		finishMeshlet(indexCount);
+}
+
+void MeshletBuilder::ComputeBounds(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount, Meshlet& meshlet)
+{
+	// Bounding sphere (Ritter's) - start from the most
+	// distant pair of extreme points along x, y or z,
+	// then grow it to take in anything left outside
+	XMFLOAT3 minPoints[3];
+	XMFLOAT3 maxPoints[3];
+	for (int axis = 0; axis < 3; axis++)
+	{
+		minPoints[axis] = vertices[indices[0]].Position;
+		maxPoints[axis] = minPoints[axis];
+	}
+	for (unsigned int i = 1; i < indexCount; i++)
+	{
+		const XMFLOAT3& p = vertices[indices[i]].Position;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			//XMFLOAT3 is three floats in a row, so index it like an array
+			if ((&p.x)[axis] < (&minPoints[axis].x)[axis]) minPoints[axis] = p;
+			if ((&p.x)[axis] > (&maxPoints[axis].x)[axis]) maxPoints[axis] = p;
+		}
+	}
+
+	int widest = 0;
+	float widestSq = -1;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		float lengthSq = XMVectorGetX(XMVector3LengthSq(XMLoadFloat3(&maxPoints[axis]) - XMLoadFloat3(&minPoints[axis])));
+		if (lengthSq > widestSq)
+		{
+			widestSq = lengthSq;
+			widest = axis;
+		}
+	}
+
+	XMVECTOR center = (XMLoadFloat3(&minPoints[widest]) + XMLoadFloat3(&maxPoints[widest])) * 0.5f;
+	float radius = sqrtf(widestSq) * 0.5f;
+	for (unsigned int i = 0; i < indexCount; i++)
+	{
+		XMVECTOR point = XMLoadFloat3(&vertices[indices[i]].Position);
+		float distance = XMVectorGetX(XMVector3Length(point - center));
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center += (point - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+
+	XMStoreFloat3(&meshlet.center, center);
+	meshlet.radius = radius;
+
+	// Normal cone - the axis is the average facing of the triangles,
+	// the cutoff comes from the one that strays furthest from it
+	unsigned int triangleCount = indexCount / 3;
+	std::vector<XMVECTOR> normals(triangleCount);
+	XMVECTOR normalSum = XMVectorZero();
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3 + 0]].Position);
+		XMVECTOR p1 = XMLoadFloat3(&vertices[indices[t * 3 + 1]].Position);
+		XMVECTOR p2 = XMLoadFloat3(&vertices[indices[t * 3 + 2]].Position);
+
+		//clockwise front faces, so this points out of the front
+		normals[t] = XMVector3Normalize(XMVector3Cross(p1 - p0, p2 - p0));
+		normalSum += normals[t];
+	}
+
+	meshlet.coneApex = meshlet.center;
+	meshlet.coneAxis = XMFLOAT3(0, 0, 0);
+	meshlet.coneCutoff = 1.0f;
+	if (XMVectorGetX(XMVector3LengthSq(normalSum)) <= 0)
+		return;
+
+	XMVECTOR axis = XMVector3Normalize(normalSum);
+	float minDot = 1.0f;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		//degenerate triangles have no facing, they can't be seen anyway
+		if (XMVectorGetX(XMVector3LengthSq(normals[t])) <= 0)
+			continue;
+		float d = XMVectorGetX(XMVector3Dot(normals[t], axis));
+		if (d < minDot)
+			minDot = d;
+	}
+
+	XMStoreFloat3(&meshlet.coneAxis, axis);
+
+	// Wider than a hemisphere, some triangle always faces the camera
+	if (minDot <= 0)
+		return;
+
+	// Pull the apex back along the axis until every triangle's plane
+	// is in front of it, so the cone test holds for nearby cameras too
+	float maxT = 0;
+	for (unsigned int t = 0; t < triangleCount; t++)
+	{
+		if (XMVectorGetX(XMVector3LengthSq(normals[t])) <= 0)
+			continue;
+		XMVECTOR p0 = XMLoadFloat3(&vertices[indices[t * 3]].Position);
+		float dc = XMVectorGetX(XMVector3Dot(center - p0, normals[t]));
+		float dn = XMVectorGetX(XMVector3Dot(axis, normals[t]));
+		float t0 = dc / dn;
+		if (t0 > maxT)
+			maxT = t0;
+	}
+
+	XMStoreFloat3(&meshlet.coneApex, center - axis * maxT);
+	meshlet.coneCutoff = sqrtf(1.0f - minDot * minDot);
+}
+
+void MeshletCuller::TransformPlanesToLocal(const XMFLOAT4* worldPlanes, unsigned int planeCount, const XMFLOAT4X4& worldMatrix, XMFLOAT4* localPlanes)
+{
+	// A plane transforms by the inverse transpose, and going from
+	// world back to local undoes the world matrix - so it's just
+	// the transpose of the world matrix itself
+	XMMATRIX toLocal = XMMatrixTranspose(XMLoadFloat4x4(&worldMatrix));
+	for (unsigned int i = 0; i < planeCount; i++)
+		XMStoreFloat4(&localPlanes[i], XMPlaneTransform(XMLoadFloat4(&worldPlanes[i]), toLocal));
+}
+
+bool MeshletCuller::IsOutsidePlanes(const Meshlet& meshlet, const XMFLOAT4* planes, unsigned int planeCount)
+{
+	XMVECTOR center = XMVectorSetW(XMLoadFloat3(&meshlet.center), 1.0f);
+	for (unsigned int i = 0; i < planeCount; i++)
+	{
+		XMVECTOR plane = XMLoadFloat4(&planes[i]);
+		float distance = XMVectorGetX(XMVector4Dot(plane, center));
+		float planeScale = XMVectorGetX(XMVector3Length(plane));
+		if (distance < -meshlet.radius * planeScale)
+			return true;
+	}
+	return false;
+}
+
+bool MeshletCuller::IsBackfacing(const Meshlet& meshlet, const XMFLOAT3& cameraPosition)
+{
+	XMVECTOR toApex = XMLoadFloat3(&meshlet.coneApex) - XMLoadFloat3(&cameraPosition);
+	if (XMVectorGetX(XMVector3LengthSq(toApex)) <= 0)
+		return false;
+	float d = XMVectorGetX(XMVector3Dot(XMVector3Normalize(toApex), XMLoadFloat3(&meshlet.coneAxis)));
+	return d > meshlet.coneCutoff;
+}
+
+unsigned int MeshletCuller::Cull(const MeshletData& data, const XMFLOAT4* planes, unsigned int planeCount, const XMFLOAT3& cameraPosition, std::vector<unsigned int>& visible)
+{
+	visible.clear();
+	for (unsigned int i = 0; i < data.meshlets.size(); i++)
+	{
+		const Meshlet& meshlet = data.meshlets[i];
+		if (IsBackfacing(meshlet, cameraPosition) || IsOutsidePlanes(meshlet, planes, planeCount))
+			continue;
+		visible.push_back(i);
+	}
+	return (unsigned int)visible.size();
+}
+
+unsigned int MeshletCuller::CountWronglyBackfaceCulled(const MeshletData& data, const Vertex* vertices, const unsigned int* indices, const XMFLOAT3& cameraPosition, unsigned int& culledCount)
+{
+	XMVECTOR camera = XMLoadFloat3(&cameraPosition);
+	unsigned int wrong = 0;
+	culledCount = 0;
+	for (auto& meshlet : data.meshlets)
+	{
+		if (!IsBackfacing(meshlet, cameraPosition))
+			continue;
+		culledCount++;
+
+		for (unsigned int t = 0; t < meshlet.triangleCount; t++)
+		{
+			const unsigned int* tri = indices + meshlet.indexOffset + t * 3;
+			XMVECTOR p0 = XMLoadFloat3(&vertices[tri[0]].Position);
+			XMVECTOR p1 = XMLoadFloat3(&vertices[tri[1]].Position);
+			XMVECTOR p2 = XMLoadFloat3(&vertices[tri[2]].Position);
+			XMVECTOR normal = XMVector3Cross(p1 - p0, p2 - p0);
+			if (XMVectorGetX(XMVector3Dot(normal, camera - p0)) > 0)
+			{
+				wrong++;
+				break;
+			}
+		}
+	}
+	return wrong;
+}
@@ -0,0 +1,79 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include "Vertex.h"
+
+// Limits for a single meshlet - 64/124 keeps the local triangle
+// list byte sized and matches what mesh shader hardware likes
+static const unsigned int MaxMeshletVertices = 64;
+static const unsigned int MaxMeshletTriangles = 124;
+
+// --------------------------------------------------------
+// A small cluster of a mesh's triangles
+//
+// The triangles are also a contiguous range of the mesh's
+// index buffer (indexOffset), so a visible meshlet can be
+// drawn with a plain DrawIndexed.
+// --------------------------------------------------------
+struct Meshlet
+{
+	unsigned int vertexOffset;		// first entry of this meshlet in MeshletData::vertices
+	unsigned int triangleOffset;	// first byte of this meshlet in MeshletData::triangles
+	unsigned int indexOffset;		// first index of the same triangles in the mesh's index buffer
+	unsigned short vertexCount;
+	unsigned short triangleCount;
+
+	// Bounding sphere, for frustum tests
+	DirectX::XMFLOAT3 center;
+	float radius;
+
+	// Normal cone, for backface tests - every triangle faces away
+	// from the camera when dot(normalize(coneApex - camera), coneAxis) > coneCutoff
+	// - coneCutoff is 1 when the normals spread too far to ever cull
+	DirectX::XMFLOAT3 coneApex;
+	DirectX::XMFLOAT3 coneAxis;
+	float coneCutoff;
+};
+
+// All the meshlets of one mesh, laid out flat so it can be saved as is
+struct MeshletData
+{
+	std::vector<Meshlet> meshlets;
+	std::vector<unsigned int> vertices;		// mesh vertex index for each meshlet's local vertices
+	std::vector<unsigned char> triangles;	// three local vertex indices per triangle
+};
+
+class MeshletBuilder
+{
+public:
+	//splits the index buffer into meshlets in its current order (run the vertex cache optimization first)
+	static void Build(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, MeshletData& out);
+
+	//bounding sphere and normal cone of a set of triangles
+	static void ComputeBounds(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount, Meshlet& meshlet);
+};
+
+// --------------------------------------------------------
+// CPU reference culling for meshlets
+//
+// Everything is in the mesh's local space - use
+// TransformPlanesToLocal to bring world space planes over.
+// Planes are (a, b, c, d) with inside being ax + by + cz + d >= 0,
+// they don't need to be normalized.
+// --------------------------------------------------------
+class MeshletCuller
+{
+public:
+	//world space planes -> local space planes of a mesh drawn with this world matrix
+	static void TransformPlanesToLocal(const DirectX::XMFLOAT4* worldPlanes, unsigned int planeCount, const DirectX::XMFLOAT4X4& worldMatrix, DirectX::XMFLOAT4* localPlanes);
+
+	static bool IsOutsidePlanes(const Meshlet& meshlet, const DirectX::XMFLOAT4* planes, unsigned int planeCount);
+	static bool IsBackfacing(const Meshlet& meshlet, const DirectX::XMFLOAT3& cameraPosition);
+
+	//fills visible with the index of every meshlet that survives both tests, returns how many did
+	static unsigned int Cull(const MeshletData& data, const DirectX::XMFLOAT4* planes, unsigned int planeCount, const DirectX::XMFLOAT3& cameraPosition, std::vector<unsigned int>& visible);
+
+	//checks the cone test against every single triangle from one camera position
+	//returns how many meshlets were culled even though one of their triangles faces the camera (should be 0)
+	static unsigned int CountWronglyBackfaceCulled(const MeshletData& data, const Vertex* vertices, const unsigned int* indices, const DirectX::XMFLOAT3& cameraPosition, unsigned int& culledCount);
+};
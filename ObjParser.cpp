@@ -0,0 +1,459 @@
+#include "ObjParser.h"
+#include <Windows.h>
+#include <thread>
+#include <chrono>
+#include <climits>
+#include <cstring>
+
+using namespace DirectX;
+
+//marks a face corner that didnt specify a uv or normal
+static const int MissingIndex = INT_MIN;
+
+//don't bother splitting files smaller than this across threads
+static const size_t MinimumChunkSize = 256 * 1024;
+
+//everything one thread pulls out of its part of the file
+struct ObjChunk
+{
+	const char* start;
+	const char* end;
+
+	std::vector<XMFLOAT3> positions;
+	std::vector<XMFLOAT3> normals;
+	std::vector<XMFLOAT2> uvs;
+
+	// 3 ints per corner (position, uv, normal), 0-based
+	// - Positive file indices are absolute and stored as-is
+	// - Negative (relative) file indices can only be resolved once we
+	//   know how many elements came before this chunk, so they are
+	//   stored relative to the chunk and listed in relativeCorners
+	std::vector<int> corners;
+	std::vector<size_t> relativeCorners;
+};
+
+// --------------------------------------------------------
+// Hand written tokenizers - much faster than sscanf since
+// they never have to interpret a format string
+// --------------------------------------------------------
+static inline bool IsDigit(char c)
+{
+	return c >= '0' && c <= '9';
+}
+
+static inline const char* SkipSpaces(const char* p, const char* end)
+{
+	while (p < end && (*p == ' ' || *p == '\t'))
+		p++;
+	return p;
+}
+
+static const char* ParseFloat(const char* p, const char* end, float& out)
+{
+	p = SkipSpaces(p, end);
+
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	//gather up to 19 significant digits, which always fits in 64 bits
+	unsigned long long mantissa = 0;
+	int digits = 0;
+	int exponent = 0;
+	while (p < end && IsDigit(*p))
+	{
+		if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; }
+		else { exponent++; }
+		p++;
+	}
+	if (p < end && *p == '.')
+	{
+		p++;
+		while (p < end && IsDigit(*p))
+		{
+			if (digits < 19) { mantissa = mantissa * 10 + (*p - '0'); digits++; exponent--; }
+			p++;
+		}
+	}
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		p++;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = *p == '-';
+			p++;
+		}
+		int fileExponent = 0;
+		while (p < end && IsDigit(*p))
+		{
+			if (fileExponent < 1000) fileExponent = fileExponent * 10 + (*p - '0');
+			p++;
+		}
+		exponent += negativeExponent ? -fileExponent : fileExponent;
+	}
+
+	//exact powers of ten cover everything a modeling package writes out
+	static const double powersOfTen[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10,
+		1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	double value = (double)mantissa;
+	while (exponent > 22) { value *= 1e22; exponent -= 22; }
+	while (exponent < -22) { value /= 1e22; exponent += 22; }
+	if (exponent > 0) value *= powersOfTen[exponent];
+	else if (exponent < 0) value /= powersOfTen[-exponent];
+
+	out = (float)(negative ? -value : value);
+	return p;
+}
+
+static const char* ParseInt(const char* p, const char* end, int& out, bool& found)
+{
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		p++;
+	}
+
+	found = false;
+	long long value = 0;
+	while (p < end && IsDigit(*p))
+	{
+		if (value < INT_MAX) value = value * 10 + (*p - '0');
+		found = true;
+		p++;
+	}
+	if (value > INT_MAX) value = INT_MAX;
+
+	out = (int)(negative ? -value : value);
+	return p;
+}
+
+//converts a 1-based (or negative, relative) file index to the chunk encoding described in ObjChunk
+static void AddCornerIndex(ObjChunk& chunk, int fileIndex, bool found, size_t localCount)
+{
+	if (!found || fileIndex == 0)
+	{
+		chunk.corners.push_back(MissingIndex);
+	}
+	else if (fileIndex > 0)
+	{
+		chunk.corners.push_back(fileIndex - 1);
+	}
+	else
+	{
+		chunk.relativeCorners.push_back(chunk.corners.size());
+		chunk.corners.push_back((int)localCount + fileIndex);
+	}
+}
+
+static void ParseChunk(ObjChunk& chunk)
+{
+	const char* p = chunk.start;
+	const char* end = chunk.end;
+
+	//the corners of the polygon on the current line, before fanning into triangles
+	std::vector<int> polygon;
+
+	while (p < end)
+	{
+		//find the end of this line - no fixed size line buffer to overflow
+		const char* lineEnd = (const char*)memchr(p, '\n', end - p);
+		if (!lineEnd) lineEnd = end;
+
+		const char* line = SkipSpaces(p, lineEnd);
+		p = lineEnd + 1;
+
+		if (lineEnd - line < 2)
+			continue;
+
+		if (line[0] == 'v' && line[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			const char* c = ParseFloat(line + 2, lineEnd, norm.x);
+			c = ParseFloat(c, lineEnd, norm.y);
+			ParseFloat(c, lineEnd, norm.z);
+			chunk.normals.push_back(norm);
+		}
+		else if (line[0] == 'v' && line[1] == 't')
+		{
+			XMFLOAT2 uv;
+			const char* c = ParseFloat(line + 2, lineEnd, uv.x);
+			ParseFloat(c, lineEnd, uv.y);
+			chunk.uvs.push_back(uv);
+		}
+		else if (line[0] == 'v' && (line[1] == ' ' || line[1] == '\t'))
+		{
+			XMFLOAT3 pos;
+			const char* c = ParseFloat(line + 1, lineEnd, pos.x);
+			c = ParseFloat(c, lineEnd, pos.y);
+			ParseFloat(c, lineEnd, pos.z);
+			chunk.positions.push_back(pos);
+		}
+		else if (line[0] == 'f' && (line[1] == ' ' || line[1] == '\t'))
+		{
+			// Read every corner on the line, each in one of the forms
+			//  v, v/vt, v//vn or v/vt/vn
+			polygon.clear();
+			const char* c = line + 1;
+			while (true)
+			{
+				c = SkipSpaces(c, lineEnd);
+				if (c >= lineEnd || !(IsDigit(*c) || *c == '-' || *c == '+'))
+					break;
+
+				int v = 0, vt = 0, vn = 0;
+				bool hasV = false, hasVT = false, hasVN = false;
+				c = ParseInt(c, lineEnd, v, hasV);
+				if (c < lineEnd && *c == '/')
+				{
+					c++;
+					if (c < lineEnd && *c != '/')
+						c = ParseInt(c, lineEnd, vt, hasVT);
+					if (c < lineEnd && *c == '/')
+					{
+						c++;
+						c = ParseInt(c, lineEnd, vn, hasVN);
+					}
+				}
+				if (!hasV)
+					break;
+
+				polygon.push_back(v);
+				polygon.push_back(hasVT ? vt : 0);
+				polygon.push_back(hasVN ? vn : 0);
+			}
+
+			// Fan the polygon into triangles (0,1,2), (0,2,3), ...
+			// which matches how quads were always split
+			size_t cornerCount = polygon.size() / 3;
+			for (size_t k = 1; k + 1 < cornerCount; k++)
+			{
+				size_t tri[3] = { 0, k, k + 1 };
+				for (int t = 0; t < 3; t++)
+				{
+					const int* corner = &polygon[tri[t] * 3];
+					AddCornerIndex(chunk, corner[0], corner[0] != 0, chunk.positions.size());
+					AddCornerIndex(chunk, corner[1], corner[1] != 0, chunk.uvs.size());
+					AddCornerIndex(chunk, corner[2], corner[2] != 0, chunk.normals.size());
+				}
+			}
+		}
+	}
+}
+
+ObjParser::ObjParser()
+{
+	fileSize = 0;
+	parseSeconds = 0;
+	threadCount = 0;
+}
+
+ObjParser::~ObjParser()
+{
+}
+
+bool ObjParser::Parse(const char* filename, ObjData& data)
+{
+	auto startTime = std::chrono::high_resolution_clock::now();
+
+	fileSize = 0;
+	parseSeconds = 0;
+	threadCount = 0;
+
+	// Map the whole file into our address space, the OS pages
+	// it in as the threads touch it so there is no copying
+	HANDLE file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	if (!GetFileSizeEx(file, &size) || size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mapping = CreateFileMappingA(file, 0, PAGE_READONLY, 0, 0, 0);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		return false;
+	}
+
+	const char* contents = (const char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!contents)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileSize = (size_t)size.QuadPart;
+	const char* fileEnd = contents + fileSize;
+
+	// Decide how many pieces to cut the file into
+	size_t maxThreads = std::thread::hardware_concurrency();
+	if (maxThreads == 0) maxThreads = 1;
+	size_t chunkCount = fileSize / MinimumChunkSize;
+	if (chunkCount > maxThreads) chunkCount = maxThreads;
+	if (chunkCount == 0) chunkCount = 1;
+
+	// Cut at roughly even offsets, then push each cut forward
+	// to the start of the next line so no line is split
+	std::vector<ObjChunk> chunks(chunkCount);
+	const char* chunkStart = contents;
+	for (size_t i = 0; i < chunkCount; i++)
+	{
+		const char* chunkEnd = fileEnd;
+		if (i + 1 < chunkCount)
+		{
+			chunkEnd = contents + fileSize * (i + 1) / chunkCount;
+			if (chunkEnd < chunkStart) chunkEnd = chunkStart;
+			const char* newline = (const char*)memchr(chunkEnd, '\n', fileEnd - chunkEnd);
+			chunkEnd = newline ? newline + 1 : fileEnd;
+		}
+		chunks[i].start = chunkStart;
+		chunks[i].end = chunkEnd;
+		chunkStart = chunkEnd;
+	}
+
+	// Parse every chunk but the first on its own thread,
+	// this thread takes the first one itself
+	std::vector<std::thread> workers;
+	for (size_t i = 1; i < chunkCount; i++)
+		workers.push_back(std::thread(ParseChunk, std::ref(chunks[i])));
+	ParseChunk(chunks[0]);
+	for (auto& w : workers)
+		w.join();
+	threadCount = (unsigned int)chunkCount;
+
+	UnmapViewOfFile(contents);
+	CloseHandle(mapping);
+	CloseHandle(file);
+
+	// Stitch the chunks back together in file order
+	size_t totalPositions = 0, totalNormals = 0, totalUVs = 0, totalCorners = 0;
+	for (auto& c : chunks)
+	{
+		totalPositions += c.positions.size();
+		totalNormals += c.normals.size();
+		totalUVs += c.uvs.size();
+		totalCorners += c.corners.size() / 3;
+	}
+
+	data.positions.clear();
+	data.normals.clear();
+	data.uvs.clear();
+	data.corners.clear();
+	data.positions.reserve(totalPositions);
+	data.normals.reserve(totalNormals + 1);
+	data.uvs.reserve(totalUVs + 1);
+	data.corners.reserve(totalCorners);
+
+	// Files without uvs or normals still need something to point
+	// at, so those corners share a single default value
+	unsigned int defaultUV = UINT_MAX;
+	unsigned int defaultNormal = UINT_MAX;
+
+	for (auto& c : chunks)
+	{
+		int bases[3] = { (int)data.positions.size(), (int)data.uvs.size(), (int)data.normals.size() };
+		for (size_t fix : c.relativeCorners)
+			c.corners[fix] += bases[fix % 3];
+
+		data.positions.insert(data.positions.end(), c.positions.begin(), c.positions.end());
+		data.normals.insert(data.normals.end(), c.normals.begin(), c.normals.end());
+		data.uvs.insert(data.uvs.end(), c.uvs.begin(), c.uvs.end());
+	}
+
+	for (auto& c : chunks)
+	{
+		for (size_t i = 0; i + 9 <= c.corners.size(); i += 9)
+		{
+			ObjCorner tri[3];
+			bool valid = true;
+			for (int t = 0; t < 3; t++)
+			{
+				const int* raw = &c.corners[i + t * 3];
+
+				if (raw[1] == MissingIndex)
+				{
+					if (defaultUV == UINT_MAX)
+					{
+						defaultUV = (unsigned int)data.uvs.size();
+						data.uvs.push_back(XMFLOAT2(0, 0));
+					}
+					tri[t].uv = defaultUV;
+				}
+				else
+				{
+					tri[t].uv = (unsigned int)raw[1];
+				}
+
+				if (raw[2] == MissingIndex)
+				{
+					if (defaultNormal == UINT_MAX)
+					{
+						defaultNormal = (unsigned int)data.normals.size();
+						data.normals.push_back(XMFLOAT3(0, 1, 0));
+					}
+					tri[t].normal = defaultNormal;
+				}
+				else
+				{
+					tri[t].normal = (unsigned int)raw[2];
+				}
+
+				tri[t].position = (unsigned int)raw[0];
+
+				//anything pointing outside the file's data (or missing a position) is dropped
+				if (raw[0] < 0 || (raw[1] < 0 && raw[1] != MissingIndex) || (raw[2] < 0 && raw[2] != MissingIndex) ||
+					tri[t].position >= data.positions.size() ||
+					tri[t].uv >= data.uvs.size() ||
+					tri[t].normal >= data.normals.size())
+				{
+					valid = false;
+				}
+			}
+
+			if (valid)
+			{
+				data.corners.push_back(tri[0]);
+				data.corners.push_back(tri[1]);
+				data.corners.push_back(tri[2]);
+			}
+		}
+	}
+
+	auto endTime = std::chrono::high_resolution_clock::now();
+	parseSeconds = std::chrono::duration<double>(endTime - startTime).count();
+	return true;
+}
+
+size_t ObjParser::GetFileSize()
+{
+	return fileSize;
+}
+
+double ObjParser::GetParseSeconds()
+{
+	return parseSeconds;
+}
+
+double ObjParser::GetMegabytesPerSecond()
+{
+	if (parseSeconds <= 0)
+		return 0;
+	return (fileSize / (1024.0 * 1024.0)) / parseSeconds;
+}
+
+unsigned int ObjParser::GetThreadCount()
+{
+	return threadCount;
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+
+// One corner of a triangle read from an .obj file
+// - All three indices are 0-based and already validated
+//   against the arrays in ObjData
+struct ObjCorner
+{
+	unsigned int position;
+	unsigned int uv;
+	unsigned int normal;
+};
+
+// Raw data read from an .obj file, still in the file's (right-handed) space
+struct ObjData
+{
+	std::vector<DirectX::XMFLOAT3> positions;
+	std::vector<DirectX::XMFLOAT3> normals;
+	std::vector<DirectX::XMFLOAT2> uvs;
+	std::vector<ObjCorner> corners;	// 3 per triangle, polygons are fanned into triangles
+};
+
+// --------------------------------------------------------
+// Memory mapped, multithreaded .obj parser
+//
+// The file is mapped into memory and split into line aligned
+// chunks which are parsed on separate threads, each chunk
+// building its own arrays.  The arrays are then stitched back
+// together in file order, so the result is identical to
+// reading the file front to back.
+// --------------------------------------------------------
+class ObjParser
+{
+public:
+	ObjParser();
+	~ObjParser();
+
+	//parses the whole file into data, returns false if the file could not be read
+	bool Parse(const char* filename, ObjData& data);
+
+	//stats from the last call to Parse
+	size_t GetFileSize();
+	double GetParseSeconds();
+	double GetMegabytesPerSecond();
+	unsigned int GetThreadCount();
+
+private:
+	size_t fileSize;
+	double parseSeconds;
+	unsigned int threadCount;
+};
@@ -0,0 +1,437 @@
+#include "OcclusionCuller.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <string>
+
+using namespace DirectX;
+
+OcclusionCuller::OcclusionCuller(unsigned int width, unsigned int height, unsigned int tileWidth, unsigned int tileHeight, unsigned int threadCount)
+{
+	this->width = width;
+	this->height = height;
+	this->tileWidth = tileWidth;
+	this->tileHeight = tileHeight;
+	tilesX = width / tileWidth;
+	tilesY = height / tileHeight;
+	bins.resize(tilesX * tilesY);
+	XMStoreFloat4x4(&viewProjection, XMMatrixIdentity());
+
+	// Every level down to a single texel, starting out at the far plane
+	unsigned int levelWidth = width;
+	unsigned int levelHeight = height;
+	while (true)
+	{
+		levels.push_back(std::vector<float>(levelWidth * levelHeight, 1.0f));
+		levelWidths.push_back(levelWidth);
+		levelHeights.push_back(levelHeight);
+		if (levelWidth == 1 && levelHeight == 1)
+			break;
+		levelWidth = (levelWidth + 1) / 2;
+		levelHeight = (levelHeight + 1) / 2;
+	}
+
+	frame = 0;
+	workersBusy = 0;
+	nextTile = 0;
+	stopping = false;
+
+	// The thread calling Rasterize draws tiles too, so it counts as one -
+	// and there's no point in more threads than tiles
+	if (threadCount == 0)
+		threadCount = std::thread::hardware_concurrency();
+	if (threadCount > tilesX * tilesY)
+		threadCount = tilesX * tilesY;
+	for (unsigned int i = 1; i < threadCount; i++)
+		workers.push_back(std::thread(&OcclusionCuller::WorkerLoop, this));
+}
+
+OcclusionCuller::~OcclusionCuller()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	frameStarted.notify_all();
+	for (auto& w : workers)
+		w.join();
+}
+
+void OcclusionCuller::BeginFrame(const XMFLOAT4X4& viewProjection)
+{
+	this->viewProjection = viewProjection;
+	triangles.clear();
+	for (auto& bin : bins)
+		bin.clear();
+}
+
+void OcclusionCuller::AddOccluder(const XMFLOAT3* positions, const unsigned int* indices, unsigned int indexCount, const XMFLOAT4X4& worldMatrix)
+{
+	XMMATRIX toClip = XMMatrixMultiply(XMLoadFloat4x4(&worldMatrix), XMLoadFloat4x4(&viewProjection));
+
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		XMFLOAT4 corners[3];
+		unsigned int inFront = 0;
+		unsigned int pastFar = 0;
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			XMStoreFloat4(&corners[k], XMVector3Transform(XMLoadFloat3(&positions[indices[i + k]]), toClip));
+			inFront += corners[k].z >= 0.0f;
+			pastFar += corners[k].z > corners[k].w;
+		}
+
+		// Nothing to draw if it's all behind the near plane or past the far one
+		if (inFront == 0 || pastFar == 3)
+			continue;
+		if (inFront == 3)
+		{
+			AddTriangle(corners[0], corners[1], corners[2]);
+			continue;
+		}
+
+		// Cut off the part behind the near plane (z = 0 in clip space) -
+		// what's left is a triangle or a quad, which is split in two
+		clipped.clear();
+		for (unsigned int k = 0; k < 3; k++)
+		{
+			const XMFLOAT4& a = corners[k];
+			const XMFLOAT4& b = corners[(k + 1) % 3];
+			if (a.z >= 0.0f)
+				clipped.push_back(a);
+			if ((a.z >= 0.0f) != (b.z >= 0.0f))
+			{
+				XMFLOAT4 cut;
+				XMStoreFloat4(&cut, XMVectorLerp(XMLoadFloat4(&a), XMLoadFloat4(&b), a.z / (a.z - b.z)));
+				cut.z = 0.0f;
+				clipped.push_back(cut);
+			}
+		}
+		for (unsigned int k = 2; k < clipped.size(); k++)
+			AddTriangle(clipped[0], clipped[k - 1], clipped[k]);
+	}
+}
+
+void OcclusionCuller::AddOccluderBox(const Aabb& localBox, const XMFLOAT4X4& worldMatrix)
+{
+	// Corner n has the max x if bit 0 is set, max y for bit 1 and max z for bit 2
+	XMFLOAT3 corners[8];
+	for (unsigned int n = 0; n < 8; n++)
+	{
+		corners[n].x = (n & 1) ? localBox.maxCorner.x : localBox.minCorner.x;
+		corners[n].y = (n & 2) ? localBox.maxCorner.y : localBox.minCorner.y;
+		corners[n].z = (n & 4) ? localBox.maxCorner.z : localBox.minCorner.z;
+	}
+
+	//two triangles a side, clockwise looking at it from outside
+	static const unsigned int indices[36] =
+	{
+		0, 2, 3,  0, 3, 1,	// -z
+		5, 7, 6,  5, 6, 4,	// +z
+		4, 6, 2,  4, 2, 0,	// -x
+		1, 3, 7,  1, 7, 5,	// +x
+		0, 1, 5,  0, 5, 4,	// -y
+		2, 6, 7,  2, 7, 3,	// +y
+	};
+	AddOccluder(corners, indices, 36, worldMatrix);
+}
+
+void OcclusionCuller::AddTriangle(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c)
+{
+	// To pixels, y going down the screen - in doubles, since a corner the
+	// near plane cut off can be a hundred thousand pixels off screen, and
+	// in floats the plane through it loses the depth of what's on screen
+	const XMFLOAT4* clip[3] = { &a, &b, &c };
+	double x[3], y[3], z[3];
+	for (unsigned int k = 0; k < 3; k++)
+	{
+		double invW = 1.0 / clip[k]->w;
+		x[k] = (clip[k]->x * invW * 0.5 + 0.5) * width;
+		y[k] = (0.5 - clip[k]->y * invW * 0.5) * height;
+		z[k] = clip[k]->z * invW;
+	}
+
+	// Clockwise on screen is a positive area with y going down - anything
+	// else is facing away (or edge on), and the front of the occluder
+	// will be nearer anyway
+	double e1x = x[1] - x[0], e1y = y[1] - y[0];
+	double e2x = x[2] - x[0], e2y = y[2] - y[0];
+	double area = e1x * e2y - e2x * e1y;
+	if (!(area > 0.0))
+		return;
+
+	ScreenTriangle tri;
+	tri.minX = (int)floor((std::max)((std::min)((std::min)(x[0], x[1]), x[2]), 0.0));
+	tri.minY = (int)floor((std::max)((std::min)((std::min)(y[0], y[1]), y[2]), 0.0));
+	tri.maxX = (int)floor((std::min)((std::max)((std::max)(x[0], x[1]), x[2]), width - 1.0));
+	tri.maxY = (int)floor((std::min)((std::max)((std::max)(y[0], y[1]), y[2]), height - 1.0));
+	if (tri.minX > tri.maxX || tri.minY > tri.maxY)
+		return;
+
+	// Each edge's function is positive on the inside, the same side as the corner it doesn't touch
+	for (unsigned int k = 0; k < 3; k++)
+	{
+		unsigned int next = (k + 1) % 3;
+		tri.edgeA[k] = (float)(y[k] - y[next]);
+		tri.edgeB[k] = (float)(x[next] - x[k]);
+		tri.edgeC[k] = (float)((y[next] - y[k]) * x[k] - (x[next] - x[k]) * y[k]);
+	}
+
+	// Depth is linear across the screen after the divide
+	double dz1 = z[1] - z[0];
+	double dz2 = z[2] - z[0];
+	double depthA = (dz1 * e2y - dz2 * e1y) / area;
+	double depthB = (dz2 * e1x - dz1 * e2x) / area;
+	tri.depthA = (float)depthA;
+	tri.depthB = (float)depthB;
+	tri.depthC = (float)(z[0] - depthA * x[0] - depthB * y[0]);
+
+	unsigned int index = (unsigned int)triangles.size();
+	triangles.push_back(tri);
+	for (unsigned int ty = tri.minY / tileHeight; ty <= tri.maxY / tileHeight; ty++)
+		for (unsigned int tx = tri.minX / tileWidth; tx <= tri.maxX / tileWidth; tx++)
+			bins[ty * tilesX + tx].push_back(index);
+}
+
+void OcclusionCuller::Rasterize()
+{
+	nextTile = 0;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		frame++;
+		workersBusy = (unsigned int)workers.size();
+	}
+	frameStarted.notify_all();
+
+	DrawTiles();
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		frameFinished.wait(lock, [this] { return workersBusy == 0; });
+	}
+
+	BuildPyramid();
+}
+
+void OcclusionCuller::WorkerLoop()
+{
+	unsigned int drawnFrame = 0;
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			frameStarted.wait(lock, [this, drawnFrame] { return stopping || frame != drawnFrame; });
+			if (stopping)
+				break;
+			drawnFrame = frame;
+		}
+
+		DrawTiles();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			workersBusy--;
+		}
+		frameFinished.notify_one();
+	}
+}
+
+void OcclusionCuller::DrawTiles()
+{
+	unsigned int tileCount = tilesX * tilesY;
+	for (unsigned int tile = nextTile++; tile < tileCount; tile = nextTile++)
+		DrawTile(tile);
+}
+
+void OcclusionCuller::DrawTile(unsigned int tile)
+{
+	int tileX = (int)((tile % tilesX) * tileWidth);
+	int tileY = (int)((tile / tilesX) * tileHeight);
+	int tileMaxX = tileX + (int)tileWidth - 1;
+	int tileMaxY = tileY + (int)tileHeight - 1;
+	float* depth = levels[0].data();
+
+	for (int py = tileY; py <= tileMaxY; py++)
+		std::fill(depth + py * width + tileX, depth + py * width + tileMaxX + 1, 1.0f);
+
+	// Four pixels side by side at a time - tiles start on a multiple of four,
+	// so a group never runs off the tile, and pixels in a group past the
+	// triangle's box are still tested properly against its edges
+	const XMVECTOR offsets = XMVectorSet(0.5f, 1.5f, 2.5f, 3.5f);
+	const XMVECTOR zero = XMVectorZero();
+	for (unsigned int t : bins[tile])
+	{
+		const ScreenTriangle& tri = triangles[t];
+		int minX = (std::max)(tri.minX, tileX) & ~3;
+		int maxX = (std::min)(tri.maxX, tileMaxX);
+		int minY = (std::max)(tri.minY, tileY);
+		int maxY = (std::min)(tri.maxY, tileMaxY);
+
+		XMVECTOR edgeA0 = XMVectorReplicate(tri.edgeA[0]);
+		XMVECTOR edgeA1 = XMVectorReplicate(tri.edgeA[1]);
+		XMVECTOR edgeA2 = XMVectorReplicate(tri.edgeA[2]);
+		XMVECTOR depthA = XMVectorReplicate(tri.depthA);
+
+		for (int py = minY; py <= maxY; py++)
+		{
+			float centerY = py + 0.5f;
+			XMVECTOR row0 = XMVectorReplicate(tri.edgeB[0] * centerY + tri.edgeC[0]);
+			XMVECTOR row1 = XMVectorReplicate(tri.edgeB[1] * centerY + tri.edgeC[1]);
+			XMVECTOR row2 = XMVectorReplicate(tri.edgeB[2] * centerY + tri.edgeC[2]);
+			XMVECTOR rowDepth = XMVectorReplicate(tri.depthB * centerY + tri.depthC);
+			float* row = depth + py * width;
+
+			for (int px = minX; px <= maxX; px += 4)
+			{
+				XMVECTOR centerX = offsets + XMVectorReplicate((float)px);
+				XMVECTOR inside = XMVectorAndInt(XMVectorAndInt(
+					XMVectorGreaterOrEqual(edgeA0 * centerX + row0, zero),
+					XMVectorGreaterOrEqual(edgeA1 * centerX + row1, zero)),
+					XMVectorGreaterOrEqual(edgeA2 * centerX + row2, zero));
+
+				XMVECTOR z = depthA * centerX + rowDepth;
+				XMVECTOR current = XMLoadFloat4((const XMFLOAT4*)(row + px));
+				XMVECTOR nearer = XMVectorAndInt(inside, XMVectorLess(z, current));
+				XMStoreFloat4((XMFLOAT4*)(row + px), XMVectorSelect(current, z, nearer));
+			}
+		}
+	}
+}
+
+void OcclusionCuller::BuildPyramid()
+{
+	for (size_t level = 1; level < levels.size(); level++)
+	{
+		const float* below = levels[level - 1].data();
+		unsigned int belowWidth = levelWidths[level - 1];
+		unsigned int belowHeight = levelHeights[level - 1];
+		float* texels = levels[level].data();
+
+		// The furthest of the (up to) four texels under each one - odd sizes
+		// leave the last row or column with only one below it
+		for (unsigned int y = 0; y < levelHeights[level]; y++)
+		{
+			unsigned int y0 = y * 2;
+			unsigned int y1 = (std::min)(y0 + 1, belowHeight - 1);
+			for (unsigned int x = 0; x < levelWidths[level]; x++)
+			{
+				unsigned int x0 = x * 2;
+				unsigned int x1 = (std::min)(x0 + 1, belowWidth - 1);
+				float furthest = (std::max)(
+					(std::max)(below[y0 * belowWidth + x0], below[y0 * belowWidth + x1]),
+					(std::max)(below[y1 * belowWidth + x0], below[y1 * belowWidth + x1]));
+				texels[y * levelWidths[level] + x] = furthest;
+			}
+		}
+	}
+}
+
+bool OcclusionCuller::IsVisible(const Aabb& box)
+{
+	// The eight corners to clip space, four at a time - the bottom four
+	// then the top four, each lane one corner
+	const XMFLOAT4X4& m = viewProjection;
+	XMVECTOR cornerX = XMVectorSet(box.minCorner.x, box.maxCorner.x, box.minCorner.x, box.maxCorner.x);
+	XMVECTOR cornerZ = XMVectorSet(box.minCorner.z, box.minCorner.z, box.maxCorner.z, box.maxCorner.z);
+	XMVECTOR partX = cornerX * XMVectorReplicate(m._11) + cornerZ * XMVectorReplicate(m._31) + XMVectorReplicate(m._41);
+	XMVECTOR partY = cornerX * XMVectorReplicate(m._12) + cornerZ * XMVectorReplicate(m._32) + XMVectorReplicate(m._42);
+	XMVECTOR partZ = cornerX * XMVectorReplicate(m._13) + cornerZ * XMVectorReplicate(m._33) + XMVectorReplicate(m._43);
+	XMVECTOR partW = cornerX * XMVectorReplicate(m._14) + cornerZ * XMVectorReplicate(m._34) + XMVectorReplicate(m._44);
+
+	// Screen x, y and depth, as the nearest and furthest of each lane
+	XMVECTOR lowX = XMVectorReplicate(FLT_MAX), lowY = lowX, lowDepth = lowX;
+	XMVECTOR highX = XMVectorReplicate(-FLT_MAX), highY = highX;
+	const XMVECTOR half = XMVectorReplicate(0.5f);
+	float heights[2] = { box.minCorner.y, box.maxCorner.y };
+	for (unsigned int h = 0; h < 2; h++)
+	{
+		XMVECTOR cornerY = XMVectorReplicate(heights[h]);
+		XMVECTOR clipX = partX + cornerY * XMVectorReplicate(m._21);
+		XMVECTOR clipY = partY + cornerY * XMVectorReplicate(m._22);
+		XMVECTOR clipZ = partZ + cornerY * XMVectorReplicate(m._23);
+		XMVECTOR clipW = partW + cornerY * XMVectorReplicate(m._24);
+
+		// A corner in front of the near plane means the box reaches past
+		// the camera, and there's no sensible rectangle to test
+		uint32_t nearCut[4];
+		XMStoreInt4(nearCut, XMVectorLess(clipZ, XMVectorZero()));
+		if (nearCut[0] | nearCut[1] | nearCut[2] | nearCut[3])
+			return true;
+
+		XMVECTOR invW = XMVectorReciprocal(clipW);
+		XMVECTOR screenX = (clipX * invW * half + half) * XMVectorReplicate((float)width);
+		XMVECTOR screenY = (half - clipY * invW * half) * XMVectorReplicate((float)height);
+		lowX = XMVectorMin(lowX, screenX);
+		lowY = XMVectorMin(lowY, screenY);
+		highX = XMVectorMax(highX, screenX);
+		highY = XMVectorMax(highY, screenY);
+		lowDepth = XMVectorMin(lowDepth, clipZ * invW);
+	}
+
+	XMFLOAT4A lanes[5];
+	XMStoreFloat4A(&lanes[0], lowX);
+	XMStoreFloat4A(&lanes[1], lowY);
+	XMStoreFloat4A(&lanes[2], lowDepth);
+	XMStoreFloat4A(&lanes[3], highX);
+	XMStoreFloat4A(&lanes[4], highY);
+	XMFLOAT3 low, high;
+	low.x = (std::min)((std::min)(lanes[0].x, lanes[0].y), (std::min)(lanes[0].z, lanes[0].w));
+	low.y = (std::min)((std::min)(lanes[1].x, lanes[1].y), (std::min)(lanes[1].z, lanes[1].w));
+	low.z = (std::min)((std::min)(lanes[2].x, lanes[2].y), (std::min)(lanes[2].z, lanes[2].w));
+	high.x = (std::max)((std::max)(lanes[3].x, lanes[3].y), (std::max)(lanes[3].z, lanes[3].w));
+	high.y = (std::max)((std::max)(lanes[4].x, lanes[4].y), (std::max)(lanes[4].z, lanes[4].w));
+	if (high.x < 0.0f || high.y < 0.0f || low.x >= width || low.y >= height)
+		return false;
+
+	// Every pixel the rectangle touches, even a little
+	int minX = (int)(std::max)(floorf(low.x), 0.0f);
+	int minY = (int)(std::max)(floorf(low.y), 0.0f);
+	int maxX = (int)(std::min)(floorf(high.x), width - 1.0f);
+	int maxY = (int)(std::min)(floorf(high.y), height - 1.0f);
+
+	// Up the pyramid until the rectangle is at most 2x2 texels, then
+	// it's hidden if its nearest point is past the furthest in all of them
+	unsigned int level = 0;
+	while ((maxX >> level) - (minX >> level) > 1 || (maxY >> level) - (minY >> level) > 1)
+		level++;
+	const float* texels = levels[level].data();
+	unsigned int levelWidth = levelWidths[level];
+	for (int y = minY >> level; y <= (maxY >> level); y++)
+		for (int x = minX >> level; x <= (maxX >> level); x++)
+			if (low.z <= texels[y * levelWidth + x])
+				return true;
+	return false;
+}
+
+unsigned int OcclusionCuller::Cull(const Aabb* boxes, const unsigned int* indices, unsigned int count, std::vector<unsigned int>& visible)
+{
+	visible.resize(count);
+	unsigned int visibleCount = 0;
+	for (unsigned int n = 0; n < count; n++)
+	{
+		visible[visibleCount] = indices[n];
+		visibleCount += IsVisible(boxes[indices[n]]);
+	}
+	visible.resize(visibleCount);
+	return visibleCount;
+}
+
+unsigned int OcclusionCuller::GetWidth() { return width; }
+unsigned int OcclusionCuller::GetHeight() { return height; }
+unsigned int OcclusionCuller::GetThreadCount() { return (unsigned int)workers.size() + 1; }
+unsigned int OcclusionCuller::GetTriangleCount() { return (unsigned int)triangles.size(); }
+const float* OcclusionCuller::GetDepth() { return levels[0].data(); }
+
+void OcclusionCuller::BuildDepthImage(std::vector<unsigned char>& image)
+{
+	std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n65535\n";
+	image.assign(header.begin(), header.end());
+	image.reserve(header.size() + width * height * 2);
+
+	//pgm samples are big endian
+	for (float d : levels[0])
+	{
+		unsigned int sample = (unsigned int)((std::min)((std::max)(d, 0.0f), 1.0f) * 65535.0f + 0.5f);
+		image.push_back((unsigned char)(sample >> 8));
+		image.push_back((unsigned char)(sample & 0xFF));
+	}
+}
@@ -0,0 +1,109 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// Software occlusion culling
+//
+// A small depth buffer drawn on the cpu from a few chosen
+// occluders (big solid things, like the booth's roof and
+// walls), then used to throw away anything whose box is
+// completely behind them before it's drawn.
+//
+// Each frame:
+// - BeginFrame with the camera's view * projection
+// - AddOccluder for each occluder - its triangles are moved to
+//   the screen, clipped against the near plane and sorted into
+//   the tiles they touch
+// - Rasterize draws every tile, spread over worker threads,
+//   four pixels at a time. Then each level of a max-depth
+//   pyramid is built from the one below it, so any box on
+//   screen can be checked against a 2x2 block of one level
+// - IsVisible / Cull test boxes against the pyramid
+//
+// Depth is D3D's, 0 at the near plane to 1 at the far one.
+// Each tile is only ever drawn by one thread, in the order
+// its triangles were added, so the result doesn't depend on
+// the thread count - BuildDepthImage gives the same bytes
+// every time for the same input.
+//
+// Occluders are sampled at pixel centers, so an edge can
+// cover up to half a pixel more than the real thing does.
+// At this resolution that only matters for slivers.
+// --------------------------------------------------------
+class OcclusionCuller
+{
+public:
+	//width must be a multiple of tileWidth, height of tileHeight, tileWidth of 4 - threadCount counts the one calling Rasterize, 0 for one per core
+	OcclusionCuller(unsigned int width = 256, unsigned int height = 128, unsigned int tileWidth = 64, unsigned int tileHeight = 32, unsigned int threadCount = 0);
+	~OcclusionCuller();
+
+	//clears everything from the last frame - viewProjection takes world space points to clip space
+	void BeginFrame(const DirectX::XMFLOAT4X4& viewProjection);
+	//local space triangles and the world matrix they're drawn with - clockwise triangles face the camera, like the gpu draws them
+	void AddOccluder(const DirectX::XMFLOAT3* positions, const unsigned int* indices, unsigned int indexCount, const DirectX::XMFLOAT4X4& worldMatrix);
+	//the 12 triangles of a local space box - only for things that fill their box, or it'll hide what's behind the gaps
+	void AddOccluderBox(const Aabb& localBox, const DirectX::XMFLOAT4X4& worldMatrix);
+	//draws the occluders and builds the max-depth pyramid
+	void Rasterize();
+
+	//false only when the whole world space box is behind the occluders (or off screen)
+	bool IsVisible(const Aabb& box);
+	//like FrustumCuller::Cull - fills visible with every index out of indices[0, count) whose box is visible, in order
+	unsigned int Cull(const Aabb* boxes, const unsigned int* indices, unsigned int count, std::vector<unsigned int>& visible);
+
+	unsigned int GetWidth();
+	unsigned int GetHeight();
+	unsigned int GetThreadCount();
+	unsigned int GetTriangleCount();	// occluder triangles on screen this frame, after clipping
+	//the full resolution depth buffer, rows top to bottom
+	const float* GetDepth();
+	//the depth buffer as a binary 16 bit pgm file, 65535 being the far plane
+	void BuildDepthImage(std::vector<unsigned char>& image);
+
+private:
+	// A triangle in screen space (pixels, y down) set up for drawing
+	struct ScreenTriangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];	// edge functions ax + by + c, all >= 0 inside
+		float depthA, depthB, depthC;		// depth = ax + by + c across it
+		int minX, minY, maxX, maxY;			// pixels it could touch, clamped to the screen
+	};
+
+	unsigned int width;
+	unsigned int height;
+	unsigned int tileWidth;
+	unsigned int tileHeight;
+	unsigned int tilesX;
+	unsigned int tilesY;
+	DirectX::XMFLOAT4X4 viewProjection;
+
+	std::vector<ScreenTriangle> triangles;
+	std::vector<std::vector<unsigned int>> bins;	// by tile, the triangles that touch it
+	std::vector<std::vector<float>> levels;			// levels[0] is the depth buffer, each one after that is the max of 2x2 of the last
+	std::vector<unsigned int> levelWidths;
+	std::vector<unsigned int> levelHeights;
+	std::vector<DirectX::XMFLOAT4> clipped;			// scratch, kept so AddOccluder doesn't allocate
+
+	// Workers wait for a frame, then take tiles until there aren't any left
+	std::vector<std::thread> workers;
+	std::mutex mutex;
+	std::condition_variable frameStarted;
+	std::condition_variable frameFinished;
+	unsigned int frame;
+	unsigned int workersBusy;
+	std::atomic<unsigned int> nextTile;
+	bool stopping;
+
+	void WorkerLoop();
+	void DrawTiles();
+	void DrawTile(unsigned int tile);
+	//a clip space triangle that's already in front of the near plane
+	void AddTriangle(const DirectX::XMFLOAT4& a, const DirectX::XMFLOAT4& b, const DirectX::XMFLOAT4& c);
+	void BuildPyramid();
+};
@@ -0,0 +1,114 @@
+#pragma once
+#include <vector>
+#include <utility>
+#include <cstdio>
+#include <cassert>
+
+// A reference to something in a ResourcePool
+// - generation 0 is never handed out, so a zeroed handle means "nothing"
+template<typename T>
+struct Handle
+{
+	unsigned int index = 0;
+	unsigned int generation = 0;
+
+	bool IsValid() const { return generation != 0; }
+	bool operator==(const Handle& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const Handle& other) const { return !(*this == other); }
+};
+
+// --------------------------------------------------------
+// Resource pool
+//
+// Keeps every T of one type side by side in a vector and
+// hands out handles to them instead of pointers. Getting
+// one back is an index into the vector, no refcounts.
+//
+// Each slot has a generation that goes up when its item is
+// removed, so a handle kept past that no longer matches and
+// debug builds catch it instead of reading whatever moved
+// in. Removed slots are reused by later Adds.
+//
+// References from Get last until the next Add (the vector
+// may grow) - hold handles, not references, between frames.
+// Key is what the handles are typed on, for pools that keep
+// their T behind a pointer but hand out Handle<Key>s.
+// --------------------------------------------------------
+template<typename T, typename Key = T>
+class ResourcePool
+{
+public:
+	ResourcePool() : count(0) {}
+
+	Handle<Key> Add(T item)
+	{
+		Handle<Key> handle;
+		if (!freeSlots.empty())
+		{
+			//the old item is only let go of here, when something takes its place
+			handle.index = freeSlots.back();
+			freeSlots.pop_back();
+			items[handle.index] = std::move(item);
+		}
+		else
+		{
+			handle.index = (unsigned int)items.size();
+			items.push_back(std::move(item));
+			generations.push_back(1);
+		}
+		handle.generation = generations[handle.index];
+		count++;
+		return handle;
+	}
+
+	//every handle to it goes stale
+	void Remove(Handle<Key> handle)
+	{
+		if (!IsAlive(handle))
+			return;
+
+		//skip 0 if it ever wraps around, that's the invalid generation
+		if (++generations[handle.index] == 0)
+			generations[handle.index] = 1;
+		freeSlots.push_back(handle.index);
+		count--;
+	}
+
+	bool IsAlive(Handle<Key> handle) const
+	{
+		return handle.generation != 0 && handle.index < generations.size() && generations[handle.index] == handle.generation;
+	}
+
+	T& Get(Handle<Key> handle)
+	{
+#if defined(DEBUG) || defined(_DEBUG)
+		if (!IsAlive(handle))
+		{
+			printf("Stale or invalid handle (index %u, generation %u, slot is on %u)\n", handle.index, handle.generation,
+				handle.index < generations.size() ? generations[handle.index] : 0);
+			assert(false);
+		}
+#endif
+		return items[handle.index];
+	}
+
+	unsigned int GetCount() const { return count; }	// live items, not slots
+
+private:
+	std::vector<T> items;
+	std::vector<unsigned int> generations;
+	std::vector<unsigned int> freeSlots;
+	unsigned int count;
+};
+
+class Mesh;
+class Material;
+class SimpleVertexShader;
+class SimplePixelShader;
+struct TextureResource;
+
+typedef Handle<Mesh> MeshHandle;
+typedef Handle<Material> MaterialHandle;
+typedef Handle<SimpleVertexShader> VertexShaderHandle;
+typedef Handle<SimplePixelShader> PixelShaderHandle;
+typedef Handle<TextureResource> TextureHandle;
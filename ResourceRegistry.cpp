@@ -0,0 +1,86 @@
+#include "ResourceRegistry.h"
+
+MeshHandle ResourceRegistry::AddMesh(Mesh mesh)
+{
+	return meshes.Add(std::move(mesh));
+}
+
+Mesh& ResourceRegistry::GetMesh(MeshHandle handle)
+{
+	return meshes.Get(handle);
+}
+
+void ResourceRegistry::RemoveMesh(MeshHandle handle)
+{
+	//its geometry goes back to the arena now, not when the slot is reused
+	if (meshes.IsAlive(handle))
+		meshes.Get(handle).Release();
+	meshes.Remove(handle);
+}
+
+MaterialHandle ResourceRegistry::AddMaterial(Material material)
+{
+	return materials.Add(std::move(material));
+}
+
+Material& ResourceRegistry::GetMaterial(MaterialHandle handle)
+{
+	return materials.Get(handle);
+}
+
+void ResourceRegistry::RemoveMaterial(MaterialHandle handle)
+{
+	materials.Remove(handle);
+}
+
+VertexShaderHandle ResourceRegistry::AddVertexShader(std::unique_ptr<SimpleVertexShader> shader)
+{
+	return vertexShaders.Add(std::move(shader));
+}
+
+SimpleVertexShader& ResourceRegistry::GetVertexShader(VertexShaderHandle handle)
+{
+	return *vertexShaders.Get(handle);
+}
+
+PixelShaderHandle ResourceRegistry::AddPixelShader(std::unique_ptr<SimplePixelShader> shader)
+{
+	return pixelShaders.Add(std::move(shader));
+}
+
+SimplePixelShader& ResourceRegistry::GetPixelShader(PixelShaderHandle handle)
+{
+	return *pixelShaders.Get(handle);
+}
+
+TextureHandle ResourceRegistry::AddTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv)
+{
+	TextureResource texture;
+	texture.srv = srv;
+	return textures.Add(std::move(texture));
+}
+
+TextureResource& ResourceRegistry::GetTexture(TextureHandle handle)
+{
+	return textures.Get(handle);
+}
+
+void ResourceRegistry::RemoveTexture(TextureHandle handle)
+{
+	textures.Remove(handle);
+}
+
+unsigned int ResourceRegistry::GetMeshCount()
+{
+	return meshes.GetCount();
+}
+
+unsigned int ResourceRegistry::GetMaterialCount()
+{
+	return materials.GetCount();
+}
+
+unsigned int ResourceRegistry::GetTextureCount()
+{
+	return textures.GetCount();
+}
@@ -0,0 +1,64 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <memory>
+#include "ResourcePool.h"
+#include "Mesh.h"
+#include "Material.h"
+#include "SimpleShader.h"
+#include "TextureStreamer.h"
+
+// A texture slot materials point at
+// - srv is the placeholder until the real one is in, a streamed texture's srv wins once it has mips
+struct TextureResource
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	std::shared_ptr<StreamedTexture> streamed;
+
+	ID3D11ShaderResourceView* GetSRV() const { return streamed && streamed->srv ? streamed->srv.Get() : srv.Get(); }
+};
+
+// --------------------------------------------------------
+// Resource registry
+//
+// Owns the game's meshes, materials, shaders and texture
+// slots, each kind in its own ResourcePool, and hands out
+// handles to them. Entities and materials keep handles and
+// look them up here when they draw.
+//
+// Shaders are kept behind unique_ptrs - SimpleShader owns
+// raw arrays and can't be copied around the pool, but the
+// lookup is still one index and no refcount.
+// Device thread only.
+// --------------------------------------------------------
+class ResourceRegistry
+{
+public:
+	MeshHandle AddMesh(Mesh mesh);
+	Mesh& GetMesh(MeshHandle handle);
+	void RemoveMesh(MeshHandle handle);
+
+	MaterialHandle AddMaterial(Material material);
+	Material& GetMaterial(MaterialHandle handle);
+	void RemoveMaterial(MaterialHandle handle);
+
+	VertexShaderHandle AddVertexShader(std::unique_ptr<SimpleVertexShader> shader);
+	SimpleVertexShader& GetVertexShader(VertexShaderHandle handle);
+	PixelShaderHandle AddPixelShader(std::unique_ptr<SimplePixelShader> shader);
+	SimplePixelShader& GetPixelShader(PixelShaderHandle handle);
+
+	TextureHandle AddTexture(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv);
+	TextureResource& GetTexture(TextureHandle handle);
+	void RemoveTexture(TextureHandle handle);
+
+	unsigned int GetMeshCount();
+	unsigned int GetMaterialCount();
+	unsigned int GetTextureCount();
+
+private:
+	ResourcePool<Mesh> meshes;
+	ResourcePool<Material> materials;
+	ResourcePool<std::unique_ptr<SimpleVertexShader>, SimpleVertexShader> vertexShaders;
+	ResourcePool<std::unique_ptr<SimplePixelShader>, SimplePixelShader> pixelShaders;
+	ResourcePool<TextureResource> textures;
+};
@@ -18,6 +18,15 @@ struct VertexShaderInput
 	float3 tangent : TANGENT;
 
 
+};
+// Packed version of the vertex above - must match VertexCompact in VertexCompact.h
+// - The input layout turns the 16 bit snorms and halfs into floats for us
+struct VertexShaderCompactInput
+{
+	float4 localPosition : POSITION; // XYZ in -1 to 1 across the mesh bounds, W is the bitangent sign
+	float2 uv : TEXCOORD;
+	float2 normal : NORMAL; // octahedral
+	float2 tangent : TANGENT; // octahedral
 };
 struct VertexToPixelSky
 {
@@ -56,6 +65,15 @@ struct VertexToPixelNormalMapping
 
 
 };
+// Unfolds an octahedral encoded unit vector (see VertexCompactCodec::EncodeOctahedral)
+float3 DecodeOctahedral(float2 f)
+{
+	float3 n = float3(f.x, f.y, 1.0f - abs(f.x) - abs(f.y));
+	float t = saturate(-n.z);
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return normalize(n);
+}
 struct Light
 {
 	int Type; // Which kind of light?  0, 1 or 2 (see above) 
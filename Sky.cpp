@@ -1,10 +1,10 @@
 #include "Sky.h"
 
-Sky::Sky(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerStateFromGame, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> cubemapSRVFromGame, std::shared_ptr<Mesh> skyMeshFromGame, std::shared_ptr<SimpleVertexShader> vertexShaderFromGame, std::shared_ptr<SimplePixelShader> pixelShaderFromGame)
+Sky::Sky(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11SamplerState> samplerStateFromGame, TextureHandle cubemapFromGame, MeshHandle skyMeshFromGame, VertexShaderHandle vertexShaderFromGame, PixelShaderHandle pixelShaderFromGame)
 {
 	//setting memeber variables 
 	samplerState = samplerStateFromGame;
-	cubemapSRV = cubemapSRVFromGame;
+	cubemap = cubemapFromGame;
 	skyMesh = skyMeshFromGame;
 	pixelShader = pixelShaderFromGame;
 	vertexShader = vertexShaderFromGame;
@@ -22,8 +22,11 @@ Sky::Sky(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3
 	device->CreateDepthStencilState(&DSState, depthBuffer.GetAddressOf());
 }
 
-void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
+void Sky::Draw(ResourceRegistry& registry, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_ptr<Camera> camera)
 {
+	SimpleVertexShader* vertexShader = &registry.GetVertexShader(this->vertexShader);
+	SimplePixelShader* pixelShader = &registry.GetPixelShader(this->pixelShader);
+
 	//set rasterizing settings
 	context->RSSetState(rasterizerState.Get());
 	//set depth settings
@@ -37,11 +40,11 @@ void Sky::Draw(Microsoft::WRL::ComPtr<ID3D11DeviceContext> context, std::shared_
 	vertexShader->SetMatrix4x4("projection", camera->GetProjectionMatrix()); // shaders cbuffer!
 	vertexShader->CopyAllBufferData();
 	//set textures in pixel shader
-	pixelShader->SetShaderResourceView("SurfaceTexture", cubemapSRV);
+	pixelShader->SetShaderResourceView("SurfaceTexture", registry.GetTexture(cubemap).GetSRV());
 	pixelShader->SetSamplerState("BasicSampler",samplerState);
 
 	//draw our mesh to screen
-	skyMesh->Draw();
+	registry.GetMesh(skyMesh).Draw();
 
 	context->RSSetState(0);
 	context->OMSetDepthStencilState(0, 0);
@@ -0,0 +1,448 @@
+#include "SpatialGrid.h"
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include <cassert>
+
+using namespace DirectX;
+
+const float SpatialGrid::DefaultCellSize = 10.0f;
+
+static bool Overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.minCorner.x <= b.maxCorner.x && a.minCorner.y <= b.maxCorner.y && a.minCorner.z <= b.maxCorner.z &&
+		a.maxCorner.x >= b.minCorner.x && a.maxCorner.y >= b.minCorner.y && a.maxCorner.z >= b.minCorner.z;
+}
+
+// -1 when the box is all the way outside one of the planes, 1 when
+// it's inside every one of them, 0 when it's across some
+static int ClassifyAgainstPlanes(const Aabb& box, const XMFLOAT4* planes, unsigned int planeCount)
+{
+	float centerX = (box.minCorner.x + box.maxCorner.x) * 0.5f;
+	float centerY = (box.minCorner.y + box.maxCorner.y) * 0.5f;
+	float centerZ = (box.minCorner.z + box.maxCorner.z) * 0.5f;
+	float extentX = (box.maxCorner.x - box.minCorner.x) * 0.5f;
+	float extentY = (box.maxCorner.y - box.minCorner.y) * 0.5f;
+	float extentZ = (box.maxCorner.z - box.minCorner.z) * 0.5f;
+	int result = 1;
+	for (unsigned int i = 0; i < planeCount; i++)
+	{
+		const XMFLOAT4& plane = planes[i];
+		float distance = plane.x * centerX + plane.y * centerY + plane.z * centerZ + plane.w;
+		float reach = fabsf(plane.x) * extentX + fabsf(plane.y) * extentY + fabsf(plane.z) * extentZ;
+		if (distance + reach < 0)
+			return -1;
+		if (distance - reach < 0)
+			result = 0;
+	}
+	return result;
+}
+
+// Where three planes meet - false if two of them are parallel
+static bool IntersectPlanes(const XMFLOAT4& a, const XMFLOAT4& b, const XMFLOAT4& c, XMFLOAT3& point)
+{
+	XMVECTOR na = XMLoadFloat4(&a);
+	XMVECTOR nb = XMLoadFloat4(&b);
+	XMVECTOR nc = XMLoadFloat4(&c);
+	XMVECTOR bc = XMVector3Cross(nb, nc);
+	float denominator = XMVectorGetX(XMVector3Dot(na, bc));
+	if (fabsf(denominator) < 1e-6f)
+		return false;
+	XMVECTOR p = (bc * -a.w + XMVector3Cross(nc, na) * -b.w + XMVector3Cross(na, nb) * -c.w) / denominator;
+	XMStoreFloat3(&point, p);
+	return true;
+}
+
+SpatialGrid::SpatialGrid(float cellSize)
+	: cellSize(cellSize), freeProxies(NullProxy), itemCount(0),
+	minCellX(0), minCellZ(0), maxCellX(-1), maxCellZ(-1), maxOverhang(0), cellsVisited(0), boxesTested(0)
+{
+}
+
+//which cell a coordinate is in, kept to a range an int can hold however far out it is
+static int ToCell(float coordinate, float cellSize)
+{
+	float cell = floorf(coordinate / cellSize);
+	return (int)(std::max)(-1e9f, (std::min)(cell, 1e9f));
+}
+
+unsigned long long SpatialGrid::Key(int x, int z)
+{
+	return ((unsigned long long)(unsigned int)x << 32) | (unsigned int)z;
+}
+
+void SpatialGrid::GetCellCoordinates(const Aabb& box, int& x, int& z)
+{
+	x = ToCell((box.minCorner.x + box.maxCorner.x) * 0.5f, cellSize);
+	z = ToCell((box.minCorner.z + box.maxCorner.z) * 0.5f, cellSize);
+}
+
+unsigned int SpatialGrid::FindCell(int x, int z)
+{
+	auto found = cellLookup.find(Key(x, z));
+	return found == cellLookup.end() ? NullProxy : found->second;
+}
+
+unsigned int SpatialGrid::FindOrAddCell(int x, int z)
+{
+	unsigned int cell = FindCell(x, z);
+	if (cell != NullProxy)
+		return cell;
+
+	cell = (unsigned int)cells.size();
+	cells.push_back(Cell());
+	cells[cell].x = x;
+	cells[cell].z = z;
+	cells[cell].boundsDirty = false;
+	cellLookup[Key(x, z)] = cell;
+
+	if (maxCellX < minCellX)
+	{
+		minCellX = maxCellX = x;
+		minCellZ = maxCellZ = z;
+	}
+	else
+	{
+		minCellX = (std::min)(minCellX, x);
+		maxCellX = (std::max)(maxCellX, x);
+		minCellZ = (std::min)(minCellZ, z);
+		maxCellZ = (std::max)(maxCellZ, z);
+	}
+	return cell;
+}
+
+void SpatialGrid::AddToCell(unsigned int cell, unsigned int proxy, const Aabb& box, unsigned int userData)
+{
+	Cell& c = cells[cell];
+	if (c.items.empty())
+		c.bounds = box;
+	else
+		c.bounds = Bounds::Merge(c.bounds, box);
+	proxies[proxy].cell = cell;
+	proxies[proxy].slot = (unsigned int)c.items.size();
+	c.items.push_back({ box, userData, proxy });
+	maxOverhang = (std::max)(maxOverhang, GetOverhang(c.x, c.z, box));
+}
+
+float SpatialGrid::GetOverhang(int x, int z, const Aabb& box)
+{
+	float cellMinX = x * cellSize;
+	float cellMinZ = z * cellSize;
+	return (std::max)((std::max)(cellMinX - box.minCorner.x, box.maxCorner.x - (cellMinX + cellSize)),
+		(std::max)(cellMinZ - box.minCorner.z, box.maxCorner.z - (cellMinZ + cellSize)));
+}
+
+void SpatialGrid::Place(unsigned int proxy, const Aabb& box, unsigned int userData)
+{
+	int x, z;
+	GetCellCoordinates(box, x, z);
+	if (GetOverhang(x, z, box) > cellSize)
+	{
+		proxies[proxy].cell = OversizedCell;
+		proxies[proxy].slot = (unsigned int)oversized.size();
+		oversized.push_back({ box, userData, proxy });
+	}
+	else
+	{
+		AddToCell(FindOrAddCell(x, z), proxy, box, userData);
+	}
+}
+
+void SpatialGrid::RemoveFromCell(unsigned int proxy)
+{
+	// The last item in the cell fills the gap
+	unsigned int cell = proxies[proxy].cell;
+	std::vector<Item>& items = cell == OversizedCell ? oversized : cells[cell].items;
+	unsigned int slot = proxies[proxy].slot;
+	if (slot != items.size() - 1)
+	{
+		items[slot] = items.back();
+		proxies[items[slot].proxy].slot = slot;
+	}
+	items.pop_back();
+	if (cell == OversizedCell)
+		return;
+
+	//the box around what's left could be smaller now
+	Cell& c = cells[cell];
+	if (!c.boundsDirty)
+	{
+		c.boundsDirty = true;
+		dirtyCells.push_back(cell);
+	}
+}
+
+unsigned int SpatialGrid::Insert(const Aabb& box, unsigned int userData)
+{
+	unsigned int proxy;
+	if (freeProxies != NullProxy)
+	{
+		proxy = freeProxies;
+		freeProxies = proxies[proxy].cell;
+	}
+	else
+	{
+		proxy = (unsigned int)proxies.size();
+		proxies.push_back(Proxy());
+	}
+
+	Place(proxy, box, userData);
+	itemCount++;
+	return proxy;
+}
+
+void SpatialGrid::Remove(unsigned int proxy)
+{
+	assert(proxy < proxies.size());
+	RemoveFromCell(proxy);
+	proxies[proxy].cell = freeProxies;
+	proxies[proxy].slot = NullProxy;
+	freeProxies = proxy;
+	itemCount--;
+}
+
+bool SpatialGrid::Move(unsigned int proxy, const Aabb& box)
+{
+	assert(proxy < proxies.size() && proxies[proxy].slot != NullProxy);
+	int x, z;
+	GetCellCoordinates(box, x, z);
+	float overhang = GetOverhang(x, z, box);
+	unsigned int cell = proxies[proxy].cell;
+	unsigned int slot = proxies[proxy].slot;
+
+	//still oversized, nothing else to keep up
+	if (cell == OversizedCell && overhang > cellSize)
+	{
+		oversized[slot].box = box;
+		return false;
+	}
+	if (cell != OversizedCell && overhang <= cellSize && cells[cell].x == x && cells[cell].z == z)
+	{
+		//same cell, bounds are redone so they follow it wherever it went
+		Cell& c = cells[cell];
+		c.items[slot].box = box;
+		maxOverhang = (std::max)(maxOverhang, overhang);
+		if (!c.boundsDirty)
+		{
+			c.boundsDirty = true;
+			dirtyCells.push_back(cell);
+		}
+		return false;
+	}
+
+	unsigned int userData = cell == OversizedCell ? oversized[slot].userData : cells[cell].items[slot].userData;
+	RemoveFromCell(proxy);
+	Place(proxy, box, userData);
+	return true;
+}
+
+void SpatialGrid::Clear()
+{
+	cells.clear();
+	cellLookup.clear();
+	oversized.clear();
+	proxies.clear();
+	dirtyCells.clear();
+	freeProxies = NullProxy;
+	itemCount = 0;
+	minCellX = minCellZ = 0;
+	maxCellX = maxCellZ = -1;
+	maxOverhang = 0;
+}
+
+void SpatialGrid::RefreshBounds()
+{
+	for (unsigned int cell : dirtyCells)
+	{
+		Cell& c = cells[cell];
+		c.boundsDirty = false;
+		if (c.items.empty())
+			continue;
+		c.bounds = c.items[0].box;
+		for (unsigned int i = 1; i < c.items.size(); i++)
+			c.bounds = Bounds::Merge(c.bounds, c.items[i].box);
+	}
+	dirtyCells.clear();
+}
+
+void SpatialGrid::QueryCellFrustum(unsigned int cell, const XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results)
+{
+	const Cell& c = cells[cell];
+	cellsVisited++;
+	if (c.items.empty())
+		return;
+	int side = ClassifyAgainstPlanes(c.bounds, planes, planeCount);
+	if (side < 0)
+		return;
+
+	//all of it's in view, no need to look at each box
+	if (side > 0)
+	{
+		for (const Item& item : c.items)
+			results.push_back(item.userData);
+		return;
+	}
+	boxesTested += (unsigned int)c.items.size();
+	for (const Item& item : c.items)
+	{
+		if (ClassifyAgainstPlanes(item.box, planes, planeCount) >= 0)
+			results.push_back(item.userData);
+	}
+}
+
+void SpatialGrid::QueryCellOverlap(unsigned int cell, const Aabb& box, std::vector<unsigned int>& results)
+{
+	const Cell& c = cells[cell];
+	cellsVisited++;
+	if (c.items.empty() || !Overlaps(c.bounds, box))
+		return;
+	boxesTested += (unsigned int)c.items.size();
+	for (const Item& item : c.items)
+	{
+		if (Overlaps(item.box, box))
+			results.push_back(item.userData);
+	}
+}
+
+void SpatialGrid::QueryFrustum(const XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results)
+{
+	results.clear();
+	cellsVisited = 0;
+	boxesTested = 0;
+	RefreshBounds();
+
+	boxesTested += (unsigned int)oversized.size();
+	for (const Item& item : oversized)
+	{
+		if (ClassifyAgainstPlanes(item.box, planes, planeCount) >= 0)
+			results.push_back(item.userData);
+	}
+	if (cells.empty())
+		return;
+
+	// The cells under the frustum are the ones between its corners on the
+	// ground. Planes come left, right, bottom, top, near, far (Camera's
+	// order), and each corner is where one of each pair meets
+	int fromX = minCellX, toX = maxCellX, fromZ = minCellZ, toZ = maxCellZ;
+	bool narrowed = planeCount == 6;
+	float lowX = FLT_MAX, highX = -FLT_MAX, lowZ = FLT_MAX, highZ = -FLT_MAX;
+	for (int corner = 0; corner < 8 && narrowed; corner++)
+	{
+		XMFLOAT3 point;
+		if (!IntersectPlanes(planes[corner & 1], planes[2 + ((corner >> 1) & 1)], planes[4 + (corner >> 2)], point))
+		{
+			narrowed = false;
+			break;
+		}
+		lowX = (std::min)(lowX, point.x);
+		highX = (std::max)(highX, point.x);
+		lowZ = (std::min)(lowZ, point.z);
+		highZ = (std::max)(highZ, point.z);
+	}
+	if (narrowed)
+	{
+		//things centered in a nearby cell can still stick out into these ones
+		lowX -= maxOverhang; highX += maxOverhang;
+		lowZ -= maxOverhang; highZ += maxOverhang;
+		fromX = (std::max)(fromX, ToCell(lowX, cellSize));
+		toX = (std::min)(toX, ToCell(highX, cellSize));
+		fromZ = (std::max)(fromZ, ToCell(lowZ, cellSize));
+		toZ = (std::min)(toZ, ToCell(highZ, cellSize));
+	}
+
+	// Looking up every coordinate only pays off while there are fewer of
+	// them than cells that actually exist
+	if (fromX > toX || fromZ > toZ)
+		return;
+	if ((unsigned long long)(toX - fromX + 1) * (toZ - fromZ + 1) < cells.size())
+	{
+		for (int z = fromZ; z <= toZ; z++)
+		{
+			for (int x = fromX; x <= toX; x++)
+			{
+				unsigned int cell = FindCell(x, z);
+				if (cell != NullProxy)
+					QueryCellFrustum(cell, planes, planeCount, results);
+			}
+		}
+	}
+	else
+	{
+		for (unsigned int cell = 0; cell < cells.size(); cell++)
+		{
+			const Cell& c = cells[cell];
+			if (c.x >= fromX && c.x <= toX && c.z >= fromZ && c.z <= toZ)
+				QueryCellFrustum(cell, planes, planeCount, results);
+		}
+	}
+}
+
+void SpatialGrid::QueryOverlap(const Aabb& box, std::vector<unsigned int>& results)
+{
+	results.clear();
+	cellsVisited = 0;
+	boxesTested = 0;
+	RefreshBounds();
+
+	boxesTested += (unsigned int)oversized.size();
+	for (const Item& item : oversized)
+	{
+		if (Overlaps(item.box, box))
+			results.push_back(item.userData);
+	}
+	if (cells.empty())
+		return;
+
+	int fromX = (std::max)(minCellX, ToCell(box.minCorner.x - maxOverhang, cellSize));
+	int toX = (std::min)(maxCellX, ToCell(box.maxCorner.x + maxOverhang, cellSize));
+	int fromZ = (std::max)(minCellZ, ToCell(box.minCorner.z - maxOverhang, cellSize));
+	int toZ = (std::min)(maxCellZ, ToCell(box.maxCorner.z + maxOverhang, cellSize));
+	if (fromX > toX || fromZ > toZ)
+		return;
+	if ((unsigned long long)(toX - fromX + 1) * (toZ - fromZ + 1) < cells.size())
+	{
+		for (int z = fromZ; z <= toZ; z++)
+		{
+			for (int x = fromX; x <= toX; x++)
+			{
+				unsigned int cell = FindCell(x, z);
+				if (cell != NullProxy)
+					QueryCellOverlap(cell, box, results);
+			}
+		}
+	}
+	else
+	{
+		for (unsigned int cell = 0; cell < cells.size(); cell++)
+		{
+			const Cell& c = cells[cell];
+			if (c.x >= fromX && c.x <= toX && c.z >= fromZ && c.z <= toZ)
+				QueryCellOverlap(cell, box, results);
+		}
+	}
+}
+
+unsigned int SpatialGrid::GetItemCount()
+{
+	return itemCount;
+}
+
+unsigned int SpatialGrid::GetCellCount()
+{
+	return (unsigned int)cells.size();
+}
+
+unsigned int SpatialGrid::GetOversizedCount()
+{
+	return (unsigned int)oversized.size();
+}
+
+unsigned int SpatialGrid::GetCellsVisited()
+{
+	return cellsVisited;
+}
+
+unsigned int SpatialGrid::GetBoxesTested()
+{
+	return boxesTested;
+}
@@ -0,0 +1,112 @@
+#pragma once
+#include <DirectXMath.h>
+#include <vector>
+#include <unordered_map>
+#include "Bounds.h"
+
+// --------------------------------------------------------
+// Loose spatial grid
+//
+// Splits the ground (x and z) into square cells, each running
+// all the way up and down, and looks cells up by their
+// coordinates in a hash map - only cells with something in
+// them exist, so the world can be any size. Made for lots of
+// small things spread evenly over flat ground, like the prop
+// field, where a tree's levels don't buy much.
+//
+// It's loose: everything goes in the one cell its center is
+// in, and each cell keeps the box around what's in it to test
+// queries against. Moving only changes cells when the center
+// crosses into another one.
+//
+// Queries have to look as far past their edges as any box
+// reaches past its cell, so one huge box (the ground) would
+// make every query look at the whole grid. Anything reaching more than a
+// cell past its own goes in a short oversized list instead,
+// which every query just tests box by box.
+//
+// Each cell keeps its items' boxes side by side in one array,
+// so a query that reaches a cell reads straight through it.
+// Frustum queries only visit the cells under the frustum.
+// --------------------------------------------------------
+class SpatialGrid
+{
+public:
+	static const unsigned int NullProxy = 0xFFFFFFFF;
+	static const float DefaultCellSize;
+
+	explicit SpatialGrid(float cellSize = DefaultCellSize);
+
+	//returns a proxy for the box, userData is what queries hand back for it
+	unsigned int Insert(const Aabb& box, unsigned int userData);
+	void Remove(unsigned int proxy);
+	//returns true if it changed cells
+	bool Move(unsigned int proxy, const Aabb& box);
+	void Clear();
+
+	// Queries - each one clears results and fills it with userData
+	//planes like FrustumCuller's, inside being ax + by + cz + d >= 0 - needs a closed frustum (near and far planes) to narrow down the cells
+	void QueryFrustum(const DirectX::XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results);
+	void QueryOverlap(const Aabb& box, std::vector<unsigned int>& results);
+
+	unsigned int GetItemCount();
+	unsigned int GetCellCount();
+	unsigned int GetOversizedCount();
+	//cells looked at and boxes tested by the last query
+	unsigned int GetCellsVisited();
+	unsigned int GetBoxesTested();
+
+private:
+	struct Item
+	{
+		Aabb box;
+		unsigned int userData;
+		unsigned int proxy;		// so moving an item within the array can fix up its proxy
+	};
+
+	struct Cell
+	{
+		int x;
+		int z;
+		Aabb bounds;			// around every box in it, can poke out past the cell
+		bool boundsDirty;		// something left, bounds could shrink - redone before the next query
+		std::vector<Item> items;
+	};
+
+	struct Proxy
+	{
+		unsigned int cell;		// OversizedCell, or the next free proxy while on the free list
+		unsigned int slot;		// in the cell's items (or oversized)
+	};
+	static const unsigned int OversizedCell = NullProxy - 1;
+
+	float cellSize;
+	std::vector<Cell> cells;
+	std::unordered_map<unsigned long long, unsigned int> cellLookup;	// packed coordinates -> cells index
+	std::vector<Item> oversized;
+	std::vector<Proxy> proxies;
+	unsigned int freeProxies;
+	unsigned int itemCount;
+	//every cell there's ever been is within these
+	int minCellX, minCellZ, maxCellX, maxCellZ;
+	float maxOverhang;		// furthest any box in a cell has reached past it, never more than cellSize
+	std::vector<unsigned int> dirtyCells;
+	unsigned int cellsVisited;
+	unsigned int boxesTested;
+
+	static unsigned long long Key(int x, int z);
+	void GetCellCoordinates(const Aabb& box, int& x, int& z);
+	unsigned int FindOrAddCell(int x, int z);
+	//cells index or NullProxy
+	unsigned int FindCell(int x, int z);
+	//how far a box reaches past the cell at x, z
+	float GetOverhang(int x, int z, const Aabb& box);
+	//puts it in the cell its center is in, or the oversized list
+	void Place(unsigned int proxy, const Aabb& box, unsigned int userData);
+	void AddToCell(unsigned int cell, unsigned int proxy, const Aabb& box, unsigned int userData);
+	void RemoveFromCell(unsigned int proxy);
+	void RefreshBounds();
+	//tests a cell against the planes, then its boxes unless it's all inside
+	void QueryCellFrustum(unsigned int cell, const DirectX::XMFLOAT4* planes, unsigned int planeCount, std::vector<unsigned int>& results);
+	void QueryCellOverlap(unsigned int cell, const Aabb& box, std::vector<unsigned int>& results);
+};
@@ -0,0 +1,320 @@
+#include "TangentGenerator.h"
+#include <vector>
+#include <thread>
+#include <cmath>
+
+using namespace DirectX;
+
+//don't bother splitting meshes smaller than this across threads
+static const unsigned int MinimumTrianglesPerThread = 16384;
+
+//triangles whose uvs cover less than this (twice the signed area) have no usable uv direction
+static const float DegenerateUVArea = 1e-12f;
+
+//tangents shorter than this after removing the normal part get the fallback instead
+static const float MinimumTangentLength = 1e-12f;
+
+// Some tangent that is perpendicular to the normal, for vertices
+// whose triangles didn't give them one
+static XMFLOAT3 FallbackTangent(const XMFLOAT3& normal)
+{
+	XMVECTOR n = XMLoadFloat3(&normal);
+	XMVECTOR axis = fabsf(normal.x) < 0.9f ? XMVectorSet(1, 0, 0, 0) : XMVectorSet(0, 1, 0, 0);
+	XMVECTOR tangent = axis - n * XMVector3Dot(n, axis);
+
+	XMFLOAT3 result(1, 0, 0);
+	if (XMVectorGetX(XMVector3LengthSq(tangent)) > MinimumTangentLength)
+		XMStoreFloat3(&result, XMVector3Normalize(tangent));
+	return result;
+}
+
+// The tangent direction of one triangle (not normalized, so bigger
+// triangles count for more), zero if its uvs are degenerate
+static inline void TriangleTangent(const Vertex& v1, const Vertex& v2, const Vertex& v3, float& tx, float& ty, float& tz)
+{
+	float x1 = v2.Position.x - v1.Position.x;
+	float y1 = v2.Position.y - v1.Position.y;
+	float z1 = v2.Position.z - v1.Position.z;
+
+	float x2 = v3.Position.x - v1.Position.x;
+	float y2 = v3.Position.y - v1.Position.y;
+	float z2 = v3.Position.z - v1.Position.z;
+
+	float s1 = v2.UV.x - v1.UV.x;
+	float t1 = v2.UV.y - v1.UV.y;
+
+	float s2 = v3.UV.x - v1.UV.x;
+	float t2 = v3.UV.y - v1.UV.y;
+
+	// 1 / 0 would be infinite and poison every vertex it touches,
+	// and the > test is false for NaN uvs too
+	float det = s1 * t2 - s2 * t1;
+	float r = 0;
+	if (fabsf(det) > DegenerateUVArea)
+		r = 1.0f / det;
+
+	tx = (t2 * x1 - t1 * x2) * r;
+	ty = (t2 * y1 - t1 * y2) * r;
+	tz = (t2 * z1 - t1 * z2) * r;
+}
+
+// Adds the tangents of triangles [firstTriangle, endTriangle) into sumX/Y/Z
+static void AccumulateTriangles(const Vertex* vertices, const unsigned int* indices, unsigned int firstTriangle, unsigned int endTriangle, float* sumX, float* sumY, float* sumZ)
+{
+	const XMVECTOR degenerate = XMVectorReplicate(DegenerateUVArea);
+
+	unsigned int t = firstTriangle;
+	for (; t + 4 <= endTriangle; t += 4)
+	{
+		// Gather four triangles so each register holds one
+		// value from each of them (x of all four first corners etc.)
+		XMFLOAT4A p0x, p0y, p0z, p1x, p1y, p1z, p2x, p2y, p2z;
+		XMFLOAT4A u0, v0, u1, v1, u2, v2;
+		float* lanes[15] = { &p0x.x, &p0y.x, &p0z.x, &p1x.x, &p1y.x, &p1z.x, &p2x.x, &p2y.x, &p2z.x, &u0.x, &v0.x, &u1.x, &v1.x, &u2.x, &v2.x };
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const unsigned int* tri = indices + (t + k) * 3;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				const Vertex& v = vertices[tri[c]];
+				lanes[c * 3 + 0][k] = v.Position.x;
+				lanes[c * 3 + 1][k] = v.Position.y;
+				lanes[c * 3 + 2][k] = v.Position.z;
+				lanes[9 + c * 2 + 0][k] = v.UV.x;
+				lanes[9 + c * 2 + 1][k] = v.UV.y;
+			}
+		}
+
+		XMVECTOR x0 = XMLoadFloat4A(&p0x);
+		XMVECTOR y0 = XMLoadFloat4A(&p0y);
+		XMVECTOR z0 = XMLoadFloat4A(&p0z);
+		XMVECTOR x1 = XMLoadFloat4A(&p1x) - x0;
+		XMVECTOR y1 = XMLoadFloat4A(&p1y) - y0;
+		XMVECTOR z1 = XMLoadFloat4A(&p1z) - z0;
+		XMVECTOR x2 = XMLoadFloat4A(&p2x) - x0;
+		XMVECTOR y2 = XMLoadFloat4A(&p2y) - y0;
+		XMVECTOR z2 = XMLoadFloat4A(&p2z) - z0;
+
+		XMVECTOR uv0x = XMLoadFloat4A(&u0);
+		XMVECTOR uv0y = XMLoadFloat4A(&v0);
+		XMVECTOR s1 = XMLoadFloat4A(&u1) - uv0x;
+		XMVECTOR t1 = XMLoadFloat4A(&v1) - uv0y;
+		XMVECTOR s2 = XMLoadFloat4A(&u2) - uv0x;
+		XMVECTOR t2 = XMLoadFloat4A(&v2) - uv0y;
+
+		// Same math as TriangleTangent, the degenerate lanes get r = 0
+		XMVECTOR det = s1 * t2 - s2 * t1;
+		XMVECTOR usable = XMVectorGreater(XMVectorAbs(det), degenerate);
+		XMVECTOR r = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(det), usable);
+
+		XMFLOAT4A tx, ty, tz;
+		XMStoreFloat4A(&tx, (t2 * x1 - t1 * x2) * r);
+		XMStoreFloat4A(&ty, (t2 * y1 - t1 * y2) * r);
+		XMStoreFloat4A(&tz, (t2 * z1 - t1 * z2) * r);
+
+		// Scatter back one triangle at a time, two of the
+		// four can share a vertex so this can't be vectorized
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			const unsigned int* tri = indices + (t + k) * 3;
+			for (unsigned int c = 0; c < 3; c++)
+			{
+				sumX[tri[c]] += (&tx.x)[k];
+				sumY[tri[c]] += (&ty.x)[k];
+				sumZ[tri[c]] += (&tz.x)[k];
+			}
+		}
+	}
+
+	// Whatever doesn't fill a group of four
+	for (; t < endTriangle; t++)
+	{
+		const unsigned int* tri = indices + t * 3;
+		float tx, ty, tz;
+		TriangleTangent(vertices[tri[0]], vertices[tri[1]], vertices[tri[2]], tx, ty, tz);
+		for (unsigned int c = 0; c < 3; c++)
+		{
+			sumX[tri[c]] += tx;
+			sumY[tri[c]] += ty;
+			sumZ[tri[c]] += tz;
+		}
+	}
+}
+
+// Adds up every thread's sums for vertices [firstVertex, endVertex),
+// makes them perpendicular to the normals and stores them
+static void ResolveTangents(Vertex* vertices, unsigned int firstVertex, unsigned int endVertex, const std::vector<std::vector<float>>& sums, unsigned int threadCount)
+{
+	const XMVECTOR minimumLength = XMVectorReplicate(MinimumTangentLength);
+
+	unsigned int i = firstVertex;
+	for (; i + 4 <= endVertex; i += 4)
+	{
+		XMFLOAT4A nx, ny, nz;
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			(&nx.x)[k] = vertices[i + k].Normal.x;
+			(&ny.x)[k] = vertices[i + k].Normal.y;
+			(&nz.x)[k] = vertices[i + k].Normal.z;
+		}
+
+		// Each thread's sums are stored as x, y, z arrays
+		// back to back, so four vertices load straight in
+		XMVECTOR tx = XMVectorZero();
+		XMVECTOR ty = XMVectorZero();
+		XMVECTOR tz = XMVectorZero();
+		for (unsigned int t = 0; t < threadCount; t++)
+		{
+			const float* sum = &sums[t][0];
+			unsigned int vertexCount = (unsigned int)sums[t].size() / 3;
+			tx += XMLoadFloat4((const XMFLOAT4*)(sum + i));
+			ty += XMLoadFloat4((const XMFLOAT4*)(sum + vertexCount + i));
+			tz += XMLoadFloat4((const XMFLOAT4*)(sum + vertexCount * 2 + i));
+		}
+
+		// Gram-Schmidt, four vertices at once
+		XMVECTOR normalX = XMLoadFloat4A(&nx);
+		XMVECTOR normalY = XMLoadFloat4A(&ny);
+		XMVECTOR normalZ = XMLoadFloat4A(&nz);
+		XMVECTOR d = normalX * tx + normalY * ty + normalZ * tz;
+		tx -= normalX * d;
+		ty -= normalY * d;
+		tz -= normalZ * d;
+
+		XMVECTOR lengthSq = tx * tx + ty * ty + tz * tz;
+		XMVECTOR valid = XMVectorGreater(lengthSq, minimumLength);
+		XMVECTOR invLength = XMVectorSelect(XMVectorZero(), XMVectorReciprocal(XMVectorSqrt(lengthSq)), valid);
+
+		XMFLOAT4A outX, outY, outZ, outValid;
+		XMStoreFloat4A(&outX, tx * invLength);
+		XMStoreFloat4A(&outY, ty * invLength);
+		XMStoreFloat4A(&outZ, tz * invLength);
+		XMStoreFloat4A(&outValid, XMVectorSelect(XMVectorZero(), XMVectorSplatOne(), valid));
+
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			Vertex& v = vertices[i + k];
+			if ((&outValid.x)[k] != 0)
+				v.Tangent = XMFLOAT3((&outX.x)[k], (&outY.x)[k], (&outZ.x)[k]);
+			else
+				v.Tangent = FallbackTangent(v.Normal);
+		}
+	}
+
+	for (; i < endVertex; i++)
+	{
+		unsigned int vertexCount = (unsigned int)sums[0].size() / 3;
+		XMFLOAT3 sum(0, 0, 0);
+		for (unsigned int t = 0; t < threadCount; t++)
+		{
+			sum.x += sums[t][i];
+			sum.y += sums[t][vertexCount + i];
+			sum.z += sums[t][vertexCount * 2 + i];
+		}
+
+		XMVECTOR normal = XMLoadFloat3(&vertices[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&sum);
+		tangent = tangent - normal * XMVector3Dot(normal, tangent);
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) > MinimumTangentLength)
+			XMStoreFloat3(&vertices[i].Tangent, XMVector3Normalize(tangent));
+		else
+			vertices[i].Tangent = FallbackTangent(vertices[i].Normal);
+	}
+}
+
+unsigned int TangentGenerator::Generate(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	if (vertexCount == 0)
+		return 0;
+
+	unsigned int triangleCount = indexCount / 3;
+
+	// Decide how many threads to split the triangles across
+	unsigned int threadCount = std::thread::hardware_concurrency();
+	if (threadCount == 0) threadCount = 1;
+	if (threadCount > triangleCount / MinimumTrianglesPerThread) threadCount = triangleCount / MinimumTrianglesPerThread;
+	if (threadCount == 0) threadCount = 1;
+
+	// One set of sums per thread, laid out as all the x's,
+	// then all the y's, then all the z's
+	std::vector<std::vector<float>> sums(threadCount);
+
+	auto accumulate = [&](unsigned int t)
+	{
+		sums[t].assign(vertexCount * 3, 0.0f);
+		float* sum = &sums[t][0];
+		AccumulateTriangles(vertices, indices,
+			(unsigned int)((unsigned long long)triangleCount * t / threadCount),
+			(unsigned int)((unsigned long long)triangleCount * (t + 1) / threadCount),
+			sum, sum + vertexCount, sum + vertexCount * 2);
+	};
+
+	auto resolve = [&](unsigned int t)
+	{
+		ResolveTangents(vertices,
+			(unsigned int)((unsigned long long)vertexCount * t / threadCount),
+			(unsigned int)((unsigned long long)vertexCount * (t + 1) / threadCount),
+			sums, threadCount);
+	};
+
+	// Every thread adds its triangles into its own sums, then once
+	// they're all done each one resolves its own range of vertices -
+	// this thread takes the first part of each step itself
+	std::vector<std::thread> workers;
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(std::thread(accumulate, t));
+	accumulate(0);
+	for (auto& w : workers)
+		w.join();
+
+	workers.clear();
+	for (unsigned int t = 1; t < threadCount; t++)
+		workers.push_back(std::thread(resolve, t));
+	resolve(0);
+	for (auto& w : workers)
+		w.join();
+
+	return threadCount;
+}
+
+void TangentGenerator::GenerateReference(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount)
+{
+	// Reset tangents
+	for (unsigned int i = 0; i < vertexCount; i++)
+		vertices[i].Tangent = XMFLOAT3(0, 0, 0);
+
+	// Calculate tangents one whole triangle at a time
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		Vertex* v1 = &vertices[indices[i]];
+		Vertex* v2 = &vertices[indices[i + 1]];
+		Vertex* v3 = &vertices[indices[i + 2]];
+
+		float tx, ty, tz;
+		TriangleTangent(*v1, *v2, *v3, tx, ty, tz);
+
+		v1->Tangent.x += tx;
+		v1->Tangent.y += ty;
+		v1->Tangent.z += tz;
+
+		v2->Tangent.x += tx;
+		v2->Tangent.y += ty;
+		v2->Tangent.z += tz;
+
+		v3->Tangent.x += tx;
+		v3->Tangent.y += ty;
+		v3->Tangent.z += tz;
+	}
+
+	// Ensure all of the tangents are orthogonal to the normals
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		XMVECTOR normal = XMLoadFloat3(&vertices[i].Normal);
+		XMVECTOR tangent = XMLoadFloat3(&vertices[i].Tangent);
+		tangent = tangent - normal * XMVector3Dot(normal, tangent);
+		if (XMVectorGetX(XMVector3LengthSq(tangent)) > MinimumTangentLength)
+			XMStoreFloat3(&vertices[i].Tangent, XMVector3Normalize(tangent));
+		else
+			vertices[i].Tangent = FallbackTangent(vertices[i].Normal);
+	}
+}
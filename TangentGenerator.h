@@ -0,0 +1,25 @@
+#pragma once
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// Per vertex tangents from positions, uvs and normals
+//
+// Generate works on four triangles at a time (gathered into
+// x/y/z registers) and splits big meshes across threads.
+// Every thread adds into its own copy of the tangent sums,
+// and those copies are added together afterwards, so no two
+// threads ever write to the same vertex.
+//
+// Triangles with no uv area (stretched or zero size uvs)
+// add nothing, and any vertex left without a tangent gets
+// one that is simply perpendicular to its normal.
+// --------------------------------------------------------
+class TangentGenerator
+{
+public:
+	//fills in the Tangent of every vertex, returns how many threads it used
+	static unsigned int Generate(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+
+	//one triangle at a time on one thread - the plain version to check Generate against
+	static void GenerateReference(Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount);
+};
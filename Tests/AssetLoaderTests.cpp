@@ -0,0 +1,164 @@
+#include "TestFramework.h"
+#include "../AssetLoader.h"
+#include "../ResourceRegistry.h"
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace Microsoft::WRL;
+
+//the same per frame budget Game gives the loader
+static const float UploadMillisecondsPerFrame = 4.0f;
+
+// WARP is d3d11 running on the cpu - no window and no gpu,
+// but every resource the loader makes is real
+static bool CreateStandInDevice(ComPtr<ID3D11Device>& device, ComPtr<ID3D11DeviceContext>& context)
+{
+	return SUCCEEDED(D3D11CreateDevice(0, D3D_DRIVER_TYPE_WARP, 0, 0, 0, 0, D3D11_SDK_VERSION,
+		device.GetAddressOf(), 0, context.GetAddressOf()));
+}
+
+static std::wstring GetWideAssetPath(const char* relativePath)
+{
+	std::string path = TestRunner::GetAssetPath(relativePath);
+	return std::wstring(path.begin(), path.end());
+}
+
+//what came back for one texture request
+struct TextureResult
+{
+	bool called = false;
+	ComPtr<ID3D11ShaderResourceView> srv;
+};
+
+//requests what Game does out of the Assets tree, then runs frames until it's all in - returns false if anything's missing
+static bool LoadAssets(ComPtr<ID3D11Device> device, ComPtr<ID3D11DeviceContext> context, double& firstFrameMs, double& totalMs, double& loadMs, unsigned int& threads)
+{
+	ResourceRegistry registry;
+	AssetLoader loader(registry, device, context);
+	threads = loader.GetThreadCount();
+	TestTimer timer;
+
+	// The models, processed the way Game asks for them
+	MeshOptions compactOptions;
+	compactOptions.compactVertices = true;
+	compactOptions.lodRatios = { 0.5f, 0.25f, 0.125f };
+	compactOptions.buildMeshlets = true;
+	MeshOptions propOptions;
+	propOptions.buildMeshlets = true;
+	std::vector<MeshHandle> meshes;
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/sphere.obj"), compactOptions));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/torus.obj"), propOptions));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/cube.obj"), compactOptions));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/cylinder.obj"), propOptions));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/helix.obj"), propOptions));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/quad.obj")));
+	meshes.push_back(loader.LoadMesh(TestRunner::GetAssetPath("Models/cube.obj")));
+
+	// The textures, each toon one asked for twice like Game's albedo and
+	// normal map slots - the second has to share the first's load
+	const char* toonTextures[] = { "GrassTexture", "RockTexture", "RockTextureTwo", "GroundTexture", "CactusTexture", "WoodTexture" };
+	std::vector<std::shared_ptr<TextureResult>> textures;
+	auto loadTexture = [&](const std::wstring& filename, TextureKind kind)
+	{
+		std::shared_ptr<TextureResult> result = std::make_shared<TextureResult>();
+		textures.push_back(result);
+		loader.LoadTexture(filename, kind, [result](ComPtr<ID3D11ShaderResourceView> srv)
+		{
+			result->called = true;
+			result->srv = srv;
+		});
+	};
+	loadTexture(GetWideAssetPath("Textures/RampTexture.png"), TextureKind::Image);
+	for (const char* name : toonTextures)
+	{
+		std::string file = std::string("Textures/Toon/") + name + ".png";
+		loadTexture(GetWideAssetPath(file.c_str()), TextureKind::Color);
+		loadTexture(GetWideAssetPath(file.c_str()), TextureKind::Color);
+	}
+
+	// The first frame only gets its upload budget, whatever has loaded by then
+	loader.Update(UploadMillisecondsPerFrame);
+	firstFrameMs = timer.GetMilliseconds();
+
+	loader.Finish();
+	totalMs = timer.GetMilliseconds();
+	loadMs = loader.GetLoadSeconds() * 1000.0;
+
+	bool allLoaded = loader.IsIdle() && loader.GetPendingCount() == 0;
+	for (MeshHandle mesh : meshes)
+		allLoaded = allLoaded && registry.GetMesh(mesh).IsReady();
+
+	// Every callback runs once the load's done - a texture that failed
+	// to decode keeps its placeholder, so those are only counted
+	unsigned int loadedTextures = 0;
+	for (const std::shared_ptr<TextureResult>& texture : textures)
+	{
+		allLoaded = allLoaded && texture->called;
+		loadedTextures += texture->srv ? 1 : 0;
+	}
+	TextureCache& textureCache = loader.GetTextureCache();
+	printf("    %u meshes, %u of %u textures made, %u of %u texture requests hit the cache\n",
+		(unsigned int)meshes.size(), loadedTextures, (unsigned int)textures.size(), textureCache.GetHitCount(), textureCache.GetRequestCount());
+	allLoaded = allLoaded && textureCache.GetHitCount() >= (unsigned int)(sizeof(toonTextures) / sizeof(toonTextures[0]));
+	return allLoaded;
+}
+
+TEST(AssetLoaderLoadsAssetsHeadless)
+{
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	REQUIRE(CreateStandInDevice(device, context));
+
+	// The first run builds whatever caches and imports aren't there yet,
+	// the second finds them all - the usual start up after the first
+	const char* runs[] = { "first run", "cached" };
+	for (const char* run : runs)
+	{
+		double firstFrameMs = 0;
+		double totalMs = 0;
+		double loadMs = 0;
+		unsigned int threads = 0;
+		CHECK(LoadAssets(device, context, firstFrameMs, totalMs, loadMs, threads));
+		printf("    %s: first frame %.2f ms, everything loaded %.2f ms (%.2f ms of loading on %u threads)\n",
+			run, firstFrameMs, totalMs, loadMs, threads);
+		CHECK(firstFrameMs <= totalMs);
+		CHECK(loadMs <= totalMs);
+	}
+}
+
+TEST(AssetLoaderStreamingStaysOutOfLoading)
+{
+	ComPtr<ID3D11Device> device;
+	ComPtr<ID3D11DeviceContext> context;
+	REQUIRE(CreateStandInDevice(device, context));
+	ResourceRegistry registry;
+	AssetLoader loader(registry, device, context);
+
+	std::wstring filename = GetWideAssetPath("Textures/Toon/GrassTexture.png");
+	std::shared_ptr<StreamedTexture> texture = loader.LoadStreamedTexture(filename, TextureKind::Color);
+	loader.Finish();
+	REQUIRE(loader.IsIdle());
+	REQUIRE(texture->residency != (unsigned int)-1);
+	double loadSeconds = loader.GetLoadSeconds();
+
+	// Asking for the full texture streams in its finer mips on the
+	// same workers - which isn't loading as far as anyone watching
+	// the loader's concerned, and mustn't restart its timer
+	TextureStreamer& streamer = loader.GetTextureStreamer();
+	streamer.SetBudget(64 << 20);
+	streamer.BeginFrame();
+	streamer.RequestMip(*texture, 0);
+	loader.StreamTextures();
+	CHECK(streamer.GetResidency().GetLoadCount() > 0);
+	CHECK(loader.IsIdle());
+	CHECK(loader.GetPendingCount() == 0);
+
+	loader.Finish();
+	CHECK(streamer.GetResidency().GetLoadCount() == 0);
+	CHECK(streamer.GetStreamedLevels() > 0);
+	CHECK(loader.Update(UploadMillisecondsPerFrame) == 0);
+	CHECK(loader.GetLoadSeconds() == loadSeconds);
+	loader.ReleaseStreamedTexture(filename, TextureKind::Color);
+}
@@ -0,0 +1,369 @@
+#include "TestFramework.h"
+#include "../DynamicAabbTree.h"
+#include "../FrustumCuller.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+static Aabb MakeBox(float x, float y, float z, float extent)
+{
+	Aabb box;
+	box.minCorner = XMFLOAT3(x - extent, y - extent, z - extent);
+	box.maxCorner = XMFLOAT3(x + extent, y + extent, z + extent);
+	return box;
+}
+
+static Aabb RandomBox(std::mt19937& random, float spread)
+{
+	std::uniform_real_distribution<float> any(-1, 1);
+	float x = any(random) * spread, y = any(random) * 5, z = any(random) * spread;
+	return MakeBox(x, y, z, 0.3f + fabsf(any(random)) * 1.5f);
+}
+
+static bool Overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.minCorner.x <= b.maxCorner.x && a.minCorner.y <= b.maxCorner.y && a.minCorner.z <= b.maxCorner.z &&
+		a.maxCorner.x >= b.minCorner.x && a.maxCorner.y >= b.minCorner.y && a.maxCorner.z >= b.minCorner.z;
+}
+
+//slab test, one box at a time - distance is where the ray goes in (0 if it starts inside)
+static bool RayHits(const XMFLOAT3& origin, const XMFLOAT3& direction, const Aabb& box, float maxDistance, float& distance)
+{
+	const float* o = &origin.x;
+	const float* d = &direction.x;
+	const float* low = &box.minCorner.x;
+	const float* high = &box.maxCorner.x;
+	float enter = 0;
+	float exit = maxDistance;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (d[axis] == 0)
+		{
+			if (o[axis] < low[axis] || o[axis] > high[axis])
+				return false;
+			continue;
+		}
+		float t0 = (low[axis] - o[axis]) / d[axis];
+		float t1 = (high[axis] - o[axis]) / d[axis];
+		enter = (std::max)(enter, (std::min)(t0, t1));
+		exit = (std::min)(exit, (std::max)(t0, t1));
+		if (enter > exit)
+			return false;
+	}
+	distance = enter;
+	return true;
+}
+
+TEST(TreeMatchesBruteForce)
+{
+	// Boxes going in, drifting, jumping and coming out, with every kind
+	// of query checked against looking at all of them after each round
+	std::mt19937 random(31);
+	std::uniform_real_distribution<float> any(-1, 1);
+	const float spread = 100;
+	DynamicAabbTree tree;
+	std::vector<Aabb> boxes;
+	std::vector<unsigned int> proxies;
+	std::vector<bool> alive;
+	std::vector<unsigned int> results, expected, live;
+
+	for (int round = 0; round < 30; round++)
+	{
+		for (int i = 0; i < 200; i++)
+		{
+			boxes.push_back(RandomBox(random, spread));
+			proxies.push_back(tree.Insert(boxes.back(), (unsigned int)boxes.size() - 1));
+			alive.push_back(true);
+		}
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (!alive[i])
+				continue;
+			unsigned int what = random() % 10;
+			if (what < 4)
+			{
+				float dx = any(random) * 0.05f;
+				float dz = any(random) * 0.05f;
+				boxes[i].minCorner.x += dx;
+				boxes[i].maxCorner.x += dx;
+				boxes[i].minCorner.z += dz;
+				boxes[i].maxCorner.z += dz;
+				tree.Move(proxies[i], boxes[i]);
+			}
+			else if (what < 5)
+			{
+				boxes[i] = RandomBox(random, spread);
+				tree.Move(proxies[i], boxes[i]);
+			}
+			else if (what < 6 && random() % 4 == 0)
+			{
+				tree.Remove(proxies[i]);
+				alive[i] = false;
+			}
+		}
+		REQUIRE(tree.Validate());
+
+		live.clear();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (alive[i])
+			{
+				live.push_back((unsigned int)i);
+				CHECK(tree.GetUserData(proxies[i]) == i);
+			}
+		}
+		CHECK(tree.GetLeafCount() == live.size());
+
+		// Frustum - exactly what culling every box gives
+		XMFLOAT3 eye(any(random) * 20, any(random) * 5, any(random) * 20);
+		XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&eye), XMMatrixRotationRollPitchYaw(any(random) * 0.5f, any(random) * 3.1f, 0).r[2], XMVectorSet(0, 1, 0, 0));
+		XMFLOAT4 planes[FrustumCuller::PlaneCount];
+		FrustumCuller::ExtractPlanes(view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f), planes);
+		FrustumCuller::CullReference(&boxes[0], &live[0], (unsigned int)live.size(), planes, FrustumCuller::PlaneCount, expected);
+		tree.QueryFrustum(planes, FrustumCuller::PlaneCount, results);
+		std::sort(results.begin(), results.end());
+		CHECK(results == expected);
+
+		// Overlap, some of the query boxes long and thin
+		for (int q = 0; q < 20; q++)
+		{
+			Aabb query = RandomBox(random, spread);
+			query.maxCorner.x += fabsf(any(random)) * 20;
+			expected.clear();
+			for (unsigned int i : live)
+			{
+				if (Overlaps(boxes[i], query))
+					expected.push_back(i);
+			}
+			tree.QueryOverlap(query, results);
+			std::sort(results.begin(), results.end());
+			CHECK(results == expected);
+		}
+
+		// Rays, some flat along an axis and some that stop short
+		for (int q = 0; q < 50; q++)
+		{
+			XMFLOAT3 origin(any(random) * spread, any(random) * 10, any(random) * spread);
+			XMFLOAT3 direction(any(random), any(random) * 0.2f, any(random));
+			if (q % 10 == 0)
+				direction.y = 0;
+			float maxDistance = q % 3 ? 1e30f : 30.0f;
+
+			expected.clear();
+			float nearest = maxDistance;
+			bool anyHit = false;
+			for (unsigned int i : live)
+			{
+				float distance;
+				if (RayHits(origin, direction, boxes[i], maxDistance, distance))
+				{
+					expected.push_back(i);
+					nearest = (std::min)(nearest, distance);
+					anyHit = true;
+				}
+			}
+			tree.QueryRay(origin, direction, maxDistance, results);
+			std::sort(results.begin(), results.end());
+			CHECK(results == expected);
+
+			unsigned int hit = 0;
+			float hitDistance = 0;
+			bool found = tree.RayCast(origin, direction, maxDistance, hit, hitDistance);
+			CHECK(found == anyHit);
+			if (found && anyHit)
+			{
+				CHECK(fabsf(hitDistance - nearest) <= 1e-5f * (std::max)(1.0f, nearest));
+				CHECK(alive[hit]);
+			}
+		}
+	}
+	printf("    %u leaves, height %u\n", tree.GetLeafCount(), tree.GetHeight());
+}
+
+TEST(TreeMovesInsideTheMarginForFree)
+{
+	DynamicAabbTree tree(0.5f);
+	Aabb box = MakeBox(0, 0, 0, 1);
+	unsigned int proxy = tree.Insert(box, 3);
+	Aabb fat = tree.GetFatBox(proxy);
+	CHECK(fat.minCorner.x < box.minCorner.x && fat.maxCorner.z > box.maxCorner.z);
+
+	// A little drift stays in the fattened box, but queries see where it really is
+	CHECK(!tree.Move(proxy, MakeBox(0.2f, 0, 0, 1)));
+	std::vector<unsigned int> results;
+	tree.QueryOverlap(MakeBox(-1.1f, 0, 0, 0.05f), results);
+	CHECK(results.empty());
+	tree.QueryOverlap(MakeBox(1.15f, 0, 0, 0.05f), results);
+	CHECK(results.size() == 1 && results[0] == 3);
+
+	// Out of it the tree has to change
+	CHECK(tree.Move(proxy, MakeBox(10, 0, 0, 1)));
+	CHECK(tree.Validate());
+	tree.QueryOverlap(MakeBox(10, 0, 0, 0.1f), results);
+	CHECK(results.size() == 1);
+}
+
+TEST(TreeStaysBalanced)
+{
+	// Sorted inserts would make a list out of a tree that never rotates
+	DynamicAabbTree tree;
+	const unsigned int count = 4096;
+	std::vector<unsigned int> proxies;
+	for (unsigned int i = 0; i < count; i++)
+		proxies.push_back(tree.Insert(MakeBox((float)i * 3, 0, 0, 1), i));
+	REQUIRE(tree.Validate());
+	CHECK(tree.GetNodeCount() == count * 2 - 1);
+	CHECK(tree.GetHeight() <= 2 * 12 + 2);
+
+	// Taking every other one out keeps it balanced, and the nodes go back
+	for (unsigned int i = 0; i < count; i += 2)
+		tree.Remove(proxies[i]);
+	REQUIRE(tree.Validate());
+	CHECK(tree.GetLeafCount() == count / 2);
+	CHECK(tree.GetNodeCount() == count - 1);
+	CHECK(tree.GetHeight() <= 2 * 11 + 2);
+}
+
+TEST(TreeEmptyAndSingle)
+{
+	DynamicAabbTree tree;
+	std::vector<unsigned int> results(2, 7);
+	unsigned int hit;
+	float hitDistance;
+	CHECK(tree.Validate());
+	tree.QueryOverlap(MakeBox(0, 0, 0, 100), results);
+	CHECK(results.empty());
+	CHECK(!tree.RayCast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 10, hit, hitDistance));
+
+	// One in and out again leaves nothing behind
+	unsigned int proxy = tree.Insert(MakeBox(5, 0, 0, 1), 9);
+	CHECK(tree.RayCast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 10, hit, hitDistance));
+	CHECK(hit == 9);
+	CHECK_NEAR(hitDistance, 4.0f, 1e-5f);
+	CHECK(!tree.RayCast(XMFLOAT3(0, 0, 0), XMFLOAT3(1, 0, 0), 3, hit, hitDistance));
+	tree.Remove(proxy);
+	CHECK(tree.Validate());
+	CHECK(tree.GetNodeCount() == 0);
+	CHECK(tree.GetLeafCount() == 0);
+}
+
+TEST(TreeBenchmark)
+{
+	// What each operation costs the tree, against looking at every box:
+	// building it, a frame of a tenth of them drifting, and frustum,
+	// overlap and ray queries
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	const unsigned int queries = 200;
+	std::mt19937 random(32);
+	std::uniform_real_distribution<float> any(-1, 1);
+	for (unsigned int count : counts)
+	{
+		//about the same number of boxes per area at every size
+		float spread = 100.0f * sqrtf(count / 1000.0f);
+		std::vector<Aabb> boxes(count);
+		std::vector<unsigned int> all(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			boxes[i] = RandomBox(random, spread);
+			all[i] = i;
+		}
+
+		DynamicAabbTree tree;
+		std::vector<unsigned int> proxies(count);
+		TestTimer insertTimer;
+		for (unsigned int i = 0; i < count; i++)
+			proxies[i] = tree.Insert(boxes[i], i);
+		double insertNs = insertTimer.GetMilliseconds() * 1e6 / count;
+
+		TestTimer moveTimer;
+		unsigned int moves = 0;
+		for (int frame = 0; frame < 10; frame++)
+		{
+			for (unsigned int i = frame; i < count; i += 10)
+			{
+				float dx = any(random) * 0.3f;
+				boxes[i].minCorner.x += dx;
+				boxes[i].maxCorner.x += dx;
+				tree.Move(proxies[i], boxes[i]);
+				moves++;
+			}
+		}
+		double moveNs = moveTimer.GetMilliseconds() * 1e6 / moves;
+
+		// Each query both ways, the answers checked against each other
+		std::vector<unsigned int> results, expected;
+		double frustumTree = 0, frustumBrute = 0, overlapTree = 0, overlapBrute = 0, rayTree = 0, rayBrute = 0;
+		unsigned int mismatches = 0;
+		for (unsigned int q = 0; q < queries; q++)
+		{
+			XMFLOAT3 eye(any(random) * spread, any(random) * 5, any(random) * spread);
+			XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&eye), XMMatrixRotationRollPitchYaw(any(random) * 0.5f, any(random) * 3.1f, 0).r[2], XMVectorSet(0, 1, 0, 0));
+			XMFLOAT4 planes[FrustumCuller::PlaneCount];
+			FrustumCuller::ExtractPlanes(view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f), planes);
+			{
+				TestTimer timer;
+				tree.QueryFrustum(planes, FrustumCuller::PlaneCount, results);
+				frustumTree += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				FrustumCuller::CullReference(&boxes[0], &all[0], count, planes, FrustumCuller::PlaneCount, expected);
+				frustumBrute += timer.GetMilliseconds();
+			}
+			std::sort(results.begin(), results.end());
+			mismatches += results != expected;
+
+			Aabb query = RandomBox(random, spread);
+			query.maxCorner.x += 5;
+			{
+				TestTimer timer;
+				tree.QueryOverlap(query, results);
+				overlapTree += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				expected.clear();
+				for (unsigned int i = 0; i < count; i++)
+				{
+					if (Overlaps(boxes[i], query))
+						expected.push_back(i);
+				}
+				overlapBrute += timer.GetMilliseconds();
+			}
+			std::sort(results.begin(), results.end());
+			mismatches += results != expected;
+
+			// Picking - the nearest box along a ray
+			XMFLOAT3 direction(any(random), any(random) * 0.1f, any(random));
+			unsigned int hit = 0;
+			float hitDistance = 0;
+			bool found;
+			{
+				TestTimer timer;
+				found = tree.RayCast(eye, direction, 1e30f, hit, hitDistance);
+				rayTree += timer.GetMilliseconds();
+			}
+			float nearest = 1e30f;
+			{
+				TestTimer timer;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					float distance;
+					if (RayHits(eye, direction, boxes[i], nearest, distance))
+						nearest = (std::min)(nearest, distance);
+				}
+				rayBrute += timer.GetMilliseconds();
+			}
+			mismatches += found != (nearest < 1e30f);
+		}
+		CHECK(mismatches == 0);
+
+		double perQuery = 1e3 / queries;
+		printf("    %6u boxes: insert %.0f ns, move %.0f ns, frustum %.1f us (%.1f brute force), overlap %.2f us (%.1f), ray %.2f us (%.1f)\n",
+			count, insertNs, moveNs, frustumTree * perQuery, frustumBrute * perQuery, overlapTree * perQuery, overlapBrute * perQuery, rayTree * perQuery, rayBrute * perQuery);
+	}
+}
@@ -0,0 +1,444 @@
+#include "TestFramework.h"
+#include "../EntityStore.h"
+#include "../Transform.h"
+#include <cstdio>
+#include <random>
+#include <map>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+//scale, then rotate, then move, the same as Transform
+static XMMATRIX MakeLocal(const XMFLOAT3& position, const XMFLOAT3& rotation, const XMFLOAT3& scale)
+{
+	return XMMatrixScaling(scale.x, scale.y, scale.z) *
+		XMMatrixRotationRollPitchYaw(rotation.x, rotation.y, rotation.z) *
+		XMMatrixTranslation(position.x, position.y, position.z);
+}
+
+//every element within tolerance, relative for the big ones
+static bool IsClose(const XMFLOAT4X4& a, FXMMATRIX expected, float tolerance)
+{
+	XMFLOAT4X4 b;
+	XMStoreFloat4x4(&b, expected);
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (fabsf(a.m[r][c] - b.m[r][c]) > tolerance * fmaxf(1.0f, fabsf(b.m[r][c])))
+				return false;
+		}
+	}
+	return true;
+}
+
+static unsigned long long Key(EntityId id)
+{
+	return ((unsigned long long)id.index << 32) | id.generation;
+}
+
+TEST(EntityIdsSurviveRemovals)
+{
+	// Lots of adds and removes against a map of what each id should hold -
+	// entities move around the arrays, but their ids still find them
+	EntityStore store;
+	std::map<unsigned long long, XMFLOAT3> expected;
+	std::vector<EntityId> live;
+	std::vector<EntityId> removed;
+	std::mt19937 random(1);
+	for (int step = 0; step < 20000; step++)
+	{
+		if (live.empty() || random() % 3)
+		{
+			EntityId id = store.Add(MeshHandle(), MaterialHandle());
+			CHECK(id.IsValid());
+			float v = (float)step;
+			store.SetPosition(id, v, v + 1, v + 2);
+			live.push_back(id);
+			expected[Key(id)] = XMFLOAT3(v, v + 1, v + 2);
+		}
+		else
+		{
+			size_t which = random() % live.size();
+			EntityId id = live[which];
+			live[which] = live.back();
+			live.pop_back();
+			store.Remove(id);
+			CHECK(!store.IsAlive(id));
+			expected.erase(Key(id));
+			removed.push_back(id);
+		}
+		if (step % 997 == 0)
+			store.UpdateWorldMatrices();
+	}
+
+	CHECK(store.GetCount() == live.size());
+	for (EntityId id : live)
+	{
+		REQUIRE(store.IsAlive(id));
+		XMFLOAT3 position = store.GetPosition(id);
+		XMFLOAT3 should = expected[Key(id)];
+		CHECK(position.x == should.x && position.y == should.y && position.z == should.z);
+		CHECK(store.GetIds()[store.GetIndex(id)] == id);
+	}
+
+	// Slots get reused, but never under an id that was handed out before
+	for (EntityId id : removed)
+		CHECK(!store.IsAlive(id));
+
+	store.UpdateWorldMatrices();
+	CHECK(store.GetDirtyCount() == 0);
+	for (EntityId id : live)
+	{
+		const XMFLOAT4X4& world = store.GetWorldMatrices()[store.GetIndex(id)];
+		XMFLOAT3 position = store.GetPosition(id);
+		CHECK(world._41 == position.x && world._42 == position.y && world._43 == position.z);
+	}
+}
+
+TEST(EntityRemoveMovesTheLastOneIn)
+{
+	EntityStore store;
+	MeshHandle mesh;
+	mesh.generation = 1;
+	EntityId a = store.Add(MeshHandle(), MaterialHandle());
+	EntityId b = store.Add(MeshHandle(), MaterialHandle());
+	EntityId c = store.Add(mesh, MaterialHandle());
+	store.SetPosition(c, 3, 0, 0);
+	store.SetScale(c, 2, 2, 2);
+	CHECK(store.GetIndex(c) == 2);
+
+	// c takes a's place, bringing everything of its own with it
+	store.Remove(a);
+	CHECK(store.GetCount() == 2);
+	CHECK(store.GetIndex(c) == 0);
+	CHECK(store.GetIndex(b) == 1);
+	CHECK(store.GetIds()[0] == c);
+	CHECK(store.GetPositions()[0].x == 3);
+	CHECK(store.GetScales()[0].y == 2);
+	CHECK(store.GetMeshes()[0] == mesh);
+
+	store.UpdateWorldMatrices();
+	CHECK(store.GetWorldMatrices()[0]._41 == 3);
+	CHECK(store.GetWorldMatrices()[0]._11 == 2);
+
+	// Removing a stale id does nothing
+	unsigned int epoch = store.GetSceneEpoch();
+	store.Remove(a);
+	CHECK(store.GetCount() == 2);
+	CHECK(store.GetSceneEpoch() == epoch);
+}
+
+TEST(EntityMatricesMatchDirectXMath)
+{
+	EntityStore store;
+	std::mt19937 random(2);
+	std::uniform_real_distribution<float> any(-10, 10);
+	std::uniform_real_distribution<float> positive(0.1f, 5);
+	std::vector<EntityId> ids;
+	for (int i = 0; i < 1000; i++)
+	{
+		EntityId id = store.Add(MeshHandle(), MaterialHandle());
+		store.SetPosition(id, any(random), any(random), any(random));
+		store.SetRotation(id, any(random), any(random), any(random));
+		store.SetScale(id, positive(random), positive(random), positive(random));
+		ids.push_back(id);
+	}
+	store.UpdateWorldMatrices();
+	CHECK(store.GetMovedCount() == 1000);
+
+	for (EntityId id : ids)
+	{
+		unsigned int index = store.GetIndex(id);
+		XMMATRIX world = MakeLocal(store.GetPosition(id), store.GetRotation(id), store.GetScale(id));
+		CHECK(IsClose(store.GetWorldMatrices()[index], world, 1e-4f));
+		CHECK(IsClose(store.GetWorldInverseTransposes()[index], XMMatrixTranspose(XMMatrixInverse(0, world)), 1e-3f));
+	}
+}
+
+TEST(EntityUpdatesOnlyWhatMoved)
+{
+	EntityStore store;
+	std::vector<EntityId> ids;
+	for (int i = 0; i < 10; i++)
+		ids.push_back(store.Add(MeshHandle(), MaterialHandle()));
+	store.UpdateWorldMatrices();
+
+	// Nothing moved, nothing redone, and moving isn't a scene change
+	store.UpdateWorldMatrices();
+	CHECK(store.GetMovedCount() == 0);
+	unsigned int epoch = store.GetSceneEpoch();
+
+	store.SetPosition(ids[3], 1, 2, 3);
+	store.SetRotation(ids[3], 0.5f, 0, 0);
+	store.SetScale(ids[7], 2, 2, 2);
+	CHECK(store.GetDirtyCount() == 2);
+	store.UpdateWorldMatrices();
+	CHECK(store.GetDirtyCount() == 0);
+	REQUIRE(store.GetMovedCount() == 2);
+	const unsigned int* moved = store.GetMovedIndices();
+	CHECK((moved[0] == store.GetIndex(ids[3]) && moved[1] == store.GetIndex(ids[7])) ||
+		(moved[1] == store.GetIndex(ids[3]) && moved[0] == store.GetIndex(ids[7])));
+	CHECK(store.GetSceneEpoch() == epoch);
+
+	// Adding, removing and changing meshes are
+	MeshHandle mesh;
+	mesh.generation = 1;
+	store.SetMesh(ids[1], mesh);
+	CHECK(store.GetSceneEpoch() != epoch);
+	epoch = store.GetSceneEpoch();
+	store.Remove(ids[2]);
+	CHECK(store.GetSceneEpoch() != epoch);
+}
+
+// --------------------------------------------------------
+// Hierarchy
+// --------------------------------------------------------
+
+//the world matrix worked out the slow way, up through every parent
+static XMMATRIX GetExpectedWorld(EntityStore& store, EntityId id)
+{
+	XMMATRIX world = MakeLocal(store.GetPosition(id), store.GetRotation(id), store.GetScale(id));
+	EntityId parent = store.GetParent(id);
+	if (store.IsAlive(parent))
+		world = world * GetExpectedWorld(store, parent);
+	return world;
+}
+
+TEST(EntityParentsAndChildren)
+{
+	EntityStore store;
+	EntityId a = store.Add(MeshHandle(), MaterialHandle());
+	EntityId b = store.Add(MeshHandle(), MaterialHandle());
+	EntityId c = store.Add(MeshHandle(), MaterialHandle());
+	EntityId d = store.Add(MeshHandle(), MaterialHandle());
+	EntityId e = store.Add(MeshHandle(), MaterialHandle());
+
+	// a > b > c, and d > e on their own
+	CHECK(store.SetParent(b, a));
+	CHECK(store.SetParent(c, b));
+	CHECK(store.SetParent(e, d));
+	CHECK(store.GetParent(c) == b);
+
+	// Nothing goes under itself or its own children
+	CHECK(!store.SetParent(a, c));
+	CHECK(!store.SetParent(a, a));
+	CHECK(store.GetParent(a) == EntityId());
+
+	store.SetPosition(a, 1, 0, 0);
+	store.SetPosition(b, 0, 2, 0);
+	store.SetPosition(c, 0, 0, 3);
+	store.SetPosition(d, 10, 0, 0);
+	store.SetPosition(e, 0, 10, 0);
+	store.UpdateWorldMatrices();
+	const XMFLOAT4X4* worlds = store.GetWorldMatrices();
+	CHECK(worlds[store.GetIndex(c)]._41 == 1 && worlds[store.GetIndex(c)]._42 == 2 && worlds[store.GetIndex(c)]._43 == 3);
+	CHECK(worlds[store.GetIndex(e)]._41 == 10 && worlds[store.GetIndex(e)]._42 == 10);
+
+	// Moving a redoes a's subtree and nothing else - marks left in the
+	// other subtree's matrices show it wasn't touched
+	XMFLOAT4X4* marked = const_cast<XMFLOAT4X4*>(worlds);
+	marked[store.GetIndex(d)]._11 = 777;
+	marked[store.GetIndex(e)]._11 = 777;
+	store.SetPosition(a, 5, 0, 0);
+	store.UpdateWorldMatrices();
+	CHECK(worlds[store.GetIndex(d)]._11 == 777 && worlds[store.GetIndex(e)]._11 == 777);
+	CHECK(worlds[store.GetIndex(c)]._41 == 5);
+	CHECK(store.GetMovedCount() == 3);
+
+	// Moving a leaf only redoes the leaf
+	marked[store.GetIndex(a)]._11 = 555;
+	store.SetPosition(c, 0, 0, 4);
+	store.UpdateWorldMatrices();
+	CHECK(worlds[store.GetIndex(a)]._11 == 555);
+	CHECK(worlds[store.GetIndex(c)]._43 == 4);
+	CHECK(store.GetMovedCount() == 1);
+
+	// Removing b leaves c on its own, its local transform is its world one now
+	store.Remove(b);
+	store.UpdateWorldMatrices();
+	worlds = store.GetWorldMatrices();
+	CHECK(store.GetParent(c) == EntityId());
+	CHECK(worlds[store.GetIndex(c)]._41 == 0 && worlds[store.GetIndex(c)]._43 == 4);
+
+	// Reparenting is a scene change, and the world follows the new parent
+	unsigned int epoch = store.GetSceneEpoch();
+	CHECK(store.SetParent(c, d));
+	CHECK(store.GetSceneEpoch() != epoch);
+	store.UpdateWorldMatrices();
+	CHECK(store.GetWorldMatrices()[store.GetIndex(c)]._41 == 10);
+
+	// And detaching goes back to the local one
+	CHECK(store.SetParent(c, EntityId()));
+	store.UpdateWorldMatrices();
+	CHECK(store.GetWorldMatrices()[store.GetIndex(c)]._41 == 0);
+}
+
+TEST(EntityHierarchyMatchesBruteForce)
+{
+	// A forest that keeps changing shape - adds under random parents,
+	// reparenting (some of it into loops, which has to be refused),
+	// removes and moves - checked against walking up every parent
+	EntityStore store;
+	std::vector<EntityId> live;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> any(-5, 5);
+	std::uniform_real_distribution<float> angle(-3, 3);
+	std::uniform_real_distribution<float> size(0.5f, 2);
+
+	auto checkAll = [&]()
+	{
+		for (EntityId id : live)
+		{
+			unsigned int index = store.GetIndex(id);
+			XMMATRIX world = GetExpectedWorld(store, id);
+			CHECK(IsClose(store.GetWorldMatrices()[index], world, 2e-3f));
+			CHECK(IsClose(store.GetWorldInverseTransposes()[index], XMMatrixTranspose(XMMatrixInverse(0, world)), 5e-3f));
+		}
+	};
+
+	for (int step = 0; step < 3000; step++)
+	{
+		unsigned int operation = random() % 10;
+		if (live.size() < 5 || operation < 3)
+		{
+			EntityId id = store.Add(MeshHandle(), MaterialHandle());
+			store.SetPosition(id, any(random), any(random), any(random));
+			store.SetRotation(id, angle(random), angle(random), angle(random));
+			store.SetScale(id, size(random), size(random), size(random));
+			live.push_back(id);
+			if (random() % 2)
+				store.SetParent(id, live[random() % live.size()]);
+		}
+		else if (operation < 5)
+		{
+			EntityId child = live[random() % live.size()];
+			EntityId parent = random() % 5 ? live[random() % live.size()] : EntityId();
+
+			// Refused exactly when the parent is the child or somewhere under it
+			bool loops = false;
+			for (EntityId above = parent; store.IsAlive(above); above = store.GetParent(above))
+				loops = loops || above == child;
+			CHECK(store.SetParent(child, parent) == !loops);
+		}
+		else if (operation < 6)
+		{
+			size_t which = random() % live.size();
+			store.Remove(live[which]);
+			live[which] = live.back();
+			live.pop_back();
+		}
+		else
+		{
+			EntityId id = live[random() % live.size()];
+			store.SetPosition(id, any(random), any(random), any(random));
+			if (random() % 2)
+				store.SetScale(id, size(random), size(random), size(random));
+		}
+
+		if (step % 7 == 0)
+		{
+			store.UpdateWorldMatrices();
+			if (step % 49 == 0)
+				checkAll();
+		}
+	}
+	store.UpdateWorldMatrices();
+	checkAll();
+
+	// No loops got through
+	for (EntityId id : live)
+	{
+		unsigned int depth = 0;
+		for (EntityId above = store.GetParent(id); store.IsAlive(above) && depth <= live.size(); above = store.GetParent(above))
+		{
+			CHECK(above != id);
+			depth++;
+		}
+		CHECK(depth <= live.size());
+	}
+}
+
+//what Game used to keep - every entity new'd on its own, its Transform caching its matrices
+struct OldEntity
+{
+	Transform transform;
+	MeshHandle mesh;
+	MaterialHandle material;
+};
+
+TEST(EntityStoreBenchmark)
+{
+	// Moving everything and reading back every world matrix, the store
+	// against the vector of pointers it replaced, from 1k up to 1M entities
+	const unsigned int counts[] = { 1000, 10000, 100000, 1000000 };
+	for (unsigned int count : counts)
+	{
+		EntityStore store;
+		store.Reserve(count);
+		std::vector<EntityId> ids;
+		std::vector<OldEntity*> oldEntities;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			ids.push_back(store.Add(MeshHandle(), MaterialHandle()));
+			oldEntities.push_back(new OldEntity());
+		}
+
+		//about as much work at every size, so the small ones aren't just timer noise
+		unsigned int rounds = (std::max)(1u, 1000000 / count);
+		double storeUpdate = 0, oldUpdate = 0, storeIterate = 0, oldIterate = 0;
+		float storeSum = 0, oldSum = 0;
+		for (unsigned int round = 0; round < rounds; round++)
+		{
+			float t = (float)round;
+			{
+				TestTimer timer;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					store.SetPosition(ids[i], (float)i, t, 0);
+					store.SetRotation(ids[i], t, (float)i, 0);
+				}
+				store.UpdateWorldMatrices();
+				storeUpdate += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				for (unsigned int i = 0; i < count; i++)
+				{
+					Transform& transform = oldEntities[i]->transform;
+					transform.SetPosition((float)i, t, 0);
+					transform.SetRotation(t, (float)i, 0);
+					transform.GetWorldInverseTranspose();
+				}
+				oldUpdate += timer.GetMilliseconds();
+			}
+
+			// Just the y of every position, out of the world matrices
+			{
+				TestTimer timer;
+				const XMFLOAT4X4* worlds = store.GetWorldMatrices();
+				float sum = 0;
+				for (unsigned int i = 0; i < store.GetCount(); i++)
+					sum += worlds[i]._42;
+				storeSum = sum;
+				storeIterate += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				float sum = 0;
+				for (OldEntity* entity : oldEntities)
+					sum += entity->transform.BuildMatrix()._42;
+				oldSum = sum;
+				oldIterate += timer.GetMilliseconds();
+			}
+		}
+		CHECK_NEAR(storeSum, oldSum, 1e-3f * fabsf(oldSum));
+
+		double perEntity = 1e6 / ((double)count * rounds);
+		printf("    %7u entities: update %6.1f ns (was %6.1f), iterate %5.2f ns (was %5.2f) per entity\n",
+			count, storeUpdate * perEntity, oldUpdate * perEntity, storeIterate * perEntity, oldIterate * perEntity);
+		for (OldEntity* entity : oldEntities)
+			delete entity;
+	}
+}
@@ -0,0 +1,193 @@
+#include "TestFramework.h"
+#include "../FrustumCuller.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+//view * projection the way Camera builds them
+static XMMATRIX MakeViewProjection(const XMFLOAT3& position, float pitch, float yaw)
+{
+	XMMATRIX view = XMMatrixLookToLH(XMLoadFloat3(&position),
+		XMMatrixRotationRollPitchYaw(pitch, yaw, 0).r[2],
+		XMVectorSet(0, 1, 0, 0));
+	return view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f);
+}
+
+//clip space test with some room at the edges - anything this says is on screen really is
+static bool IsOnScreen(const XMFLOAT3& point, FXMMATRIX viewProjection)
+{
+	XMFLOAT4 clip;
+	XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(point.x, point.y, point.z, 1), viewProjection));
+	return clip.w > 1e-3f &&
+		fabsf(clip.x) < clip.w * 0.999f && fabsf(clip.y) < clip.w * 0.999f &&
+		clip.z > clip.w * 0.001f && clip.z < clip.w * 0.999f;
+}
+
+TEST(FrustumPlanesMatchClipSpace)
+{
+	// Inside every plane has to mean inside the clip volume - apart from
+	// right on a plane, where float precision decides (and the far
+	// plane, where depth precision is worst)
+	std::mt19937 random(21);
+	std::uniform_real_distribution<float> any(-1, 1);
+	for (int view = 0; view < 50; view++)
+	{
+		XMFLOAT3 eye(any(random) * 10, any(random) * 10, any(random) * 10);
+		XMMATRIX viewProjection = MakeViewProjection(eye, any(random) * 1.5f, any(random) * 3.1f);
+		XMFLOAT4 planes[FrustumCuller::PlaneCount];
+		FrustumCuller::ExtractPlanes(viewProjection, planes);
+		for (const XMFLOAT4& plane : planes)
+			CHECK_NEAR(sqrtf(plane.x * plane.x + plane.y * plane.y + plane.z * plane.z), 1.0f, 1e-4f);
+
+		for (int i = 0; i < 2000; i++)
+		{
+			XMFLOAT3 point(eye.x + any(random) * 120, eye.y + any(random) * 120, eye.z + any(random) * 120);
+			XMFLOAT4 clip;
+			XMStoreFloat4(&clip, XMVector4Transform(XMVectorSet(point.x, point.y, point.z, 1), viewProjection));
+			bool inClip = clip.w > 0 && fabsf(clip.x) <= clip.w && fabsf(clip.y) <= clip.w && clip.z >= 0 && clip.z <= clip.w;
+
+			float nearest = 1e30f;
+			unsigned int nearestPlane = 0;
+			for (unsigned int p = 0; p < FrustumCuller::PlaneCount; p++)
+			{
+				float distance = planes[p].x * point.x + planes[p].y * point.y + planes[p].z * point.z + planes[p].w;
+				if (distance < nearest)
+				{
+					nearest = distance;
+					nearestPlane = p;
+				}
+			}
+			bool inPlanes = nearest >= 0;
+			CHECK(inClip == inPlanes || fabsf(nearest) < (nearestPlane == 5 ? 0.2f : 1e-3f));
+		}
+	}
+}
+
+TEST(FrustumCullMatchesBruteForce)
+{
+	// Four at a time has to give exactly what one at a time does, and
+	// neither can cull a box with a corner or its center on screen
+	std::mt19937 random(22);
+	std::uniform_real_distribution<float> any(-1, 1);
+	for (int view = 0; view < 50; view++)
+	{
+		XMFLOAT3 eye(any(random) * 10, any(random) * 10, any(random) * 10);
+		XMMATRIX viewProjection = MakeViewProjection(eye, any(random) * 1.5f, any(random) * 3.1f);
+		XMFLOAT4 planes[FrustumCuller::PlaneCount];
+		FrustumCuller::ExtractPlanes(viewProjection, planes);
+
+		//not a multiple of four, some big boxes, and only some of them asked about
+		const unsigned int count = 2003;
+		std::vector<Aabb> boxes(count);
+		std::vector<unsigned int> indices;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			XMFLOAT3 center(eye.x + any(random) * 110, eye.y + any(random) * 110, eye.z + any(random) * 110);
+			float extent = fabsf(any(random)) * (i % 7 == 0 ? 30 : 3);
+			boxes[i].minCorner = XMFLOAT3(center.x - extent, center.y - extent * 0.5f, center.z - extent * 0.3f);
+			boxes[i].maxCorner = XMFLOAT3(center.x + extent, center.y + extent * 0.5f, center.z + extent * 0.3f);
+			if (i % 3)
+				indices.push_back(i);
+		}
+
+		std::vector<unsigned int> visible, reference;
+		unsigned int visibleCount = FrustumCuller::Cull(&boxes[0], &indices[0], (unsigned int)indices.size(), planes, FrustumCuller::PlaneCount, visible);
+		FrustumCuller::CullReference(&boxes[0], &indices[0], (unsigned int)indices.size(), planes, FrustumCuller::PlaneCount, reference);
+		CHECK(visibleCount == visible.size());
+		CHECK(visible == reference);
+
+		std::vector<bool> isVisible(count, false);
+		for (unsigned int i : visible)
+			isVisible[i] = true;
+		for (unsigned int i : indices)
+		{
+			if (isVisible[i])
+				continue;
+			const Aabb& box = boxes[i];
+			for (int corner = 0; corner < 8; corner++)
+			{
+				XMFLOAT3 point(
+					corner & 1 ? box.maxCorner.x : box.minCorner.x,
+					corner & 2 ? box.maxCorner.y : box.minCorner.y,
+					corner & 4 ? box.maxCorner.z : box.minCorner.z);
+				CHECK(!IsOnScreen(point, viewProjection));
+			}
+			XMFLOAT3 center((box.minCorner.x + box.maxCorner.x) / 2, (box.minCorner.y + box.maxCorner.y) / 2, (box.minCorner.z + box.maxCorner.z) / 2);
+			CHECK(!IsOnScreen(center, viewProjection));
+		}
+	}
+}
+
+TEST(FrustumCullEdgeCases)
+{
+	XMFLOAT4 planes[FrustumCuller::PlaneCount];
+	FrustumCuller::ExtractPlanes(MakeViewProjection(XMFLOAT3(0, 0, 0), 0, 0), planes);
+
+	// Nothing in, nothing out - whatever was in the list before
+	std::vector<unsigned int> visible(3, 9);
+	CHECK(FrustumCuller::Cull(nullptr, nullptr, 0, planes, FrustumCuller::PlaneCount, visible) == 0);
+	CHECK(visible.empty());
+
+	// A partial group doesn't let its repeated spare lanes through
+	Aabb boxes[3];
+	boxes[0].minCorner = XMFLOAT3(-1, -1, 5);	boxes[0].maxCorner = XMFLOAT3(1, 1, 6);		// ahead
+	boxes[1].minCorner = XMFLOAT3(-1, -1, -6);	boxes[1].maxCorner = XMFLOAT3(1, 1, -5);	// behind
+	boxes[2].minCorner = XMFLOAT3(-1, -1, 200);	boxes[2].maxCorner = XMFLOAT3(1, 1, 201);	// past the far plane
+	unsigned int indices[] = { 1, 0, 2 };
+	CHECK(FrustumCuller::Cull(boxes, indices, 3, planes, FrustumCuller::PlaneCount, visible) == 1);
+	CHECK(visible.size() == 1 && visible[0] == 0);
+
+	// One straddling a plane stays
+	Aabb straddling;
+	straddling.minCorner = XMFLOAT3(-1, -1, -1);
+	straddling.maxCorner = XMFLOAT3(1, 1, 1);
+	CHECK(!FrustumCuller::IsOutsidePlanes(straddling, planes, FrustumCuller::PlaneCount));
+}
+
+TEST(FrustumCullBenchmark)
+{
+	// Props scattered over the ground around a camera looking along it,
+	// out to the far plane, four at a time against one at a time
+	const unsigned int counts[] = { 1000, 10000, 100000, 1000000 };
+	std::mt19937 random(23);
+	std::uniform_real_distribution<float> any(-1, 1);
+	XMFLOAT4 planes[FrustumCuller::PlaneCount];
+	FrustumCuller::ExtractPlanes(MakeViewProjection(XMFLOAT3(0, 2, 0), 0.1f, 0.7f), planes);
+	for (unsigned int count : counts)
+	{
+		std::vector<Aabb> boxes(count);
+		std::vector<unsigned int> indices(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			float x = any(random) * 100, z = any(random) * 100;
+			float extent = 0.2f + fabsf(any(random));
+			boxes[i].minCorner = XMFLOAT3(x - extent, 0, z - extent);
+			boxes[i].maxCorner = XMFLOAT3(x + extent, extent * 2, z + extent);
+			indices[i] = i;
+		}
+
+		//best of a few, about as much work at every size
+		unsigned int rounds = (std::max)(1u, 1000000 / count);
+		std::vector<unsigned int> visible, reference;
+		double culled = 1e6, referenceCulled = 1e6;
+		for (int run = 0; run < 3; run++)
+		{
+			TestTimer timer;
+			for (unsigned int round = 0; round < rounds; round++)
+				FrustumCuller::Cull(&boxes[0], &indices[0], count, planes, FrustumCuller::PlaneCount, visible);
+			culled = (std::min)(culled, timer.GetMilliseconds() * 1e6 / ((double)count * rounds));
+
+			TestTimer referenceTimer;
+			for (unsigned int round = 0; round < rounds; round++)
+				FrustumCuller::CullReference(&boxes[0], &indices[0], count, planes, FrustumCuller::PlaneCount, reference);
+			referenceCulled = (std::min)(referenceCulled, referenceTimer.GetMilliseconds() * 1e6 / ((double)count * rounds));
+		}
+		CHECK(visible == reference);
+		printf("    %7u boxes, %5.1f%% visible: %5.2f ns each, %5.2f one at a time (%.1fx)\n",
+			count, 100.0 * visible.size() / count, culled, referenceCulled, referenceCulled / culled);
+	}
+}
@@ -0,0 +1,165 @@
+#include "TestFramework.h"
+#include "../GeometryArena.h"
+#include <random>
+#include <vector>
+#include <algorithm>
+
+TEST(RangeAllocatorHandsOutRangesInOrder)
+{
+	RangeAllocator allocator(100);
+	CHECK(allocator.GetCapacity() == 100);
+	CHECK(allocator.GetUsed() == 0);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+
+	CHECK(allocator.Allocate(10) == 0);
+	CHECK(allocator.Allocate(20) == 10);
+	CHECK(allocator.Allocate(70) == 30);
+	CHECK(allocator.GetUsed() == 100);
+	CHECK(allocator.GetFreeRangeCount() == 0);
+
+	// Full, and nothing ever fits a size of 0
+	CHECK(allocator.Allocate(1) == RangeAllocator::InvalidOffset);
+	CHECK(allocator.Allocate(0) == RangeAllocator::InvalidOffset);
+}
+
+TEST(RangeAllocatorTakesTheBestFit)
+{
+	RangeAllocator allocator(100);
+	unsigned int a = allocator.Allocate(30);
+	allocator.Allocate(10);
+	unsigned int c = allocator.Allocate(10);
+	allocator.Allocate(5);
+	allocator.Allocate(45);
+
+	// Free ranges of 30 and 10 with something between them
+	allocator.Free(a, 30);
+	allocator.Free(c, 10);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.GetLargestFreeRange() == 30);
+
+	// 8 goes in the 10, leaving the 30 for something big
+	CHECK(allocator.Allocate(8) == c);
+	CHECK(allocator.Allocate(25) == a);
+	CHECK(allocator.Allocate(6) == RangeAllocator::InvalidOffset);
+}
+
+TEST(RangeAllocatorCoalesces)
+{
+	RangeAllocator allocator(40);
+	unsigned int a = allocator.Allocate(10);
+	unsigned int b = allocator.Allocate(10);
+	unsigned int c = allocator.Allocate(10);
+	unsigned int d = allocator.Allocate(10);
+
+	// Neither neighbour free, so each stays on its own
+	allocator.Free(a, 10);
+	allocator.Free(c, 10);
+	CHECK(allocator.GetFreeRangeCount() == 2);
+	CHECK(allocator.GetFragmentation() > 0.0f);
+
+	// b joins the ranges on both sides into one
+	allocator.Free(b, 10);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.GetLargestFreeRange() == 30);
+	CHECK(allocator.GetFragmentation() == 0.0f);
+
+	allocator.Free(d, 10);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.GetLargestFreeRange() == 40);
+	CHECK(allocator.GetUsed() == 0);
+}
+
+TEST(RangeAllocatorGrowKeepsRanges)
+{
+	RangeAllocator allocator(20);
+	CHECK(allocator.Allocate(15) == 0);
+	CHECK(allocator.Allocate(10) == RangeAllocator::InvalidOffset);
+
+	// The 5 at the end merges with the new space
+	allocator.Grow(40);
+	CHECK(allocator.GetCapacity() == 40);
+	CHECK(allocator.GetUsed() == 15);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.GetLargestFreeRange() == 25);
+	CHECK(allocator.Allocate(25) == 15);
+
+	// Shrinking isn't a thing
+	allocator.Grow(10);
+	CHECK(allocator.GetCapacity() == 40);
+}
+
+TEST(RangeAllocatorMatchesReference)
+{
+	// Random allocations and frees against a plain array of which
+	// units are taken - ranges never overlap, and freeing
+	// everything always gets back one range the whole size
+	const unsigned int capacity = 4096;
+	RangeAllocator allocator(capacity);
+	std::vector<bool> taken(capacity, false);
+	struct Range { unsigned int offset; unsigned int size; };
+	std::vector<Range> live;
+	std::mt19937 random(7);
+	unsigned int used = 0;
+
+	for (int step = 0; step < 20000; step++)
+	{
+		if (live.empty() || random() % 5 < 3)
+		{
+			unsigned int size = 1 + random() % 64;
+			unsigned int offset = allocator.Allocate(size);
+			if (offset == RangeAllocator::InvalidOffset)
+			{
+				CHECK(allocator.GetLargestFreeRange() < size);
+				continue;
+			}
+			REQUIRE(offset + size <= capacity);
+			for (unsigned int i = offset; i < offset + size; i++)
+			{
+				REQUIRE(!taken[i]);
+				taken[i] = true;
+			}
+			live.push_back({ offset, size });
+			used += size;
+		}
+		else
+		{
+			unsigned int which = random() % live.size();
+			Range range = live[which];
+			live[which] = live.back();
+			live.pop_back();
+			allocator.Free(range.offset, range.size);
+			for (unsigned int i = range.offset; i < range.offset + range.size; i++)
+				taken[i] = false;
+			used -= range.size;
+		}
+		CHECK(allocator.GetUsed() == used);
+
+		// Every run of free units in the reference is exactly one free range
+		if (step % 500 == 0)
+		{
+			unsigned int runs = 0;
+			unsigned int largest = 0;
+			for (unsigned int i = 0; i < capacity;)
+			{
+				if (taken[i])
+				{
+					i++;
+					continue;
+				}
+				unsigned int start = i;
+				while (i < capacity && !taken[i])
+					i++;
+				runs++;
+				largest = (std::max)(largest, i - start);
+			}
+			CHECK(allocator.GetFreeRangeCount() == runs);
+			CHECK(allocator.GetLargestFreeRange() == largest);
+		}
+	}
+
+	for (const Range& range : live)
+		allocator.Free(range.offset, range.size);
+	CHECK(allocator.GetUsed() == 0);
+	CHECK(allocator.GetFreeRangeCount() == 1);
+	CHECK(allocator.GetLargestFreeRange() == capacity);
+}
@@ -0,0 +1,179 @@
+#include "TestFramework.h"
+#include "../Mesh.h"
+#include "../MeshCache.h"
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+
+//the same arrays, bit for bit
+template <typename T>
+static bool SameBytes(const T* a, const T* b, size_t count)
+{
+	return count == 0 || memcmp(a, b, count * sizeof(T)) == 0;
+}
+
+//builds the model (which writes its cache), then loads it again and checks the cache gave back exactly what was built
+static void CheckCacheRoundTrip(const char* model, const MeshOptions& options)
+{
+	std::string path = TestRunner::GetAssetPath((std::string("Models/") + model).c_str());
+
+	MeshData built;
+	REQUIRE(Mesh::BuildData(path.c_str(), options, built));
+	REQUIRE(!built.cache);
+
+	MeshData loaded;
+	REQUIRE(Mesh::LoadData(path.c_str(), options, loaded));
+	REQUIRE(loaded.cache);
+	CHECK(loaded.vertices.empty());
+	CHECK(loaded.indices.empty());
+
+	REQUIRE(loaded.GetVertexCount() == built.GetVertexCount());
+	REQUIRE(loaded.GetIndexCount() == built.GetIndexCount());
+	CHECK(SameBytes(loaded.GetVertices(), built.GetVertices(), built.GetVertexCount()));
+	CHECK(SameBytes(loaded.GetIndices(), built.GetIndices(), built.GetIndexCount()));
+
+	REQUIRE(loaded.lods.size() == built.lods.size());
+	CHECK(SameBytes(loaded.lods.data(), built.lods.data(), built.lods.size()));
+	CHECK(SameBytes(&loaded.bounds, &built.bounds, 1));
+
+	REQUIRE(loaded.meshlets.meshlets.size() == built.meshlets.meshlets.size());
+	CHECK(SameBytes(loaded.meshlets.meshlets.data(), built.meshlets.meshlets.data(), built.meshlets.meshlets.size()));
+	CHECK(loaded.meshlets.vertices == built.meshlets.vertices);
+	CHECK(loaded.meshlets.triangles == built.meshlets.triangles);
+}
+
+TEST(MeshCacheMatchesBuild)
+{
+	MeshOptions options;
+	options.buildMeshlets = true;
+	options.lodRatios = { 0.5f, 0.25f };
+	const char* models[] = { "helix.obj", "torus.obj", "sphere.obj" };
+	for (const char* model : models)
+	{
+		CheckCacheRoundTrip(model, options);
+
+		MeshData loaded;
+		REQUIRE(Mesh::LoadData(TestRunner::GetAssetPath((std::string("Models/") + model).c_str()).c_str(), options, loaded));
+		CHECK(loaded.meshlets.meshlets.size() > 0);
+		CHECK(loaded.lods.size() > 1);
+	}
+}
+
+TEST(MeshCacheMatchesUnprocessedBuild)
+{
+	// Nothing optional, so a different cache file with no meshlets in it
+	MeshOptions options;
+	options.optimizeVertexCache = false;
+	options.optimizeOverdraw = false;
+	CheckCacheRoundTrip("cube.obj", options);
+}
+
+// --------------------------------------------------------
+// Keeping the cache honest - a file that no longer matches
+// its source or has been damaged must be turned down, so the
+// model gets built from the obj again instead
+// --------------------------------------------------------
+
+//a copy of a model to change and break caches for, deleted with its cache when it goes out of scope
+struct ScratchModel
+{
+	std::string path;
+	unsigned long long flags;
+	~ScratchModel()
+	{
+		std::remove(MeshCache::GetCachePath(path.c_str(), flags).c_str());
+		std::remove(path.c_str());
+	}
+};
+
+static bool CopyModel(const std::string& from, const std::string& to, const char* extra)
+{
+	std::ifstream in(from, std::ios::binary);
+	std::ofstream out(to, std::ios::binary);
+	if (!in.is_open() || !out.is_open())
+		return false;
+	out << in.rdbuf() << extra;
+	return out.good();
+}
+
+//true if the cache opened, the same as LoadData deciding whether to use it
+static bool CacheOpens(const ScratchModel& model)
+{
+	MeshCache cache;
+	return cache.Open(model.path.c_str(), model.flags);
+}
+
+TEST(MeshCacheRejectsStaleFiles)
+{
+	MeshOptions options;
+	ScratchModel model = { TestRunner::GetAssetPath("Models/MeshCacheScratch.obj"), Mesh::GetProcessingFlags(options) };
+	std::string source = TestRunner::GetAssetPath("Models/cube.obj");
+	REQUIRE(CopyModel(source, model.path, ""));
+
+	MeshData data;
+	REQUIRE(Mesh::BuildData(model.path.c_str(), options, data));
+	CHECK(CacheOpens(model));
+
+	// Processed another way is a different file, which doesn't exist yet
+	MeshOptions other = options;
+	other.optimizeOverdraw = !other.optimizeOverdraw;
+	MeshCache cache;
+	CHECK(!cache.Open(model.path.c_str(), Mesh::GetProcessingFlags(other)));
+
+	// Written again with the same contents still matches - by the stamp, or failing that the hash
+	REQUIRE(CopyModel(source, model.path, ""));
+	CHECK(CacheOpens(model));
+
+	// Any change to the source is out of date, until it's built again
+	REQUIRE(CopyModel(source, model.path, "# changed\n"));
+	CHECK(!CacheOpens(model));
+	REQUIRE(Mesh::LoadData(model.path.c_str(), options, data));
+	CHECK(!data.cache);
+	CHECK(CacheOpens(model));
+}
+
+TEST(MeshCacheRejectsDamagedFiles)
+{
+	MeshOptions options;
+	ScratchModel model = { TestRunner::GetAssetPath("Models/MeshCacheScratch.obj"), Mesh::GetProcessingFlags(options) };
+	REQUIRE(CopyModel(TestRunner::GetAssetPath("Models/cube.obj"), model.path, ""));
+	MeshData data;
+	REQUIRE(Mesh::BuildData(model.path.c_str(), options, data));
+	std::string cachePath = MeshCache::GetCachePath(model.path.c_str(), model.flags);
+
+	MeshCacheHeader header;
+	{
+		std::ifstream file(cachePath, std::ios::binary);
+		REQUIRE(file.read((char*)&header, sizeof(header)));
+	}
+
+	// An index past the end of the vertices, with every count still adding up
+	{
+		std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+		file.seekp(sizeof(MeshCacheHeader) + (std::streamoff)header.vertexCount * sizeof(Vertex));
+		unsigned int bad = header.vertexCount;
+		REQUIRE(file.write((const char*)&bad, sizeof(bad)));
+	}
+	CHECK(!CacheOpens(model));
+
+	// Cut short
+	REQUIRE(Mesh::BuildData(model.path.c_str(), options, data));
+	CHECK(CacheOpens(model));
+	{
+		std::ifstream in(cachePath, std::ios::binary);
+		std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+		in.close();
+		std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+		out.write(bytes.data(), bytes.size() - 4);
+	}
+	CHECK(!CacheOpens(model));
+
+	// Not one of ours at all
+	{
+		std::ofstream out(cachePath, std::ios::binary | std::ios::trunc);
+		std::string junk(sizeof(MeshCacheHeader) + 64, 'x');
+		out.write(junk.data(), junk.size());
+	}
+	CHECK(!CacheOpens(model));
+}
@@ -0,0 +1,101 @@
+#include "TestFramework.h"
+#include "TestMeshes.h"
+#include "../MeshOptimizer.h"
+#include <cstdio>
+
+TEST(VertexCacheOrderLowersAcmr)
+{
+	// A scrambled grid is about as bad as it gets (close to 3 misses
+	// a triangle), in a good order it should be near the 0.5 ideal
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	TestMeshes::MakeGrid(64, true, vertices, indices);
+
+	VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+	VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+	printf("    shuffled grid: ACMR %.3f -> %.3f, ATVR %.3f -> %.3f\n", before.acmr, after.acmr, before.atvr, after.atvr);
+
+	CHECK(before.acmr > 1.5f);
+	CHECK(after.acmr < 0.8f);
+	CHECK(after.atvr < 1.5f);
+}
+
+TEST(VertexCacheOrderOnModels)
+{
+	// The models as exported, so less to gain than the grid
+	const char* models[] = { "sphere.obj", "torus.obj", "cylinder.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+
+		VertexCacheStats before = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+		MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+		VertexCacheStats after = MeshOptimizer::AnalyzeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+		printf("    %s: ACMR %.3f -> %.3f\n", model, before.acmr, after.acmr);
+
+		CHECK(after.acmr < before.acmr);
+	}
+}
+
+TEST(VertexCacheOrderKeepsTriangles)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	REQUIRE(TestMeshes::LoadModel("torus.obj", vertices, indices));
+	std::vector<float> expected = TestMeshes::GetSortedTriangles(&vertices[0], &indices[0], (unsigned int)indices.size());
+
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+	CHECK(TestMeshes::GetSortedTriangles(&vertices[0], &indices[0], (unsigned int)indices.size()) == expected);
+
+	// Fetch order renumbers the vertices by first use and drops unused ones
+	unsigned int usedVertices = MeshOptimizer::OptimizeVertexFetch(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+	CHECK(usedVertices <= vertices.size());
+	CHECK(TestMeshes::GetSortedTriangles(&vertices[0], &indices[0], (unsigned int)indices.size()) == expected);
+
+	unsigned int nextNew = 0;
+	for (unsigned int index : indices)
+	{
+		REQUIRE(index < usedVertices);
+		REQUIRE(index <= nextNew);
+		if (index == nextNew)
+			nextNew++;
+	}
+	CHECK(nextNew == usedVertices);
+}
+
+TEST(OverdrawOrderStaysInCacheThreshold)
+{
+	// Meshes that hide parts of themselves, where the order matters
+	const char* models[] = { "torus.obj", "helix.obj", "sphere.obj", "cylinder.obj" };
+	const float thresholds[] = { 1.01f, 1.05f, 1.25f };
+	for (const char* model : models)
+	for (float threshold : thresholds)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+		unsigned int indexCount = (unsigned int)indices.size();
+		unsigned int vertexCount = (unsigned int)vertices.size();
+
+		MeshOptimizer::OptimizeVertexCache(&indices[0], indexCount, vertexCount);
+		std::vector<float> expected = TestMeshes::GetSortedTriangles(&vertices[0], &indices[0], indexCount);
+		VertexCacheStats cacheBefore = MeshOptimizer::AnalyzeVertexCache(&indices[0], indexCount, vertexCount);
+		OverdrawStats before = MeshOptimizer::AnalyzeOverdraw(&indices[0], indexCount, &vertices[0], vertexCount);
+
+		MeshOptimizer::OptimizeOverdraw(&indices[0], indexCount, &vertices[0], vertexCount, threshold);
+		VertexCacheStats cacheAfter = MeshOptimizer::AnalyzeVertexCache(&indices[0], indexCount, vertexCount);
+		OverdrawStats after = MeshOptimizer::AnalyzeOverdraw(&indices[0], indexCount, &vertices[0], vertexCount);
+		printf("    %s: overdraw %.3f -> %.3f, ACMR %.3f -> %.3f\n", model, before.overdraw, after.overdraw, cacheBefore.acmr, cacheAfter.acmr);
+
+		CHECK(TestMeshes::GetSortedTriangles(&vertices[0], &indices[0], indexCount) == expected);
+		CHECK(cacheAfter.acmr <= cacheBefore.acmr * threshold + 0.001f);
+		CHECK(after.overdraw <= before.overdraw + 0.001f);
+		//the torus and helix cover themselves from some views, with room to reorder they have to get better
+		if (threshold >= 1.05f && before.overdraw > 1.01f)
+			CHECK(after.overdraw < before.overdraw);
+		CHECK(after.pixelsCovered == before.pixelsCovered);
+	}
+}
@@ -0,0 +1,142 @@
+#include "TestFramework.h"
+#include "TestMeshes.h"
+#include "../MeshSimplifier.h"
+#include <cstdio>
+#include <cfloat>
+#include <algorithm>
+
+//every index in range and no triangle with two of the same corner
+static bool IsValid(const unsigned int* indices, unsigned int indexCount, unsigned int vertexCount)
+{
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		if (indices[i] >= vertexCount || indices[i + 1] >= vertexCount || indices[i + 2] >= vertexCount)
+			return false;
+		if (indices[i] == indices[i + 1] || indices[i + 1] == indices[i + 2] || indices[i] == indices[i + 2])
+			return false;
+	}
+	return true;
+}
+
+TEST(SimplifyHalvesModels)
+{
+	const char* models[] = { "sphere.obj", "torus.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+		unsigned int indexCount = (unsigned int)indices.size();
+
+		// Each level from the full mesh, coarser ones can only be further off
+		float lastError = 0;
+		for (float ratio : { 0.5f, 0.25f, 0.125f })
+		{
+			unsigned int target = (unsigned int)(indexCount / 3 * ratio) * 3;
+			std::vector<unsigned int> simplified(indexCount);
+			float error = -1;
+			unsigned int count = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, target, FLT_MAX, &simplified[0], &error);
+			printf("    %s: %u -> %u triangles (target %u), error %.5f\n", model, indexCount / 3, count / 3, target / 3, error);
+
+			CHECK(count % 3 == 0);
+			CHECK(count > 0);
+			CHECK(count <= indexCount);
+			CHECK(IsValid(&simplified[0], count, (unsigned int)vertices.size()));
+			CHECK(error >= lastError);
+			lastError = error;
+		}
+	}
+}
+
+TEST(SimplifyReachesTarget)
+{
+	// The sphere has no seams that lock it up, so it should get all the way there
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	REQUIRE(TestMeshes::LoadModel("sphere.obj", vertices, indices));
+	unsigned int indexCount = (unsigned int)indices.size();
+	unsigned int target = indexCount / 3 / 2 * 3;
+
+	std::vector<unsigned int> simplified(indexCount);
+	float error = 0;
+	unsigned int count = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, target, FLT_MAX, &simplified[0], &error);
+	CHECK(count <= target);
+	CHECK(count >= target - 6);
+}
+
+TEST(SimplifyStopsAtMaxError)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	REQUIRE(TestMeshes::LoadModel("torus.obj", vertices, indices));
+	unsigned int indexCount = (unsigned int)indices.size();
+
+	std::vector<unsigned int> simplified(indexCount);
+	float unlimitedError = 0;
+	unsigned int unlimited = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, 3, FLT_MAX, &simplified[0], &unlimitedError);
+
+	float maxError = unlimitedError * 0.1f;
+	float error = 0;
+	unsigned int limited = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, 3, maxError, &simplified[0], &error);
+	CHECK(error <= maxError);
+	CHECK(limited > unlimited);
+	CHECK(IsValid(&simplified[0], limited, (unsigned int)vertices.size()));
+}
+
+TEST(SimplifyFlatGridHasNoError)
+{
+	// Everything's in one plane, so collapsing inside it moves nothing
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	TestMeshes::MakeGrid(16, false, vertices, indices);
+	unsigned int indexCount = (unsigned int)indices.size();
+
+	std::vector<unsigned int> simplified(indexCount);
+	float error = 1;
+	unsigned int count = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, indexCount / 4 / 3 * 3, FLT_MAX, &simplified[0], &error);
+	CHECK(count < indexCount / 2);
+	CHECK(error < 0.0001f);
+	CHECK(IsValid(&simplified[0], count, (unsigned int)vertices.size()));
+
+	// And every triangle still faces up
+	for (unsigned int i = 0; i < count; i += 3)
+	{
+		const DirectX::XMFLOAT3& a = vertices[simplified[i]].Position;
+		const DirectX::XMFLOAT3& b = vertices[simplified[i + 1]].Position;
+		const DirectX::XMFLOAT3& c = vertices[simplified[i + 2]].Position;
+		float normalY = (b.z - a.z) * (c.x - a.x) - (b.x - a.x) * (c.z - a.z);
+		CHECK(normalY > 0);
+	}
+}
+
+TEST(SimplifyBenchmark)
+{
+	// How long each level takes from the full mesh and how far off it ends up, on every included model
+	const char* models[] = { "sphere.obj", "cube.obj", "torus.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+		unsigned int indexCount = (unsigned int)indices.size();
+		std::vector<unsigned int> simplified(indexCount);
+
+		for (float ratio : { 0.5f, 0.25f, 0.125f })
+		{
+			// Best of a few runs, the first one warms the caches
+			unsigned int target = (unsigned int)(indexCount / 3 * ratio) * 3;
+			unsigned int count = 0;
+			float error = 0;
+			double best = 0;
+			for (int run = 0; run < 5; run++)
+			{
+				TestTimer timer;
+				count = MeshSimplifier::Simplify(&vertices[0], (unsigned int)vertices.size(), &indices[0], indexCount, target, FLT_MAX, &simplified[0], &error);
+				double ms = timer.GetMilliseconds();
+				best = run == 0 ? ms : (std::min)(best, ms);
+			}
+			printf("    %-10s %5u -> %5u triangles (%.3f): %7.3f ms, error %.5f\n", model, indexCount / 3, count / 3, ratio, best, error);
+			CHECK(IsValid(&simplified[0], count, (unsigned int)vertices.size()));
+		}
+	}
+}
@@ -0,0 +1,149 @@
+#include "TestFramework.h"
+#include "TestMeshes.h"
+#include "../Meshlet.h"
+#include "../MeshOptimizer.h"
+#include <cstdio>
+#include <cmath>
+
+using namespace DirectX;
+
+//a model in vertex cache order split into meshlets, the way Mesh::ProcessMesh does it
+static bool BuildModel(const char* model, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices, MeshletData& meshlets)
+{
+	if (!TestMeshes::LoadModel(model, vertices, indices))
+		return false;
+	MeshOptimizer::OptimizeVertexCache(&indices[0], (unsigned int)indices.size(), (unsigned int)vertices.size());
+	MeshletBuilder::Build(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size(), meshlets);
+	return true;
+}
+
+TEST(MeshletsCoverTheIndexBuffer)
+{
+	const char* models[] = { "sphere.obj", "torus.obj", "cube.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MeshletData data;
+		REQUIRE(BuildModel(model, vertices, indices, data));
+		REQUIRE(!data.meshlets.empty());
+
+		// Back to back ranges of the index buffer, each within the limits,
+		// whose local triangles point at the same vertices as the indices
+		unsigned int nextIndex = 0;
+		for (const Meshlet& meshlet : data.meshlets)
+		{
+			CHECK(meshlet.indexOffset == nextIndex);
+			CHECK(meshlet.vertexCount > 0 && meshlet.vertexCount <= MaxMeshletVertices);
+			CHECK(meshlet.triangleCount > 0 && meshlet.triangleCount <= MaxMeshletTriangles);
+			REQUIRE(meshlet.vertexOffset + meshlet.vertexCount <= data.vertices.size());
+			REQUIRE(meshlet.triangleOffset + meshlet.triangleCount * 3u <= data.triangles.size());
+			REQUIRE(meshlet.indexOffset + meshlet.triangleCount * 3u <= indices.size());
+
+			for (unsigned int i = 0; i < meshlet.triangleCount * 3u; i++)
+			{
+				unsigned char local = data.triangles[meshlet.triangleOffset + i];
+				REQUIRE(local < meshlet.vertexCount);
+				CHECK(data.vertices[meshlet.vertexOffset + local] == indices[meshlet.indexOffset + i]);
+			}
+			nextIndex += meshlet.triangleCount * 3;
+		}
+		CHECK(nextIndex == indices.size());
+	}
+}
+
+TEST(MeshletSpheresHoldTheirVertices)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MeshletData data;
+	REQUIRE(BuildModel("helix.obj", vertices, indices, data));
+
+	for (const Meshlet& meshlet : data.meshlets)
+	{
+		XMVECTOR center = XMLoadFloat3(&meshlet.center);
+		for (unsigned int v = 0; v < meshlet.vertexCount; v++)
+		{
+			XMVECTOR p = XMLoadFloat3(&vertices[data.vertices[meshlet.vertexOffset + v]].Position);
+			CHECK(XMVectorGetX(XMVector3Length(p - center)) <= meshlet.radius * 1.0001f + 0.0001f);
+		}
+	}
+}
+
+TEST(MeshletConesNeverHideVisibleTriangles)
+{
+	// Cameras all the way around each model, near and far - a cone may
+	// only reject a meshlet when every one of its triangles faces away
+	const char* models[] = { "sphere.obj", "torus.obj", "cylinder.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		MeshletData data;
+		REQUIRE(BuildModel(model, vertices, indices, data));
+
+		unsigned int culled = 0;
+		unsigned int tested = 0;
+		const int views = 64;
+		for (int i = 0; i < views; i++)
+		{
+			float y = 1 - (i + 0.5f) * 2.0f / views;
+			float radius = sqrtf(1 - y * y);
+			float angle = i * 2.39996323f;
+			for (float distance : { 1.5f, 4.0f, 20.0f })
+			{
+				XMFLOAT3 camera(cosf(angle) * radius * distance, y * distance, sinf(angle) * radius * distance);
+				unsigned int culledHere = 0;
+				CHECK(MeshletCuller::CountWronglyBackfaceCulled(data, &vertices[0], &indices[0], camera, culledHere) == 0);
+				culled += culledHere;
+				tested += (unsigned int)data.meshlets.size();
+			}
+		}
+		printf("    %s: %u meshlets, cones culled %.1f%%\n", model, (unsigned int)data.meshlets.size(), 100.0f * culled / tested);
+
+		CHECK(culled > 0);
+	}
+}
+
+TEST(MeshletFrustumCullingInLocalSpace)
+{
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	MeshletData data;
+	REQUIRE(BuildModel("torus.obj", vertices, indices, data));
+
+	// A world matrix that moves, turns and scales the mesh, and a world
+	// space box of planes that cuts through it
+	XMFLOAT4X4 world;
+	XMStoreFloat4x4(&world, XMMatrixScaling(2, 2, 2) * XMMatrixRotationRollPitchYaw(0.3f, 1.1f, 0.2f) * XMMatrixTranslation(5, -1, 3));
+	XMFLOAT4 worldPlanes[6] = {
+		XMFLOAT4(1, 0, 0, -6.5f), XMFLOAT4(-1, 0, 0, 9),
+		XMFLOAT4(0, 1, 0, 3), XMFLOAT4(0, -1, 0, 3),
+		XMFLOAT4(0, 0, 1, 0), XMFLOAT4(0, 0, -1, 6) };
+	XMFLOAT4 localPlanes[6];
+	MeshletCuller::TransformPlanesToLocal(worldPlanes, 6, world, localPlanes);
+
+	// Any meshlet with a vertex inside every world plane has to survive
+	XMMATRIX worldMatrix = XMLoadFloat4x4(&world);
+	unsigned int outside = 0;
+	for (const Meshlet& meshlet : data.meshlets)
+	{
+		bool anyInside = false;
+		for (unsigned int v = 0; v < meshlet.vertexCount && !anyInside; v++)
+		{
+			XMVECTOR p = XMVector3TransformCoord(XMLoadFloat3(&vertices[data.vertices[meshlet.vertexOffset + v]].Position), worldMatrix);
+			bool inside = true;
+			for (const XMFLOAT4& plane : worldPlanes)
+				inside = inside && XMVectorGetX(XMPlaneDotCoord(XMLoadFloat4(&plane), p)) >= 0;
+			anyInside = inside;
+		}
+
+		bool culled = MeshletCuller::IsOutsidePlanes(meshlet, localPlanes, 6);
+		if (anyInside)
+			CHECK(!culled);
+		if (culled)
+			outside++;
+	}
+	CHECK(outside > 0);
+	CHECK(outside < data.meshlets.size());
+}
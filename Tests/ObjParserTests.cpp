@@ -0,0 +1,225 @@
+#include "TestFramework.h"
+#include "../ObjParser.h"
+#include <fstream>
+#include <cstdio>
+#include <algorithm>
+
+using namespace DirectX;
+
+// --------------------------------------------------------
+// The loader Mesh used before ObjParser - getline into a 100
+// character buffer and sscanf_s on every line - kept here as
+// the baseline to check and measure the parser against
+// --------------------------------------------------------
+static bool ParseLineByLine(const char* filename, ObjData& data)
+{
+	std::ifstream obj(filename);
+	if (!obj.is_open())
+		return false;
+
+	data = ObjData();
+	char chars[100];
+	while (obj.good())
+	{
+		obj.getline(chars, 100);
+
+		if (chars[0] == 'v' && chars[1] == 'n')
+		{
+			XMFLOAT3 norm;
+			sscanf_s(chars, "vn %f %f %f", &norm.x, &norm.y, &norm.z);
+			data.normals.push_back(norm);
+		}
+		else if (chars[0] == 'v' && chars[1] == 't')
+		{
+			XMFLOAT2 uv;
+			sscanf_s(chars, "vt %f %f", &uv.x, &uv.y);
+			data.uvs.push_back(uv);
+		}
+		else if (chars[0] == 'v')
+		{
+			XMFLOAT3 pos;
+			sscanf_s(chars, "v %f %f %f", &pos.x, &pos.y, &pos.z);
+			data.positions.push_back(pos);
+		}
+		else if (chars[0] == 'f')
+		{
+			unsigned int i[12];
+			int numbersRead = sscanf_s(
+				chars,
+				"f %d/%d/%d %d/%d/%d %d/%d/%d %d/%d/%d",
+				&i[0], &i[1], &i[2],
+				&i[3], &i[4], &i[5],
+				&i[6], &i[7], &i[8],
+				&i[9], &i[10], &i[11]);
+
+			if (numbersRead == 1)
+			{
+				numbersRead = sscanf_s(
+					chars,
+					"f %d//%d %d//%d %d//%d %d//%d",
+					&i[0], &i[2],
+					&i[3], &i[5],
+					&i[6], &i[8],
+					&i[9], &i[11]);
+				i[1] = 1;
+				i[4] = 1;
+				i[7] = 1;
+				i[10] = 1;
+				if (data.uvs.size() == 0)
+					data.uvs.push_back(XMFLOAT2(0, 0));
+			}
+
+			// Same triangles the parser fans a polygon into, still 1-based here
+			ObjCorner corners[4];
+			for (int c = 0; c < 4; c++)
+			{
+				corners[c].position = i[c * 3] - 1;
+				corners[c].uv = i[c * 3 + 1] - 1;
+				corners[c].normal = i[c * 3 + 2] - 1;
+			}
+			data.corners.push_back(corners[0]);
+			data.corners.push_back(corners[1]);
+			data.corners.push_back(corners[2]);
+			if (numbersRead == 12 || numbersRead == 8)
+			{
+				data.corners.push_back(corners[0]);
+				data.corners.push_back(corners[2]);
+				data.corners.push_back(corners[3]);
+			}
+		}
+	}
+	return true;
+}
+
+static bool SameFloat3(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	return a.x == b.x && a.y == b.y && a.z == b.z;
+}
+
+//the two can index their arrays differently (where the default uv goes), so compare what each corner points at
+static bool SameTriangles(const ObjData& a, const ObjData& b)
+{
+	if (a.corners.size() != b.corners.size())
+		return false;
+	for (size_t i = 0; i < a.corners.size(); i++)
+	{
+		const ObjCorner& ca = a.corners[i];
+		const ObjCorner& cb = b.corners[i];
+		if (!SameFloat3(a.positions[ca.position], b.positions[cb.position]) ||
+			!SameFloat3(a.normals[ca.normal], b.normals[cb.normal]) ||
+			a.uvs[ca.uv].x != b.uvs[cb.uv].x || a.uvs[ca.uv].y != b.uvs[cb.uv].y)
+			return false;
+	}
+	return true;
+}
+
+static size_t GetFileSize(const char* filename)
+{
+	std::ifstream file(filename, std::ios::binary | std::ios::ate);
+	return file.is_open() ? (size_t)file.tellg() : 0;
+}
+
+TEST(ObjParserMatchesLineByLine)
+{
+	//not archery.obj, its faces have no normals and the old loader never could read those
+	const char* models[] = { "sphere.obj", "torus.obj", "cube.obj", "cylinder.obj", "helix.obj", "quad.obj" };
+	for (const char* model : models)
+	{
+		std::string path = TestRunner::GetAssetPath((std::string("Models/") + model).c_str());
+
+		ObjData expected;
+		REQUIRE(ParseLineByLine(path.c_str(), expected));
+		ObjParser parser;
+		ObjData parsed;
+		REQUIRE(parser.Parse(path.c_str(), parsed));
+
+		CHECK(parsed.positions.size() == expected.positions.size());
+		CHECK(!parsed.corners.empty());
+		CHECK(SameTriangles(parsed, expected));
+	}
+}
+
+TEST(ObjParserReadsFacesWithoutNormals)
+{
+	// Corners written as v/vt all point at one made up normal
+	ObjParser parser;
+	ObjData parsed;
+	REQUIRE(parser.Parse(TestRunner::GetAssetPath("Models/archery.obj").c_str(), parsed));
+	REQUIRE(!parsed.corners.empty());
+	CHECK(parsed.corners.size() % 3 == 0);
+	for (const ObjCorner& corner : parsed.corners)
+	{
+		CHECK(corner.position < parsed.positions.size());
+		CHECK(corner.uv < parsed.uvs.size());
+		CHECK(corner.normal < parsed.normals.size());
+	}
+}
+
+//deletes the file when it goes out of scope, so a failed REQUIRE doesn't leave it behind
+struct RemoveOnExit
+{
+	const char* filename;
+	~RemoveOnExit() { std::remove(filename); }
+};
+
+TEST(ObjParserThroughput)
+{
+	// A made up scan sized model - big enough to split across
+	// threads, and with short lines so the old loader reads it too
+	const char* filename = "ObjParserThroughput.obj";
+	RemoveOnExit removeFile = { filename };
+	{
+		std::ofstream obj(filename);
+		REQUIRE(obj.is_open());
+		const int size = 700;
+		char line[100];
+		for (int z = 0; z <= size; z++)
+		{
+			for (int x = 0; x <= size; x++)
+			{
+				snprintf(line, sizeof(line), "v %.6f %.6f %.6f\nvt %.6f %.6f\n", x * 0.01f, (x * z % 17) * 0.001f, z * 0.01f, x / (float)size, z / (float)size);
+				obj << line;
+			}
+		}
+		obj << "vn 0.000000 1.000000 0.000000\n";
+		for (int z = 0; z < size; z++)
+		{
+			for (int x = 0; x < size; x++)
+			{
+				int a = z * (size + 1) + x + 1;
+				int b = a + size + 1;
+				snprintf(line, sizeof(line), "f %d/%d/1 %d/%d/1 %d/%d/1 %d/%d/1\n", a, a, b, b, b + 1, b + 1, a + 1, a + 1);
+				obj << line;
+			}
+		}
+	}
+	double megabytes = GetFileSize(filename) / (1024.0 * 1024.0);
+	REQUIRE(megabytes > 0);
+
+	// Best of a few runs each, so a cold file cache doesn't count against either
+	double oldMs = 0;
+	double newMs = 0;
+	ObjData expected;
+	ObjData parsed;
+	ObjParser parser;
+	for (int run = 0; run < 3; run++)
+	{
+		TestTimer oldTimer;
+		REQUIRE(ParseLineByLine(filename, expected));
+		double ms = oldTimer.GetMilliseconds();
+		oldMs = run == 0 ? ms : (std::min)(oldMs, ms);
+
+		TestTimer newTimer;
+		REQUIRE(parser.Parse(filename, parsed));
+		ms = newTimer.GetMilliseconds();
+		newMs = run == 0 ? ms : (std::min)(newMs, ms);
+	}
+
+	double oldRate = megabytes / (oldMs / 1000.0);
+	double newRate = megabytes / (newMs / 1000.0);
+	printf("    %.1f MB: line by line %.1f MB/s, ObjParser %.1f MB/s on %u threads (%.1fx)\n",
+		megabytes, oldRate, newRate, parser.GetThreadCount(), newRate / oldRate);
+
+	// Only the result is checked - how fast either one goes depends on the machine and what else is running
+	CHECK(SameTriangles(parsed, expected));
+}
@@ -0,0 +1,293 @@
+#include "TestFramework.h"
+#include "../OcclusionCuller.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <cfloat>
+#include <algorithm>
+
+using namespace DirectX;
+
+//an occluder box - its local box and where it's drawn
+struct Occluder
+{
+	Aabb box;
+	XMFLOAT4X4 world;
+	XMFLOAT4X4 toLocal;
+};
+
+//the camera the tests look through, at the origin looking down z - the culler's default 256x128 is 2:1
+static XMFLOAT4X4 MakeViewProjection(float pitch, float yaw)
+{
+	XMMATRIX view = XMMatrixLookToLH(XMVectorZero(), XMMatrixRotationRollPitchYaw(pitch, yaw, 0).r[2], XMVectorSet(0, 1, 0, 0));
+	XMFLOAT4X4 viewProjection;
+	XMStoreFloat4x4(&viewProjection, view * XMMatrixPerspectiveFovLH(XM_PIDIV2, 2.0f, 0.01f, 100.0f));
+	return viewProjection;
+}
+
+//a box of random size, turned and put somewhere out in front of the camera
+static Occluder MakeOccluder(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> any(-1, 1);
+	Occluder occluder;
+	XMFLOAT3 extent(0.3f + fabsf(any(random)) * 3, 0.3f + fabsf(any(random)) * 2, 0.1f + fabsf(any(random)));
+	occluder.box.minCorner = XMFLOAT3(-extent.x, -extent.y, -extent.z);
+	occluder.box.maxCorner = extent;
+	XMMATRIX world = XMMatrixRotationRollPitchYaw(any(random) * 3, any(random) * 3, any(random) * 3) *
+		XMMatrixTranslation(any(random) * 12, any(random) * 5, 4 + fabsf(any(random)) * 30);
+	XMStoreFloat4x4(&occluder.world, world);
+	XMStoreFloat4x4(&occluder.toLocal, XMMatrixInverse(0, world));
+	return occluder;
+}
+
+//box from corner to corner, not turned
+static Occluder MakeWall(float minX, float minY, float minZ, float maxX, float maxY, float maxZ)
+{
+	Occluder occluder;
+	occluder.box.minCorner = XMFLOAT3(minX, minY, minZ);
+	occluder.box.maxCorner = XMFLOAT3(maxX, maxY, maxZ);
+	XMStoreFloat4x4(&occluder.world, XMMatrixIdentity());
+	occluder.toLocal = occluder.world;
+	return occluder;
+}
+
+// How far along the ray it goes into the box's outside - a ray that
+// starts inside only sees back faces, which aren't drawn, so it misses
+static bool RayEnters(FXMVECTOR origin, FXMVECTOR direction, const Occluder& occluder, float& enter)
+{
+	XMMATRIX toLocal = XMLoadFloat4x4(&occluder.toLocal);
+	XMFLOAT3 o, d;
+	XMStoreFloat3(&o, XMVector3TransformCoord(origin, toLocal));
+	XMStoreFloat3(&d, XMVector3TransformNormal(direction, toLocal));
+	const float* oa = &o.x;
+	const float* da = &d.x;
+	const float* low = &occluder.box.minCorner.x;
+	const float* high = &occluder.box.maxCorner.x;
+	enter = -FLT_MAX;
+	float exit = FLT_MAX;
+	for (int axis = 0; axis < 3; axis++)
+	{
+		if (da[axis] == 0)
+		{
+			if (oa[axis] < low[axis] || oa[axis] > high[axis])
+				return false;
+			continue;
+		}
+		float t0 = (low[axis] - oa[axis]) / da[axis];
+		float t1 = (high[axis] - oa[axis]) / da[axis];
+		enter = (std::max)(enter, (std::min)(t0, t1));
+		exit = (std::min)(exit, (std::max)(t0, t1));
+	}
+	return enter <= exit && enter > 0;
+}
+
+// Depth of the nearest front face through a point on the screen, cast
+// from the near plane to the far one - 1 if there's nothing, like a
+// cleared buffer. which is the occluder hit, or -1
+static float CastDepth(const std::vector<Occluder>& occluders, FXMMATRIX viewProjection, CXMMATRIX toWorld, float screenX, float screenY, int& which)
+{
+	float ndcX = screenX / 256.0f * 2 - 1;
+	float ndcY = 1 - screenY / 128.0f * 2;
+	XMVECTOR nearPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 0, 1), toWorld);
+	XMVECTOR farPoint = XMVector3TransformCoord(XMVectorSet(ndcX, ndcY, 1, 1), toWorld);
+	XMVECTOR direction = farPoint - nearPoint;
+
+	float nearest = 1;
+	which = -1;
+	for (size_t i = 0; i < occluders.size(); i++)
+	{
+		float enter;
+		if (RayEnters(nearPoint, direction, occluders[i], enter) && enter <= nearest)
+		{
+			nearest = enter;
+			which = (int)i;
+		}
+	}
+	if (which < 0)
+		return 1;
+	XMFLOAT4 clip;
+	XMStoreFloat4(&clip, XMVector4Transform(XMVectorSetW(nearPoint + direction * nearest, 1), viewProjection));
+	return clip.z / clip.w;
+}
+
+static void DrawOccluders(OcclusionCuller& culler, const XMFLOAT4X4& viewProjection, const std::vector<Occluder>& occluders)
+{
+	culler.BeginFrame(viewProjection);
+	for (const Occluder& occluder : occluders)
+		culler.AddOccluderBox(occluder.box, occluder.world);
+	culler.Rasterize();
+}
+
+TEST(OcclusionDepthMatchesRayCasting)
+{
+	// Every pixel center against a ray through it. Right on an edge
+	// float rounding decides which side a pixel falls, so pixels where
+	// rays a hair to either side see different things are left out
+	std::mt19937 random(24);
+	std::uniform_real_distribution<float> any(-1, 1);
+	OcclusionCuller culler;
+	unsigned int edgePixels = 0;
+	unsigned int coveredPixels = 0;
+	for (int scene = 0; scene < 8; scene++)
+	{
+		XMFLOAT4X4 viewProjection = MakeViewProjection(scene ? any(random) * 0.3f : 0, scene ? any(random) * 0.3f : 0);
+		XMMATRIX viewProjectionMatrix = XMLoadFloat4x4(&viewProjection);
+		XMMATRIX toWorld = XMMatrixInverse(0, viewProjectionMatrix);
+
+		// A wall beside the camera and a floor under it, both running from
+		// behind it to well in front, so the near plane cuts through them
+		std::vector<Occluder> occluders;
+		occluders.push_back(MakeWall(1.0f, -2, -3, 1.5f, 2, 6));
+		occluders.push_back(MakeWall(-20, -1.5f, -5, 20, -1.0f, 40));
+		for (int i = 0; i < 12; i++)
+			occluders.push_back(MakeOccluder(random));
+		DrawOccluders(culler, viewProjection, occluders);
+		const float* depth = culler.GetDepth();
+
+		for (unsigned int py = 0; py < culler.GetHeight(); py++)
+		{
+			for (unsigned int px = 0; px < culler.GetWidth(); px++)
+			{
+				int which;
+				float expected = CastDepth(occluders, viewProjectionMatrix, toWorld, px + 0.5f, py + 0.5f, which);
+				bool onEdge = false;
+				const float nudges[4][2] = { { 0.01f, 0 }, { -0.01f, 0 }, { 0, 0.01f }, { 0, -0.01f } };
+				for (const auto& nudge : nudges)
+				{
+					int nudgedWhich;
+					CastDepth(occluders, viewProjectionMatrix, toWorld, px + 0.5f + nudge[0], py + 0.5f + nudge[1], nudgedWhich);
+					onEdge = onEdge || nudgedWhich != which;
+				}
+				if (onEdge)
+				{
+					edgePixels++;
+					continue;
+				}
+				CHECK_NEAR(depth[py * culler.GetWidth() + px], expected, 1e-5f);
+				coveredPixels += which >= 0;
+			}
+		}
+
+		// Looking straight ahead the right edge is the wall beside the
+		// camera - only the part of it past the near plane drawn
+		int which;
+		CastDepth(occluders, viewProjectionMatrix, toWorld, 255.5f, 64.5f, which);
+		if (scene == 0)
+			CHECK(which == 0);
+	}
+	CHECK(edgePixels < 8 * 256 * 128 / 20);
+	printf("    %u pixels covered, %u on edges left out\n", coveredPixels, edgePixels);
+}
+
+TEST(OcclusionSameImageOnAnyThreadCount)
+{
+	// Lots of overlapping occluders, so tiles have plenty of triangles
+	// fighting over the same pixels
+	std::mt19937 random(25);
+	std::vector<Occluder> occluders;
+	for (int i = 0; i < 400; i++)
+		occluders.push_back(MakeOccluder(random));
+	occluders.push_back(MakeWall(1.0f, -2, -3, 1.5f, 2, 6));
+	XMFLOAT4X4 viewProjection = MakeViewProjection(0.1f, -0.2f);
+
+	std::vector<unsigned char> first;
+	const unsigned int threadCounts[] = { 1, 2, 4, 8 };
+	for (unsigned int threads : threadCounts)
+	{
+		OcclusionCuller culler(256, 128, 64, 32, threads);
+		CHECK(culler.GetThreadCount() == threads);
+		//twice, so the second frame draws over what the first left
+		std::vector<unsigned char> image;
+		for (int frame = 0; frame < 2; frame++)
+		{
+			DrawOccluders(culler, viewProjection, occluders);
+			culler.BuildDepthImage(image);
+		}
+		if (first.empty())
+			first = image;
+		CHECK(image == first);
+	}
+	//a pgm header, then two bytes a pixel
+	const char header[] = "P5\n256 128\n65535\n";
+	CHECK(first.size() == sizeof(header) - 1 + 256 * 128 * 2);
+	CHECK(std::equal(header, header + sizeof(header) - 1, first.begin()));
+}
+
+TEST(OcclusionNeverHidesAnythingInFront)
+{
+	// Boxes all over, some behind the occluders, some poking out and
+	// some in front - any that's culled can't have a single point on
+	// screen nearer than the depth buffer there
+	std::mt19937 random(26);
+	std::uniform_real_distribution<float> any(-1, 1);
+	OcclusionCuller culler;
+	unsigned int culledCount = 0;
+	unsigned int tested = 0;
+	for (int scene = 0; scene < 8; scene++)
+	{
+		XMFLOAT4X4 viewProjection = MakeViewProjection(any(random) * 0.3f, any(random) * 0.3f);
+		XMMATRIX viewProjectionMatrix = XMLoadFloat4x4(&viewProjection);
+		std::vector<Occluder> occluders;
+		occluders.push_back(MakeWall(-15, -6, 8, 15, 6, 8.5f));
+		occluders.push_back(MakeWall(1.0f, -2, -3, 1.5f, 2, 6));
+		for (int i = 0; i < 6; i++)
+			occluders.push_back(MakeOccluder(random));
+		DrawOccluders(culler, viewProjection, occluders);
+		const float* depth = culler.GetDepth();
+
+		for (int i = 0; i < 1000; i++)
+		{
+			Aabb box;
+			XMFLOAT3 center(any(random) * 20, any(random) * 8, fabsf(any(random)) * 40 - 2);
+			XMFLOAT3 extent(fabsf(any(random)) * 2, fabsf(any(random)) * 2, fabsf(any(random)) * 2);
+			box.minCorner = XMFLOAT3(center.x - extent.x, center.y - extent.y, center.z - extent.z);
+			box.maxCorner = XMFLOAT3(center.x + extent.x, center.y + extent.y, center.z + extent.z);
+			tested++;
+			if (culler.IsVisible(box))
+				continue;
+			culledCount++;
+
+			// A 5x5x5 grid of points through the box, its corners included
+			for (int s = 0; s < 125; s++)
+			{
+				XMVECTOR point = XMVectorSet(
+					box.minCorner.x + (box.maxCorner.x - box.minCorner.x) * (s % 5) / 4.0f,
+					box.minCorner.y + (box.maxCorner.y - box.minCorner.y) * (s / 5 % 5) / 4.0f,
+					box.minCorner.z + (box.maxCorner.z - box.minCorner.z) * (s / 25) / 4.0f, 1);
+				XMFLOAT4 clip;
+				XMStoreFloat4(&clip, XMVector4Transform(point, viewProjectionMatrix));
+				if (clip.w <= 0 || clip.z < 0 || clip.z > clip.w)
+					continue;
+				float screenX = (clip.x / clip.w * 0.5f + 0.5f) * culler.GetWidth();
+				float screenY = (0.5f - clip.y / clip.w * 0.5f) * culler.GetHeight();
+				if (screenX < 0 || screenY < 0 || screenX >= culler.GetWidth() || screenY >= culler.GetHeight())
+					continue;
+				CHECK(clip.z / clip.w >= depth[(unsigned int)screenY * culler.GetWidth() + (unsigned int)screenX]);
+			}
+		}
+
+		// And Cull agrees with asking one at a time
+		std::vector<Aabb> boxes;
+		std::vector<unsigned int> indices, visible;
+		for (int i = 0; i < 50; i++)
+		{
+			Aabb box;
+			XMFLOAT3 center(any(random) * 20, any(random) * 8, fabsf(any(random)) * 40);
+			box.minCorner = XMFLOAT3(center.x - 1, center.y - 1, center.z - 1);
+			box.maxCorner = XMFLOAT3(center.x + 1, center.y + 1, center.z + 1);
+			boxes.push_back(box);
+			indices.push_back(i);
+		}
+		culler.Cull(&boxes[0], &indices[0], (unsigned int)indices.size(), visible);
+		std::vector<unsigned int> expected;
+		for (unsigned int i : indices)
+		{
+			if (culler.IsVisible(boxes[i]))
+				expected.push_back(i);
+		}
+		CHECK(visible == expected);
+	}
+	CHECK(culledCount > tested / 10);
+	printf("    %u of %u boxes culled\n", culledCount, tested);
+}
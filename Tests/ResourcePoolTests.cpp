@@ -0,0 +1,100 @@
+#include "TestFramework.h"
+#include "../ResourcePool.h"
+#include <memory>
+#include <string>
+
+TEST(PoolAddAndGet)
+{
+	ResourcePool<std::string> pool;
+	Handle<std::string> a = pool.Add("a");
+	Handle<std::string> b = pool.Add("b");
+	CHECK(a.IsValid() && b.IsValid());
+	CHECK(a != b);
+	CHECK(pool.Get(a) == "a");
+	CHECK(pool.Get(b) == "b");
+	CHECK(pool.GetCount() == 2);
+
+	// A zeroed handle is nothing, and never alive
+	Handle<std::string> none;
+	CHECK(!none.IsValid());
+	CHECK(!pool.IsAlive(none));
+}
+
+TEST(PoolRemovedHandlesGoStale)
+{
+	ResourcePool<std::string> pool;
+	Handle<std::string> a = pool.Add("a");
+	Handle<std::string> b = pool.Add("b");
+	Handle<std::string> copy = a;
+
+	pool.Remove(a);
+	CHECK(!pool.IsAlive(a));
+	CHECK(!pool.IsAlive(copy));
+	CHECK(pool.IsAlive(b));
+	CHECK(pool.GetCount() == 1);
+
+	// Removing it again, through any copy, does nothing
+	pool.Remove(copy);
+	CHECK(pool.GetCount() == 1);
+}
+
+TEST(PoolReusedSlotsDontMatchOldHandles)
+{
+	ResourcePool<std::string> pool;
+	Handle<std::string> old = pool.Add("old");
+	pool.Remove(old);
+
+	// The slot comes back with a new generation
+	Handle<std::string> reused = pool.Add("new");
+	CHECK(reused.index == old.index);
+	CHECK(reused.generation != old.generation);
+	CHECK(!pool.IsAlive(old));
+	CHECK(pool.IsAlive(reused));
+	CHECK(pool.Get(reused) == "new");
+
+	// And a stale handle can't take out what moved in
+	pool.Remove(old);
+	CHECK(pool.IsAlive(reused));
+	CHECK(pool.GetCount() == 1);
+
+	// Every removal moves the slot on, so none of its old handles ever match again
+	std::vector<Handle<std::string>> stale;
+	for (int i = 0; i < 100; i++)
+	{
+		stale.push_back(reused);
+		pool.Remove(reused);
+		reused = pool.Add("again");
+		CHECK(reused.index == old.index);
+	}
+	for (const Handle<std::string>& handle : stale)
+		CHECK(!pool.IsAlive(handle));
+	CHECK(pool.IsAlive(reused));
+}
+
+TEST(PoolOutOfRangeHandles)
+{
+	ResourcePool<int> pool;
+	pool.Add(1);
+	Handle<int> outside;
+	outside.index = 5;
+	outside.generation = 1;
+	CHECK(!pool.IsAlive(outside));
+	pool.Remove(outside);
+	CHECK(pool.GetCount() == 1);
+}
+
+TEST(PoolKeyedOnPointee)
+{
+	// Kept behind unique_ptrs, but the handles are typed on what they point to
+	ResourcePool<std::unique_ptr<std::string>, std::string> pool;
+	Handle<std::string> a = pool.Add(std::unique_ptr<std::string>(new std::string("a")));
+	Handle<std::string> b = pool.Add(std::unique_ptr<std::string>(new std::string("b")));
+	CHECK(*pool.Get(a) == "a");
+	CHECK(*pool.Get(b) == "b");
+
+	pool.Remove(a);
+	Handle<std::string> c = pool.Add(std::unique_ptr<std::string>(new std::string("c")));
+	CHECK(!pool.IsAlive(a));
+	CHECK(*pool.Get(c) == "c");
+	CHECK(*pool.Get(b) == "b");
+}
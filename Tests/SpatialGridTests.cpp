@@ -0,0 +1,308 @@
+#include "TestFramework.h"
+#include "../SpatialGrid.h"
+#include "../FrustumCuller.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+//something standing on the ground like the prop field's - thin poles, tall boxes and wide ones
+static Aabb MakeProp(std::mt19937& random, float spread)
+{
+	std::uniform_real_distribution<float> any(-1, 1);
+	float x = any(random) * spread, z = any(random) * spread;
+	unsigned int kind = random() % 3;
+	float width = kind == 0 ? 0.01f : (kind == 1 ? 0.5f : 0.8f);
+	float height = kind == 0 ? 0.3f : (kind == 1 ? 1.5f : 0.5f);
+	Aabb box;
+	box.minCorner = XMFLOAT3(x - width, -0.5f, z - width);
+	box.maxCorner = XMFLOAT3(x + width, -0.5f + 2 * height, z + width);
+	return box;
+}
+
+static bool Overlaps(const Aabb& a, const Aabb& b)
+{
+	return a.minCorner.x <= b.maxCorner.x && a.minCorner.y <= b.maxCorner.y && a.minCorner.z <= b.maxCorner.z &&
+		a.maxCorner.x >= b.minCorner.x && a.maxCorner.y >= b.minCorner.y && a.maxCorner.z >= b.minCorner.z;
+}
+
+//box around the frustum's eight corners, each one where a side, top or bottom, and near or far plane meet
+static Aabb GetFrustumHull(const XMFLOAT4* planes)
+{
+	Aabb hull;
+	hull.minCorner = XMFLOAT3(1e30f, 1e30f, 1e30f);
+	hull.maxCorner = XMFLOAT3(-1e30f, -1e30f, -1e30f);
+	for (int corner = 0; corner < 8; corner++)
+	{
+		const XMFLOAT4& a = planes[corner & 1];
+		const XMFLOAT4& b = planes[2 + ((corner >> 1) & 1)];
+		const XMFLOAT4& c = planes[4 + (corner >> 2)];
+		XMVECTOR na = XMLoadFloat4(&a);
+		XMVECTOR nb = XMLoadFloat4(&b);
+		XMVECTOR nc = XMLoadFloat4(&c);
+		XMVECTOR bc = XMVector3Cross(nb, nc);
+		float denominator = XMVectorGetX(XMVector3Dot(na, bc));
+		XMFLOAT3 point;
+		XMStoreFloat3(&point, (bc * -a.w + XMVector3Cross(nc, na) * -b.w + XMVector3Cross(na, nb) * -c.w) / denominator);
+		hull.minCorner = XMFLOAT3((std::min)(hull.minCorner.x, point.x), (std::min)(hull.minCorner.y, point.y), (std::min)(hull.minCorner.z, point.z));
+		hull.maxCorner = XMFLOAT3((std::max)(hull.maxCorner.x, point.x), (std::max)(hull.maxCorner.y, point.y), (std::max)(hull.maxCorner.z, point.z));
+	}
+	return hull;
+}
+
+TEST(GridMatchesBruteForce)
+{
+	// Props going in, moving across cells, growing past them, jumping
+	// far away and coming out - plus the odd ground-sized box for the
+	// oversized list - with queries checked after each round
+	std::mt19937 random(41);
+	std::uniform_real_distribution<float> any(-1, 1);
+	SpatialGrid grid(7.0f);
+	std::vector<Aabb> boxes;
+	std::vector<unsigned int> proxies;
+	std::vector<bool> alive;
+	std::vector<unsigned int> results, expected, live;
+	unsigned int leftOut = 0;
+
+	for (int round = 0; round < 30; round++)
+	{
+		for (int i = 0; i < 200; i++)
+		{
+			Aabb box = MakeProp(random, 60);
+			if (i % 50 == 0)
+			{
+				box.maxCorner.x += 25;
+				box.maxCorner.z += 12;
+			}
+			if (i == 7 && round % 8 == 0)
+			{
+				box.minCorner = XMFLOAT3(-100, -0.6f, -100);
+				box.maxCorner = XMFLOAT3(100, -0.5f, 100);
+			}
+			boxes.push_back(box);
+			proxies.push_back(grid.Insert(box, (unsigned int)boxes.size() - 1));
+			alive.push_back(true);
+		}
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (!alive[i])
+				continue;
+			unsigned int what = random() % 10;
+			if (what < 4)
+			{
+				float dx = any(random) * 3;
+				float dz = any(random) * 3;
+				boxes[i].minCorner.x += dx;
+				boxes[i].maxCorner.x += dx;
+				boxes[i].minCorner.z += dz;
+				boxes[i].maxCorner.z += dz;
+				grid.Move(proxies[i], boxes[i]);
+			}
+			else if (what < 5)
+			{
+				boxes[i] = MakeProp(random, 200);
+				grid.Move(proxies[i], boxes[i]);
+			}
+			else if (what == 9 && random() % 8 == 0)
+			{
+				boxes[i].maxCorner.x += 30;
+				grid.Move(proxies[i], boxes[i]);
+			}
+			else if (what < 6 && random() % 4 == 0)
+			{
+				grid.Remove(proxies[i]);
+				alive[i] = false;
+			}
+		}
+
+		live.clear();
+		for (size_t i = 0; i < boxes.size(); i++)
+		{
+			if (alive[i])
+				live.push_back((unsigned int)i);
+		}
+		CHECK(grid.GetItemCount() == live.size());
+
+		for (int view = 0; view < 10; view++)
+		{
+			XMFLOAT3 eye(any(random) * 80, any(random) * 5, any(random) * 80);
+			XMMATRIX viewMatrix = XMMatrixLookToLH(XMLoadFloat3(&eye), XMMatrixRotationRollPitchYaw(any(random) * 1.4f, any(random) * 3.1f, 0).r[2], XMVectorSet(0, 1, 0, 0));
+			XMFLOAT4 planes[FrustumCuller::PlaneCount];
+			FrustumCuller::ExtractPlanes(viewMatrix * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f), planes);
+
+			// Only cells under the frustum are looked at, so a box can be left
+			// out that the planes alone would let through - but only one that
+			// doesn't even touch the box around the frustum, which is never
+			// on screen. Nothing the planes cull can come back
+			FrustumCuller::CullReference(&boxes[0], &live[0], (unsigned int)live.size(), planes, FrustumCuller::PlaneCount, expected);
+			grid.QueryFrustum(planes, FrustumCuller::PlaneCount, results);
+			std::sort(results.begin(), results.end());
+			CHECK(std::includes(expected.begin(), expected.end(), results.begin(), results.end()));
+			Aabb hull = GetFrustumHull(planes);
+			for (unsigned int i : expected)
+			{
+				if (std::binary_search(results.begin(), results.end(), i))
+					continue;
+				CHECK(!Overlaps(boxes[i], hull));
+				leftOut++;
+			}
+
+			// Without the near and far planes there's no hull to narrow it down, so it has to be exact
+			FrustumCuller::CullReference(&boxes[0], &live[0], (unsigned int)live.size(), planes, 4, expected);
+			grid.QueryFrustum(planes, 4, results);
+			std::sort(results.begin(), results.end());
+			CHECK(results == expected);
+		}
+
+		for (int q = 0; q < 20; q++)
+		{
+			Aabb query = MakeProp(random, 150);
+			query.maxCorner.x += fabsf(any(random)) * 40;
+			expected.clear();
+			for (unsigned int i : live)
+			{
+				if (Overlaps(boxes[i], query))
+					expected.push_back(i);
+			}
+			grid.QueryOverlap(query, results);
+			std::sort(results.begin(), results.end());
+			CHECK(results == expected);
+		}
+	}
+	printf("    %u items in %u cells, %u oversized, %u left out past the frustum\n",
+		grid.GetItemCount(), grid.GetCellCount(), grid.GetOversizedCount(), leftOut);
+}
+
+TEST(GridMovesBetweenCells)
+{
+	SpatialGrid grid(10.0f);
+	Aabb box;
+	box.minCorner = XMFLOAT3(1, 0, 1);
+	box.maxCorner = XMFLOAT3(2, 1, 2);
+	unsigned int proxy = grid.Insert(box, 5);
+	CHECK(grid.GetCellCount() == 1);
+
+	// Still centered in the same cell
+	box.minCorner.x += 5;
+	box.maxCorner.x += 5;
+	CHECK(!grid.Move(proxy, box));
+
+	// Across into the next one - queries find it where it went
+	box.minCorner.x += 5;
+	box.maxCorner.x += 5;
+	CHECK(grid.Move(proxy, box));
+	std::vector<unsigned int> results;
+	Aabb query;
+	query.minCorner = XMFLOAT3(10.5f, 0, 1.2f);
+	query.maxCorner = XMFLOAT3(11.5f, 1, 1.8f);
+	grid.QueryOverlap(query, results);
+	CHECK(results.size() == 1 && results[0] == 5);
+	query.minCorner.x -= 10;
+	query.maxCorner.x -= 10;
+	grid.QueryOverlap(query, results);
+	CHECK(results.empty());
+
+	// Growing to more than a cell past its own puts it in the oversized list, and back again
+	box.maxCorner.x += 40;
+	grid.Move(proxy, box);
+	CHECK(grid.GetOversizedCount() == 1);
+	box.maxCorner.x -= 40;
+	grid.Move(proxy, box);
+	CHECK(grid.GetOversizedCount() == 0);
+	CHECK(grid.GetItemCount() == 1);
+
+	grid.Remove(proxy);
+	CHECK(grid.GetItemCount() == 0);
+	grid.QueryOverlap(query, results);
+	CHECK(results.empty());
+}
+
+TEST(GridEmpty)
+{
+	SpatialGrid grid;
+	std::vector<unsigned int> results(3, 1);
+	grid.QueryFrustum(nullptr, 0, results);
+	CHECK(results.empty());
+	Aabb everything;
+	everything.minCorner = XMFLOAT3(-1000, -1000, -1000);
+	everything.maxCorner = XMFLOAT3(1000, 1000, 1000);
+	results.push_back(1);
+	grid.QueryOverlap(everything, results);
+	CHECK(results.empty());
+}
+
+TEST(GridBenchmark)
+{
+	// The prop field - 100 by 100 - at more and more props, queried
+	// from cameras standing in it and with small boxes around them,
+	// against the linear scan over every prop it replaced
+	const unsigned int counts[] = { 200, 2000, 20000, 200000 };
+	const unsigned int queries = 200;
+	std::mt19937 random(42);
+	std::uniform_real_distribution<float> any(-1, 1);
+	for (unsigned int count : counts)
+	{
+		SpatialGrid grid;
+		std::vector<Aabb> boxes(count);
+		std::vector<unsigned int> all(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			boxes[i] = MakeProp(random, 50);
+			all[i] = i;
+			grid.Insert(boxes[i], i);
+		}
+
+		std::vector<unsigned int> results, expected;
+		double frustumGrid = 0, frustumScan = 0, overlapGrid = 0, overlapScan = 0;
+		unsigned int mismatches = 0;
+		for (unsigned int q = 0; q < queries; q++)
+		{
+			XMFLOAT3 eye(any(random) * 50, 1, any(random) * 50);
+			XMMATRIX viewMatrix = XMMatrixLookToLH(XMLoadFloat3(&eye), XMMatrixRotationRollPitchYaw(any(random) * 0.3f, any(random) * 3.1f, 0).r[2], XMVectorSet(0, 1, 0, 0));
+			XMFLOAT4 planes[FrustumCuller::PlaneCount];
+			FrustumCuller::ExtractPlanes(viewMatrix * XMMatrixPerspectiveFovLH(XM_PIDIV2, 16.0f / 9.0f, 0.01f, 100.0f), planes);
+			{
+				TestTimer timer;
+				grid.QueryFrustum(planes, FrustumCuller::PlaneCount, results);
+				frustumGrid += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				FrustumCuller::CullReference(&boxes[0], &all[0], count, planes, FrustumCuller::PlaneCount, expected);
+				frustumScan += timer.GetMilliseconds();
+			}
+			//the grid can leave out boxes off in the corners that can't be on screen anyway
+			std::sort(results.begin(), results.end());
+			mismatches += !std::includes(expected.begin(), expected.end(), results.begin(), results.end());
+
+			Aabb query;
+			query.minCorner = XMFLOAT3(eye.x - 5, -1, eye.z - 5);
+			query.maxCorner = XMFLOAT3(eye.x + 5, 3, eye.z + 5);
+			{
+				TestTimer timer;
+				grid.QueryOverlap(query, results);
+				overlapGrid += timer.GetMilliseconds();
+			}
+			{
+				TestTimer timer;
+				expected.clear();
+				for (unsigned int i = 0; i < count; i++)
+				{
+					if (Overlaps(boxes[i], query))
+						expected.push_back(i);
+				}
+				overlapScan += timer.GetMilliseconds();
+			}
+			std::sort(results.begin(), results.end());
+			mismatches += results != expected;
+		}
+		CHECK(mismatches == 0);
+
+		double perQuery = 1e3 / queries;
+		printf("    %6u props in %4u cells: frustum %8.1f us (scan %8.1f), 10x10 overlap %6.2f us (scan %7.1f)\n",
+			count, grid.GetCellCount(), frustumGrid * perQuery, frustumScan * perQuery, overlapGrid * perQuery, overlapScan * perQuery);
+	}
+}
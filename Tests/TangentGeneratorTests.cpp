@@ -0,0 +1,95 @@
+#include "TestFramework.h"
+#include "TestMeshes.h"
+#include "../TangentGenerator.h"
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+//biggest distance between the tangents of two copies of the same mesh
+static float LargestDifference(const std::vector<Vertex>& a, const std::vector<Vertex>& b)
+{
+	float largest = 0;
+	for (size_t i = 0; i < a.size(); i++)
+		largest = (std::max)(largest, XMVectorGetX(XMVector3Length(XMLoadFloat3(&a[i].Tangent) - XMLoadFloat3(&b[i].Tangent))));
+	return largest;
+}
+
+//every tangent should come out unit length and flat against its normal
+static void CheckTangents(const std::vector<Vertex>& vertices)
+{
+	for (const Vertex& v : vertices)
+	{
+		XMVECTOR tangent = XMLoadFloat3(&v.Tangent);
+		XMVECTOR normal = XMVector3Normalize(XMLoadFloat3(&v.Normal));
+		CHECK_NEAR(XMVectorGetX(XMVector3Length(tangent)), 1.0f, 0.001f);
+		CHECK(fabsf(XMVectorGetX(XMVector3Dot(tangent, normal))) < 0.001f);
+	}
+}
+
+TEST(TangentsMatchReferenceOnModels)
+{
+	const char* models[] = { "sphere.obj", "torus.obj", "cube.obj", "cylinder.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+		std::vector<Vertex> reference = vertices;
+
+		TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+		TangentGenerator::GenerateReference(&reference[0], (unsigned int)reference.size(), &indices[0], (unsigned int)indices.size());
+
+		float difference = LargestDifference(vertices, reference);
+		printf("    %s: largest difference %g\n", model, difference);
+		CHECK(difference < 0.0001f);
+		CheckTangents(vertices);
+	}
+}
+
+TEST(TangentsMatchReferenceAcrossThreads)
+{
+	// Big enough to get split up, with bumps so the tangents aren't all the same
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	TestMeshes::MakeGrid(256, true, vertices, indices);
+	for (Vertex& v : vertices)
+	{
+		float dx = cosf(v.Position.x * 0.1f) * 0.5f;
+		float dz = cosf(v.Position.z * 0.07f) * 0.35f;
+		v.Position.y = sinf(v.Position.x * 0.1f) * 5 + sinf(v.Position.z * 0.07f) * 5;
+		XMStoreFloat3(&v.Normal, XMVector3Normalize(XMVectorSet(-dx, 1, -dz, 0)));
+	}
+	std::vector<Vertex> reference = vertices;
+
+	TestTimer generateTimer;
+	unsigned int threads = TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+	double generateMs = generateTimer.GetMilliseconds();
+	TestTimer referenceTimer;
+	TangentGenerator::GenerateReference(&reference[0], (unsigned int)reference.size(), &indices[0], (unsigned int)indices.size());
+	double referenceMs = referenceTimer.GetMilliseconds();
+
+	float difference = LargestDifference(vertices, reference);
+	printf("    %u triangles: %.3f ms (%u threads), reference %.3f ms, largest difference %g\n",
+		(unsigned int)indices.size() / 3, generateMs, threads, referenceMs, difference);
+	CHECK(threads >= 1);
+	CHECK(difference < 0.0001f);
+	CheckTangents(vertices);
+}
+
+TEST(TangentsFallBackWithoutUvs)
+{
+	// Every uv the same, so no triangle has any uv area to go on
+	std::vector<Vertex> vertices;
+	std::vector<unsigned int> indices;
+	TestMeshes::MakeGrid(4, false, vertices, indices);
+	for (Vertex& v : vertices)
+	{
+		v.UV = XMFLOAT2(0.5f, 0.5f);
+		v.Tangent = XMFLOAT3(0, 0, 0);
+	}
+
+	TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+	CheckTangents(vertices);
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cmath>
+#include <chrono>
+
+// --------------------------------------------------------
+// Just enough of a test framework for the Tests project
+//
+// TEST(Name) defines a test and registers it before main
+// runs. CHECK records a failure (file, line and condition)
+// and carries on, so one run shows everything that's broken,
+// REQUIRE also ends the test when there's no point going on.
+//
+// Tests run on the cpu only - no window, and the few that
+// need a device get a WARP one, which is d3d11 on the cpu.
+// Benchmarks are just tests that print what they measured.
+// --------------------------------------------------------
+typedef void(*TestFunction)();
+
+class TestRunner
+{
+public:
+	//called by TEST, returns anything so it can initialize a static
+	static int Register(const char* name, TestFunction function);
+	static void Fail(const char* file, int line, const char* condition);
+
+	//runs every test whose name contains filter (all of them if it's null), returns how many failed
+	static int RunAll(const char* filter);
+
+	//path to something in the repo's Assets folder, e.g. "Models/sphere.obj"
+	static std::string GetAssetPath(const char* relativePath);
+
+private:
+	struct Test
+	{
+		const char* name;
+		TestFunction function;
+	};
+	static std::vector<Test>& GetTests();
+	static unsigned int currentFailures;
+};
+
+// Wall clock timing for benchmarks
+class TestTimer
+{
+public:
+	TestTimer() : start(std::chrono::high_resolution_clock::now()) {}
+	double GetMilliseconds() { return std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - start).count(); }
+
+private:
+	std::chrono::high_resolution_clock::time_point start;
+};
+
+#define TEST(name) \
+	static void name(); \
+	static int name##Registered = TestRunner::Register(#name, name); \
+	static void name()
+
+#define CHECK(condition) \
+	do { if (!(condition)) TestRunner::Fail(__FILE__, __LINE__, #condition); } while (0)
+
+#define CHECK_NEAR(a, b, tolerance) \
+	do { if (!(std::fabs((double)(a) - (double)(b)) <= (double)(tolerance))) TestRunner::Fail(__FILE__, __LINE__, #a " ~= " #b); } while (0)
+
+#define REQUIRE(condition) \
+	do { if (!(condition)) { TestRunner::Fail(__FILE__, __LINE__, #condition); return; } } while (0)
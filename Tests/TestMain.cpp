@@ -0,0 +1,69 @@
+#include "TestFramework.h"
+#include <cstdio>
+#include <cstring>
+
+unsigned int TestRunner::currentFailures = 0;
+
+std::vector<TestRunner::Test>& TestRunner::GetTests()
+{
+	//a function static so it exists before any TEST registers itself
+	static std::vector<Test> tests;
+	return tests;
+}
+
+int TestRunner::Register(const char* name, TestFunction function)
+{
+	Test test = { name, function };
+	GetTests().push_back(test);
+	return (int)GetTests().size();
+}
+
+void TestRunner::Fail(const char* file, int line, const char* condition)
+{
+	currentFailures++;
+	printf("    %s(%d): failed %s\n", file, line, condition);
+}
+
+int TestRunner::RunAll(const char* filter)
+{
+	int failed = 0;
+	int run = 0;
+	for (Test& test : GetTests())
+	{
+		if (filter && !strstr(test.name, filter))
+			continue;
+
+		printf("[ RUN  ] %s\n", test.name);
+		currentFailures = 0;
+		TestTimer timer;
+		test.function();
+		double ms = timer.GetMilliseconds();
+
+		printf("[ %s ] %s (%.1f ms)\n", currentFailures ? "FAIL" : " OK ", test.name, ms);
+		if (currentFailures)
+			failed++;
+		run++;
+	}
+
+	printf("\n%d of %d tests passed\n", run - failed, run);
+	return failed;
+}
+
+std::string TestRunner::GetAssetPath(const char* relativePath)
+{
+	// Relative to this file rather than the working directory,
+	// so it doesn't matter where the exe is run from
+	std::string path = __FILE__;
+	size_t slash = path.find_last_of("/\\");
+	path = slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+	return path + "../Assets/" + relativePath;
+}
+
+// --------------------------------------------------------
+// Runs every test, or the ones whose names contain the first argument
+// - Returns how many failed, so a build step can check it
+// --------------------------------------------------------
+int main(int argc, char* argv[])
+{
+	return TestRunner::RunAll(argc > 1 ? argv[1] : 0);
+}
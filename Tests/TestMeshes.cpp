@@ -0,0 +1,120 @@
+#include "TestMeshes.h"
+#include "TestFramework.h"
+#include "../ObjParser.h"
+#include <map>
+#include <tuple>
+#include <array>
+#include <random>
+#include <algorithm>
+
+using namespace DirectX;
+
+bool TestMeshes::LoadModel(const char* name, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	ObjParser parser;
+	ObjData obj;
+	if (!parser.Parse(TestRunner::GetAssetPath((std::string("Models/") + name).c_str()).c_str(), obj) || obj.corners.empty())
+		return false;
+
+	vertices.clear();
+	indices.clear();
+	std::map<std::tuple<unsigned int, unsigned int, unsigned int>, unsigned int> welded;
+	for (size_t i = 0; i + 2 < obj.corners.size(); i += 3)
+	{
+		unsigned int triangle[3];
+		for (int c = 0; c < 3; c++)
+		{
+			const ObjCorner& corner = obj.corners[i + c];
+			auto key = std::make_tuple(corner.position, corner.uv, corner.normal);
+			auto found = welded.find(key);
+			if (found == welded.end())
+			{
+				Vertex v;
+				v.Position = obj.positions[corner.position];
+				v.UV = obj.uvs[corner.uv];
+				v.Normal = obj.normals[corner.normal];
+				v.Tangent = XMFLOAT3(0, 0, 0);
+				found = welded.insert({ key, (unsigned int)vertices.size() }).first;
+				vertices.push_back(v);
+			}
+			triangle[c] = found->second;
+		}
+
+		// Same left handed flip as Mesh
+		indices.push_back(triangle[0]);
+		indices.push_back(triangle[2]);
+		indices.push_back(triangle[1]);
+	}
+	for (Vertex& v : vertices)
+	{
+		v.UV.y = 1.0f - v.UV.y;
+		v.Position.z *= -1.0f;
+		v.Normal.z *= -1.0f;
+	}
+	return true;
+}
+
+void TestMeshes::MakeGrid(unsigned int size, bool shuffled, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices)
+{
+	vertices.clear();
+	indices.clear();
+	for (unsigned int z = 0; z <= size; z++)
+	{
+		for (unsigned int x = 0; x <= size; x++)
+		{
+			Vertex v;
+			v.Position = XMFLOAT3((float)x, 0, (float)z);
+			v.UV = XMFLOAT2(x / (float)size, z / (float)size);
+			v.Normal = XMFLOAT3(0, 1, 0);
+			v.Tangent = XMFLOAT3(1, 0, 0);
+			vertices.push_back(v);
+		}
+	}
+
+	// Clockwise from above, so the front faces point up
+	std::vector<std::array<unsigned int, 3>> triangles;
+	for (unsigned int z = 0; z < size; z++)
+	{
+		for (unsigned int x = 0; x < size; x++)
+		{
+			unsigned int a = z * (size + 1) + x;
+			unsigned int b = a + size + 1;
+			triangles.push_back({ { a, b, a + 1 } });
+			triangles.push_back({ { a + 1, b, b + 1 } });
+		}
+	}
+	if (shuffled)
+	{
+		std::mt19937 random(1234);
+		std::shuffle(triangles.begin(), triangles.end(), random);
+	}
+	for (auto& triangle : triangles)
+		indices.insert(indices.end(), triangle.begin(), triangle.end());
+}
+
+std::vector<float> TestMeshes::GetSortedTriangles(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount)
+{
+	typedef std::array<float, 9> Triangle;
+	std::vector<Triangle> triangles;
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		Triangle corners[3];
+		for (int start = 0; start < 3; start++)
+		{
+			for (int c = 0; c < 3; c++)
+			{
+				const XMFLOAT3& p = vertices[indices[i + (start + c) % 3]].Position;
+				corners[start][c * 3] = p.x;
+				corners[start][c * 3 + 1] = p.y;
+				corners[start][c * 3 + 2] = p.z;
+			}
+		}
+		triangles.push_back((std::min)((std::min)(corners[0], corners[1]), corners[2]));
+	}
+	std::sort(triangles.begin(), triangles.end());
+
+	std::vector<float> flat;
+	for (Triangle& t : triangles)
+		flat.insert(flat.end(), t.begin(), t.end());
+	return flat;
+}
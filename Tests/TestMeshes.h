@@ -0,0 +1,21 @@
+#pragma once
+#include <vector>
+#include "../Vertex.h"
+
+// --------------------------------------------------------
+// Meshes for the tests to work on, made without Mesh so
+// nothing needs a device
+// --------------------------------------------------------
+class TestMeshes
+{
+public:
+	//a model from Assets/Models, welded into an indexed mesh the way Mesh::BuildData does before any processing
+	static bool LoadModel(const char* name, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	//size x size quads on the xz plane facing up, shuffled puts the triangles in a random (but repeatable) order
+	static void MakeGrid(unsigned int size, bool shuffled, std::vector<Vertex>& vertices, std::vector<unsigned int>& indices);
+
+	//every triangle by the positions of its corners, rotated to a fixed start and sorted - equal when two
+	//index buffers draw the same triangles with the same winding, whatever order they're in
+	static std::vector<float> GetSortedTriangles(const Vertex* vertices, const unsigned int* indices, unsigned int indexCount);
+};
@@ -0,0 +1,169 @@
+#include "TestFramework.h"
+#include "../TextureCache.h"
+#include <vector>
+
+using namespace Microsoft::WRL;
+
+// Stands in for a texture the loader made - the cache only
+// passes srvs around and compares them, it never looks inside.
+// Lives on the stack, so it counts references but never deletes itself
+class FakeView : public ID3D11ShaderResourceView
+{
+public:
+	HRESULT STDMETHODCALLTYPE QueryInterface(REFIID, void** object) { *object = 0; return E_NOINTERFACE; }
+	ULONG STDMETHODCALLTYPE AddRef() { return ++references; }
+	ULONG STDMETHODCALLTYPE Release() { return --references; }
+	void STDMETHODCALLTYPE GetDevice(ID3D11Device** device) { *device = 0; }
+	HRESULT STDMETHODCALLTYPE GetPrivateData(REFGUID, UINT*, void*) { return E_FAIL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateData(REFGUID, UINT, const void*) { return E_FAIL; }
+	HRESULT STDMETHODCALLTYPE SetPrivateDataInterface(REFGUID, const IUnknown*) { return E_FAIL; }
+	void STDMETHODCALLTYPE GetResource(ID3D11Resource** resource) { *resource = 0; }
+	void STDMETHODCALLTYPE GetDesc(D3D11_SHADER_RESOURCE_VIEW_DESC* desc) { *desc = {}; }
+
+	ULONG references = 0;
+};
+
+//the callback a request passes in, keeping what it was handed
+struct ReadyResult
+{
+	unsigned int calls = 0;
+	ID3D11ShaderResourceView* srv = 0;
+
+	TextureReadyCallback Callback()
+	{
+		return [this](ComPtr<ID3D11ShaderResourceView> view)
+		{
+			calls++;
+			srv = view.Get();
+		};
+	}
+};
+
+TEST(TextureCacheSharesLoads)
+{
+	FakeView grass;
+	ReadyResult first, second, third, normalMap;
+	TextureCache cache;
+
+	// The first request misses and has to load it, one for the same
+	// file written another way waits on that load, and one for
+	// another kind of texture from the same file is its own load
+	CHECK(!cache.Request(L"Textures/Grass.png", TextureKind::Color, first.Callback()));
+	CHECK(cache.Request(L"textures\\GRASS.png", TextureKind::Color, second.Callback()));
+	CHECK(!cache.Request(L"Textures/Grass.png", TextureKind::NormalMap, normalMap.Callback()));
+	CHECK(first.calls == 0 && second.calls == 0);
+	CHECK(cache.GetTextureCount() == 0);
+
+	// A hit mid-load is only counted as saved once the size is known
+	CHECK(cache.GetHitCount() == 1);
+	CHECK(cache.GetBytesSaved() == 0);
+	cache.Resolve(L"Textures/Grass.png", TextureKind::Color, &grass, 1234, 1000);
+	CHECK(first.calls == 1 && first.srv == &grass);
+	CHECK(second.calls == 1 && second.srv == &grass);
+	CHECK(cache.GetBytesSaved() == 1000);
+	CHECK(cache.GetTextureCount() == 1);
+	CHECK(cache.GetBytesResident() == 1000);
+
+	// Once it's loaded a hit gets it right away
+	CHECK(cache.Request(L"Textures/Grass.png", TextureKind::Color, third.Callback()));
+	CHECK(third.calls == 1 && third.srv == &grass);
+	CHECK(cache.GetRequestCount() == 4);
+	CHECK(cache.GetHitCount() == 2);
+	CHECK_NEAR(cache.GetHitRate(), 0.5f, 1e-6f);
+	CHECK(cache.GetBytesSaved() == 2000);
+
+	// A failed load drops what was waiting on it, and the next request tries again
+	cache.Resolve(L"Textures/Grass.png", TextureKind::NormalMap, nullptr, 0, 0);
+	CHECK(normalMap.calls == 0);
+	CHECK(!cache.Request(L"Textures/Grass.png", TextureKind::NormalMap, normalMap.Callback()));
+
+	// It stays until every request has let go of it
+	cache.Release(L"Textures/Grass.png", TextureKind::Color);
+	cache.Release(L"Textures/Grass.png", TextureKind::Color);
+	CHECK(cache.GetTextureCount() == 1);
+	cache.Release(L"Textures/Grass.png", TextureKind::Color);
+	CHECK(cache.GetTextureCount() == 0);
+	CHECK(cache.GetBytesResident() == 0);
+	CHECK(!cache.FindContents(1234, TextureKind::Color));
+	CHECK(!cache.Request(L"Textures/Grass.png", TextureKind::Color, first.Callback()));
+}
+
+TEST(TextureCacheSharesContents)
+{
+	FakeView rock, newRock;
+	ReadyResult original, copy, another;
+	TextureCache cache;
+
+	CHECK(!cache.Request(L"Textures/Rock.png", TextureKind::Color, original.Callback()));
+	cache.Resolve(L"Textures/Rock.png", TextureKind::Color, &rock, 77, 500);
+
+	// A copy under another name misses on its path, but once its bytes
+	// are read and hashed the loader finds the texture they made - only
+	// for the same kind, the same bytes imported another way aren't it
+	CHECK(!cache.Request(L"Textures/RockCopy.png", TextureKind::Color, copy.Callback()));
+	CHECK(cache.FindContents(77, TextureKind::Color).Get() == &rock);
+	CHECK(!cache.FindContents(77, TextureKind::Mask));
+	CHECK(!cache.FindContents(78, TextureKind::Color));
+	cache.Resolve(L"Textures/RockCopy.png", TextureKind::Color, &rock, 77, 500);
+	CHECK(copy.calls == 1 && copy.srv == &rock);
+	CHECK(cache.GetHitCount() == 1);
+	CHECK(cache.GetBytesSaved() == 500);
+	CHECK(cache.GetTextureCount() == 1);
+	CHECK(cache.GetBytesResident() == 500);
+
+	// Letting go of the path the contents were found under hands them
+	// to the copy, which now holds the only texture
+	cache.Release(L"Textures/Rock.png", TextureKind::Color);
+	CHECK(cache.FindContents(77, TextureKind::Color).Get() == &rock);
+	CHECK(cache.GetTextureCount() == 1);
+	CHECK(cache.GetBytesResident() == 500);
+
+	// And again down a chain of copies
+	CHECK(!cache.Request(L"Textures/RockAgain.png", TextureKind::Color, another.Callback()));
+	cache.Resolve(L"Textures/RockAgain.png", TextureKind::Color, cache.FindContents(77, TextureKind::Color), 77, 500);
+	CHECK(another.srv == &rock);
+	CHECK(cache.GetTextureCount() == 1);
+	cache.Release(L"Textures/RockCopy.png", TextureKind::Color);
+	CHECK(cache.FindContents(77, TextureKind::Color).Get() == &rock);
+	CHECK(cache.GetBytesResident() == 500);
+	cache.Release(L"Textures/RockAgain.png", TextureKind::Color);
+	CHECK(!cache.FindContents(77, TextureKind::Color));
+	CHECK(cache.GetTextureCount() == 0);
+
+	// Different bytes under the old path aren't shared with anything
+	CHECK(!cache.Request(L"Textures/Rock.png", TextureKind::Color, original.Callback()));
+	cache.Resolve(L"Textures/Rock.png", TextureKind::Color, &newRock, 79, 500);
+	CHECK(original.srv == &newRock);
+	CHECK(cache.GetHitCount() == 2);
+	CHECK(cache.GetBytesSaved() == 1000);
+}
+
+TEST(TextureCacheReleaseWhileLoading)
+{
+	FakeView wood;
+	ReadyResult first, second;
+	TextureCache cache;
+
+	// Let go of before it's in - the load that finishes has nowhere to go
+	CHECK(!cache.Request(L"Textures/Wood.png", TextureKind::Color, first.Callback()));
+	cache.Release(L"Textures/Wood.png", TextureKind::Color);
+	cache.Resolve(L"Textures/Wood.png", TextureKind::Color, &wood, 5, 300);
+	CHECK(first.calls == 0);
+	CHECK(cache.GetTextureCount() == 0);
+
+	// Asked for again mid-load it's a second load - whichever finishes
+	// first hands it out, and neither counts as a hit or as saved
+	CHECK(!cache.Request(L"Textures/Wood.png", TextureKind::Color, first.Callback()));
+	cache.Release(L"Textures/Wood.png", TextureKind::Color);
+	CHECK(!cache.Request(L"Textures/Wood.png", TextureKind::Color, second.Callback()));
+	cache.Resolve(L"Textures/Wood.png", TextureKind::Color, &wood, 5, 300);
+	cache.Resolve(L"Textures/Wood.png", TextureKind::Color, &wood, 5, 300);
+	CHECK(first.calls == 0);
+	CHECK(second.calls == 1 && second.srv == &wood);
+	CHECK(cache.GetHitCount() == 0);
+	CHECK(cache.GetBytesSaved() == 0);
+	CHECK(cache.GetTextureCount() == 1);
+	cache.Release(L"Textures/Wood.png", TextureKind::Color);
+	CHECK(cache.GetTextureCount() == 0);
+	CHECK(!cache.FindContents(5, TextureKind::Color));
+}
@@ -0,0 +1,176 @@
+#include "TestFramework.h"
+#include "../TextureCompressor.h"
+#include <cstdio>
+#include <cmath>
+#include <cstring>
+#include <algorithm>
+
+//smooth color with a bit of everything going on, like a typical painted texture
+static ImageRgba MakeColorImage(unsigned int width, unsigned int height)
+{
+	ImageRgba image = { width, height };
+	image.pixels.resize((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			unsigned char* p = &image.pixels[((size_t)y * width + x) * 4];
+			p[0] = (unsigned char)(255 * x / (width - 1));
+			p[1] = (unsigned char)(127.5f + 127.5f * sinf(y * 0.1f));
+			p[2] = (unsigned char)(127.5f + 127.5f * cosf((x + y) * 0.05f));
+			p[3] = (unsigned char)(255 * y / (height - 1));
+		}
+	}
+	return image;
+}
+
+//tangent space normals of a bumpy surface, packed the usual 0-255 way
+static ImageRgba MakeNormalImage(unsigned int width, unsigned int height)
+{
+	ImageRgba image = { width, height };
+	image.pixels.resize((size_t)width * height * 4);
+	for (unsigned int y = 0; y < height; y++)
+	{
+		for (unsigned int x = 0; x < width; x++)
+		{
+			float dx = cosf(x * 0.2f) * 0.5f;
+			float dy = cosf(y * 0.15f) * 0.5f;
+			float length = sqrtf(dx * dx + dy * dy + 1);
+			unsigned char* p = &image.pixels[((size_t)y * width + x) * 4];
+			p[0] = (unsigned char)(127.5f + 127.5f * -dx / length);
+			p[1] = (unsigned char)(127.5f + 127.5f * -dy / length);
+			p[2] = (unsigned char)(127.5f + 127.5f / length);
+			p[3] = 255;
+		}
+	}
+	return image;
+}
+
+TEST(CompressedTexturesKeepTheirQuality)
+{
+	struct Case { const char* name; BlockFormat format; MipFilter filter; ImageRgba image; unsigned int channels; float minimumPsnr; };
+	ImageRgba color = MakeColorImage(128, 64);
+	ImageRgba opaque = color;
+	for (size_t i = 3; i < opaque.pixels.size(); i += 4)
+		opaque.pixels[i] = 255;
+	Case cases[] = {
+		{ "BC1", BlockFormat::BC1, MipFilter::Color, opaque, 3, 35.0f },
+		{ "BC4", BlockFormat::BC4, MipFilter::Linear, color, 1, 40.0f },
+		{ "BC5", BlockFormat::BC5, MipFilter::Normal, MakeNormalImage(128, 64), 2, 40.0f },
+		{ "BC7", BlockFormat::BC7, MipFilter::Color, color, 4, 40.0f } };
+
+	for (Case& c : cases)
+	{
+		CompressedTexture texture;
+		TextureCompressor::Compress(c.image, c.format, c.filter, false, texture);
+
+		ImageRgba decoded;
+		TextureCompressor::Decompress(texture, 0, decoded);
+		float psnr = TextureCompressor::ComputePsnr(c.image, decoded, c.channels);
+		printf("    %s: PSNR %.2f dB, %u bytes\n", c.name, psnr, (unsigned int)texture.blocks.size());
+
+		CHECK(psnr >= c.minimumPsnr);
+		CHECK_NEAR(texture.psnr, psnr, 0.001f);
+
+		//the channels a format drops come back as 0, alpha as 255
+		if (c.format == BlockFormat::BC4 || c.format == BlockFormat::BC5)
+		{
+			for (size_t i = 0; i < decoded.pixels.size(); i += 4)
+			{
+				CHECK(decoded.pixels[i + 2] == 0);
+				CHECK(decoded.pixels[i + 3] == 255);
+				if (c.format == BlockFormat::BC4)
+					CHECK(decoded.pixels[i + 1] == 0);
+			}
+		}
+	}
+}
+
+TEST(CompressedMipChainLayout)
+{
+	// Not square and not a power of two, so the small levels get partial blocks
+	CompressedTexture texture;
+	TextureCompressor::Compress(MakeColorImage(100, 36), BlockFormat::BC7, MipFilter::Color, true, texture);
+	CHECK(texture.format == DXGI_FORMAT_BC7_UNORM_SRGB);
+	CHECK(texture.mipCount == 7);
+	REQUIRE(texture.mipOffsets.size() == texture.mipCount);
+
+	size_t offset = 0;
+	for (unsigned int mip = 0; mip < texture.mipCount; mip++)
+	{
+		unsigned int width = (std::max)(100u >> mip, 1u);
+		unsigned int height = (std::max)(36u >> mip, 1u);
+		CHECK(texture.mipOffsets[mip] == offset);
+		offset += (size_t)((width + 3) / 4) * ((height + 3) / 4) * 16;
+
+		ImageRgba decoded;
+		TextureCompressor::Decompress(texture, mip, decoded);
+		CHECK(decoded.width == width);
+		CHECK(decoded.height == height);
+	}
+	CHECK(texture.blocks.size() == offset);
+}
+
+TEST(SolidBlocksStayFlat)
+{
+	// One flat color per block - the single channel formats store
+	// those exactly, BC1 and BC7 round to their endpoint precision
+	ImageRgba image = { 8, 8 };
+	image.pixels.resize(8 * 8 * 4);
+	for (unsigned int i = 0; i < 64; i++)
+	{
+		unsigned char* p = &image.pixels[i * 4];
+		bool right = (i % 8) >= 4;
+		p[0] = right ? 200 : 16;
+		p[1] = right ? 96 : 240;
+		p[2] = right ? 8 : 128;
+		p[3] = 255;
+	}
+
+	BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+	float minimumPsnr[] = { 40.0f, 99.0f, 99.0f, 50.0f };
+	for (int f = 0; f < 4; f++)
+	{
+		CompressedTexture texture;
+		TextureCompressor::Compress(image, formats[f], MipFilter::Linear, false, texture);
+		CHECK(texture.psnr >= minimumPsnr[f]);
+
+		// And every pixel of a block decodes to the same color
+		ImageRgba decoded;
+		TextureCompressor::Decompress(texture, 0, decoded);
+		for (unsigned int i = 0; i < 64; i++)
+		{
+			unsigned int corner = (i / 8 / 4 * 4 * 8 + i % 8 / 4 * 4) * 4;
+			CHECK(memcmp(&decoded.pixels[i * 4], &decoded.pixels[corner], 4) == 0);
+		}
+	}
+}
+
+TEST(DdsLayoutRoundTrip)
+{
+	BlockFormat formats[] = { BlockFormat::BC1, BlockFormat::BC4, BlockFormat::BC5, BlockFormat::BC7 };
+	for (BlockFormat format : formats)
+	{
+		CompressedTexture texture;
+		TextureCompressor::Compress(MakeColorImage(64, 32), format, MipFilter::Linear, false, texture);
+
+		std::string source = TestRunner::GetAssetPath("Textures/RampTexture.png");
+		std::vector<unsigned char> dds;
+		TextureCompressor::BuildDds(texture, std::wstring(source.begin(), source.end()), dds);
+
+		CompressedTexture layout;
+		size_t blocksOffset = 0;
+		REQUIRE(TextureCompressor::ReadDdsLayout(dds, layout, blocksOffset));
+		CHECK(layout.width == texture.width);
+		CHECK(layout.height == texture.height);
+		CHECK(layout.mipCount == texture.mipCount);
+		CHECK(layout.format == texture.format);
+		CHECK(layout.mipOffsets == texture.mipOffsets);
+		REQUIRE(blocksOffset + texture.blocks.size() == dds.size());
+		CHECK(memcmp(&dds[blocksOffset], &texture.blocks[0], texture.blocks.size()) == 0);
+
+		// Cut short, it doesn't add up any more
+		dds.pop_back();
+		CHECK(!TextureCompressor::ReadDdsLayout(dds, layout, blocksOffset));
+	}
+}
@@ -0,0 +1,347 @@
+#include "TestFramework.h"
+#include "../TextureStreamer.h"
+#include <random>
+#include <map>
+
+//a 256x256 BC7 chain, 64KB at the top down to one block
+static std::vector<unsigned long long> MakeLevels()
+{
+	std::vector<unsigned long long> levels;
+	for (unsigned int size = 256; size >= 1; size /= 2)
+		levels.push_back((unsigned long long)((size + 3) / 4) * ((size + 3) / 4) * 16);
+	return levels;
+}
+
+static unsigned long long BytesFrom(const std::vector<unsigned long long>& levels, unsigned int mip)
+{
+	unsigned long long bytes = 0;
+	for (unsigned int level = mip; level < levels.size(); level++)
+		bytes += levels[level];
+	return bytes;
+}
+
+//plans, then finishes every load it started the way succeeded says
+static std::vector<MipChange> PlanAndFinish(MipResidency& residency, unsigned int maxLoads, bool succeeded = true)
+{
+	std::vector<MipChange> changes;
+	residency.Plan(maxLoads, changes);
+	for (const MipChange& change : changes)
+	{
+		if (change.toMip < change.fromMip)
+			residency.FinishLoad(change.texture, succeeded);
+	}
+	return changes;
+}
+
+TEST(ResidencyLoadsRequestedMips)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int texture = residency.AddTexture(levels, 3);
+	CHECK(residency.GetResidentMip(texture) == 3);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 3));
+
+	residency.BeginFrame();
+	residency.RequestMip(texture, 5);
+	residency.RequestMip(texture, 1);
+	CHECK(residency.GetRequiredMip(texture) == 1);
+
+	// The load holds its bytes from Plan on
+	std::vector<MipChange> changes;
+	residency.Plan(4, changes);
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].texture == texture);
+	CHECK(changes[0].fromMip == 3);
+	CHECK(changes[0].toMip == 1);
+	CHECK(residency.IsLoading(texture));
+	CHECK(residency.GetLoadCount() == 1);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 1));
+
+	// Nothing new to do while it's going
+	std::vector<MipChange> again;
+	residency.Plan(4, again);
+	CHECK(again.empty());
+
+	residency.FinishLoad(texture, true);
+	CHECK(!residency.IsLoading(texture));
+	CHECK(residency.GetLoadCount() == 0);
+	CHECK(residency.GetResidentMip(texture) == 1);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 1));
+}
+
+TEST(ResidencyFailedLoadGivesBytesBack)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int texture = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(texture, 0);
+	PlanAndFinish(residency, 4, false);
+	CHECK(residency.GetResidentMip(texture) == 4);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 4));
+	CHECK(residency.GetLoadCount() == 0);
+}
+
+TEST(ResidencyNeverGoesPastStartMip)
+{
+	// Asking for less than it has is the same as asking for nothing
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(0);
+	unsigned int texture = residency.AddTexture(levels, 3);
+
+	residency.BeginFrame();
+	residency.RequestMip(texture, 7);
+	CHECK(residency.GetRequiredMip(texture) == 3);
+	CHECK(PlanAndFinish(residency, 4).empty());
+	CHECK(residency.GetResidentMip(texture) == 3);
+}
+
+TEST(ResidencyLimitsLoadsAndPicksTheNeediest)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int a = residency.AddTexture(levels, 4);
+	unsigned int b = residency.AddTexture(levels, 4);
+	unsigned int c = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(a, 3);
+	residency.RequestMip(b, 0);
+	residency.RequestMip(c, 2);
+
+	std::vector<MipChange> changes;
+	residency.Plan(2, changes);
+	REQUIRE(changes.size() == 2);
+	CHECK(changes[0].texture == b);
+	CHECK(changes[1].texture == c);
+	CHECK(!residency.IsLoading(a));
+	CHECK(residency.GetLoadCount() == 2);
+}
+
+TEST(ResidencyEvictsLeastRecentlyNeeded)
+{
+	// Room for exactly what the first two frames ask for
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(BytesFrom(levels, 0) + BytesFrom(levels, 2) + BytesFrom(levels, 4));
+	unsigned int a = residency.AddTexture(levels, 4);
+	unsigned int b = residency.AddTexture(levels, 4);
+	unsigned int c = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(a, 0);
+	PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(a) == 0);
+
+	residency.BeginFrame();
+	residency.RequestMip(b, 2);
+	PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(b) == 2);
+
+	// b was needed more recently than a, so a's levels go first
+	residency.BeginFrame();
+	residency.RequestMip(c, 1);
+	std::vector<MipChange> changes = PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(c) == 1);
+	CHECK(residency.GetResidentMip(b) == 2);
+	CHECK(residency.GetResidentMip(a) == 1);
+	CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+
+	// Drops come first in the list, from where it was to where it is now
+	REQUIRE(!changes.empty());
+	CHECK(changes[0].texture == a);
+	CHECK(changes[0].fromMip == 0);
+	CHECK(changes[0].toMip == residency.GetResidentMip(a));
+}
+
+TEST(ResidencyKeepsNeededLevelsForLoads)
+{
+	// Both wanted at once and only room for one - the other waits
+	// rather than taking levels that are on screen
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(BytesFrom(levels, 0) + BytesFrom(levels, 4));
+	unsigned int a = residency.AddTexture(levels, 4);
+	unsigned int b = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(a, 0);
+	PlanAndFinish(residency, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(a, 0);
+	residency.RequestMip(b, 0);
+	PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(a) == 0);
+	CHECK(residency.GetResidentMip(b) == 4);
+	CHECK(residency.GetResidentBytes() <= residency.GetBudget());
+}
+
+TEST(ResidencyLoweredBudgetDropsNeededLevels)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int texture = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(texture, 0);
+	PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(texture) == 0);
+
+	residency.SetBudget(BytesFrom(levels, 2));
+	residency.BeginFrame();
+	residency.RequestMip(texture, 0);
+	std::vector<MipChange> changes = PlanAndFinish(residency, 4);
+	CHECK(residency.GetResidentMip(texture) == 2);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 2));
+	REQUIRE(changes.size() == 1);
+	CHECK(changes[0].fromMip == 0);
+	CHECK(changes[0].toMip == 2);
+}
+
+TEST(ResidencyCancelDropPutsLevelsBack)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int texture = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(texture, 0);
+	PlanAndFinish(residency, 4);
+
+	residency.SetBudget(BytesFrom(levels, 3));
+	residency.BeginFrame();
+	std::vector<MipChange> changes;
+	residency.Plan(4, changes);
+	REQUIRE(changes.size() == 1);
+	CHECK(residency.GetResidentMip(texture) == 3);
+
+	residency.CancelDrop(changes[0]);
+	CHECK(residency.GetResidentMip(texture) == 0);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 0));
+
+	// A second cancel of the same drop does nothing
+	residency.CancelDrop(changes[0]);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 0));
+}
+
+TEST(ResidencyRemoveTexture)
+{
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	residency.SetBudget(1 << 20);
+	unsigned int a = residency.AddTexture(levels, 4);
+	unsigned int b = residency.AddTexture(levels, 4);
+
+	residency.BeginFrame();
+	residency.RequestMip(a, 1);
+	PlanAndFinish(residency, 4);
+
+	residency.RemoveTexture(a);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 4));
+	CHECK(residency.GetTextureCount() == 2);
+
+	// Removing twice gives nothing back twice
+	residency.RemoveTexture(a);
+	CHECK(residency.GetResidentBytes() == BytesFrom(levels, 4));
+
+	// And it's never planned for again
+	residency.BeginFrame();
+	residency.RequestMip(a, 0);
+	std::vector<MipChange> changes;
+	residency.Plan(4, changes);
+	CHECK(changes.empty());
+
+	// Removed mid load, the load's bytes go with it and finishing it changes nothing
+	residency.BeginFrame();
+	residency.RequestMip(b, 0);
+	residency.Plan(4, changes);
+	REQUIRE(changes.size() == 1);
+	residency.RemoveTexture(b);
+	CHECK(residency.GetResidentBytes() == 0);
+	residency.FinishLoad(b, true);
+	CHECK(residency.GetLoadCount() == 0);
+	CHECK(residency.GetResidentBytes() == 0);
+}
+
+TEST(ResidencyBytesAlwaysAddUp)
+{
+	// Random requests, budgets and failures - the count it keeps has
+	// to match what the changes it handed out add up to
+	std::vector<unsigned long long> levels = MakeLevels();
+	MipResidency residency;
+	std::mt19937 random(42);
+	const unsigned int count = 16;
+	std::vector<unsigned int> resident(count);
+	std::map<unsigned int, unsigned int> loading;
+	std::vector<bool> removed(count, false);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		resident[i] = 3 + i % 3;
+		residency.AddTexture(levels, resident[i]);
+	}
+
+	for (int frame = 0; frame < 500; frame++)
+	{
+		if (frame % 50 == 0)
+			residency.SetBudget(BytesFrom(levels, 0) * (1 + random() % 6));
+
+		residency.BeginFrame();
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (random() % 3 == 0)
+				residency.RequestMip(i, random() % (unsigned int)levels.size());
+		}
+
+		std::vector<MipChange> changes;
+		residency.Plan(3, changes);
+		for (const MipChange& change : changes)
+		{
+			CHECK(change.fromMip == resident[change.texture]);
+			if (change.toMip > change.fromMip)
+				resident[change.texture] = change.toMip;
+			else
+				loading[change.texture] = change.toMip;
+		}
+
+		// Finish about half the loads, one in five of those failing
+		for (auto it = loading.begin(); it != loading.end();)
+		{
+			if (random() % 2)
+			{
+				++it;
+				continue;
+			}
+			bool succeeded = random() % 5 != 0;
+			residency.FinishLoad(it->first, succeeded);
+			if (succeeded && !removed[it->first])
+				resident[it->first] = it->second;
+			it = loading.erase(it);
+		}
+
+		if (frame == 300)
+		{
+			residency.RemoveTexture(5);
+			removed[5] = true;
+		}
+
+		unsigned long long expected = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			if (removed[i])
+				continue;
+			auto found = loading.find(i);
+			expected += BytesFrom(levels, found != loading.end() ? found->second : resident[i]);
+			CHECK(residency.GetResidentMip(i) == resident[i]);
+		}
+		CHECK(residency.GetResidentBytes() == expected);
+		CHECK(residency.GetLoadCount() == loading.size());
+	}
+}
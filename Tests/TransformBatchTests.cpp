@@ -0,0 +1,198 @@
+#include "TestFramework.h"
+#include "../TransformBatch.h"
+#include "../Transform.h"
+#include <cstdio>
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+//largest difference between a and b, relative to b's largest element
+static float RelativeError(const XMFLOAT4X4& a, const XMFLOAT4X4& b)
+{
+	float largest = 1;
+	float error = 0;
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			largest = (std::max)(largest, fabsf(b.m[r][c]));
+			error = (std::max)(error, fabsf(a.m[r][c] - b.m[r][c]));
+		}
+	}
+	return error / largest;
+}
+
+TEST(BatchMatchesXMMatrix)
+{
+	// Not a multiple of four, every kind of scale, and only some of them asked for
+	const unsigned int count = 10003;
+	std::mt19937 random(3);
+	std::uniform_real_distribution<float> position(-500, 500);
+	std::uniform_real_distribution<float> angle(-7, 7);
+	std::uniform_real_distribution<float> size(0.01f, 100);
+	std::vector<XMFLOAT3> positions(count), rotations(count), scales(count);
+	std::vector<unsigned int> indices;
+	for (unsigned int i = 0; i < count; i++)
+	{
+		positions[i] = XMFLOAT3(position(random), position(random), position(random));
+		rotations[i] = XMFLOAT3(angle(random), angle(random), angle(random));
+		switch (i % 4)
+		{
+		case 0: { float uniform = size(random); scales[i] = XMFLOAT3(uniform, uniform, uniform); break; }
+		case 1: scales[i] = XMFLOAT3(size(random), size(random), size(random)); break;
+		case 2: scales[i] = XMFLOAT3(-size(random) * 0.1f, size(random) * 0.1f, size(random) * 0.1f); break;
+		default: scales[i] = XMFLOAT3(1, 1, 1); break;
+		}
+		if (random() % 3)
+			indices.push_back(i);
+	}
+
+	std::vector<XMFLOAT4X4> worlds(count), inverseTransposes(count);
+	TransformBatch::BuildWorldMatrices(&positions[0], &rotations[0], &scales[0], &indices[0], (unsigned int)indices.size(), &worlds[0], &inverseTransposes[0]);
+
+	float worstWorld = 0;
+	float worstInverse = 0;
+	for (unsigned int i : indices)
+	{
+		XMMATRIX world = XMMatrixScaling(scales[i].x, scales[i].y, scales[i].z) *
+			XMMatrixRotationRollPitchYaw(rotations[i].x, rotations[i].y, rotations[i].z) *
+			XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
+		XMFLOAT4X4 expectedWorld, expectedInverse;
+		XMStoreFloat4x4(&expectedWorld, world);
+		XMStoreFloat4x4(&expectedInverse, XMMatrixTranspose(XMMatrixInverse(0, world)));
+		worstWorld = (std::max)(worstWorld, RelativeError(worlds[i], expectedWorld));
+		worstInverse = (std::max)(worstInverse, RelativeError(inverseTransposes[i], expectedInverse));
+	}
+	printf("    %u matrices: world %.2e, inverse transpose %.2e\n", (unsigned int)indices.size(), worstWorld, worstInverse);
+	CHECK(worstWorld < 1e-5f);
+	CHECK(worstInverse < 1e-4f);
+}
+
+TEST(BatchMatchesReference)
+{
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> any(-5, 5);
+	std::uniform_real_distribution<float> size(0.1f, 4);
+	const unsigned int count = 257;
+	std::vector<XMFLOAT3> positions(count), rotations(count), scales(count);
+	std::vector<unsigned int> indices(count);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		positions[i] = XMFLOAT3(any(random), any(random), any(random));
+		rotations[i] = XMFLOAT3(any(random), any(random), any(random));
+		scales[i] = XMFLOAT3(size(random), size(random), size(random));
+		indices[i] = i;
+	}
+
+	std::vector<XMFLOAT4X4> worlds(count), inverses(count), referenceWorlds(count), referenceInverses(count);
+	TransformBatch::BuildWorldMatrices(&positions[0], &rotations[0], &scales[0], &indices[0], count, &worlds[0], &inverses[0]);
+	TransformBatch::BuildWorldMatricesReference(&positions[0], &rotations[0], &scales[0], &indices[0], count, &referenceWorlds[0], &referenceInverses[0]);
+	for (unsigned int i = 0; i < count; i++)
+	{
+		CHECK(RelativeError(worlds[i], referenceWorlds[i]) < 1e-5f);
+		CHECK(RelativeError(inverses[i], referenceInverses[i]) < 1e-4f);
+	}
+}
+
+TEST(BatchOnlyWritesItsIndices)
+{
+	std::vector<XMFLOAT3> positions(8, XMFLOAT3(1, 2, 3)), rotations(8, XMFLOAT3(0, 0, 0)), scales(8, XMFLOAT3(1, 1, 1));
+	std::vector<XMFLOAT4X4> worlds(8), inverses(8);
+	for (XMFLOAT4X4& m : worlds)
+		m._11 = 42;
+	for (XMFLOAT4X4& m : inverses)
+		m._11 = 42;
+
+	unsigned int indices[] = { 3, 6 };
+	TransformBatch::BuildWorldMatrices(&positions[0], &rotations[0], &scales[0], indices, 2, &worlds[0], &inverses[0]);
+	for (unsigned int i = 0; i < 8; i++)
+	{
+		bool written = i == 3 || i == 6;
+		CHECK((worlds[i]._11 == 42) != written);
+		CHECK((inverses[i]._11 == 42) != written);
+	}
+	CHECK(worlds[3]._41 == 1 && worlds[3]._42 == 2 && worlds[3]._43 == 3);
+}
+
+TEST(BatchFlatScaleKeepsNormals)
+{
+	// A quad squashed flat along y - the inverse transpose still has to
+	// send its up normal up instead of dividing by zero
+	XMFLOAT3 position(0, -0.5f, 0), rotation(0, 0, 0), scale(100, 0, 100);
+	unsigned int index = 0;
+	XMFLOAT4X4 world, inverseTranspose;
+	TransformBatch::BuildWorldMatrices(&position, &rotation, &scale, &index, 1, &world, &inverseTranspose);
+
+	XMFLOAT3 normal;
+	XMStoreFloat3(&normal, XMVector3TransformNormal(XMVectorSet(0, 1, 0, 0), XMLoadFloat4x4(&inverseTranspose)));
+	CHECK(std::isfinite(normal.x) && std::isfinite(normal.y) && std::isfinite(normal.z));
+	CHECK(normal.y > 0);
+	CHECK(normal.x == 0 && normal.z == 0);
+}
+
+TEST(BatchBenchmark)
+{
+	// Every entity's matrices rebuilt, the way each path gets there:
+	// a Transform per entity asked for its inverse transpose (what
+	// GameEntity::Draw used to do), the reference one at a time over
+	// the arrays, and four at a time
+	const unsigned int counts[] = { 1000, 10000, 100000 };
+	std::mt19937 random(4);
+	std::uniform_real_distribution<float> any(-5, 5);
+	for (unsigned int count : counts)
+	{
+		std::vector<XMFLOAT3> positions(count), rotations(count), scales(count);
+		std::vector<unsigned int> indices(count);
+		std::vector<Transform> transforms(count);
+		for (unsigned int i = 0; i < count; i++)
+		{
+			positions[i] = XMFLOAT3(any(random) * 100, any(random), any(random) * 100);
+			rotations[i] = XMFLOAT3(any(random), any(random), any(random));
+			scales[i] = XMFLOAT3(fabsf(any(random)) + 0.1f, fabsf(any(random)) + 0.1f, fabsf(any(random)) + 0.1f);
+			indices[i] = i;
+		}
+		std::vector<XMFLOAT4X4> worlds(count), inverseTransposes(count), referenceWorlds(count), referenceInverses(count);
+
+		//best of a few, about as much work at every size
+		unsigned int rounds = (std::max)(1u, 200000 / count);
+		double perEntity = 1e6, referencePerEntity = 1e6, batchPerEntity = 1e6;
+		for (int run = 0; run < 3; run++)
+		{
+			TestTimer timer;
+			for (unsigned int round = 0; round < rounds; round++)
+			{
+				for (unsigned int i = 0; i < count; i++)
+				{
+					transforms[i].SetScale(scales[i].x, scales[i].y, scales[i].z);
+					transforms[i].SetRotation(rotations[i].x, rotations[i].y, rotations[i].z);
+					transforms[i].SetPosition(positions[i].x, positions[i].y, positions[i].z);
+					inverseTransposes[i] = transforms[i].GetWorldInverseTranspose();
+				}
+			}
+			perEntity = (std::min)(perEntity, timer.GetMilliseconds() * 1e6 / ((double)count * rounds));
+
+			TestTimer referenceTimer;
+			for (unsigned int round = 0; round < rounds; round++)
+				TransformBatch::BuildWorldMatricesReference(&positions[0], &rotations[0], &scales[0], &indices[0], count, &referenceWorlds[0], &referenceInverses[0]);
+			referencePerEntity = (std::min)(referencePerEntity, referenceTimer.GetMilliseconds() * 1e6 / ((double)count * rounds));
+
+			TestTimer batchTimer;
+			for (unsigned int round = 0; round < rounds; round++)
+				TransformBatch::BuildWorldMatrices(&positions[0], &rotations[0], &scales[0], &indices[0], count, &worlds[0], &inverseTransposes[0]);
+			batchPerEntity = (std::min)(batchPerEntity, batchTimer.GetMilliseconds() * 1e6 / ((double)count * rounds));
+		}
+
+		float worst = 0;
+		for (unsigned int i = 0; i < count; i++)
+		{
+			worst = (std::max)(worst, RelativeError(worlds[i], transforms[i].BuildMatrix()));
+			worst = (std::max)(worst, RelativeError(inverseTransposes[i], referenceInverses[i]));
+		}
+		CHECK(worst < 1e-4f);
+		printf("    %6u entities: per Transform %6.1f ns, reference %6.1f ns, batched %5.1f ns each (%.1fx)\n",
+			count, perEntity, referencePerEntity, batchPerEntity, perEntity / batchPerEntity);
+	}
+}
@@ -0,0 +1,143 @@
+#include "TestFramework.h"
+#include "../Transform.h"
+#include <random>
+#include <cmath>
+
+using namespace DirectX;
+
+//every element within tolerance, relative for the big ones
+static bool IsClose(const XMFLOAT4X4& a, FXMMATRIX expected, float tolerance)
+{
+	XMFLOAT4X4 b;
+	XMStoreFloat4x4(&b, expected);
+	for (int r = 0; r < 4; r++)
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			if (fabsf(a.m[r][c] - b.m[r][c]) > tolerance * fmaxf(1.0f, fabsf(b.m[r][c])))
+				return false;
+		}
+	}
+	return true;
+}
+
+static bool IsClose(const XMFLOAT3& a, FXMVECTOR expected, float tolerance)
+{
+	return XMVectorGetX(XMVector3Length(XMLoadFloat3(&a) - expected)) < tolerance;
+}
+
+//what the matrices were when the rotation was kept as pitch, yaw and roll
+static XMMATRIX MakeEulerWorld(const XMFLOAT3& position, float pitch, float yaw, float roll, const XMFLOAT3& scale)
+{
+	return XMMatrixScaling(scale.x, scale.y, scale.z) *
+		XMMatrixRotationRollPitchYaw(pitch, yaw, roll) *
+		XMMatrixTranslation(position.x, position.y, position.z);
+}
+
+TEST(TransformMatchesEulerMatrices)
+{
+	std::mt19937 random(11);
+	std::uniform_real_distribution<float> angle(-10, 10);
+	std::uniform_real_distribution<float> any(-50, 50);
+	std::uniform_real_distribution<float> size(0.1f, 5);
+	for (int i = 0; i < 10000; i++)
+	{
+		float pitch = angle(random), yaw = angle(random), roll = angle(random);
+		XMFLOAT3 position(any(random), any(random), any(random));
+		XMFLOAT3 scale(size(random), size(random), size(random));
+
+		Transform transform;
+		transform.SetPosition(position.x, position.y, position.z);
+		transform.SetScale(scale.x, scale.y, scale.z);
+		transform.SetRotation(pitch, yaw, roll);
+
+		XMMATRIX world = MakeEulerWorld(position, pitch, yaw, roll, scale);
+		CHECK(IsClose(transform.BuildMatrix(), world, 1e-5f));
+		CHECK(IsClose(transform.GetWorldInverseTranspose(), XMMatrixTranspose(XMMatrixInverse(0, world)), 1e-4f));
+
+		XMMATRIX rotation = XMMatrixRotationRollPitchYaw(pitch, yaw, roll);
+		CHECK(IsClose(transform.GetRight(), rotation.r[0], 1e-5f));
+		CHECK(IsClose(transform.GetUp(), rotation.r[1], 1e-5f));
+		CHECK(IsClose(transform.GetForward(), rotation.r[2], 1e-5f));
+
+		// Moving only patches the position into the matrices, they have to come out the same
+		transform.MoveRelative(1, 2, 3);
+		XMVECTOR moved = XMLoadFloat3(&position) + rotation.r[0] * 1 + rotation.r[1] * 2 + rotation.r[2] * 3;
+		CHECK(IsClose(transform.GetPosition(), moved, 1e-4f));
+		XMFLOAT3 newPosition = transform.GetPosition();
+		world = MakeEulerWorld(newPosition, pitch, yaw, roll, scale);
+		CHECK(IsClose(transform.BuildMatrix(), world, 1e-5f));
+		CHECK(IsClose(transform.GetWorldInverseTranspose(), XMMatrixTranspose(XMMatrixInverse(0, world)), 1e-4f));
+	}
+}
+
+TEST(TransformRotationRoundTrip)
+{
+	// The angles that come back may not be the ones that went in, but
+	// they have to turn things the same way - straight up and down included
+	std::mt19937 random(12);
+	std::uniform_real_distribution<float> angle(-3, 3);
+	for (int i = 0; i < 10000; i++)
+	{
+		float pitch = i % 10 == 0 ? XM_PIDIV2 : i % 10 == 1 ? -XM_PIDIV2 : angle(random);
+		float yaw = angle(random), roll = angle(random);
+		Transform transform;
+		transform.SetRotation(pitch, yaw, roll);
+		XMFLOAT3 angles = transform.GetRotation();
+		CHECK(angles.x >= -XM_PIDIV2 - 1e-4f && angles.x <= XM_PIDIV2 + 1e-4f);
+
+		Transform again;
+		again.SetRotation(angles.x, angles.y, angles.z);
+		CHECK(IsClose(again.BuildMatrix(), XMMatrixRotationRollPitchYaw(pitch, yaw, roll), 2e-3f));
+	}
+}
+
+TEST(TransformRotateMatchesAddingAngles)
+{
+	// Mouse look - lots of small pitches and yaws with no roll should
+	// end up where adding them all to the angles would
+	std::mt19937 random(13);
+	std::uniform_real_distribution<float> start(-1, 1);
+	std::uniform_real_distribution<float> step(-0.05f, 0.05f);
+	for (int run = 0; run < 100; run++)
+	{
+		float pitch = start(random), yaw = start(random) * 3;
+		Transform transform;
+		transform.SetRotation(pitch, yaw, 0);
+		for (int i = 0; i < 1000; i++)
+		{
+			float p = step(random), y = step(random);
+			transform.Rotate(p, y, 0);
+			pitch += p;
+			yaw += y;
+		}
+		XMMATRIX rotation = XMMatrixRotationRollPitchYaw(pitch, yaw, 0);
+		CHECK(IsClose(transform.BuildMatrix(), rotation, 2e-3f));
+		CHECK(IsClose(transform.GetForward(), rotation.r[2], 2e-3f));
+	}
+
+	// Roll on its own too, while level
+	Transform rolled;
+	for (int i = 0; i < 100; i++)
+		rolled.Rotate(0, 0, 0.03f);
+	CHECK(IsClose(rolled.BuildMatrix(), XMMatrixRotationRollPitchYaw(0, 0, 3.0f), 1e-3f));
+}
+
+TEST(TransformRotateStaysUnitLength)
+{
+	Transform transform;
+	for (int i = 0; i < 100000; i++)
+		transform.Rotate(0.01f, 0.013f, 0.007f);
+	XMFLOAT4 q = transform.GetRotationQuaternion();
+	CHECK_NEAR(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w, 1.0f, 1e-5f);
+
+	// So the axes are still unit length and square to each other
+	XMFLOAT3 axes[3] = { transform.GetRight(), transform.GetUp(), transform.GetForward() };
+	XMVECTOR right = XMLoadFloat3(&axes[0]);
+	XMVECTOR up = XMLoadFloat3(&axes[1]);
+	XMVECTOR forward = XMLoadFloat3(&axes[2]);
+	CHECK_NEAR(XMVectorGetX(XMVector3Length(right)), 1.0f, 1e-5f);
+	CHECK_NEAR(XMVectorGetX(XMVector3Length(forward)), 1.0f, 1e-5f);
+	CHECK(fabsf(XMVectorGetX(XMVector3Dot(right, up))) < 1e-5f);
+	CHECK(fabsf(XMVectorGetX(XMVector3Dot(up, forward))) < 1e-5f);
+}
@@ -0,0 +1,111 @@
+#include "TestFramework.h"
+#include "TestMeshes.h"
+#include "../VertexCompact.h"
+#include "../TangentGenerator.h"
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+
+using namespace DirectX;
+
+TEST(CompactVertexIsTwentyBytes)
+{
+	CHECK(sizeof(VertexCompact) == 20);
+	CHECK(sizeof(Vertex) == 44);
+}
+
+TEST(OctahedralRoundTrip)
+{
+	// Points spread evenly over the sphere, plus the axes and the
+	// folded corners, where the mapping is most likely to go wrong
+	std::vector<XMFLOAT3> directions = {
+		XMFLOAT3(1, 0, 0), XMFLOAT3(-1, 0, 0), XMFLOAT3(0, 1, 0),
+		XMFLOAT3(0, -1, 0), XMFLOAT3(0, 0, 1), XMFLOAT3(0, 0, -1) };
+	for (int i = 0; i < 8; i++)
+		directions.push_back(XMFLOAT3(i & 1 ? -0.57735f : 0.57735f, i & 2 ? -0.57735f : 0.57735f, i & 4 ? -0.57735f : 0.57735f));
+	const int count = 2000;
+	for (int i = 0; i < count; i++)
+	{
+		float y = 1 - (i + 0.5f) * 2.0f / count;
+		float radius = sqrtf(1 - y * y);
+		float angle = i * 2.39996323f;
+		directions.push_back(XMFLOAT3(cosf(angle) * radius, y, sinf(angle) * radius));
+	}
+
+	float worstDegrees = 0;
+	for (const XMFLOAT3& direction : directions)
+	{
+		short packed[2];
+		VertexCompactCodec::EncodeOctahedral(direction, packed);
+		XMFLOAT3 decoded = VertexCompactCodec::DecodeOctahedral(packed);
+
+		XMVECTOR a = XMVector3Normalize(XMLoadFloat3(&direction));
+		XMVECTOR b = XMLoadFloat3(&decoded);
+		CHECK_NEAR(XMVectorGetX(XMVector3Length(b)), 1.0f, 0.001f);
+		float cosine = (std::min)(1.0f, XMVectorGetX(XMVector3Dot(a, XMVector3Normalize(b))));
+		worstDegrees = (std::max)(worstDegrees, XMConvertToDegrees(acosf(cosine)));
+	}
+	printf("    worst octahedral error %.4f degrees\n", worstDegrees);
+	CHECK(worstDegrees < 0.03f);
+}
+
+TEST(CompactModelRoundTrip)
+{
+	const char* models[] = { "sphere.obj", "torus.obj", "cube.obj", "helix.obj" };
+	for (const char* model : models)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		REQUIRE(TestMeshes::LoadModel(model, vertices, indices));
+		TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+
+		VertexQuantization quantization = VertexCompactCodec::ComputeQuantization(&vertices[0], (unsigned int)vertices.size());
+		std::vector<VertexCompact> packed(vertices.size());
+		VertexCompactCodec::Encode(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size(), quantization, &packed[0]);
+		VertexCompactError error = VertexCompactCodec::MeasureError(&vertices[0], &packed[0], (unsigned int)vertices.size(), quantization);
+		printf("    %s: position %.5f, uv %.5f, normal %.3f deg, tangent %.3f deg\n", model, error.position, error.uv, error.normal, error.tangent);
+
+		// Half a 16 bit step on every axis at most
+		XMFLOAT3 step = quantization.scale;
+		float halfStep = XMVectorGetX(XMVector3Length(XMLoadFloat3(&step))) / 32767.0f;
+		CHECK(error.position <= halfStep);
+		//halves keep 11 bits, relative to the largest uv (the helix's tile past 1)
+		float largestUv = 1;
+		for (const Vertex& v : vertices)
+			largestUv = (std::max)(largestUv, (std::max)(fabsf(v.UV.x), fabsf(v.UV.y)));
+		CHECK(error.uv <= largestUv / 2048.0f);
+		CHECK(error.normal < 0.05f);
+		CHECK(error.tangent < 0.05f);
+
+		for (const VertexCompact& v : packed)
+			CHECK(VertexCompactCodec::DecodeTangentSign(v) == 1.0f || VertexCompactCodec::DecodeTangentSign(v) == -1.0f);
+	}
+}
+
+TEST(CompactTangentSignFollowsMirroredUvs)
+{
+	// The same grid twice, the second with its u running backwards -
+	// every vertex of one should agree, and the two should disagree
+	float signs[2] = {};
+	for (int mirrored = 0; mirrored < 2; mirrored++)
+	{
+		std::vector<Vertex> vertices;
+		std::vector<unsigned int> indices;
+		TestMeshes::MakeGrid(8, false, vertices, indices);
+		if (mirrored)
+		{
+			for (Vertex& v : vertices)
+				v.UV.x = 1 - v.UV.x;
+		}
+		TangentGenerator::Generate(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size());
+
+		VertexQuantization quantization = VertexCompactCodec::ComputeQuantization(&vertices[0], (unsigned int)vertices.size());
+		std::vector<VertexCompact> packed(vertices.size());
+		VertexCompactCodec::Encode(&vertices[0], (unsigned int)vertices.size(), &indices[0], (unsigned int)indices.size(), quantization, &packed[0]);
+
+		signs[mirrored] = VertexCompactCodec::DecodeTangentSign(packed[0]);
+		for (const VertexCompact& v : packed)
+			CHECK(VertexCompactCodec::DecodeTangentSign(v) == signs[mirrored]);
+	}
+	CHECK(signs[0] == -signs[1]);
+}
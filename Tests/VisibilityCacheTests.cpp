@@ -0,0 +1,167 @@
+#include "TestFramework.h"
+#include "../VisibilityCache.h"
+#include <random>
+#include <vector>
+#include <cmath>
+#include <algorithm>
+
+static Visibility AnyVisibility(std::mt19937& random)
+{
+	return (Visibility)std::uniform_int_distribution<int>(0, 3)(random);
+}
+
+//the cache has to hold exactly what storing the same state from scratch would
+static bool MatchesStore(VisibilityCache& cache, const std::vector<Visibility>& visibility, const std::vector<unsigned long long>& sortKeys)
+{
+	VisibilityCache fresh;
+	fresh.Begin(0, 0, 0, (unsigned int)visibility.size());
+	fresh.Store(visibility.data(), sortKeys.data(), (unsigned int)visibility.size());
+	fresh.End();
+
+	bool same = cache.GetDrawList() == fresh.GetDrawList();
+	const Visibility states[] = { Visibility::Empty, Visibility::OutsideView, Visibility::Occluded, Visibility::Visible };
+	for (Visibility state : states)
+		same = same && cache.GetCount(state) == fresh.GetCount(state);
+	for (unsigned int i = 0; i < visibility.size(); i++)
+		same = same && cache.GetVisibility(i) == visibility[i];
+	return same;
+}
+
+TEST(VisibilityCacheBeginPicksReuse)
+{
+	std::vector<Visibility> visibility(400, Visibility::Visible);
+	std::vector<unsigned long long> sortKeys(400, 0);
+	VisibilityCache cache;
+	auto frame = [&](unsigned int cameraEpoch, unsigned int sceneEpoch, unsigned int moved, unsigned int count)
+	{
+		VisibilityReuse reuse = cache.Begin(cameraEpoch, sceneEpoch, moved, count);
+		if (reuse == VisibilityReuse::None)
+			cache.Store(visibility.data(), sortKeys.data(), count);
+		cache.End();
+		return reuse;
+	};
+
+	// Nothing stored yet, then nothing changed
+	CHECK(frame(1, 1, 0, 400) == VisibilityReuse::None);
+	CHECK(frame(1, 1, 0, 400) == VisibilityReuse::All);
+
+	// A few moved, up to the limit and one past it
+	unsigned int limit = (unsigned int)floorf(400 * VisibilityCache::PatchLimit);
+	CHECK(frame(1, 1, 1, 400) == VisibilityReuse::Patch);
+	CHECK(frame(1, 1, limit, 400) == VisibilityReuse::Patch);
+	CHECK(frame(1, 1, limit + 1, 400) == VisibilityReuse::None);
+
+	// Either epoch changing, or a different number of entities
+	CHECK(frame(2, 1, 0, 400) == VisibilityReuse::None);
+	CHECK(frame(2, 1, 0, 400) == VisibilityReuse::All);
+	CHECK(frame(2, 2, 1, 400) == VisibilityReuse::None);
+	CHECK(frame(2, 2, 1, 400) == VisibilityReuse::Patch);
+	CHECK(frame(2, 2, 0, 300) == VisibilityReuse::None);
+	CHECK(frame(2, 2, 0, 400) == VisibilityReuse::None);
+
+	// Invalidate throws away whatever's there, until it's stored again
+	cache.Invalidate();
+	CHECK(frame(2, 2, 0, 400) == VisibilityReuse::None);
+	CHECK(frame(2, 2, 0, 400) == VisibilityReuse::All);
+
+	CHECK(cache.GetFrameCount() == 13);
+	CHECK(cache.GetRebuiltCount() == 7);
+	CHECK(cache.GetReusedCount() == 3);
+	CHECK(cache.GetPatchedCount() == 3);
+	CHECK_NEAR(cache.GetHitRate(), 6.0f / 13.0f, 1e-6f);
+}
+
+TEST(VisibilityCacheMatchesStore)
+{
+	// Random frames - the camera or scene changing, a few entities or a
+	// crowd moving, or nothing - with the cache doing whatever Begin says
+	// against the state it's given. Keys come from a small range so plenty
+	// of entities share one, and only change when the scene does
+	std::mt19937 random(25);
+	std::uniform_int_distribution<int> percent(0, 99);
+	std::vector<Visibility> visibility;
+	std::vector<unsigned long long> sortKeys;
+	VisibilityCache cache;
+	unsigned int cameraEpoch = 0;
+	unsigned int sceneEpoch = 0;
+	unsigned int reused[3] = {};
+	bool valid = false;
+	for (int frame = 0; frame < 2000; frame++)
+	{
+		int change = percent(random);
+		if (change < 5 || visibility.empty())
+		{
+			// The scene changed, maybe how many entities are in it
+			sceneEpoch++;
+			if (change < 2 || visibility.empty())
+				visibility.resize(std::uniform_int_distribution<unsigned int>(1, 300)(random));
+			sortKeys.resize(visibility.size());
+			for (unsigned int i = 0; i < visibility.size(); i++)
+			{
+				visibility[i] = AnyVisibility(random);
+				sortKeys[i] = std::uniform_int_distribution<unsigned long long>(0, 7)(random);
+			}
+		}
+		else if (change < 10)
+		{
+			cameraEpoch++;
+			for (Visibility& v : visibility)
+				v = AnyVisibility(random);
+		}
+		else if (change < 13)
+		{
+			cache.Invalidate();
+			valid = false;
+		}
+		unsigned int count = (unsigned int)visibility.size();
+
+		// Which moved - often none, sometimes a handful, now and then about
+		// as many as patching allows, or more
+		unsigned int moved = 0;
+		int crowd = percent(random);
+		unsigned int limit = (unsigned int)floorf(count * VisibilityCache::PatchLimit);
+		if (crowd >= 30 && crowd < 80)
+			moved = std::uniform_int_distribution<unsigned int>(1, (std::max)(1u, (std::min)(limit, 8u)))(random);
+		else if (crowd >= 80 && crowd < 90)
+			moved = limit;
+		else if (crowd >= 90)
+			moved = (std::min)(limit + 1, count);
+		std::vector<unsigned int> movers(count);
+		for (unsigned int i = 0; i < count; i++)
+			movers[i] = i;
+		std::shuffle(movers.begin(), movers.end(), random);
+		movers.resize(moved);
+
+		bool rebuild = !valid || change < 10 || moved > count * VisibilityCache::PatchLimit;
+		VisibilityReuse expected = rebuild ? VisibilityReuse::None : (moved == 0 ? VisibilityReuse::All : VisibilityReuse::Patch);
+		VisibilityReuse reuse = cache.Begin(cameraEpoch, sceneEpoch, moved, count);
+		CHECK(reuse == expected);
+		reused[(int)reuse]++;
+
+		// Patching may see an entity more than once in a frame - in one
+		// state on the way, then the one it ends up in
+		for (unsigned int i : movers)
+		{
+			if (reuse == VisibilityReuse::Patch && percent(random) < 20)
+				cache.Patch(i, AnyVisibility(random));
+			visibility[i] = AnyVisibility(random);
+			if (reuse == VisibilityReuse::Patch)
+				cache.Patch(i, visibility[i]);
+		}
+		if (reuse == VisibilityReuse::None)
+			cache.Store(visibility.data(), sortKeys.data(), count);
+		cache.End();
+		valid = true;
+
+		REQUIRE(MatchesStore(cache, visibility, sortKeys));
+	}
+
+	// Every way Begin goes came up plenty
+	CHECK(reused[(int)VisibilityReuse::All] > 100);
+	CHECK(reused[(int)VisibilityReuse::Patch] > 100);
+	CHECK(reused[(int)VisibilityReuse::None] > 100);
+	CHECK(cache.GetFrameCount() == 2000);
+	CHECK(cache.GetReusedCount() == reused[(int)VisibilityReuse::All]);
+	CHECK(cache.GetPatchedCount() == reused[(int)VisibilityReuse::Patch]);
+	CHECK(cache.GetRebuiltCount() == reused[(int)VisibilityReuse::None]);
+}
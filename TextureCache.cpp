@@ -0,0 +1,316 @@
+#include "TextureCache.h"
+#include "TextureStreamer.h"
+#include <Windows.h>
+#include <cwctype>
+
+TextureCache::TextureCache()
+{
+	requests = 0;
+	hits = 0;
+	bytesSaved = 0;
+}
+
+std::wstring TextureCache::CanonicalPath(const std::wstring& filename)
+{
+	//full path first, that takes care of any ..'s and .'s
+	std::wstring path = filename;
+	DWORD length = GetFullPathNameW(filename.c_str(), 0, 0, 0);
+	if (length > 0)
+	{
+		std::vector<wchar_t> full(length);
+		length = GetFullPathNameW(filename.c_str(), length, &full[0], 0);
+		if (length > 0 && length < full.size())
+			path.assign(&full[0], length);
+	}
+
+	// Windows paths don't care about case or slash direction
+	for (auto& c : path)
+		c = c == L'/' ? L'\\' : (wchar_t)std::towlower(c);
+	return path;
+}
+
+unsigned long long TextureCache::HashContents(const unsigned char* bytes, size_t size, unsigned long long hash)
+{
+	for (size_t i = 0; i < size; i++)
+	{
+		hash ^= bytes[i];
+		hash *= 1099511628211ull;
+	}
+	return hash;
+}
+
+std::wstring TextureCache::MakeKey(const std::wstring& filename, TextureKind kind, bool streamed)
+{
+	static const wchar_t* kindNames[] = { L"|image", L"|color", L"|normalmap", L"|mask", L"|cubemap" };
+	return CanonicalPath(filename) + kindNames[(int)kind] + (streamed ? L"|streamed" : L"");
+}
+
+unsigned long long TextureCache::MakeContentKey(unsigned long long contentHash, TextureKind kind, bool streamed)
+{
+	unsigned long long way = (unsigned long long)kind * 2 + (streamed ? 1 : 0);
+	return contentHash ^ (way * 0x9E3779B97F4A7C15ull);
+}
+
+bool TextureCache::SharesTexture(const Entry& a, const Entry& b)
+{
+	if (a.streamed || b.streamed)
+	{
+		if (!a.streamed || !b.streamed)
+			return false;
+		//streamed ones share a number in the streamer, ones that couldn't be streamed share their srv
+		if (a.streamed->residency != (unsigned int)-1)
+			return a.streamed->residency == b.streamed->residency;
+		return a.streamed->srv && a.streamed->srv.Get() == b.streamed->srv.Get();
+	}
+	return a.srv && a.srv.Get() == b.srv.Get();
+}
+
+bool TextureCache::Request(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady)
+{
+	requests++;
+	std::wstring key = MakeKey(filename, kind);
+
+	auto found = entries.find(key);
+	if (found != entries.end())
+	{
+		Entry& entry = found->second;
+		entry.references++;
+		hits++;
+
+		//still loading - it gets counted as saved once its size is known
+		if (entry.srv)
+		{
+			bytesSaved += entry.gpuBytes;
+			onReady(entry.srv);
+		}
+		else
+		{
+			entry.waiting.push_back(onReady);
+		}
+		return true;
+	}
+
+	// A miss starts the entry off, so anything asking for the
+	// same texture before it's loaded waits on this one load
+	Entry& entry = entries.emplace(key, Entry()).first->second;
+	entry.waiting.push_back(onReady);
+	entry.contentHash = 0;
+	entry.gpuBytes = 0;
+	entry.references = 1;
+	entry.sharedContents = false;
+	return false;
+}
+
+Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> TextureCache::FindContents(unsigned long long contentHash, TextureKind kind)
+{
+	auto found = contents.find(MakeContentKey(contentHash, kind));
+	if (found == contents.end())
+		return nullptr;
+	auto entry = entries.find(found->second);
+	return entry != entries.end() ? entry->second.srv : nullptr;
+}
+
+void TextureCache::Resolve(const std::wstring& filename, TextureKind kind, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, unsigned long long contentHash, unsigned long long gpuBytes)
+{
+	std::wstring key = MakeKey(filename, kind);
+	auto found = entries.find(key);
+	if (found == entries.end())
+		return;	// everyone let go of it while it was loading
+
+	if (!srv)
+	{
+		entries.erase(found);
+		return;
+	}
+
+	Entry& entry = found->second;
+	entry.srv = srv;
+	entry.contentHash = contentHash;
+	entry.gpuBytes = gpuBytes;
+
+	// Same bytes as a texture that's already here under another
+	// path - the caller reused its srv, so this load was a hit too
+	unsigned long long contentKey = MakeContentKey(contentHash, kind);
+	auto owner = contents.find(contentKey);
+	auto ownerEntry = owner != contents.end() ? entries.find(owner->second) : entries.end();
+	if (ownerEntry != entries.end() && ownerEntry->first != key && ownerEntry->second.srv.Get() == srv.Get())
+	{
+		entry.sharedContents = true;
+		hits++;
+		bytesSaved += gpuBytes;
+	}
+	else
+	{
+		contents[contentKey] = key;
+	}
+
+	//the first one in the list is the request that missed, the rest were hits
+	//- it's empty if this is a second load of something that was let go of and asked for again mid-load
+	if (!entry.waiting.empty())
+		bytesSaved += gpuBytes * (entry.waiting.size() - 1);
+
+	std::vector<TextureReadyCallback> waiting;
+	waiting.swap(entry.waiting);
+	for (auto& onReady : waiting)
+		onReady(srv);
+}
+
+void TextureCache::Release(const std::wstring& filename, TextureKind kind)
+{
+	ReleaseKey(MakeKey(filename, kind), kind, false);
+}
+
+bool TextureCache::ReleaseKey(const std::wstring& key, TextureKind kind, bool streamed)
+{
+	auto found = entries.find(key);
+	if (found == entries.end() || --found->second.references > 0)
+		return false;
+
+	// If this entry was where its contents were found, hand that
+	// over to another path sharing them (which now owns the bytes)
+	unsigned long long contentKey = MakeContentKey(found->second.contentHash, kind, streamed);
+	auto owner = contents.find(contentKey);
+	if (found->second.gpuBytes > 0 && owner != contents.end() && owner->second == key)
+	{
+		contents.erase(owner);
+		for (auto& other : entries)
+		{
+			if (other.first != key && other.second.sharedContents && SharesTexture(other.second, found->second))
+			{
+				other.second.sharedContents = false;
+				contents[contentKey] = other.first;
+				break;
+			}
+		}
+	}
+
+	entries.erase(found);
+	return true;
+}
+
+bool TextureCache::RequestStreamed(const std::wstring& filename, TextureKind kind, std::shared_ptr<StreamedTexture>& texture)
+{
+	requests++;
+	std::wstring key = MakeKey(filename, kind, true);
+
+	auto found = entries.find(key);
+	if (found != entries.end())
+	{
+		//the texture is handed out right away either way, a hit while loading is counted as saved once its size is known
+		Entry& entry = found->second;
+		entry.references++;
+		hits++;
+		bytesSaved += entry.gpuBytes;
+		texture = entry.streamed;
+		return true;
+	}
+
+	Entry& entry = entries.emplace(key, Entry()).first->second;
+	entry.streamed = std::make_shared<StreamedTexture>();
+	entry.streamed->width = 0;
+	entry.streamed->height = 0;
+	entry.streamed->residency = (unsigned int)-1;
+	entry.contentHash = 0;
+	entry.gpuBytes = 0;
+	entry.references = 1;
+	entry.sharedContents = false;
+	texture = entry.streamed;
+	return false;
+}
+
+std::shared_ptr<StreamedTexture> TextureCache::FindStreamedContents(unsigned long long contentHash, TextureKind kind)
+{
+	auto found = contents.find(MakeContentKey(contentHash, kind, true));
+	if (found == contents.end())
+		return nullptr;
+	auto entry = entries.find(found->second);
+	return entry != entries.end() ? entry->second.streamed : nullptr;
+}
+
+bool TextureCache::ResolveStreamed(const std::wstring& filename, TextureKind kind, const std::shared_ptr<StreamedTexture>& texture, unsigned long long contentHash, unsigned long long gpuBytes)
+{
+	//let go of while loading - and maybe asked for again since, which is another load with another texture
+	std::wstring key = MakeKey(filename, kind, true);
+	auto found = entries.find(key);
+	if (found == entries.end() || found->second.streamed != texture)
+		return false;
+
+	if (gpuBytes == 0)
+	{
+		entries.erase(found);
+		return true;
+	}
+
+	Entry& entry = found->second;
+	entry.contentHash = contentHash;
+	entry.gpuBytes = gpuBytes;
+
+	//the same as Resolve - a load that turned out to be another path's contents was a hit too
+	unsigned long long contentKey = MakeContentKey(contentHash, kind, true);
+	auto owner = contents.find(contentKey);
+	auto ownerEntry = owner != contents.end() ? entries.find(owner->second) : entries.end();
+	if (ownerEntry != entries.end() && ownerEntry->first != key && SharesTexture(ownerEntry->second, entry))
+	{
+		entry.sharedContents = true;
+		hits++;
+		bytesSaved += gpuBytes;
+	}
+	else
+	{
+		contents[contentKey] = key;
+	}
+
+	//everyone who asked while it loaded shares the one load
+	bytesSaved += gpuBytes * (entry.references - 1);
+	return true;
+}
+
+void TextureCache::ReleaseStreamed(const std::wstring& filename, TextureKind kind, std::shared_ptr<StreamedTexture>& released)
+{
+	std::wstring key = MakeKey(filename, kind, true);
+	auto found = entries.find(key);
+	std::shared_ptr<StreamedTexture> texture = found != entries.end() ? found->second.streamed : nullptr;
+	released = ReleaseKey(key, kind, true) ? texture : nullptr;
+}
+
+unsigned int TextureCache::GetRequestCount()
+{
+	return requests;
+}
+
+unsigned int TextureCache::GetHitCount()
+{
+	return hits;
+}
+
+float TextureCache::GetHitRate()
+{
+	return requests > 0 ? (float)hits / requests : 0.0f;
+}
+
+unsigned long long TextureCache::GetBytesSaved()
+{
+	return bytesSaved;
+}
+
+unsigned long long TextureCache::GetBytesResident()
+{
+	unsigned long long bytes = 0;
+	for (auto& entry : entries)
+	{
+		if (entry.second.srv && !entry.second.sharedContents)
+			bytes += entry.second.gpuBytes;
+	}
+	return bytes;
+}
+
+unsigned int TextureCache::GetTextureCount()
+{
+	unsigned int count = 0;
+	for (auto& entry : entries)
+	{
+		if (entry.second.srv && !entry.second.sharedContents)
+			count++;
+	}
+	return count;
+}
@@ -0,0 +1,111 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <memory>
+
+struct StreamedTexture;
+
+//runs on the device thread once a texture exists
+typedef std::function<void(Microsoft::WRL::ComPtr<ID3D11ShaderResourceView>)> TextureReadyCallback;
+
+// How a file was turned into a texture - the same file loaded
+// two different ways is two different textures
+enum class TextureKind
+{
+	Image,		// any WIC image, rgba8 with a generated mip chain
+	Color,		// imported to BC1 or BC7, mips filtered in linear light
+	NormalMap,	// imported to BC5 (x and y only), mips renormalized
+	Mask,		// one channel, like roughness or metalness - imported to BC4
+	Cubemap		// a dds file, as is
+};
+
+// --------------------------------------------------------
+// Texture cache
+//
+// Hands out one shared SRV per texture no matter how many
+// times it's asked for. Textures are found by their full,
+// normalized path first, and failing that by a hash of the
+// file's contents, so a copy of a file under another name
+// still shares the gpu texture.
+//
+// Every request is a reference - Release drops one, and the
+// cache lets go of a texture once nothing refers to it.
+//
+// Streamed textures are kept apart from the others, even for
+// the same file and kind - what's shared is the StreamedTexture,
+// whose srv changes as its mips come and go. The streamer keeps
+// count of their bytes, the statistics here only count the hits.
+// Only used from the device thread.
+// --------------------------------------------------------
+class TextureCache
+{
+public:
+	TextureCache();
+
+	//absolute, lower case and with one kind of slash, so every way of writing a path matches
+	static std::wstring CanonicalPath(const std::wstring& filename);
+	//FNV-1a over the file's bytes - pass the last hash in to carry on from it
+	static unsigned long long HashContents(const unsigned char* bytes, size_t size, unsigned long long hash = 14695981039346656037ull);
+
+	//true if the texture is already loaded or on its way - onReady runs now, or when it's made
+	//false means the caller has to load it and hand it back through Resolve
+	bool Request(const std::wstring& filename, TextureKind kind, TextureReadyCallback onReady);
+
+	//a texture made from exactly these bytes, if there is one
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> FindContents(unsigned long long contentHash, TextureKind kind);
+
+	//finishes a load that Request missed on and runs everything waiting for it
+	//- a null srv is a failed load, the waiting callbacks are dropped and the next request tries again
+	void Resolve(const std::wstring& filename, TextureKind kind, Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv, unsigned long long contentHash, unsigned long long gpuBytes);
+
+	//drops one reference taken by Request
+	void Release(const std::wstring& filename, TextureKind kind);
+
+	// Streamed textures
+	//true if the texture is already loaded or on its way, false means the caller has to load it into texture and call ResolveStreamed
+	bool RequestStreamed(const std::wstring& filename, TextureKind kind, std::shared_ptr<StreamedTexture>& texture);
+	//a streamed texture made from exactly these bytes, if there is one that's loaded
+	std::shared_ptr<StreamedTexture> FindStreamedContents(unsigned long long contentHash, TextureKind kind);
+	//finishes a load RequestStreamed missed on - gpuBytes 0 is a failed load, and the next request tries again
+	//false if everyone let go of it while it was loading, and the streamer can let go of it too
+	bool ResolveStreamed(const std::wstring& filename, TextureKind kind, const std::shared_ptr<StreamedTexture>& texture, unsigned long long contentHash, unsigned long long gpuBytes);
+	//drops one reference taken by RequestStreamed - released is set when that was the last one, for the streamer to let go of
+	void ReleaseStreamed(const std::wstring& filename, TextureKind kind, std::shared_ptr<StreamedTexture>& released);
+
+	unsigned int GetRequestCount();
+	unsigned int GetHitCount();		// requests that didn't need a texture of their own
+	float GetHitRate();
+	unsigned long long GetBytesSaved();		// gpu memory the hits would have taken up
+	unsigned long long GetBytesResident();	// gpu memory of the textures held now
+	unsigned int GetTextureCount();
+
+private:
+	struct Entry
+	{
+		Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;	// null while loading
+		std::shared_ptr<StreamedTexture> streamed;				// streamed textures only, in place of srv
+		std::vector<TextureReadyCallback> waiting;				// hits that came in while loading
+		unsigned long long contentHash;
+		unsigned long long gpuBytes;
+		unsigned int references;
+		bool sharedContents;	// found through another path's contents, so its bytes aren't resident twice
+	};
+
+	static std::wstring MakeKey(const std::wstring& filename, TextureKind kind, bool streamed = false);
+	static unsigned long long MakeContentKey(unsigned long long contentHash, TextureKind kind, bool streamed = false);
+	//the same gpu texture, however each got it
+	static bool SharesTexture(const Entry& a, const Entry& b);
+	//drops one reference, and the entry when it was the last - false if it's still held
+	bool ReleaseKey(const std::wstring& key, TextureKind kind, bool streamed);
+
+	std::unordered_map<std::wstring, Entry> entries;
+	std::unordered_map<unsigned long long, std::wstring> contents;	// content key -> entry key holding it
+
+	unsigned int requests;
+	unsigned int hits;
+	unsigned long long bytesSaved;
+};
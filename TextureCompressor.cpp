@@ -0,0 +1,997 @@
+#include "TextureCompressor.h"
+#include <Windows.h>
+#include <DirectXMath.h>
+#include <cmath>
+#include <cstring>
+#include <cstdlib>
+#include <cfloat>
+#include <climits>
+#include <algorithm>
+
+using namespace DirectX;
+
+//bump this whenever the mips or the encoders change, so old imports get redone
+static const unsigned int TextureImportVersion = 1;
+//"TCMP" in the dds header's reserved space marks an import of ours
+static const unsigned int TextureImportMagic = 0x504D4354;
+
+// --------------------------------------------------------
+// srgb <-> linear tables
+// --------------------------------------------------------
+struct SrgbTables
+{
+	float toLinear[256];
+	unsigned char fromLinear[4096];
+
+	SrgbTables()
+	{
+		for (int i = 0; i < 256; i++)
+		{
+			float c = i / 255.0f;
+			toLinear[i] = c <= 0.04045f ? c / 12.92f : powf((c + 0.055f) / 1.055f, 2.4f);
+		}
+		for (int i = 0; i < 4096; i++)
+		{
+			float c = i / 4095.0f;
+			float s = c <= 0.0031308f ? c * 12.92f : 1.055f * powf(c, 1.0f / 2.4f) - 0.055f;
+			fromLinear[i] = (unsigned char)(s * 255.0f + 0.5f);
+		}
+	}
+};
+
+static const SrgbTables& GetSrgbTables()
+{
+	static const SrgbTables tables;
+	return tables;
+}
+
+// --------------------------------------------------------
+// Mips
+// --------------------------------------------------------
+
+//8 bit pixels to floats the filter can average directly
+static void ToFilterSpace(const ImageRgba& image, MipFilter filter, std::vector<XMFLOAT4A>& out)
+{
+	const SrgbTables& srgb = GetSrgbTables();
+	size_t count = (size_t)image.width * image.height;
+	out.resize(count);
+	for (size_t i = 0; i < count; i++)
+	{
+		const unsigned char* p = &image.pixels[i * 4];
+		if (filter == MipFilter::Color)
+			out[i] = XMFLOAT4A(srgb.toLinear[p[0]], srgb.toLinear[p[1]], srgb.toLinear[p[2]], p[3] / 255.0f);
+		else if (filter == MipFilter::Normal)
+			out[i] = XMFLOAT4A(p[0] / 127.5f - 1.0f, p[1] / 127.5f - 1.0f, p[2] / 127.5f - 1.0f, p[3] / 255.0f);
+		else
+			out[i] = XMFLOAT4A(p[0] / 255.0f, p[1] / 255.0f, p[2] / 255.0f, p[3] / 255.0f);
+	}
+}
+
+static void FromFilterSpace(const std::vector<XMFLOAT4A>& in, unsigned int width, unsigned int height, MipFilter filter, ImageRgba& out)
+{
+	const SrgbTables& srgb = GetSrgbTables();
+	out.width = width;
+	out.height = height;
+	out.pixels.resize((size_t)width * height * 4);
+
+	XMVECTOR half = XMVectorReplicate(0.5f);
+	for (size_t i = 0; i < in.size(); i++)
+	{
+		XMVECTOR v = XMLoadFloat4A(&in[i]);
+		XMFLOAT4A bytes;
+		unsigned char* p = &out.pixels[i * 4];
+		if (filter == MipFilter::Color)
+		{
+			//rgb through the table (12 bits of linear is plenty), alpha as is
+			XMStoreFloat4A(&bytes, XMVectorSaturate(v) * XMVectorSet(4095.0f, 4095.0f, 4095.0f, 255.0f) + half);
+			p[0] = srgb.fromLinear[(int)bytes.x];
+			p[1] = srgb.fromLinear[(int)bytes.y];
+			p[2] = srgb.fromLinear[(int)bytes.z];
+			p[3] = (unsigned char)bytes.w;
+			continue;
+		}
+
+		//normals go from -1..1 back to 0..1, alpha was never moved
+		if (filter == MipFilter::Normal)
+			v = XMVectorSaturate(XMVectorSelect(v, v * half + half, XMVectorSelectControl(1, 1, 1, 0)));
+		else
+			v = XMVectorSaturate(v);
+		XMStoreFloat4A(&bytes, v * XMVectorReplicate(255.0f) + half);
+		p[0] = (unsigned char)bytes.x;
+		p[1] = (unsigned char)bytes.y;
+		p[2] = (unsigned char)bytes.z;
+		p[3] = (unsigned char)bytes.w;
+	}
+}
+
+void TextureCompressor::GenerateMips(const ImageRgba& source, MipFilter filter, std::vector<ImageRgba>& mips)
+{
+	mips.clear();
+	mips.push_back(source);
+
+	// Each level is filtered from the float version of the one
+	// above rather than its 8 bit pixels, so rounding doesn't
+	// pile up on the way down the chain
+	std::vector<XMFLOAT4A> current;
+	std::vector<XMFLOAT4A> next;
+	ToFilterSpace(source, filter, current);
+
+	unsigned int width = source.width;
+	unsigned int height = source.height;
+	XMVECTOR quarter = XMVectorReplicate(0.25f);
+	XMVECTOR up = XMVectorSet(0, 0, 1, 0);
+
+	while (width > 1 || height > 1)
+	{
+		unsigned int nextWidth = (std::max)(width / 2, 1u);
+		unsigned int nextHeight = (std::max)(height / 2, 1u);
+		next.resize((size_t)nextWidth * nextHeight);
+
+		for (unsigned int y = 0; y < nextHeight; y++)
+		{
+			//a 1 pixel wide or tall level just averages the same row or column twice
+			const XMFLOAT4A* row0 = &current[(size_t)(std::min)(y * 2, height - 1) * width];
+			const XMFLOAT4A* row1 = &current[(size_t)(std::min)(y * 2 + 1, height - 1) * width];
+			for (unsigned int x = 0; x < nextWidth; x++)
+			{
+				unsigned int x0 = (std::min)(x * 2, width - 1);
+				unsigned int x1 = (std::min)(x * 2 + 1, width - 1);
+				XMVECTOR sum = XMLoadFloat4A(&row0[x0]) + XMLoadFloat4A(&row0[x1]) + XMLoadFloat4A(&row1[x0]) + XMLoadFloat4A(&row1[x1]);
+				XMVECTOR average = sum * quarter;
+
+				if (filter == MipFilter::Normal)
+				{
+					//the average of unit vectors is shorter than one, put it back on the sphere
+					XMVECTOR n = XMVector3Normalize(average);
+					if (XMVectorGetX(XMVector3LengthSq(n)) == 0.0f)
+						n = up;
+					average = XMVectorSelect(average, n, XMVectorSelectControl(1, 1, 1, 0));
+				}
+				XMStoreFloat4A(&next[(size_t)y * nextWidth + x], average);
+			}
+		}
+
+		width = nextWidth;
+		height = nextHeight;
+		current.swap(next);
+
+		ImageRgba level;
+		FromFilterSpace(current, width, height, filter, level);
+		mips.push_back(level);
+	}
+}
+
+// --------------------------------------------------------
+// Bit packing for the block formats, lowest bit first
+// --------------------------------------------------------
+struct BlockBits
+{
+	unsigned char* bytes;
+	unsigned int position;
+
+	void Write(unsigned int value, unsigned int count)
+	{
+		for (unsigned int i = 0; i < count; i++, position++)
+		{
+			if (value & (1u << i))
+				bytes[position >> 3] |= (unsigned char)(1u << (position & 7));
+		}
+	}
+
+	unsigned int Read(unsigned int count)
+	{
+		unsigned int value = 0;
+		for (unsigned int i = 0; i < count; i++, position++)
+			value |= ((bytes[position >> 3] >> (position & 7)) & 1u) << i;
+		return value;
+	}
+};
+
+// --------------------------------------------------------
+// BC1
+// --------------------------------------------------------
+static unsigned short PackRgb565(float r, float g, float b)
+{
+	unsigned int r5 = (unsigned int)(std::min)((std::max)(r * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+	unsigned int g6 = (unsigned int)(std::min)((std::max)(g * 63.0f / 255.0f + 0.5f, 0.0f), 63.0f);
+	unsigned int b5 = (unsigned int)(std::min)((std::max)(b * 31.0f / 255.0f + 0.5f, 0.0f), 31.0f);
+	return (unsigned short)((r5 << 11) | (g6 << 5) | b5);
+}
+
+static void UnpackRgb565(unsigned short c, int* rgb)
+{
+	int r = (c >> 11) & 31;
+	int g = (c >> 5) & 63;
+	int b = c & 31;
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
+
+//the four colors a pair of 565 endpoints makes (c0 > c1, so never the black/transparent mode)
+static void Bc1Palette(unsigned short c0, unsigned short c1, int palette[4][3])
+{
+	UnpackRgb565(c0, palette[0]);
+	UnpackRgb565(c1, palette[1]);
+	for (int i = 0; i < 3; i++)
+	{
+		palette[2][i] = (2 * palette[0][i] + palette[1][i]) / 3;
+		palette[3][i] = (palette[0][i] + 2 * palette[1][i]) / 3;
+	}
+}
+
+//picks the closest palette entry for each pixel, returns the total squared error
+static int Bc1Indices(const unsigned char* rgba, unsigned short c0, unsigned short c1, unsigned int* indices)
+{
+	int palette[4][3];
+	Bc1Palette(c0, c1, palette);
+
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		const unsigned char* p = &rgba[i * 4];
+		int best = 0;
+		int bestError = INT_MAX;
+		for (int j = 0; j < 4; j++)
+		{
+			int dr = p[0] - palette[j][0];
+			int dg = p[1] - palette[j][1];
+			int db = p[2] - palette[j][2];
+			int error = dr * dr + dg * dg + db * db;
+			if (error < bestError)
+			{
+				bestError = error;
+				best = j;
+			}
+		}
+		indices[i] = best;
+		total += bestError;
+	}
+	return total;
+}
+
+//endpoints at the two ends of the line the block's colors lie closest to
+static void PrincipalEndpoints(const unsigned char* rgba, unsigned int channels, float* low, float* high)
+{
+	XMVECTOR mask = channels == 4 ? XMVectorSplatOne() : XMVectorSet(1, 1, 1, 0);
+	XMVECTOR pixels[16];
+	XMVECTOR mean = XMVectorZero();
+	for (int i = 0; i < 16; i++)
+	{
+		const unsigned char* p = &rgba[i * 4];
+		pixels[i] = XMVectorSet(p[0], p[1], p[2], p[3]) * mask;
+		mean += pixels[i];
+	}
+	mean *= 1.0f / 16.0f;
+
+	// A few rounds of power iteration on the covariance (done as
+	// sum of (p.axis)p, no need to build the matrix) finds the
+	// direction the colors are most spread out in
+	XMVECTOR minimum = pixels[0];
+	XMVECTOR maximum = pixels[0];
+	for (int i = 1; i < 16; i++)
+	{
+		minimum = XMVectorMin(minimum, pixels[i]);
+		maximum = XMVectorMax(maximum, pixels[i]);
+	}
+	XMVECTOR axis = maximum - minimum;
+	for (int iteration = 0; iteration < 4; iteration++)
+	{
+		XMVECTOR next = XMVectorZero();
+		for (int i = 0; i < 16; i++)
+		{
+			XMVECTOR d = pixels[i] - mean;
+			next += d * XMVector4Dot(d, axis);
+		}
+		float length = XMVectorGetX(XMVector4Length(next));
+		if (length < 1e-6f)
+			break;
+		axis = next * (1.0f / length);
+	}
+
+	float lowest = FLT_MAX;
+	float highest = -FLT_MAX;
+	for (int i = 0; i < 16; i++)
+	{
+		float t = XMVectorGetX(XMVector4Dot(pixels[i] - mean, axis));
+		lowest = (std::min)(lowest, t);
+		highest = (std::max)(highest, t);
+	}
+
+	XMFLOAT4 a, b;
+	XMStoreFloat4(&a, mean + axis * lowest);
+	XMStoreFloat4(&b, mean + axis * highest);
+	low[0] = a.x; low[1] = a.y; low[2] = a.z; low[3] = a.w;
+	high[0] = b.x; high[1] = b.y; high[2] = b.z; high[3] = b.w;
+}
+
+//least squares endpoints for a fixed set of weights (0 = all a, 1 = all b) per pixel
+static bool FitEndpoints(const unsigned char* rgba, const float* weights, unsigned int channels, float* a, float* b)
+{
+	float aa = 0, ab = 0, bb = 0;
+	float ax[4] = {}, bx[4] = {};
+	for (int i = 0; i < 16; i++)
+	{
+		float beta = weights[i];
+		float alpha = 1.0f - beta;
+		aa += alpha * alpha;
+		ab += alpha * beta;
+		bb += beta * beta;
+		for (unsigned int c = 0; c < channels; c++)
+		{
+			ax[c] += alpha * rgba[i * 4 + c];
+			bx[c] += beta * rgba[i * 4 + c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+	if (fabsf(determinant) < 1e-6f)
+		return false;
+	float inverse = 1.0f / determinant;
+	for (unsigned int c = 0; c < channels; c++)
+	{
+		a[c] = (std::min)((std::max)((ax[c] * bb - bx[c] * ab) * inverse, 0.0f), 255.0f);
+		b[c] = (std::min)((std::max)((bx[c] * aa - ax[c] * ab) * inverse, 0.0f), 255.0f);
+	}
+	return true;
+}
+
+void TextureCompressor::EncodeBlockBC1(const unsigned char* rgba, unsigned char* block)
+{
+	float low[4], high[4];
+	PrincipalEndpoints(rgba, 3, low, high);
+
+	unsigned short c0 = PackRgb565(high[0], high[1], high[2]);
+	unsigned short c1 = PackRgb565(low[0], low[1], low[2]);
+	unsigned int indices[16];
+	int error = Bc1Indices(rgba, c0, c1, indices);
+
+	//one round of least squares with the indices that gave
+	static const float paletteWeights[4] = { 0.0f, 1.0f, 1.0f / 3.0f, 2.0f / 3.0f };
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = paletteWeights[indices[i]];
+	float a[4], b[4];
+	if (FitEndpoints(rgba, weights, 3, a, b))
+	{
+		unsigned short f0 = PackRgb565(a[0], a[1], a[2]);
+		unsigned short f1 = PackRgb565(b[0], b[1], b[2]);
+		unsigned int fitIndices[16];
+		int fitError = Bc1Indices(rgba, f0, f1, fitIndices);
+		if (fitError < error)
+		{
+			c0 = f0;
+			c1 = f1;
+			error = fitError;
+			memcpy(indices, fitIndices, sizeof(indices));
+		}
+	}
+
+	// The four color mode needs c0 > c1 - swapping the endpoints
+	// swaps 0 with 1 and 2 with 3. Equal endpoints are one flat
+	// color, and index 0 is that color in either mode
+	if (c0 < c1)
+	{
+		std::swap(c0, c1);
+		for (int i = 0; i < 16; i++)
+			indices[i] ^= 1;
+	}
+	else if (c0 == c1)
+	{
+		for (int i = 0; i < 16; i++)
+			indices[i] = 0;
+	}
+
+	memset(block, 0, 8);
+	block[0] = (unsigned char)(c0 & 0xFF);
+	block[1] = (unsigned char)(c0 >> 8);
+	block[2] = (unsigned char)(c1 & 0xFF);
+	block[3] = (unsigned char)(c1 >> 8);
+	BlockBits bits = { block + 4, 0 };
+	for (int i = 0; i < 16; i++)
+		bits.Write(indices[i], 2);
+}
+
+void TextureCompressor::DecodeBlockBC1(const unsigned char* block, unsigned char* rgba)
+{
+	unsigned short c0 = (unsigned short)(block[0] | (block[1] << 8));
+	unsigned short c1 = (unsigned short)(block[2] | (block[3] << 8));
+
+	int palette[4][3];
+	int alpha[4] = { 255, 255, 255, 255 };
+	if (c0 > c1)
+	{
+		Bc1Palette(c0, c1, palette);
+	}
+	else
+	{
+		//three colors plus transparent black
+		UnpackRgb565(c0, palette[0]);
+		UnpackRgb565(c1, palette[1]);
+		for (int i = 0; i < 3; i++)
+		{
+			palette[2][i] = (palette[0][i] + palette[1][i]) / 2;
+			palette[3][i] = 0;
+		}
+		alpha[3] = 0;
+	}
+
+	BlockBits bits = { (unsigned char*)block + 4, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned int index = bits.Read(2);
+		rgba[i * 4 + 0] = (unsigned char)palette[index][0];
+		rgba[i * 4 + 1] = (unsigned char)palette[index][1];
+		rgba[i * 4 + 2] = (unsigned char)palette[index][2];
+		rgba[i * 4 + 3] = (unsigned char)alpha[index];
+	}
+}
+
+// --------------------------------------------------------
+// BC4 (and BC5, which is two of them)
+// --------------------------------------------------------
+static void Bc4Palette(int e0, int e1, int palette[8])
+{
+	palette[0] = e0;
+	palette[1] = e1;
+	if (e0 > e1)
+	{
+		for (int i = 1; i < 7; i++)
+			palette[i + 1] = ((7 - i) * e0 + i * e1 + 3) / 7;
+	}
+	else
+	{
+		for (int i = 1; i < 5; i++)
+			palette[i + 1] = ((5 - i) * e0 + i * e1 + 2) / 5;
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+void TextureCompressor::EncodeBlockBC4(const unsigned char* rgba, unsigned int channel, unsigned char* block)
+{
+	int lowest = 255;
+	int highest = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		lowest = (std::min)(lowest, (int)rgba[i * 4 + channel]);
+		highest = (std::max)(highest, (int)rgba[i * 4 + channel]);
+	}
+
+	//highest first picks the eight value mode, which covers the range most finely
+	int palette[8];
+	Bc4Palette(highest, lowest, palette);
+
+	memset(block, 0, 8);
+	block[0] = (unsigned char)highest;
+	block[1] = (unsigned char)lowest;
+	BlockBits bits = { block + 2, 0 };
+	for (int i = 0; i < 16; i++)
+	{
+		int value = rgba[i * 4 + channel];
+		int best = 0;
+		for (int j = 1; j < 8; j++)
+		{
+			if (abs(value - palette[j]) < abs(value - palette[best]))
+				best = j;
+		}
+		bits.Write(best, 3);
+	}
+}
+
+void TextureCompressor::DecodeBlockBC4(const unsigned char* block, unsigned int channel, unsigned char* rgba)
+{
+	int palette[8];
+	Bc4Palette(block[0], block[1], palette);
+
+	BlockBits bits = { (unsigned char*)block + 2, 0 };
+	for (int i = 0; i < 16; i++)
+		rgba[i * 4 + channel] = (unsigned char)palette[bits.Read(3)];
+}
+
+// --------------------------------------------------------
+// BC7, mode 6 only - one subset, 7 bit rgba endpoints with
+// a shared low bit each and 16 weights. Not the best BC7
+// can do on blocks with two distinct colors in them, but
+// close on everything else and very simple
+// --------------------------------------------------------
+static const int Bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+struct Bc7Mode6
+{
+	int endpoints[2][4];	// 7 bits each
+	int pbits[2];
+	unsigned int indices[16];
+};
+
+static void Bc7Palette(const Bc7Mode6& mode, int palette[16][4])
+{
+	int e0[4], e1[4];
+	for (int c = 0; c < 4; c++)
+	{
+		e0[c] = (mode.endpoints[0][c] << 1) | mode.pbits[0];
+		e1[c] = (mode.endpoints[1][c] << 1) | mode.pbits[1];
+	}
+	for (int i = 0; i < 16; i++)
+	{
+		for (int c = 0; c < 4; c++)
+			palette[i][c] = ((64 - Bc7Weights[i]) * e0[c] + Bc7Weights[i] * e1[c] + 32) >> 6;
+	}
+}
+
+//quantizes float endpoints with the given low bits, picks indices, returns the total squared error
+static int Bc7Evaluate(const unsigned char* rgba, const float* a, const float* b, int p0, int p1, Bc7Mode6& mode)
+{
+	mode.pbits[0] = p0;
+	mode.pbits[1] = p1;
+	for (int c = 0; c < 4; c++)
+	{
+		mode.endpoints[0][c] = (std::min)((std::max)((int)floorf((a[c] - p0) * 0.5f + 0.5f), 0), 127);
+		mode.endpoints[1][c] = (std::min)((std::max)((int)floorf((b[c] - p1) * 0.5f + 0.5f), 0), 127);
+	}
+
+	int palette[16][4];
+	Bc7Palette(mode, palette);
+
+	// Projecting onto the line between the endpoints lands next to
+	// the best weight, so only it and its neighbours get checked
+	// rather than all 16 (rounding means it's not always the nearest)
+	int axis[4];
+	int axisLengthSq = 0;
+	for (int c = 0; c < 4; c++)
+	{
+		axis[c] = palette[15][c] - palette[0][c];
+		axisLengthSq += axis[c] * axis[c];
+	}
+
+	int total = 0;
+	for (int i = 0; i < 16; i++)
+	{
+		const unsigned char* p = &rgba[i * 4];
+		int guess = 0;
+		if (axisLengthSq > 0)
+		{
+			int projection = 0;
+			for (int c = 0; c < 4; c++)
+				projection += (p[c] - palette[0][c]) * axis[c];
+			float t = (std::min)((std::max)((float)projection / axisLengthSq, 0.0f), 1.0f);
+			guess = (int)(t * 15.0f + 0.5f);
+		}
+
+		int best = guess;
+		int bestError = INT_MAX;
+		for (int j = (std::max)(guess - 1, 0); j <= (std::min)(guess + 1, 15); j++)
+		{
+			int error = 0;
+			for (int c = 0; c < 4; c++)
+			{
+				int d = p[c] - palette[j][c];
+				error += d * d;
+			}
+			if (error < bestError)
+			{
+				bestError = error;
+				best = j;
+			}
+		}
+		mode.indices[i] = best;
+		total += bestError;
+	}
+	return total;
+}
+
+//tries all four low bit pairs for a set of endpoints, keeps whichever does best
+static int Bc7Best(const unsigned char* rgba, const float* a, const float* b, Bc7Mode6& best)
+{
+	int bestError = INT_MAX;
+	for (int p = 0; p < 4; p++)
+	{
+		Bc7Mode6 mode;
+		int error = Bc7Evaluate(rgba, a, b, p & 1, p >> 1, mode);
+		if (error < bestError)
+		{
+			bestError = error;
+			best = mode;
+		}
+	}
+	return bestError;
+}
+
+void TextureCompressor::EncodeBlockBC7(const unsigned char* rgba, unsigned char* block)
+{
+	float low[4], high[4];
+	PrincipalEndpoints(rgba, 4, low, high);
+
+	Bc7Mode6 mode;
+	int error = Bc7Best(rgba, low, high, mode);
+
+	//one round of least squares with the weights that gave
+	float weights[16];
+	for (int i = 0; i < 16; i++)
+		weights[i] = Bc7Weights[mode.indices[i]] / 64.0f;
+	float a[4], b[4];
+	if (error > 0 && FitEndpoints(rgba, weights, 4, a, b))
+	{
+		Bc7Mode6 fit;
+		if (Bc7Best(rgba, a, b, fit) < error)
+			mode = fit;
+	}
+
+	// The first index is stored a bit short, so it has to have
+	// its top bit clear - if not, swap the ends over
+	if (mode.indices[0] & 8)
+	{
+		for (int c = 0; c < 4; c++)
+			std::swap(mode.endpoints[0][c], mode.endpoints[1][c]);
+		std::swap(mode.pbits[0], mode.pbits[1]);
+		for (int i = 0; i < 16; i++)
+			mode.indices[i] = 15 - mode.indices[i];
+	}
+
+	memset(block, 0, 16);
+	BlockBits bits = { block, 0 };
+	bits.Write(1 << 6, 7);
+	for (int c = 0; c < 4; c++)
+	{
+		bits.Write(mode.endpoints[0][c], 7);
+		bits.Write(mode.endpoints[1][c], 7);
+	}
+	bits.Write(mode.pbits[0], 1);
+	bits.Write(mode.pbits[1], 1);
+	bits.Write(mode.indices[0], 3);
+	for (int i = 1; i < 16; i++)
+		bits.Write(mode.indices[i], 4);
+}
+
+void TextureCompressor::DecodeBlockBC7(const unsigned char* block, unsigned char* rgba)
+{
+	//only mode 6 is ever written here, anything else decodes as black
+	if ((block[0] & 0x7F) != (1 << 6))
+	{
+		memset(rgba, 0, 64);
+		return;
+	}
+
+	Bc7Mode6 mode;
+	BlockBits bits = { (unsigned char*)block, 7 };
+	for (int c = 0; c < 4; c++)
+	{
+		mode.endpoints[0][c] = bits.Read(7);
+		mode.endpoints[1][c] = bits.Read(7);
+	}
+	mode.pbits[0] = bits.Read(1);
+	mode.pbits[1] = bits.Read(1);
+
+	int palette[16][4];
+	Bc7Palette(mode, palette);
+	for (int i = 0; i < 16; i++)
+	{
+		unsigned int index = bits.Read(i == 0 ? 3 : 4);
+		for (int c = 0; c < 4; c++)
+			rgba[i * 4 + c] = (unsigned char)palette[index][c];
+	}
+}
+
+// --------------------------------------------------------
+// Whole textures
+// --------------------------------------------------------
+static unsigned int BlockBytes(BlockFormat format)
+{
+	return format == BlockFormat::BC1 || format == BlockFormat::BC4 ? 8 : 16;
+}
+
+static BlockFormat FormatOf(DXGI_FORMAT format)
+{
+	switch (format)
+	{
+	case DXGI_FORMAT_BC1_UNORM:
+	case DXGI_FORMAT_BC1_UNORM_SRGB:
+		return BlockFormat::BC1;
+	case DXGI_FORMAT_BC4_UNORM:
+		return BlockFormat::BC4;
+	case DXGI_FORMAT_BC5_UNORM:
+		return BlockFormat::BC5;
+	default:
+		return BlockFormat::BC7;
+	}
+}
+
+void TextureCompressor::Compress(const ImageRgba& source, BlockFormat format, MipFilter filter, bool srgb, CompressedTexture& out)
+{
+	std::vector<ImageRgba> mips;
+	GenerateMips(source, filter, mips);
+
+	switch (format)
+	{
+	case BlockFormat::BC1: out.format = srgb ? DXGI_FORMAT_BC1_UNORM_SRGB : DXGI_FORMAT_BC1_UNORM; break;
+	case BlockFormat::BC4: out.format = DXGI_FORMAT_BC4_UNORM; break;
+	case BlockFormat::BC5: out.format = DXGI_FORMAT_BC5_UNORM; break;
+	case BlockFormat::BC7: out.format = srgb ? DXGI_FORMAT_BC7_UNORM_SRGB : DXGI_FORMAT_BC7_UNORM; break;
+	}
+	out.width = source.width;
+	out.height = source.height;
+	out.mipCount = (unsigned int)mips.size();
+	out.blocks.clear();
+	out.mipOffsets.clear();
+
+	unsigned int blockBytes = BlockBytes(format);
+	for (auto& mip : mips)
+	{
+		unsigned int blocksWide = (mip.width + 3) / 4;
+		unsigned int blocksHigh = (mip.height + 3) / 4;
+		size_t offset = out.blocks.size();
+		out.mipOffsets.push_back(offset);
+		out.blocks.resize(offset + (size_t)blocksWide * blocksHigh * blockBytes);
+
+		unsigned char* block = &out.blocks[offset];
+		for (unsigned int by = 0; by < blocksHigh; by++)
+		{
+			for (unsigned int bx = 0; bx < blocksWide; bx++, block += blockBytes)
+			{
+				//levels smaller than a block repeat their edge pixels to fill it
+				unsigned char tile[64];
+				for (unsigned int y = 0; y < 4; y++)
+				{
+					unsigned int sy = (std::min)(by * 4 + y, mip.height - 1);
+					for (unsigned int x = 0; x < 4; x++)
+					{
+						unsigned int sx = (std::min)(bx * 4 + x, mip.width - 1);
+						memcpy(&tile[(y * 4 + x) * 4], &mip.pixels[((size_t)sy * mip.width + sx) * 4], 4);
+					}
+				}
+
+				switch (format)
+				{
+				case BlockFormat::BC1: EncodeBlockBC1(tile, block); break;
+				case BlockFormat::BC4: EncodeBlockBC4(tile, 0, block); break;
+				case BlockFormat::BC5: EncodeBlockBC4(tile, 0, block); EncodeBlockBC4(tile, 1, block + 8); break;
+				case BlockFormat::BC7: EncodeBlockBC7(tile, block); break;
+				}
+			}
+		}
+	}
+
+	ImageRgba decoded;
+	Decompress(out, 0, decoded);
+	unsigned int channels = format == BlockFormat::BC4 ? 1 : format == BlockFormat::BC5 ? 2 : format == BlockFormat::BC1 ? 3 : 4;
+	out.psnr = ComputePsnr(source, decoded, channels);
+}
+
+void TextureCompressor::Decompress(const CompressedTexture& texture, unsigned int mip, ImageRgba& out)
+{
+	BlockFormat format = FormatOf(texture.format);
+	out.width = (std::max)(texture.width >> mip, 1u);
+	out.height = (std::max)(texture.height >> mip, 1u);
+	out.pixels.assign((size_t)out.width * out.height * 4, 0);
+
+	unsigned int blockBytes = BlockBytes(format);
+	unsigned int blocksWide = (out.width + 3) / 4;
+	unsigned int blocksHigh = (out.height + 3) / 4;
+	const unsigned char* block = &texture.blocks[texture.mipOffsets[mip]];
+	for (unsigned int by = 0; by < blocksHigh; by++)
+	{
+		for (unsigned int bx = 0; bx < blocksWide; bx++, block += blockBytes)
+		{
+			unsigned char tile[64];
+			memset(tile, 0, sizeof(tile));
+			switch (format)
+			{
+			case BlockFormat::BC1: DecodeBlockBC1(block, tile); break;
+			case BlockFormat::BC4: DecodeBlockBC4(block, 0, tile); break;
+			case BlockFormat::BC5: DecodeBlockBC4(block, 0, tile); DecodeBlockBC4(block + 8, 1, tile); break;
+			case BlockFormat::BC7: DecodeBlockBC7(block, tile); break;
+			}
+			if (format == BlockFormat::BC4 || format == BlockFormat::BC5)
+			{
+				for (int i = 0; i < 16; i++)
+					tile[i * 4 + 3] = 255;
+			}
+
+			for (unsigned int y = 0; y < 4 && by * 4 + y < out.height; y++)
+			{
+				unsigned int width = (std::min)(4u, out.width - bx * 4);
+				memcpy(&out.pixels[((size_t)(by * 4 + y) * out.width + bx * 4) * 4], &tile[y * 16], width * 4);
+			}
+		}
+	}
+}
+
+float TextureCompressor::ComputePsnr(const ImageRgba& a, const ImageRgba& b, unsigned int channelCount)
+{
+	if (a.width != b.width || a.height != b.height || channelCount == 0)
+		return 0.0f;
+
+	double sum = 0.0;
+	size_t count = (size_t)a.width * a.height;
+	for (size_t i = 0; i < count; i++)
+	{
+		for (unsigned int c = 0; c < channelCount; c++)
+		{
+			double d = (double)a.pixels[i * 4 + c] - b.pixels[i * 4 + c];
+			sum += d * d;
+		}
+	}
+	if (sum == 0.0)
+		return 99.0f;
+
+	double mse = sum / ((double)count * channelCount);
+	return (float)(10.0 * log10(255.0 * 255.0 / mse));
+}
+
+// --------------------------------------------------------
+// DDS files
+// --------------------------------------------------------
+struct DdsPixelFormat
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int fourCC;
+	unsigned int rgbBitCount;
+	unsigned int masks[4];
+};
+
+struct DdsHeader
+{
+	unsigned int size;
+	unsigned int flags;
+	unsigned int height;
+	unsigned int width;
+	unsigned int pitchOrLinearSize;
+	unsigned int depth;
+	unsigned int mipMapCount;
+	unsigned int reserved1[11];		// [0] magic, [1] version, [2-3] source size, [4-5] source write time
+	DdsPixelFormat pixelFormat;
+	unsigned int caps[4];
+	unsigned int reserved2;
+};
+
+struct DdsHeaderDx10
+{
+	unsigned int dxgiFormat;
+	unsigned int resourceDimension;
+	unsigned int miscFlag;
+	unsigned int arraySize;
+	unsigned int miscFlags2;
+};
+
+static const unsigned int DdsMagic = 0x20534444;	// "DDS "
+static const size_t DdsHeaderBytes = 4 + sizeof(DdsHeader) + sizeof(DdsHeaderDx10);
+
+//size and write time of the source, what an import has to match to still be good
+static bool GetSourceStamp(const std::wstring& filename, unsigned int stamp[4])
+{
+	WIN32_FILE_ATTRIBUTE_DATA data = {};
+	if (!GetFileAttributesExW(filename.c_str(), GetFileExInfoStandard, &data))
+		return false;
+
+	stamp[0] = data.nFileSizeLow;
+	stamp[1] = data.nFileSizeHigh;
+	stamp[2] = data.ftLastWriteTime.dwLowDateTime;
+	stamp[3] = data.ftLastWriteTime.dwHighDateTime;
+	return true;
+}
+
+void TextureCompressor::BuildDds(const CompressedTexture& texture, const std::wstring& sourceFilename, std::vector<unsigned char>& dds)
+{
+	DdsHeader header = {};
+	header.size = sizeof(DdsHeader);
+	header.flags = 0x1 | 0x2 | 0x4 | 0x1000 | 0x20000 | 0x80000;	// caps, height, width, pixel format, mip count, linear size
+	header.height = texture.height;
+	header.width = texture.width;
+	header.pitchOrLinearSize = (unsigned int)(texture.mipCount > 1 ? texture.mipOffsets[1] : texture.blocks.size());
+	header.mipMapCount = texture.mipCount;
+	header.reserved1[0] = TextureImportMagic;
+	header.reserved1[1] = TextureImportVersion;
+	GetSourceStamp(sourceFilename, &header.reserved1[2]);
+	header.pixelFormat.size = sizeof(DdsPixelFormat);
+	header.pixelFormat.flags = 0x4;					// four cc
+	header.pixelFormat.fourCC = 0x30315844;			// "DX10"
+	header.caps[0] = 0x1000 | 0x400000 | 0x8;		// texture, mipmap, complex
+
+	DdsHeaderDx10 dx10 = {};
+	dx10.dxgiFormat = texture.format;
+	dx10.resourceDimension = 3;						// texture 2d
+	dx10.arraySize = 1;
+
+	dds.resize(DdsHeaderBytes + texture.blocks.size());
+	memcpy(&dds[0], &DdsMagic, 4);
+	memcpy(&dds[4], &header, sizeof(header));
+	memcpy(&dds[4 + sizeof(header)], &dx10, sizeof(dx10));
+	memcpy(&dds[DdsHeaderBytes], &texture.blocks[0], texture.blocks.size());
+}
+
+bool TextureCompressor::ReadDdsLayout(const std::vector<unsigned char>& dds, CompressedTexture& layout, size_t& blocksOffset)
+{
+	if (dds.size() <= DdsHeaderBytes || memcmp(&dds[0], &DdsMagic, 4) != 0)
+		return false;
+
+	DdsHeader header;
+	DdsHeaderDx10 dx10;
+	memcpy(&header, &dds[4], sizeof(header));
+	memcpy(&dx10, &dds[4 + sizeof(header)], sizeof(dx10));
+	if (header.reserved1[0] != TextureImportMagic || header.width == 0 || header.height == 0 || header.mipMapCount == 0)
+		return false;
+
+	layout.width = header.width;
+	layout.height = header.height;
+	layout.mipCount = header.mipMapCount;
+	layout.format = (DXGI_FORMAT)dx10.dxgiFormat;
+	layout.blocks.clear();
+	layout.mipOffsets.clear();
+	layout.psnr = 0.0f;
+
+	// Levels are back to back from the largest down, the same as Compress lays them out
+	unsigned int blockBytes = BlockBytes(FormatOf(layout.format));
+	size_t offset = 0;
+	for (unsigned int mip = 0; mip < layout.mipCount; mip++)
+	{
+		unsigned int width = (std::max)(1u, layout.width >> mip);
+		unsigned int height = (std::max)(1u, layout.height >> mip);
+		layout.mipOffsets.push_back(offset);
+		offset += (size_t)((width + 3) / 4) * ((height + 3) / 4) * blockBytes;
+	}
+
+	blocksOffset = DdsHeaderBytes;
+	return DdsHeaderBytes + offset == dds.size();
+}
+
+std::wstring TextureCompressor::GetImportPath(const std::wstring& sourceFilename, const wchar_t* suffix)
+{
+	return sourceFilename + L"." + suffix + L".dds";
+}
+
+bool TextureCompressor::ReadImport(const std::wstring& importFilename, const std::wstring& sourceFilename, std::vector<unsigned char>& dds)
+{
+	unsigned int stamp[4];
+	if (!GetSourceStamp(sourceFilename, stamp))
+		return false;
+
+	HANDLE file = CreateFileW(importFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER size = {};
+	DWORD read = 0;
+	bool success = GetFileSizeEx(file, &size) && size.QuadPart > (long long)DdsHeaderBytes && size.QuadPart < 0x7FFFFFFF;
+	if (success)
+	{
+		dds.resize((size_t)size.QuadPart);
+		success = ReadFile(file, &dds[0], (DWORD)dds.size(), &read, 0) && read == dds.size();
+	}
+	CloseHandle(file);
+
+	// Only good if it's one of ours, from this version of the
+	// encoder, and made from the source exactly as it is now
+	if (success)
+	{
+		DdsHeader header;
+		memcpy(&header, &dds[4], sizeof(header));
+		success = memcmp(&dds[0], &DdsMagic, 4) == 0 &&
+			header.reserved1[0] == TextureImportMagic &&
+			header.reserved1[1] == TextureImportVersion &&
+			memcmp(&header.reserved1[2], stamp, sizeof(stamp)) == 0;
+	}
+	if (!success)
+		dds.clear();
+	return success;
+}
+
+bool TextureCompressor::WriteImport(const std::wstring& importFilename, const std::vector<unsigned char>& dds)
+{
+	//written to the side and moved into place, so a half written file never looks like an import
+	std::wstring tempPath = importFilename + L".tmp";
+	HANDLE file = CreateFileW(tempPath.c_str(), GENERIC_WRITE, 0, 0, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	DWORD written = 0;
+	bool success = WriteFile(file, &dds[0], (DWORD)dds.size(), &written, 0) && written == dds.size();
+	CloseHandle(file);
+
+	if (!success || !MoveFileExW(tempPath.c_str(), importFilename.c_str(), MOVEFILE_REPLACE_EXISTING))
+	{
+		DeleteFileW(tempPath.c_str());
+		return false;
+	}
+	return true;
+}
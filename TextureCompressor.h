@@ -0,0 +1,84 @@
+#pragma once
+#include <d3d11.h>
+#include <string>
+#include <vector>
+
+// Block compressed formats the importer can write, each 4x4 pixels to a block
+enum class BlockFormat
+{
+	BC1,	// rgb, 8 bytes a block - flat colored textures
+	BC4,	// one channel, 8 bytes a block - roughness, metalness
+	BC5,	// two channels, 16 bytes a block - normal map x and y
+	BC7		// rgba, 16 bytes a block - everything else with color
+};
+
+// How the mip chain gets filtered
+enum class MipFilter
+{
+	Color,		// averaged in linear light, rgb stored with the srgb curve
+	Normal,		// averaged as vectors and renormalized
+	Linear		// plain averages
+};
+
+// An 8 bit rgba image with its rows packed together
+struct ImageRgba
+{
+	unsigned int width;
+	unsigned int height;
+	std::vector<unsigned char> pixels;
+};
+
+// A whole mip chain of blocks, largest level first, ready to go in a dds
+struct CompressedTexture
+{
+	unsigned int width;
+	unsigned int height;
+	unsigned int mipCount;
+	DXGI_FORMAT format;
+	std::vector<unsigned char> blocks;		// every level back to back
+	std::vector<size_t> mipOffsets;			// where each level starts in blocks
+	float psnr;								// top level against the source, in dB, over the channels the format keeps
+};
+
+// --------------------------------------------------------
+// Texture import - cpu mip generation and BCn encoding
+//
+// Runs once per texture, the result is saved as a dds next
+// to the source image (like the mesh cache does for models)
+// so later runs hand the blocks straight to the gpu.
+//
+// Nothing here needs a device, so it works headless.
+// --------------------------------------------------------
+class TextureCompressor
+{
+public:
+	//every level down to 1x1, including the source as level 0
+	static void GenerateMips(const ImageRgba& source, MipFilter filter, std::vector<ImageRgba>& mips);
+
+	//mips and blocks for every level - srgb picks the _SRGB flavor of BC1/BC7 (the blocks are the same)
+	static void Compress(const ImageRgba& source, BlockFormat format, MipFilter filter, bool srgb, CompressedTexture& out);
+
+	//back to rgba8 for one level, BC4 fills r only and BC5 r and g (the rest are 0, alpha 255)
+	static void Decompress(const CompressedTexture& texture, unsigned int mip, ImageRgba& out);
+
+	//peak signal to noise ratio over the first channelCount channels, higher is better (99 for identical)
+	static float ComputePsnr(const ImageRgba& a, const ImageRgba& b, unsigned int channelCount);
+
+	//single blocks, for a 4x4 tile of rgba pixels
+	static void EncodeBlockBC1(const unsigned char* rgba, unsigned char* block);
+	static void EncodeBlockBC4(const unsigned char* rgba, unsigned int channel, unsigned char* block);
+	static void EncodeBlockBC7(const unsigned char* rgba, unsigned char* block);
+	static void DecodeBlockBC1(const unsigned char* block, unsigned char* rgba);
+	static void DecodeBlockBC4(const unsigned char* block, unsigned int channel, unsigned char* rgba);
+	static void DecodeBlockBC7(const unsigned char* block, unsigned char* rgba);
+
+	//a whole dds file in memory (dx10 header), with the source's size and write time stamped in the header
+	static void BuildDds(const CompressedTexture& texture, const std::wstring& sourceFilename, std::vector<unsigned char>& dds);
+	//the layout of a dds BuildDds wrote, without its blocks - they start blocksOffset bytes into the file
+	static bool ReadDdsLayout(const std::vector<unsigned char>& dds, CompressedTexture& layout, size_t& blocksOffset);
+	//where the import of a source lives, one file per kind of import
+	static std::wstring GetImportPath(const std::wstring& sourceFilename, const wchar_t* suffix);
+	//reads an import if it was made from the source as it is now
+	static bool ReadImport(const std::wstring& importFilename, const std::wstring& sourceFilename, std::vector<unsigned char>& dds);
+	static bool WriteImport(const std::wstring& importFilename, const std::vector<unsigned char>& dds);
+};
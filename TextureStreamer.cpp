@@ -0,0 +1,542 @@
+#include "TextureStreamer.h"
+#include "TextureCompressor.h"
+#include <Windows.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+
+//textures start at the first mip that's no bigger than this on its larger side
+static const unsigned int StreamingStartSize = 64;
+
+// --------------------------------------------------------
+// Residency
+// --------------------------------------------------------
+MipResidency::MipResidency()
+{
+	budget = 0;
+	residentBytes = 0;
+	loads = 0;
+	frame = 0;
+}
+
+void MipResidency::SetBudget(unsigned long long bytes)
+{
+	budget = bytes;
+}
+
+unsigned long long MipResidency::GetBudget()
+{
+	return budget;
+}
+
+unsigned int MipResidency::AddTexture(const std::vector<unsigned long long>& levelBytes, unsigned int startMip)
+{
+	Texture texture;
+	texture.levelBytes = levelBytes;
+	texture.lastNeeded.assign(levelBytes.size(), 0);
+	texture.startMip = (std::min)(startMip, (unsigned int)levelBytes.size() - 1);
+	texture.residentMip = texture.startMip;
+	texture.loadingMip = texture.startMip;
+	texture.requiredMip = texture.startMip;
+	texture.removed = false;
+
+	residentBytes += BytesFrom(texture, texture.startMip);
+	textures.push_back(texture);
+	return (unsigned int)textures.size() - 1;
+}
+
+void MipResidency::RemoveTexture(unsigned int texture)
+{
+	Texture& t = textures[texture];
+	if (t.removed)
+		return;
+
+	// A load's bytes are already counted, and loadingMip is the
+	// finer of the two. With no levels left and nothing finer
+	// than where it is allowed, nothing will plan for it again
+	residentBytes -= BytesFrom(t, t.loadingMip);
+	t.levelBytes.clear();
+	t.lastNeeded.clear();
+	t.startMip = t.residentMip;
+	t.requiredMip = t.residentMip;
+	t.removed = true;
+}
+
+void MipResidency::BeginFrame()
+{
+	frame++;
+	for (auto& texture : textures)
+		texture.requiredMip = texture.startMip;
+}
+
+void MipResidency::RequestMip(unsigned int texture, unsigned int mip)
+{
+	Texture& t = textures[texture];
+	if (t.removed)
+		return;
+	mip = (std::min)(mip, t.startMip);
+	t.requiredMip = (std::min)(t.requiredMip, mip);
+
+	//a level that's needed needs everything under it too, and those are usually marked already
+	for (unsigned int level = mip; level < t.lastNeeded.size() && t.lastNeeded[level] != frame; level++)
+		t.lastNeeded[level] = frame;
+}
+
+unsigned long long MipResidency::BytesFrom(const Texture& texture, unsigned int mip)
+{
+	unsigned long long bytes = 0;
+	for (unsigned int level = mip; level < texture.levelBytes.size(); level++)
+		bytes += texture.levelBytes[level];
+	return bytes;
+}
+
+bool MipResidency::MakeRoom(unsigned long long extra, unsigned int keep, bool dropNeeded, std::vector<unsigned int>& dropped)
+{
+	if (residentBytes + extra <= budget)
+		return true;
+
+	// A load checks it can fit before dropping anything, so one
+	// that can't happen doesn't cost anyone their levels
+	if (!dropNeeded)
+	{
+		unsigned long long droppable = 0;
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			Texture& t = textures[i];
+			if (i != keep && t.loadingMip == t.residentMip && t.residentMip < t.requiredMip)
+				droppable += BytesFrom(t, t.residentMip) - BytesFrom(t, t.requiredMip);
+		}
+		if (residentBytes + extra > budget + droppable)
+			return false;
+	}
+
+	// One level at a time from whichever texture needed its
+	// finest level longest ago, the biggest level on a tie
+	while (residentBytes + extra > budget)
+	{
+		unsigned int victim = (unsigned int)-1;
+		for (unsigned int i = 0; i < textures.size(); i++)
+		{
+			Texture& t = textures[i];
+			if (i == keep || t.loadingMip != t.residentMip || t.residentMip >= t.startMip)
+				continue;
+			if (!dropNeeded && t.residentMip >= t.requiredMip)
+				continue;
+
+			if (victim == (unsigned int)-1)
+			{
+				victim = i;
+				continue;
+			}
+			Texture& v = textures[victim];
+			unsigned int age = t.lastNeeded[t.residentMip];
+			unsigned int victimAge = v.lastNeeded[v.residentMip];
+			if (age < victimAge || (age == victimAge && t.levelBytes[t.residentMip] > v.levelBytes[v.residentMip]))
+				victim = i;
+		}
+		if (victim == (unsigned int)-1)
+			return false;
+
+		Texture& v = textures[victim];
+		residentBytes -= v.levelBytes[v.residentMip];
+		v.residentMip++;
+		v.loadingMip = v.residentMip;
+		dropped[victim]++;
+	}
+	return true;
+}
+
+void MipResidency::Plan(unsigned int maxLoads, std::vector<MipChange>& changes)
+{
+	changes.clear();
+	std::vector<unsigned int> dropped(textures.size(), 0);
+
+	// Whatever's furthest from what it needs goes first
+	std::vector<unsigned int> wanting;
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (textures[i].loadingMip == textures[i].residentMip && textures[i].requiredMip < textures[i].residentMip)
+			wanting.push_back(i);
+	}
+	std::stable_sort(wanting.begin(), wanting.end(), [this](unsigned int a, unsigned int b)
+	{
+		return textures[a].residentMip - textures[a].requiredMip > textures[b].residentMip - textures[b].requiredMip;
+	});
+
+	std::vector<MipChange> newLoads;
+	for (unsigned int i : wanting)
+	{
+		if (loads >= maxLoads)
+			break;
+
+		// All the way to what it needs if that fits, otherwise
+		// as close as the budget allows
+		Texture& t = textures[i];
+		unsigned int target = t.requiredMip;
+		unsigned long long extra = 0;
+		for (; target < t.residentMip; target++)
+		{
+			extra = BytesFrom(t, target) - BytesFrom(t, t.residentMip);
+			if (MakeRoom(extra, i, false, dropped))
+				break;
+		}
+		if (target == t.residentMip)
+			continue;
+
+		t.loadingMip = target;
+		residentBytes += extra;
+		loads++;
+		MipChange load = { i, t.residentMip, target };
+		newLoads.push_back(load);
+	}
+
+	//the budget can end up under what's in use when it's lowered, even needed levels go then
+	MakeRoom(0, (unsigned int)-1, true, dropped);
+
+	for (unsigned int i = 0; i < textures.size(); i++)
+	{
+		if (dropped[i] > 0)
+		{
+			MipChange drop = { i, textures[i].residentMip - dropped[i], textures[i].residentMip };
+			changes.push_back(drop);
+		}
+	}
+	changes.insert(changes.end(), newLoads.begin(), newLoads.end());
+}
+
+void MipResidency::FinishLoad(unsigned int texture, bool succeeded)
+{
+	Texture& t = textures[texture];
+	if (t.loadingMip == t.residentMip)
+		return;
+
+	//removed while it was loading, its bytes went then
+	if (t.removed)
+	{
+		t.loadingMip = t.residentMip;
+		loads--;
+		return;
+	}
+
+	if (succeeded)
+		t.residentMip = t.loadingMip;
+	else
+		residentBytes -= BytesFrom(t, t.loadingMip) - BytesFrom(t, t.residentMip);
+	t.loadingMip = t.residentMip;
+	loads--;
+}
+
+void MipResidency::CancelDrop(const MipChange& drop)
+{
+	Texture& t = textures[drop.texture];
+	if (t.removed || t.residentMip != drop.toMip || t.loadingMip != t.residentMip)
+		return;
+	residentBytes += BytesFrom(t, drop.fromMip) - BytesFrom(t, drop.toMip);
+	t.residentMip = drop.fromMip;
+	t.loadingMip = drop.fromMip;
+}
+
+unsigned int MipResidency::GetResidentMip(unsigned int texture)
+{
+	return textures[texture].residentMip;
+}
+
+unsigned int MipResidency::GetRequiredMip(unsigned int texture)
+{
+	return textures[texture].requiredMip;
+}
+
+bool MipResidency::IsLoading(unsigned int texture)
+{
+	return textures[texture].loadingMip != textures[texture].residentMip;
+}
+
+unsigned int MipResidency::GetTextureCount()
+{
+	return (unsigned int)textures.size();
+}
+
+unsigned int MipResidency::GetLoadCount()
+{
+	return loads;
+}
+
+unsigned long long MipResidency::GetResidentBytes()
+{
+	return residentBytes;
+}
+
+unsigned long long MipResidency::GetRequiredBytes()
+{
+	unsigned long long bytes = 0;
+	for (auto& texture : textures)
+		bytes += BytesFrom(texture, texture.requiredMip);
+	return bytes;
+}
+
+unsigned int MipResidency::GetFrame()
+{
+	return frame;
+}
+
+// --------------------------------------------------------
+// Streamer
+// --------------------------------------------------------
+TextureStreamer::TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context)
+{
+	this->device = device;
+	this->context = context;
+	fullBytes = 0;
+	streamedLevels = 0;
+	droppedLevels = 0;
+}
+
+float TextureStreamer::ComputeMip(unsigned int textureSize, float uvDensity, float distance, float pixelsPerUnit)
+{
+	//nothing to go on (a mesh that isn't in yet), so it gets no more than it starts with
+	if (textureSize == 0 || uvDensity <= 0.0f || pixelsPerUnit <= 0.0f)
+		return 32.0f;
+
+	// Each mip halves the texels, so the mip is how many times
+	// over the texture's texels outnumber the pixels they cover
+	float texelsPerUnit = textureSize * uvDensity;
+	float pixelsHere = pixelsPerUnit / (std::max)(distance, 0.001f);
+	return log2f(texelsPerUnit / pixelsHere);
+}
+
+bool TextureStreamer::Add(std::shared_ptr<StreamedTexture> texture, const std::wstring& importFilename, const std::vector<unsigned char>& dds, bool canStream)
+{
+	CompressedTexture layout;
+	Entry entry;
+	if (!TextureCompressor::ReadDdsLayout(dds, layout, entry.blocksOffset))
+		return false;
+
+	entry.textures.push_back(texture);
+	entry.importFilename = importFilename;
+	entry.format = layout.format;
+	entry.mipCount = layout.mipCount;
+	entry.mipOffsets = layout.mipOffsets;
+	for (unsigned int mip = 0; mip < layout.mipCount; mip++)
+	{
+		size_t end = mip + 1 < layout.mipCount ? layout.mipOffsets[mip + 1] : dds.size() - entry.blocksOffset;
+		entry.levelBytes.push_back(end - layout.mipOffsets[mip]);
+	}
+	texture->width = layout.width;
+	texture->height = layout.height;
+
+	// d3d wants the top of a block compressed texture in whole
+	// blocks, so the chain can only start where that's still true
+	unsigned int lastTop = 0;
+	while (lastTop + 1 < layout.mipCount)
+	{
+		unsigned int width = layout.width >> (lastTop + 1);
+		unsigned int height = layout.height >> (lastTop + 1);
+		if (width < 4 || height < 4 || width % 4 != 0 || height % 4 != 0)
+			break;
+		lastTop++;
+	}
+	unsigned int startMip = 0;
+	while (canStream && startMip < lastTop && (std::max)(layout.width, layout.height) >> startMip > StreamingStartSize)
+		startMip++;
+
+	if (!Rebuild(entry, startMip, entry.mipCount, &dds[entry.blocksOffset + entry.mipOffsets[startMip]]))
+		return false;
+
+	texture->residency = residency.AddTexture(entry.levelBytes, startMip);
+	for (auto bytes : entry.levelBytes)
+		fullBytes += bytes;
+	entries.push_back(entry);
+	return true;
+}
+
+void TextureStreamer::Share(const StreamedTexture& existing, std::shared_ptr<StreamedTexture> texture)
+{
+	texture->srv = existing.srv;
+	texture->width = existing.width;
+	texture->height = existing.height;
+	texture->residency = existing.residency;
+
+	//one that isn't streamed never changes, so there's nothing to follow
+	if (existing.residency != (unsigned int)-1)
+		entries[existing.residency].textures.push_back(texture);
+}
+
+void TextureStreamer::Remove(std::shared_ptr<StreamedTexture> texture)
+{
+	if (texture->residency == (unsigned int)-1)
+		return;
+	Entry& entry = entries[texture->residency];
+	entry.textures.erase(std::remove(entry.textures.begin(), entry.textures.end(), texture), entry.textures.end());
+	if (entry.textures.empty())
+	{
+		residency.RemoveTexture(texture->residency);
+		for (auto bytes : entry.levelBytes)
+			fullBytes -= bytes;
+		entry.gpuTexture.Reset();
+	}
+	texture->residency = (unsigned int)-1;
+}
+
+bool TextureStreamer::Rebuild(Entry& entry, unsigned int topMip, unsigned int newLevelsEnd, const unsigned char* newLevels)
+{
+	StreamedTexture& texture = *entry.textures[0];
+
+	D3D11_TEXTURE2D_DESC desc = {};
+	desc.Width = (std::max)(1u, texture.width >> topMip);
+	desc.Height = (std::max)(1u, texture.height >> topMip);
+	desc.MipLevels = entry.mipCount - topMip;
+	desc.ArraySize = 1;
+	desc.Format = entry.format;
+	desc.SampleDesc.Count = 1;
+	desc.Usage = D3D11_USAGE_DEFAULT;
+	desc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+
+	// Rows of blocks rather than pixels
+	std::vector<D3D11_SUBRESOURCE_DATA> data(desc.MipLevels);
+	for (unsigned int mip = topMip; mip < newLevelsEnd; mip++)
+	{
+		unsigned int blocksHigh = ((std::max)(1u, texture.height >> mip) + 3) / 4;
+		data[mip - topMip].pSysMem = newLevels + (entry.mipOffsets[mip] - entry.mipOffsets[topMip]);
+		data[mip - topMip].SysMemPitch = (UINT)(entry.levelBytes[mip] / blocksHigh);
+	}
+
+	//the very first one is all new, so it can go in as the texture is made
+	bool allNew = newLevelsEnd == entry.mipCount;
+	Microsoft::WRL::ComPtr<ID3D11Texture2D> gpuTexture;
+	if (FAILED(device->CreateTexture2D(&desc, allNew ? &data[0] : 0, gpuTexture.GetAddressOf())))
+		return false;
+
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;
+	D3D11_SHADER_RESOURCE_VIEW_DESC srvDesc = {};
+	srvDesc.Format = entry.format;
+	srvDesc.ViewDimension = D3D11_SRV_DIMENSION_TEXTURE2D;
+	srvDesc.Texture2D.MipLevels = (UINT)-1;
+	if (FAILED(device->CreateShaderResourceView(gpuTexture.Get(), &srvDesc, srv.GetAddressOf())))
+		return false;
+
+	// Otherwise the new levels are uploaded and the ones the
+	// old texture has are copied across without leaving the gpu
+	if (!allNew)
+	{
+		D3D11_TEXTURE2D_DESC oldDesc;
+		entry.gpuTexture->GetDesc(&oldDesc);
+		unsigned int oldTop = entry.mipCount - oldDesc.MipLevels;
+		for (unsigned int mip = topMip; mip < entry.mipCount; mip++)
+		{
+			if (mip < newLevelsEnd)
+				context->UpdateSubresource(gpuTexture.Get(), mip - topMip, 0, data[mip - topMip].pSysMem, data[mip - topMip].SysMemPitch, 0);
+			else
+				context->CopySubresourceRegion(gpuTexture.Get(), mip - topMip, 0, 0, 0, entry.gpuTexture.Get(), mip - oldTop, 0);
+		}
+	}
+
+	entry.gpuTexture = gpuTexture;
+	for (auto& sharing : entry.textures)
+		sharing->srv = srv;
+	return true;
+}
+
+void TextureStreamer::SetBudget(unsigned long long bytes)
+{
+	residency.SetBudget(bytes);
+}
+
+void TextureStreamer::BeginFrame()
+{
+	residency.BeginFrame();
+}
+
+void TextureStreamer::RequestMip(const StreamedTexture& texture, float mip)
+{
+	if (texture.residency == (unsigned int)-1)
+		return;
+	//rounded down, a little too sharp beats a little too blurry
+	residency.RequestMip(texture.residency, mip > 0.0f ? (unsigned int)(std::min)(mip, 32.0f) : 0);
+}
+
+void TextureStreamer::Plan(unsigned int maxLoads, std::vector<MipLoad>& loads)
+{
+	loads.clear();
+	std::vector<MipChange> changes;
+	residency.Plan(maxLoads, changes);
+
+	for (auto& change : changes)
+	{
+		Entry& entry = entries[change.texture];
+		if (change.toMip > change.fromMip)
+		{
+			//if this fails the bigger texture stays a while longer, and residency has to know it's still there
+			if (Rebuild(entry, change.toMip, change.toMip, 0))
+				droppedLevels += change.toMip - change.fromMip;
+			else
+				residency.CancelDrop(change);
+			continue;
+		}
+
+		// Levels are stored largest first, so the ones missing
+		// are one run of bytes in the import
+		MipLoad load;
+		load.texture = change.texture;
+		load.fromMip = change.fromMip;
+		load.toMip = change.toMip;
+		load.importFilename = entry.importFilename;
+		load.fileOffset = entry.blocksOffset + entry.mipOffsets[change.toMip];
+		load.byteCount = entry.mipOffsets[change.fromMip] - entry.mipOffsets[change.toMip];
+		loads.push_back(load);
+	}
+}
+
+bool TextureStreamer::ReadLevels(MipLoad& load)
+{
+	HANDLE file = CreateFileW(load.importFilename.c_str(), GENERIC_READ, FILE_SHARE_READ, 0, OPEN_EXISTING, 0, 0);
+	if (file == INVALID_HANDLE_VALUE)
+		return false;
+
+	LARGE_INTEGER offset = {};
+	offset.QuadPart = (long long)load.fileOffset;
+	DWORD read = 0;
+	load.blocks.resize(load.byteCount);
+	bool success = SetFilePointerEx(file, offset, 0, FILE_BEGIN) &&
+		ReadFile(file, &load.blocks[0], (DWORD)load.byteCount, &read, 0) && read == load.byteCount;
+	CloseHandle(file);
+
+	if (!success)
+		load.blocks.clear();
+	return success;
+}
+
+void TextureStreamer::FinishLoad(MipLoad& load)
+{
+	//removed while it was loading, nothing left to put the levels in
+	Entry& entry = entries[load.texture];
+	bool removed = entry.textures.empty();
+	bool loaded = !removed && !load.blocks.empty() && Rebuild(entry, load.toMip, load.fromMip, &load.blocks[0]);
+	residency.FinishLoad(load.texture, loaded);
+	if (loaded)
+		streamedLevels += load.fromMip - load.toMip;
+#if defined(DEBUG) || defined(_DEBUG)
+	else if (!removed)
+		printf("Couldn't stream mips %u to %u of %ls\n", load.toMip, load.fromMip - 1, entry.importFilename.c_str());
+#endif
+	std::vector<unsigned char>().swap(load.blocks);
+}
+
+MipResidency& TextureStreamer::GetResidency()
+{
+	return residency;
+}
+
+unsigned long long TextureStreamer::GetFullBytes()
+{
+	return fullBytes;
+}
+
+unsigned int TextureStreamer::GetStreamedLevels()
+{
+	return streamedLevels;
+}
+
+unsigned int TextureStreamer::GetDroppedLevels()
+{
+	return droppedLevels;
+}
@@ -0,0 +1,176 @@
+#pragma once
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <string>
+#include <vector>
+#include <memory>
+
+// A texture whose finer mips come and go while it's in use
+// - materials bind whatever srv it has now, it's replaced every time its mips change
+struct StreamedTexture
+{
+	Microsoft::WRL::ComPtr<ID3D11ShaderResourceView> srv;	// null until the first mips are in
+	unsigned int width;			// the full size, 0 until the first mips are in
+	unsigned int height;
+	unsigned int residency;		// its number in the streamer, -1 when it isn't streamed (it couldn't be block compressed, or was removed)
+};
+
+// One texture moving from one resident mip to another
+// - toMip under fromMip brings in finer levels, over it drops them
+struct MipChange
+{
+	unsigned int texture;
+	unsigned int fromMip;
+	unsigned int toMip;
+};
+
+// --------------------------------------------------------
+// Mip residency decisions
+//
+// Only the numbers - which mips each texture wants and which
+// it has - so it can be run without a device. Each texture
+// has a contiguous chain from its most detailed resident mip
+// down to 1x1, never less than where it started.
+//
+// Finer mips come in for whatever's most short of what it
+// needs, and when that goes over the budget the least
+// recently needed levels are dropped to make room.
+// --------------------------------------------------------
+class MipResidency
+{
+public:
+	MipResidency();
+
+	void SetBudget(unsigned long long bytes);
+	unsigned long long GetBudget();
+
+	//levelBytes is every mip's size from the largest down, the texture starts with startMip and everything under it
+	unsigned int AddTexture(const std::vector<unsigned long long>& levelBytes, unsigned int startMip);
+	//gives back everything it holds - its number isn't reused, and a load still going just finishes through FinishLoad
+	void RemoveTexture(unsigned int texture);
+
+	//call before this frame's requests
+	void BeginFrame();
+	//something on screen wants this mip or finer - the finest request of the frame wins
+	void RequestMip(unsigned int texture, unsigned int mip);
+
+	//drops right away and starts up to maxLoads loads (counting ones already going) - loads hold their bytes until FinishLoad
+	void Plan(unsigned int maxLoads, std::vector<MipChange>& changes);
+	//a failed load gives its bytes back and the texture stays where it was
+	void FinishLoad(unsigned int texture, bool succeeded);
+	//a drop Plan made that couldn't be carried out - the levels are still there, so their bytes count again
+	void CancelDrop(const MipChange& drop);
+
+	unsigned int GetResidentMip(unsigned int texture);
+	unsigned int GetRequiredMip(unsigned int texture);	// this frame's, the start mip if nothing asked
+	bool IsLoading(unsigned int texture);
+	unsigned int GetTextureCount();
+	unsigned int GetLoadCount();				// loads between Plan and FinishLoad
+	unsigned long long GetResidentBytes();		// resident levels, plus what loads have set aside
+	unsigned long long GetRequiredBytes();		// what this frame's requests would take if they all fit
+	unsigned int GetFrame();
+
+private:
+	struct Texture
+	{
+		std::vector<unsigned long long> levelBytes;
+		std::vector<unsigned int> lastNeeded;	// frame each level was last asked for
+		unsigned int startMip;		// the coarsest it can be, and where it started
+		unsigned int residentMip;
+		unsigned int loadingMip;	// the same as residentMip unless a load is going
+		unsigned int requiredMip;
+		bool removed;
+	};
+
+	unsigned long long BytesFrom(const Texture& texture, unsigned int mip);
+	//drops least recently needed levels until extra more bytes fit - only ones not needed this frame, unless dropNeeded
+	bool MakeRoom(unsigned long long extra, unsigned int keep, bool dropNeeded, std::vector<unsigned int>& dropped);
+
+	std::vector<Texture> textures;
+	unsigned long long budget;
+	unsigned long long residentBytes;
+	unsigned int loads;
+	unsigned int frame;
+};
+
+// Levels on their way in from the import
+struct MipLoad
+{
+	unsigned int texture;
+	unsigned int fromMip;
+	unsigned int toMip;
+	std::wstring importFilename;
+	size_t fileOffset;
+	size_t byteCount;
+	std::vector<unsigned char> blocks;	// filled in by ReadLevels
+};
+
+// --------------------------------------------------------
+// Texture streaming
+//
+// Textures come in at a small mip and the streamer adds
+// finer ones as things get close enough to need them (see
+// ComputeMip), reading just those levels back out of the
+// texture's import on a worker thread. Levels that aren't
+// needed stay until the budget needs their memory.
+//
+// Every change makes a new texture with the new chain -
+// levels it already had are copied over on the gpu.
+// Device thread only, except ReadLevels.
+// --------------------------------------------------------
+class TextureStreamer
+{
+public:
+	TextureStreamer(Microsoft::WRL::ComPtr<ID3D11Device> device, Microsoft::WRL::ComPtr<ID3D11DeviceContext> context);
+
+	//the mip a texture needs to have about one texel per pixel - textureSize is its larger side,
+	//uvDensity the uv units per world unit of the surface, pixelsPerUnit how many pixels one world unit covers 1 unit from the camera
+	static float ComputeMip(unsigned int textureSize, float uvDensity, float distance, float pixelsPerUnit);
+
+	//takes a freshly loaded import and uploads the small end of its mips
+	//- canStream false (the import isn't on disk to read back) uploads every level and never drops them
+	bool Add(std::shared_ptr<StreamedTexture> texture, const std::wstring& importFilename, const std::vector<unsigned char>& dds, bool canStream);
+	//texture follows existing from now on (the same contents under another name), both get every new srv
+	void Share(const StreamedTexture& existing, std::shared_ptr<StreamedTexture> texture);
+	//lets go of the texture - its levels go once nothing sharing them is left
+	void Remove(std::shared_ptr<StreamedTexture> texture);
+
+	void SetBudget(unsigned long long bytes);
+	void BeginFrame();
+	void RequestMip(const StreamedTexture& texture, float mip);
+	//drops what has to go right away, and hands back the levels to read in
+	void Plan(unsigned int maxLoads, std::vector<MipLoad>& loads);
+	//worker thread
+	static bool ReadLevels(MipLoad& load);
+	//swaps in the new levels, or gives up on them if ReadLevels failed
+	void FinishLoad(MipLoad& load);
+
+	MipResidency& GetResidency();
+	unsigned long long GetFullBytes();		// every level of every texture, what it'd be without streaming
+	unsigned int GetStreamedLevels();		// levels read in since the start
+	unsigned int GetDroppedLevels();		// and dropped again
+
+private:
+	struct Entry
+	{
+		std::vector<std::shared_ptr<StreamedTexture>> textures;	// the one added and any sharing it, empty once removed
+		std::wstring importFilename;
+		DXGI_FORMAT format;
+		unsigned int mipCount;
+		size_t blocksOffset;
+		std::vector<size_t> mipOffsets;				// from blocksOffset
+		std::vector<unsigned long long> levelBytes;
+		Microsoft::WRL::ComPtr<ID3D11Texture2D> gpuTexture;	// levels from the resident mip down
+	};
+
+	//makes the texture for levels topMip and down - levels up to newLevelsEnd come from newLevels, the rest from the old texture
+	bool Rebuild(Entry& entry, unsigned int topMip, unsigned int newLevelsEnd, const unsigned char* newLevels);
+
+	Microsoft::WRL::ComPtr<ID3D11Device> device;
+	Microsoft::WRL::ComPtr<ID3D11DeviceContext> context;
+	MipResidency residency;
+	std::vector<Entry> entries;		// in residency order
+	unsigned long long fullBytes;
+	unsigned int streamedLevels;
+	unsigned int droppedLevels;
+};
@@ -1,9 +1,13 @@
 #include "Transform.h"
+#include "TransformBatch.h"
+#include <cmath>
 
 using namespace DirectX;
 
 Transform::Transform()
 {
+	//everything gets built the first time it's asked for
+	matrixDirty = true;
 	SetPosition(0, 0, 0);
 	SetScale(1, 1, 1);
 	SetRotation(0, 0, 0);
@@ -17,26 +21,71 @@ Transform::Transform()
 
 DirectX::XMFLOAT4X4 Transform::BuildMatrix()
 {
-	//make sure we only do this work if we have too
-	if (matrixDirty) 
-	{
-		//create the individual transform matrixes for each type of transform and then combine them and store the result
-		XMMATRIX transMat = XMMatrixTranslation(position.x, position.y, position.z);
-		XMMATRIX rotMat = XMMatrixRotationRollPitchYaw(pitchYawRoll.x, pitchYawRoll.y, pitchYawRoll.z);
-		XMMATRIX scaleMat = XMMatrixScaling(scale.x, scale.y, scale.z);
-
-		XMMATRIX worldMat = scaleMat * rotMat * transMat;
-		//set our worldmatrix
-		XMStoreFloat4x4(&worldMatrix, worldMat);
-		XMStoreFloat4x4(&worldInverseTransposeMatrix, XMMatrixInverse(0, XMMatrixTranspose(worldMat)));
-		//remember to clean matrix
-		matrixDirty = false;
-	}
-	
-	//
+	UpdateMatrices();
 	return worldMatrix;
 }
 
+void Transform::UpdateMatrices()
+{
+	//make sure we only do this work if we have too
+	if (!matrixDirty)
+		return;
+
+	// Scale * rotation * translation, built straight into the rows
+	// rather than multiplying three matrices - each rotation row
+	// scaled by its axis, then the position
+	XMMATRIX rotMat = XMMatrixRotationQuaternion(XMLoadFloat4(&rotation));
+	XMVECTOR scaleVec = XMLoadFloat3(&scale);
+	XMVECTOR pos = XMLoadFloat3(&position);
+	XMMATRIX worldMat;
+	worldMat.r[0] = rotMat.r[0] * XMVectorSplatX(scaleVec);
+	worldMat.r[1] = rotMat.r[1] * XMVectorSplatY(scaleVec);
+	worldMat.r[2] = rotMat.r[2] * XMVectorSplatZ(scaleVec);
+	worldMat.r[3] = XMVectorSetW(pos, 1);
+	//set our worldmatrix
+	XMStoreFloat4x4(&worldMatrix, worldMat);
+
+	// Scale is along our own axes, so the inverse transpose is just the
+	// rotation rows over the scale with the position run back through
+	// them in the last column, no general inverse (same as TransformBatch)
+	XMVECTOR minimumScale = XMVectorReplicate(TransformBatch::MinimumScale);
+	XMVECTOR invScale = XMVectorReciprocal(XMVectorSelect(scaleVec, minimumScale, XMVectorLess(XMVectorAbs(scaleVec), minimumScale)));
+	XMMATRIX inverse;
+	inverse.r[0] = rotMat.r[0] * XMVectorSplatX(invScale);
+	inverse.r[1] = rotMat.r[1] * XMVectorSplatY(invScale);
+	inverse.r[2] = rotMat.r[2] * XMVectorSplatZ(invScale);
+	inverse.r[0] = XMVectorSetW(inverse.r[0], -XMVectorGetX(XMVector3Dot(pos, inverse.r[0])));
+	inverse.r[1] = XMVectorSetW(inverse.r[1], -XMVectorGetX(XMVector3Dot(pos, inverse.r[1])));
+	inverse.r[2] = XMVectorSetW(inverse.r[2], -XMVectorGetX(XMVector3Dot(pos, inverse.r[2])));
+	inverse.r[3] = XMVectorSet(0, 0, 0, 1);
+	XMStoreFloat4x4(&worldInverseTransposeMatrix, inverse);
+
+	//the rotation's rows are where its x, y and z axes end up
+	XMStoreFloat3(&right, rotMat.r[0]);
+	XMStoreFloat3(&up, rotMat.r[1]);
+	XMStoreFloat3(&forward, rotMat.r[2]);
+
+	//remember to clean matrix
+	matrixDirty = false;
+}
+
+void Transform::PositionChanged()
+{
+	//if the matrices are going to be redone anyway there's nothing to keep
+	if (matrixDirty)
+		return;
+
+	// Moving doesn't turn or scale anything, so the axes stay and only
+	// the parts of the matrices that have the position in them change
+	worldMatrix._41 = position.x;
+	worldMatrix._42 = position.y;
+	worldMatrix._43 = position.z;
+	XMFLOAT4X4& inverse = worldInverseTransposeMatrix;
+	inverse._14 = -(position.x * inverse._11 + position.y * inverse._12 + position.z * inverse._13);
+	inverse._24 = -(position.x * inverse._21 + position.y * inverse._22 + position.z * inverse._23);
+	inverse._34 = -(position.x * inverse._31 + position.y * inverse._32 + position.z * inverse._33);
+}
+
 void Transform::MoveAbsolute(float x, float y, float z)
 {
 	//one way to do this is to just add the floats
@@ -45,7 +94,7 @@ void Transform::MoveAbsolute(float x, float y, float z)
 	position.y += y;
 	position.z += z;
 
-	matrixDirty = true;
+	PositionChanged();
 	//or use directxmath
 	/*
 	XMVECTOR pos = XMLoadFloat3(&position);
@@ -56,31 +105,45 @@ void Transform::MoveAbsolute(float x, float y, float z)
 
 void Transform::MoveRelative(float x, float y, float z)
 {
-	//load the movment vector(initial)
-	XMVECTOR moveVec = XMVectorSet(x, y, z, 0);
-
-	//needs a quarternion and a vector
-	XMVECTOR rotQuat = XMQuaternionRotationRollPitchYawFromVector(XMLoadFloat3(&pitchYawRoll));
-
-	XMVECTOR rotatedVec = XMVector3Rotate(moveVec, rotQuat);
+	//move along our own axes instead of the world's
+	UpdateMatrices();
+	XMVECTOR rotatedVec = XMLoadFloat3(&right) * x + XMLoadFloat3(&up) * y + XMLoadFloat3(&forward) * z;
 
 	//add the rotated movement vector to my position and overwrite my old position
 	XMVECTOR newPos = XMLoadFloat3(&position) + rotatedVec;
 	XMStoreFloat3(&position, newPos);
 
-	//remember the matrixes are dirty
-	matrixDirty = true;
+	PositionChanged();
 
 }
 
 void Transform::Rotate(float p, float y, float r)
 {
-	pitchYawRoll.x += p;
-	pitchYawRoll.y += y;
-	pitchYawRoll.z += r;
+	// Roll and pitch go on before the current rotation (about our own
+	// axes) and yaw after (about the world's up), which is what adding
+	// to the angles did while roll stayed at 0
+	//each turn about one axis is a quaternion with half the angle, no need to go through all three for each
+	float sinHalf, cosHalf;
+	XMVECTOR combined = XMLoadFloat4(&rotation);
+	if (p != 0)
+	{
+		XMScalarSinCos(&sinHalf, &cosHalf, p * 0.5f);
+		combined = XMQuaternionMultiply(XMVectorSet(sinHalf, 0, 0, cosHalf), combined);
+	}
+	if (r != 0)
+	{
+		XMScalarSinCos(&sinHalf, &cosHalf, r * 0.5f);
+		combined = XMQuaternionMultiply(XMVectorSet(0, 0, sinHalf, cosHalf), combined);
+	}
+	if (y != 0)
+	{
+		XMScalarSinCos(&sinHalf, &cosHalf, y * 0.5f);
+		combined = XMQuaternionMultiply(combined, XMVectorSet(0, sinHalf, 0, cosHalf));
+	}
 
+	//keep it unit length, or lots of small turns drift it into a scale
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(combined));
 	matrixDirty = true;
-
 }
 /*
 void Transform::Rotate(DirectX::XMFLOAT3 pitchYawRoll)
@@ -102,17 +165,19 @@ void Transform::SetPosition(float x, float y, float z)
 	position.y = y;
 	position.z = z;
 
-	matrixDirty = true;
+	PositionChanged();
 }
 
 void Transform::SetRotation(float x, float y, float z)
 {
-	pitchYawRoll.x = x;
-	pitchYawRoll.y = y;
-	pitchYawRoll.z = z;
-
+	XMStoreFloat4(&rotation, XMQuaternionRotationRollPitchYaw(x, y, z));
 	matrixDirty = true;
+}
 
+void Transform::SetRotationQuaternion(DirectX::XMFLOAT4 quaternion)
+{
+	XMStoreFloat4(&rotation, XMQuaternionNormalize(XMLoadFloat4(&quaternion)));
+	matrixDirty = true;
 }
 
 void Transform::SetScale(float x, float y, float z)
@@ -126,40 +191,19 @@ void Transform::SetScale(float x, float y, float z)
 
 DirectX::XMFLOAT3 Transform::GetRight()
 {
-	XMFLOAT3 right;
-	//get our forward vector
-	XMVECTOR rightMath = XMVector3Rotate(
-		XMVectorSet(1, 0, 0, 0),
-		XMQuaternionRotationRollPitchYaw(pitchYawRoll.x, pitchYawRoll.y, pitchYawRoll.z));
-	//store it in our float 3
-	XMStoreFloat3(&right, rightMath);
-	//return it
+	UpdateMatrices();
 	return right;
 }
 
 DirectX::XMFLOAT3 Transform::GetForward()
 {
-	XMFLOAT3 forward;
-	//get our forward vector
-	XMVECTOR forwardMath = XMVector3Rotate(
-		XMVectorSet(0, 0, 1, 0),
-		XMQuaternionRotationRollPitchYaw(pitchYawRoll.x, pitchYawRoll.y, pitchYawRoll.z));
-	//store it in our float 3
-	XMStoreFloat3(&forward, forwardMath);
-	//return it
+	UpdateMatrices();
 	return forward;
 }
 
 DirectX::XMFLOAT3 Transform::GetUp()
 {
-	XMFLOAT3 up;
-	//get our forward vector
-	XMVECTOR upMath = XMVector3Rotate(
-		XMVectorSet(0, 1, 0, 0),
-		XMQuaternionRotationRollPitchYaw(pitchYawRoll.x, pitchYawRoll.y, pitchYawRoll.z));
-	//store it in our float 3
-	XMStoreFloat3(&up, upMath);
-	//return it
+	UpdateMatrices();
 	return up;
 }
 
@@ -176,9 +220,34 @@ DirectX::XMFLOAT3 Transform::GetPosition()
 
 DirectX::XMFLOAT3 Transform::GetRotation()
 {
+	XMFLOAT4X4 r;
+	XMStoreFloat4x4(&r, XMMatrixRotationQuaternion(XMLoadFloat4(&rotation)));
+
+	// The rotation matrix is roll * pitch * yaw, so its last row
+	// (forward) is only pitch and yaw - atan2 rather than asin for
+	// the pitch, asin loses precision near straight up or down
+	float cosPitch = sqrtf(r._31 * r._31 + r._33 * r._33);
+	XMFLOAT3 pitchYawRoll;
+	pitchYawRoll.x = atan2f(-r._32, cosPitch);
+	pitchYawRoll.y = atan2f(r._31, r._33);
+
+	// Roll is whatever's left of the first row once pitch and yaw are
+	// taken out. Near straight up or down yaw and roll turn about the
+	// same axis, and working roll out this way makes up for any yaw error
+	float sinPitch = sinf(pitchYawRoll.x);
+	float sinYaw = sinf(pitchYawRoll.y);
+	float cosYaw = cosf(pitchYawRoll.y);
+	float cosRoll = r._11 * cosYaw - r._13 * sinYaw;
+	float sinRoll = r._11 * sinPitch * sinYaw + r._12 * cosf(pitchYawRoll.x) + r._13 * sinPitch * cosYaw;
+	pitchYawRoll.z = atan2f(sinRoll, cosRoll);
 	return pitchYawRoll;
 }
 
+DirectX::XMFLOAT4 Transform::GetRotationQuaternion()
+{
+	return rotation;
+}
+
 DirectX::XMFLOAT3 Transform::GetScale()
 {
 	return scale;
@@ -1,5 +1,12 @@
 #pragma once
 #include <DirectXMath.h>
+
+// Position, orientation and scale of one thing (the camera, mostly)
+// - orientation is kept as a quaternion, pitch/yaw/roll only go in and
+//   come out through SetRotation/GetRotation/Rotate
+// - the world matrix and the right/up/forward vectors are worked out
+//   together, only after something changed and only when asked for
+//   (moving only patches the position into them)
 class Transform
 {
 public:
@@ -10,16 +17,21 @@ public:
 
 	void MoveAbsolute(float x, float y, float z);
 	void MoveRelative(float x, float y, float z);
+	//pitch about its own right, yaw about the world up, roll about its own forward
+	//- the same as adding to the angles as long as there's no roll
 	void Rotate(float p, float y, float r);
 	void Rotate(DirectX::XMFLOAT3 pitchYawRoll);
 	void Scale(float x, float y, float z);
 
 	void SetPosition(float x, float y, float z);
 	void SetRotation(float x, float y, float z);
+	void SetRotationQuaternion(DirectX::XMFLOAT4 quaternion);
 	void SetScale(float x, float y, float z);
 
 	DirectX::XMFLOAT3 GetPosition();
+	//pitch, yaw and roll that give the same orientation - not necessarily the ones it was set to
 	DirectX::XMFLOAT3 GetRotation();
+	DirectX::XMFLOAT4 GetRotationQuaternion();
 	DirectX::XMFLOAT3 GetScale();
 
 	DirectX::XMFLOAT3 GetRight();
@@ -33,12 +45,21 @@ private:
 	//3 movements rotate scale pos
 	DirectX::XMFLOAT3 position;
 	DirectX::XMFLOAT3 scale;
-	DirectX::XMFLOAT3 pitchYawRoll;
+	DirectX::XMFLOAT4 rotation;
 
 	//finalized array
 	DirectX::XMFLOAT4X4 worldMatrix;
 	DirectX::XMFLOAT4X4 worldInverseTransposeMatrix;
+	//the rotation's axes, cached with the matrix
+	DirectX::XMFLOAT3 right;
+	DirectX::XMFLOAT3 up;
+	DirectX::XMFLOAT3 forward;
 	//does our matrix need a new update
 	bool matrixDirty;
+
+	//redoes the matrices and axes if anything changed
+	void UpdateMatrices();
+	//keeps clean matrices clean after a move, only their position parts change
+	void PositionChanged();
 };
 
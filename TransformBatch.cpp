@@ -0,0 +1,111 @@
+#include "TransformBatch.h"
+
+using namespace DirectX;
+
+const float TransformBatch::MinimumScale = 0.000001f;
+
+void TransformBatch::BuildWorldMatrices(const XMFLOAT3* positions, const XMFLOAT3* rotations, const XMFLOAT3* scales,
+	const unsigned int* indices, unsigned int count, XMFLOAT4X4* worldMatrices, XMFLOAT4X4* worldInverseTransposes)
+{
+	const XMVECTOR minimumScale = XMVectorReplicate(MinimumScale);
+
+	for (unsigned int first = 0; first < count; first += 4)
+	{
+		// Gather four entities - a group at the end with fewer
+		// than four left repeats its first one in the spare lanes
+		unsigned int lanes = count - first < 4 ? count - first : 4;
+		XMFLOAT4A px, py, pz, pitch, yaw, roll, sx, sy, sz;
+		for (unsigned int k = 0; k < 4; k++)
+		{
+			unsigned int i = indices[first + (k < lanes ? k : 0)];
+			(&px.x)[k] = positions[i].x;
+			(&py.x)[k] = positions[i].y;
+			(&pz.x)[k] = positions[i].z;
+			(&pitch.x)[k] = rotations[i].x;
+			(&yaw.x)[k] = rotations[i].y;
+			(&roll.x)[k] = rotations[i].z;
+			(&sx.x)[k] = scales[i].x;
+			(&sy.x)[k] = scales[i].y;
+			(&sz.x)[k] = scales[i].z;
+		}
+
+		XMVECTOR sinPitch, cosPitch, sinYaw, cosYaw, sinRoll, cosRoll;
+		XMVectorSinCos(&sinPitch, &cosPitch, XMLoadFloat4A(&pitch));
+		XMVectorSinCos(&sinYaw, &cosYaw, XMLoadFloat4A(&yaw));
+		XMVectorSinCos(&sinRoll, &cosRoll, XMLoadFloat4A(&roll));
+
+		// XMMatrixRotationRollPitchYaw written out - roll, then pitch, then yaw
+		XMVECTOR r00 = cosRoll * cosYaw + sinRoll * sinPitch * sinYaw;
+		XMVECTOR r01 = sinRoll * cosPitch;
+		XMVECTOR r02 = sinRoll * sinPitch * cosYaw - cosRoll * sinYaw;
+		XMVECTOR r10 = cosRoll * sinPitch * sinYaw - sinRoll * cosYaw;
+		XMVECTOR r11 = cosRoll * cosPitch;
+		XMVECTOR r12 = sinRoll * sinYaw + cosRoll * sinPitch * cosYaw;
+		XMVECTOR r20 = cosPitch * sinYaw;
+		XMVECTOR r21 = -sinPitch;
+		XMVECTOR r22 = cosPitch * cosYaw;
+
+		XMVECTOR scaleX = XMLoadFloat4A(&sx);
+		XMVECTOR scaleY = XMLoadFloat4A(&sy);
+		XMVECTOR scaleZ = XMLoadFloat4A(&sz);
+		XMVECTOR x = XMLoadFloat4A(&px);
+		XMVECTOR y = XMLoadFloat4A(&py);
+		XMVECTOR z = XMLoadFloat4A(&pz);
+
+		//the inverse transpose divides by the scale instead of multiplying
+		XMVECTOR invScaleX = XMVectorReciprocal(XMVectorSelect(scaleX, minimumScale, XMVectorLess(XMVectorAbs(scaleX), minimumScale)));
+		XMVECTOR invScaleY = XMVectorReciprocal(XMVectorSelect(scaleY, minimumScale, XMVectorLess(XMVectorAbs(scaleY), minimumScale)));
+		XMVECTOR invScaleZ = XMVectorReciprocal(XMVectorSelect(scaleZ, minimumScale, XMVectorLess(XMVectorAbs(scaleZ), minimumScale)));
+
+		// World rows are the rotation rows times their scales, then the
+		// position. Inverse transpose rows are the rotation rows over
+		// their scales, with the position run back through them in the
+		// last column
+		XMFLOAT4A world[9], inverse[9], inverseColumn[3];
+		XMVECTOR rows[3][3] = { { r00, r01, r02 }, { r10, r11, r12 }, { r20, r21, r22 } };
+		XMVECTOR scale[3] = { scaleX, scaleY, scaleZ };
+		XMVECTOR invScale[3] = { invScaleX, invScaleY, invScaleZ };
+		for (unsigned int row = 0; row < 3; row++)
+		{
+			XMStoreFloat4A(&world[row * 3 + 0], rows[row][0] * scale[row]);
+			XMStoreFloat4A(&world[row * 3 + 1], rows[row][1] * scale[row]);
+			XMStoreFloat4A(&world[row * 3 + 2], rows[row][2] * scale[row]);
+			XMStoreFloat4A(&inverse[row * 3 + 0], rows[row][0] * invScale[row]);
+			XMStoreFloat4A(&inverse[row * 3 + 1], rows[row][1] * invScale[row]);
+			XMStoreFloat4A(&inverse[row * 3 + 2], rows[row][2] * invScale[row]);
+			XMStoreFloat4A(&inverseColumn[row], -(x * rows[row][0] + y * rows[row][1] + z * rows[row][2]) * invScale[row]);
+		}
+
+		// Scatter back one entity at a time
+		for (unsigned int k = 0; k < lanes; k++)
+		{
+			unsigned int i = indices[first + k];
+			XMFLOAT4X4& w = worldMatrices[i];
+			w._11 = (&world[0].x)[k]; w._12 = (&world[1].x)[k]; w._13 = (&world[2].x)[k]; w._14 = 0;
+			w._21 = (&world[3].x)[k]; w._22 = (&world[4].x)[k]; w._23 = (&world[5].x)[k]; w._24 = 0;
+			w._31 = (&world[6].x)[k]; w._32 = (&world[7].x)[k]; w._33 = (&world[8].x)[k]; w._34 = 0;
+			w._41 = (&px.x)[k]; w._42 = (&py.x)[k]; w._43 = (&pz.x)[k]; w._44 = 1;
+
+			XMFLOAT4X4& n = worldInverseTransposes[i];
+			n._11 = (&inverse[0].x)[k]; n._12 = (&inverse[1].x)[k]; n._13 = (&inverse[2].x)[k]; n._14 = (&inverseColumn[0].x)[k];
+			n._21 = (&inverse[3].x)[k]; n._22 = (&inverse[4].x)[k]; n._23 = (&inverse[5].x)[k]; n._24 = (&inverseColumn[1].x)[k];
+			n._31 = (&inverse[6].x)[k]; n._32 = (&inverse[7].x)[k]; n._33 = (&inverse[8].x)[k]; n._34 = (&inverseColumn[2].x)[k];
+			n._41 = 0; n._42 = 0; n._43 = 0; n._44 = 1;
+		}
+	}
+}
+
+void TransformBatch::BuildWorldMatricesReference(const XMFLOAT3* positions, const XMFLOAT3* rotations, const XMFLOAT3* scales,
+	const unsigned int* indices, unsigned int count, XMFLOAT4X4* worldMatrices, XMFLOAT4X4* worldInverseTransposes)
+{
+	for (unsigned int n = 0; n < count; n++)
+	{
+		unsigned int i = indices[n];
+		XMMATRIX world =
+			XMMatrixScaling(scales[i].x, scales[i].y, scales[i].z) *
+			XMMatrixRotationRollPitchYaw(rotations[i].x, rotations[i].y, rotations[i].z) *
+			XMMatrixTranslation(positions[i].x, positions[i].y, positions[i].z);
+		XMStoreFloat4x4(&worldMatrices[i], world);
+		XMStoreFloat4x4(&worldInverseTransposes[i], XMMatrixInverse(0, XMMatrixTranspose(world)));
+	}
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <DirectXMath.h>
+
+// --------------------------------------------------------
+// Batched world matrices
+//
+// Builds scale * rotation * translation world matrices (the
+// same ones Transform::BuildMatrix makes) and their inverse
+// transposes four entities at a time, gathered into registers
+// that each hold one value from all four - the x scale of
+// every entity in one, their pitch in another and so on.
+//
+// The scale is always along the entity's own axes, so the
+// inverse transpose never needs a general inverse: it's the
+// rotation rows divided by their scales (times a translation
+// column). Scales too close to zero to divide by are treated
+// as MinimumScale, so squashed flat things still get normals.
+// --------------------------------------------------------
+class TransformBatch
+{
+public:
+	static const float MinimumScale;
+
+	//builds the matrices of the entities at indices[0, count) - every array is read and written at those indices
+	static void BuildWorldMatrices(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* rotations, const DirectX::XMFLOAT3* scales,
+		const unsigned int* indices, unsigned int count, DirectX::XMFLOAT4X4* worldMatrices, DirectX::XMFLOAT4X4* worldInverseTransposes);
+
+	//one entity at a time with XMMatrixInverse, like Transform - the plain version to check BuildWorldMatrices against
+	static void BuildWorldMatricesReference(const DirectX::XMFLOAT3* positions, const DirectX::XMFLOAT3* rotations, const DirectX::XMFLOAT3* scales,
+		const unsigned int* indices, unsigned int count, DirectX::XMFLOAT4X4* worldMatrices, DirectX::XMFLOAT4X4* worldInverseTransposes);
+};
@@ -0,0 +1,220 @@
+#include "VertexCompact.h"
+#include <DirectXPackedVector.h>
+#include <d3dcompiler.h>
+#include <vector>
+#include <cmath>
+
+using namespace DirectX;
+
+//float in [-1, 1] to the nearest 16 bit snorm
+static short ToSnorm16(float value)
+{
+	if (value > 1.0f) value = 1.0f;
+	if (value < -1.0f) value = -1.0f;
+	return (short)(value * 32767.0f + (value >= 0 ? 0.5f : -0.5f));
+}
+
+static float FromSnorm16(short value)
+{
+	//-32768 and -32767 both mean -1, same as the GPU
+	float f = value / 32767.0f;
+	return f < -1.0f ? -1.0f : f;
+}
+
+VertexQuantization VertexCompactCodec::ComputeQuantization(const Vertex* vertices, unsigned int vertexCount)
+{
+	VertexQuantization quantization = { XMFLOAT3(0, 0, 0), XMFLOAT3(1, 1, 1) };
+	if (vertexCount == 0)
+		return quantization;
+
+	XMVECTOR boundsMin = XMLoadFloat3(&vertices[0].Position);
+	XMVECTOR boundsMax = boundsMin;
+	for (unsigned int i = 1; i < vertexCount; i++)
+	{
+		XMVECTOR p = XMLoadFloat3(&vertices[i].Position);
+		boundsMin = XMVectorMin(boundsMin, p);
+		boundsMax = XMVectorMax(boundsMax, p);
+	}
+
+	XMStoreFloat3(&quantization.offset, (boundsMin + boundsMax) * 0.5f);
+	XMStoreFloat3(&quantization.scale, (boundsMax - boundsMin) * 0.5f);
+
+	//flat meshes (like the quad) have no extent on one axis, any scale works there
+	if (quantization.scale.x <= 0) quantization.scale.x = 1;
+	if (quantization.scale.y <= 0) quantization.scale.y = 1;
+	if (quantization.scale.z <= 0) quantization.scale.z = 1;
+	return quantization;
+}
+
+void VertexCompactCodec::EncodeOctahedral(const XMFLOAT3& v, short out[2])
+{
+	// Project onto the octahedron |x| + |y| + |z| = 1, then
+	// fold the lower half over the diagonals onto the square
+	float length = fabsf(v.x) + fabsf(v.y) + fabsf(v.z);
+	if (length <= 0)
+	{
+		out[0] = 0;
+		out[1] = 0;
+		return;
+	}
+
+	float x = v.x / length;
+	float y = v.y / length;
+	if (v.z < 0)
+	{
+		float foldedX = (1.0f - fabsf(y)) * (x >= 0 ? 1.0f : -1.0f);
+		float foldedY = (1.0f - fabsf(x)) * (y >= 0 ? 1.0f : -1.0f);
+		x = foldedX;
+		y = foldedY;
+	}
+
+	out[0] = ToSnorm16(x);
+	out[1] = ToSnorm16(y);
+}
+
+XMFLOAT3 VertexCompactCodec::DecodeOctahedral(const short in[2])
+{
+	//same math as DecodeOctahedral in ShaderIncludes.hlsli
+	float x = FromSnorm16(in[0]);
+	float y = FromSnorm16(in[1]);
+	float z = 1.0f - fabsf(x) - fabsf(y);
+	float t = z < 0 ? -z : 0;
+	x += x >= 0 ? -t : t;
+	y += y >= 0 ? -t : t;
+
+	XMFLOAT3 result;
+	XMStoreFloat3(&result, XMVector3Normalize(XMVectorSet(x, y, z, 0)));
+	return result;
+}
+
+void VertexCompactCodec::Encode(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const VertexQuantization& quantization, VertexCompact* out)
+{
+	// Vertex only keeps the tangent, so rebuild each vertex's bitangent
+	// direction from its triangles' uvs to find out which way it points
+	std::vector<XMFLOAT3> bitangents(vertexCount, XMFLOAT3(0, 0, 0));
+	for (unsigned int i = 0; i + 2 < indexCount; i += 3)
+	{
+		const Vertex& v1 = vertices[indices[i]];
+		const Vertex& v2 = vertices[indices[i + 1]];
+		const Vertex& v3 = vertices[indices[i + 2]];
+
+		float s1 = v2.UV.x - v1.UV.x;
+		float t1 = v2.UV.y - v1.UV.y;
+		float s2 = v3.UV.x - v1.UV.x;
+		float t2 = v3.UV.y - v1.UV.y;
+		float det = s1 * t2 - s2 * t1;
+		if (det == 0)
+			continue;
+		float r = 1.0f / det;
+
+		XMFLOAT3 b;
+		b.x = (s1 * (v3.Position.x - v1.Position.x) - s2 * (v2.Position.x - v1.Position.x)) * r;
+		b.y = (s1 * (v3.Position.y - v1.Position.y) - s2 * (v2.Position.y - v1.Position.y)) * r;
+		b.z = (s1 * (v3.Position.z - v1.Position.z) - s2 * (v2.Position.z - v1.Position.z)) * r;
+
+		for (int k = 0; k < 3; k++)
+		{
+			XMFLOAT3& sum = bitangents[indices[i + k]];
+			sum.x += b.x;
+			sum.y += b.y;
+			sum.z += b.z;
+		}
+	}
+
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& v = vertices[i];
+
+		XMVECTOR normal = XMLoadFloat3(&v.Normal);
+		XMVECTOR tangent = XMLoadFloat3(&v.Tangent);
+		XMVECTOR bitangent = XMLoadFloat3(&bitangents[i]);
+		float sign = XMVectorGetX(XMVector3Dot(XMVector3Cross(normal, tangent), bitangent)) < 0 ? -1.0f : 1.0f;
+
+		out[i].Position[0] = ToSnorm16((v.Position.x - quantization.offset.x) / quantization.scale.x);
+		out[i].Position[1] = ToSnorm16((v.Position.y - quantization.offset.y) / quantization.scale.y);
+		out[i].Position[2] = ToSnorm16((v.Position.z - quantization.offset.z) / quantization.scale.z);
+		out[i].Position[3] = ToSnorm16(sign);
+
+		out[i].UV[0] = PackedVector::XMConvertFloatToHalf(v.UV.x);
+		out[i].UV[1] = PackedVector::XMConvertFloatToHalf(v.UV.y);
+
+		EncodeOctahedral(v.Normal, out[i].Normal);
+		EncodeOctahedral(v.Tangent, out[i].Tangent);
+	}
+}
+
+Vertex VertexCompactCodec::Decode(const VertexCompact& vertex, const VertexQuantization& quantization)
+{
+	Vertex v;
+	v.Position.x = quantization.offset.x + FromSnorm16(vertex.Position[0]) * quantization.scale.x;
+	v.Position.y = quantization.offset.y + FromSnorm16(vertex.Position[1]) * quantization.scale.y;
+	v.Position.z = quantization.offset.z + FromSnorm16(vertex.Position[2]) * quantization.scale.z;
+	v.UV.x = PackedVector::XMConvertHalfToFloat(vertex.UV[0]);
+	v.UV.y = PackedVector::XMConvertHalfToFloat(vertex.UV[1]);
+	v.Normal = DecodeOctahedral(vertex.Normal);
+	v.Tangent = DecodeOctahedral(vertex.Tangent);
+	return v;
+}
+
+float VertexCompactCodec::DecodeTangentSign(const VertexCompact& vertex)
+{
+	return vertex.Position[3] < 0 ? -1.0f : 1.0f;
+}
+
+//angle between two unit vectors in degrees
+static float AngleBetween(const XMFLOAT3& a, const XMFLOAT3& b)
+{
+	XMVECTOR angle = XMVector3AngleBetweenNormals(XMVector3Normalize(XMLoadFloat3(&a)), XMVector3Normalize(XMLoadFloat3(&b)));
+	return XMConvertToDegrees(XMVectorGetX(angle));
+}
+
+VertexCompactError VertexCompactCodec::MeasureError(const Vertex* vertices, const VertexCompact* packed, unsigned int vertexCount, const VertexQuantization& quantization)
+{
+	VertexCompactError error = {};
+	for (unsigned int i = 0; i < vertexCount; i++)
+	{
+		const Vertex& original = vertices[i];
+		Vertex decoded = Decode(packed[i], quantization);
+
+		float position = XMVectorGetX(XMVector3Length(XMLoadFloat3(&original.Position) - XMLoadFloat3(&decoded.Position)));
+		float uv = fabsf(original.UV.x - decoded.UV.x);
+		if (fabsf(original.UV.y - decoded.UV.y) > uv)
+			uv = fabsf(original.UV.y - decoded.UV.y);
+
+		if (position > error.position) error.position = position;
+		if (uv > error.uv) error.uv = uv;
+
+		float normal = AngleBetween(original.Normal, decoded.Normal);
+		float tangent = AngleBetween(original.Tangent, decoded.Tangent);
+		if (normal > error.normal) error.normal = normal;
+		if (tangent > error.tangent) error.tangent = tangent;
+	}
+	return error;
+}
+
+Microsoft::WRL::ComPtr<ID3D11InputLayout> VertexCompactCodec::CreateInputLayout(Microsoft::WRL::ComPtr<ID3D11Device> device, const wchar_t* shaderFile)
+{
+	Microsoft::WRL::ComPtr<ID3D11InputLayout> inputLayout;
+
+	// The layout gets validated against the shader's input signature
+	Microsoft::WRL::ComPtr<ID3DBlob> shaderBlob;
+	if (FAILED(D3DReadFileToBlob(shaderFile, shaderBlob.GetAddressOf())))
+		return inputLayout;
+
+	D3D11_INPUT_ELEMENT_DESC elements[] =
+	{
+		{ "POSITION", 0, DXGI_FORMAT_R16G16B16A16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TEXCOORD", 0, DXGI_FORMAT_R16G16_FLOAT, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "NORMAL", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+		{ "TANGENT", 0, DXGI_FORMAT_R16G16_SNORM, 0, D3D11_APPEND_ALIGNED_ELEMENT, D3D11_INPUT_PER_VERTEX_DATA, 0 },
+	};
+
+	device->CreateInputLayout(
+		elements,
+		ARRAYSIZE(elements),
+		shaderBlob->GetBufferPointer(),
+		shaderBlob->GetBufferSize(),
+		inputLayout.GetAddressOf());
+
+	return inputLayout;
+}
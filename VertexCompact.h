@@ -0,0 +1,65 @@
+#pragma once
+
+#include <d3d11.h>
+#include <wrl/client.h>
+#include <DirectXMath.h>
+#include "Vertex.h"
+
+// --------------------------------------------------------
+// A packed alternative to Vertex - 20 bytes instead of 44
+//
+//  - Position: 16 bit snorm, relative to the mesh's bounding box
+//    (w holds the sign of the bitangent, +1 or -1)
+//  - UV: 16 bit floats, so tiling uvs outside 0-1 still work
+//  - Normal and Tangent: octahedral, two 16 bit snorms each
+//
+// Must match VertexShaderCompactInput in ShaderIncludes.hlsli
+// --------------------------------------------------------
+struct VertexCompact
+{
+	short Position[4];
+	unsigned short UV[2];
+	short Normal[2];
+	short Tangent[2];
+};
+
+// Maps the quantized positions back to local space: local = offset + snorm * scale
+struct VertexQuantization
+{
+	DirectX::XMFLOAT3 offset;	// center of the bounding box
+	DirectX::XMFLOAT3 scale;	// half the size of the bounding box
+};
+
+// Worst round trip error over a packed mesh
+struct VertexCompactError
+{
+	float position;	// largest distance in local units
+	float uv;		// largest difference in either channel
+	float normal;	// largest angle in degrees
+	float tangent;	// largest angle in degrees
+};
+
+class VertexCompactCodec
+{
+public:
+	//quantization that covers every position in the array
+	static VertexQuantization ComputeQuantization(const Vertex* vertices, unsigned int vertexCount);
+
+	//packs a whole mesh, the indices are needed to work out each vertex's bitangent sign
+	static void Encode(const Vertex* vertices, unsigned int vertexCount, const unsigned int* indices, unsigned int indexCount, const VertexQuantization& quantization, VertexCompact* out);
+
+	//unpacks one vertex, mostly for checking precision on the CPU
+	static Vertex Decode(const VertexCompact& vertex, const VertexQuantization& quantization);
+	static float DecodeTangentSign(const VertexCompact& vertex);
+
+	//decodes everything again and compares it against the originals
+	static VertexCompactError MeasureError(const Vertex* vertices, const VertexCompact* packed, unsigned int vertexCount, const VertexQuantization& quantization);
+
+	//octahedral mapping of a unit vector onto two snorms and back
+	static void EncodeOctahedral(const DirectX::XMFLOAT3& v, short out[2]);
+	static DirectX::XMFLOAT3 DecodeOctahedral(const short in[2]);
+
+	//the input layout has to be explicit, reflection would read the packed formats as plain floats
+	// - shaderFile is any compiled vertex shader taking VertexShaderCompactInput
+	static Microsoft::WRL::ComPtr<ID3D11InputLayout> CreateInputLayout(Microsoft::WRL::ComPtr<ID3D11Device> device, const wchar_t* shaderFile);
+};
@@ -0,0 +1,31 @@
+#include "ShaderIncludes.hlsli" 
+//describing layout of a chunk of memory
+cbuffer ExternalData : register(b0)
+{
+	matrix worldMatrix;
+	matrix view;
+	matrix projection;
+	matrix invTransposeWorldMatrix;
+	float3 positionOffset; // undoes the mesh's position quantization
+	float3 positionScale;
+}
+
+// Same as VertexShader.hlsl, but for meshes using the packed VertexCompact layout
+VertexToPixel main(VertexShaderCompactInput input)
+{
+	// Set up output struct
+	VertexToPixel output;
+
+	// Back to local space before anything else
+	float3 localPosition = positionOffset + input.localPosition.xyz * positionScale;
+	float3 normal = DecodeOctahedral(input.normal);
+
+	matrix wvp = mul((mul(projection, view)), worldMatrix);
+
+	output.screenPosition = mul(wvp, float4(localPosition, 1.0f));
+	output.normal = mul((float3x3)invTransposeWorldMatrix, normal);
+	output.worldPosition = mul(worldMatrix, float4(localPosition, 1)).xyz;
+	output.uv = input.uv;
+
+	return output;
+}
@@ -0,0 +1,182 @@
+#include "VisibilityCache.h"
+#include <algorithm>
+
+const float VisibilityCache::PatchLimit = 0.25f;
+
+VisibilityCache::VisibilityCache()
+{
+	dropped = false;
+	for (unsigned int& count : counts)
+		count = 0;
+	valid = false;
+	cameraEpoch = 0;
+	sceneEpoch = 0;
+	reuse = VisibilityReuse::None;
+	frameCount = 0;
+	reusedCount = 0;
+	patchedCount = 0;
+	rebuiltCount = 0;
+	rebuildMilliseconds = 0.0;
+	millisecondsSaved = 0.0;
+}
+
+VisibilityReuse VisibilityCache::Begin(unsigned int cameraEpoch, unsigned int sceneEpoch, unsigned int movedCount, unsigned int entityCount)
+{
+	frameStart = std::chrono::high_resolution_clock::now();
+	frameCount++;
+
+	// Past a point, patching in a crowd of entities one at a time
+	// costs about what culling them all together would
+	if (!valid || cameraEpoch != this->cameraEpoch || sceneEpoch != this->sceneEpoch ||
+		entityCount != visibilities.size() || movedCount > entityCount * PatchLimit)
+		reuse = VisibilityReuse::None;
+	else if (movedCount == 0)
+		reuse = VisibilityReuse::All;
+	else
+		reuse = VisibilityReuse::Patch;
+
+	this->cameraEpoch = cameraEpoch;
+	this->sceneEpoch = sceneEpoch;
+	return reuse;
+}
+
+void VisibilityCache::Store(const Visibility* visibility, const unsigned long long* sortKeys, unsigned int entityCount)
+{
+	visibilities.assign(visibility, visibility + entityCount);
+	this->sortKeys.assign(sortKeys, sortKeys + entityCount);
+	listed.assign(entityCount, 0);
+	added.clear();
+	dropped = false;
+
+	for (unsigned int& count : counts)
+		count = 0;
+	drawList.clear();
+	for (unsigned int i = 0; i < entityCount; i++)
+	{
+		counts[(unsigned int)visibility[i]]++;
+		if (visibility[i] == Visibility::Visible)
+		{
+			drawList.push_back(i);
+			listed[i] = 1;
+		}
+	}
+	std::sort(drawList.begin(), drawList.end(), [this](unsigned int a, unsigned int b) { return DrawsBefore(a, b); });
+	valid = true;
+}
+
+void VisibilityCache::Patch(unsigned int entity, Visibility visibility)
+{
+	Visibility before = visibilities[entity];
+	if (before == visibility)
+		return;
+	visibilities[entity] = visibility;
+	counts[(unsigned int)before]--;
+	counts[(unsigned int)visibility]++;
+
+	//the list is only fixed up at End, so something going out and back in within a frame is only listed once
+	if (before == Visibility::Visible)
+		dropped = true;
+	if (visibility == Visibility::Visible && !listed[entity])
+	{
+		added.push_back(entity);
+		listed[entity] = 1;
+	}
+}
+
+void VisibilityCache::End()
+{
+	// Take out what isn't visible any more, then merge in what's
+	// newly visible - both keep the list in order, so it's never
+	// sorted all over again
+	if (dropped)
+	{
+		unsigned int kept = 0;
+		for (unsigned int i : drawList)
+		{
+			drawList[kept] = i;
+			bool visible = visibilities[i] == Visibility::Visible;
+			kept += visible;
+			listed[i] = visible;
+		}
+		drawList.resize(kept);
+		dropped = false;
+	}
+	if (!added.empty())
+	{
+		auto drawsBefore = [this](unsigned int a, unsigned int b) { return DrawsBefore(a, b); };
+		size_t middle = drawList.size();
+		for (unsigned int i : added)
+		{
+			if (visibilities[i] == Visibility::Visible)
+				drawList.push_back(i);
+			else
+				listed[i] = 0;
+		}
+		std::sort(drawList.begin() + middle, drawList.end(), drawsBefore);
+		std::inplace_merge(drawList.begin(), drawList.begin() + middle, drawList.end(), drawsBefore);
+		added.clear();
+	}
+
+	double milliseconds = std::chrono::duration<double, std::milli>(std::chrono::high_resolution_clock::now() - frameStart).count();
+	if (reuse == VisibilityReuse::None)
+	{
+		rebuiltCount++;
+		rebuildMilliseconds += milliseconds;
+	}
+	else
+	{
+		if (reuse == VisibilityReuse::All)
+			reusedCount++;
+		else
+			patchedCount++;
+		if (rebuiltCount > 0)
+			millisecondsSaved += (std::max)(GetAverageRebuildMilliseconds() - milliseconds, 0.0);
+	}
+}
+
+void VisibilityCache::Invalidate()
+{
+	valid = false;
+}
+
+const std::vector<unsigned int>& VisibilityCache::GetDrawList()
+{
+	return drawList;
+}
+
+Visibility VisibilityCache::GetVisibility(unsigned int entity)
+{
+	return visibilities[entity];
+}
+
+unsigned int VisibilityCache::GetCount(Visibility visibility)
+{
+	return counts[(unsigned int)visibility];
+}
+
+unsigned int VisibilityCache::GetFrameCount() { return frameCount; }
+unsigned int VisibilityCache::GetReusedCount() { return reusedCount; }
+unsigned int VisibilityCache::GetPatchedCount() { return patchedCount; }
+unsigned int VisibilityCache::GetRebuiltCount() { return rebuiltCount; }
+
+float VisibilityCache::GetHitRate()
+{
+	return frameCount > 0 ? (float)(reusedCount + patchedCount) / frameCount : 0.0f;
+}
+
+double VisibilityCache::GetAverageRebuildMilliseconds()
+{
+	return rebuiltCount > 0 ? rebuildMilliseconds / rebuiltCount : 0.0;
+}
+
+double VisibilityCache::GetMillisecondsSaved()
+{
+	return millisecondsSaved;
+}
+
+bool VisibilityCache::DrawsBefore(unsigned int a, unsigned int b) const
+{
+	if (sortKeys[a] != sortKeys[b])
+		return sortKeys[a] < sortKeys[b];
+	return a < b;
+}
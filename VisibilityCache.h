@@ -0,0 +1,104 @@
+#pragma once
+#include <vector>
+#include <chrono>
+
+// What culling decided about one entity
+enum class Visibility : unsigned char
+{
+	Empty,			// no mesh, nothing to draw
+	OutsideView,
+	Occluded,
+	Visible
+};
+
+// How much of last frame's culling a frame gets to keep
+enum class VisibilityReuse
+{
+	All,		// nothing changed, the draw list stands as is
+	Patch,		// only some entities moved - cull just those and Patch them in
+	None		// cull everything and Store it
+};
+
+// --------------------------------------------------------
+// Visibility cache
+//
+// Remembers what culling found last frame, so frames where
+// little or nothing changed don't redo it. It's keyed on the
+// camera's and the entity store's epochs (counters they bump
+// whenever they change), and told how many entities moved:
+// - neither epoch changed and nothing moved: the last draw
+//   list is used again as it is
+// - only a few entities moved: only those are culled again,
+//   and patched into the draw list
+// - otherwise: everything is culled again and stored
+// Anything else culling depends on (the culling settings, the
+// occluders) calls Invalidate when it changes.
+//
+// The draw list is sorted by a key each entity is stored with
+// (the game uses material then mesh, so draws sharing state
+// end up together), then by index - patching it gives exactly
+// the order storing it all again would.
+//
+// Begin and End go around each frame's culling, which is timed
+// to report how often the cache helped and roughly how long it
+// saved, against what rebuilding has taken on average.
+// --------------------------------------------------------
+class VisibilityCache
+{
+public:
+	//the fraction of the entities that can move in a frame before patching them in stops paying off
+	static const float PatchLimit;
+
+	VisibilityCache();
+
+	//what this frame can keep - movedCount is how many entities moved or changed shape since last frame
+	VisibilityReuse Begin(unsigned int cameraEpoch, unsigned int sceneEpoch, unsigned int movedCount, unsigned int entityCount);
+	//after VisibilityReuse::None - every entity's visibility and sort key
+	void Store(const Visibility* visibility, const unsigned long long* sortKeys, unsigned int entityCount);
+	//after VisibilityReuse::Patch - what one entity that moved is now (it's fine to patch one more than once)
+	void Patch(unsigned int entity, Visibility visibility);
+	//finishes the draw list and the timing
+	void End();
+	//the next Begin starts over
+	void Invalidate();
+
+	//the visible entities, in draw order
+	const std::vector<unsigned int>& GetDrawList();
+	Visibility GetVisibility(unsigned int entity);
+	//how many entities are in that state
+	unsigned int GetCount(Visibility visibility);
+
+	// Since it was made
+	unsigned int GetFrameCount();
+	unsigned int GetReusedCount();	// frames that kept everything
+	unsigned int GetPatchedCount();
+	unsigned int GetRebuiltCount();
+	float GetHitRate();				// frames that didn't rebuild, over all of them
+	double GetAverageRebuildMilliseconds();
+	double GetMillisecondsSaved();	// the average rebuild less what each frame that didn't rebuild took instead
+
+private:
+	std::vector<Visibility> visibilities;
+	std::vector<unsigned long long> sortKeys;
+	std::vector<unsigned int> drawList;
+	std::vector<unsigned char> listed;		// by entity, in drawList or added
+	std::vector<unsigned int> added;		// patched to visible, merged into drawList at End
+	bool dropped;							// something patched out of visible, drawList needs compacting
+	unsigned int counts[4];
+
+	bool valid;
+	unsigned int cameraEpoch;
+	unsigned int sceneEpoch;
+	VisibilityReuse reuse;
+	std::chrono::high_resolution_clock::time_point frameStart;
+
+	unsigned int frameCount;
+	unsigned int reusedCount;
+	unsigned int patchedCount;
+	unsigned int rebuiltCount;
+	double rebuildMilliseconds;		// all rebuilds added up
+	double millisecondsSaved;
+
+	//the draw order - by key, then index
+	bool DrawsBefore(unsigned int a, unsigned int b) const;
+};